@@ -0,0 +1,676 @@
+// polycall_bench.c - Microbenchmarks for the protocol and state machine hot paths
+//
+// Every benchmark is calibrated so one sample takes about BENCH_SAMPLE_NS,
+// warmed up, then sampled; the ns/op of each sample feeds the percentiles.
+// Results go to stdout (or --output) as one JSON document.
+//
+// With --baseline FILE each benchmark is also compared with the samples a
+// previous run recorded. A one-sided Mann-Whitney U test over all samples
+// catches a slower median, and the same test over the slowest tenth of
+// each side catches a fatter tail. A benchmark regresses when a test is
+// significant at --alpha and the median (or p99) moved by more than
+// --threshold (or --tail-threshold); any regression makes the exit status 1.
+#include "polycall.h"
+#include "polycall_histogram.h"
+#include "polycall_protocol.h"
+#include "polycall_sm_snapshot.h"
+#include "polycall_state_machine.h"
+#include "network.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BENCH_SAMPLE_NS 2000000ULL      // Target duration of one sample
+#define BENCH_DEFAULT_SAMPLES 50
+#define BENCH_WARMUP_SAMPLES 5
+#define BENCH_MAX_SAMPLES 10000
+#define BENCH_MAX_REPETITIONS 100
+#define BENCH_MAX_NAME 128
+#define BENCH_TAIL_FRACTION 0.1         // Slowest share of samples the tail test sees
+#define BENCH_MIN_TAIL_SAMPLES 5
+
+typedef void (*bench_fn)(void* arg, uint64_t iterations);
+
+typedef struct {
+    char name[BENCH_MAX_NAME];
+    double* samples;                    // Sorted ns/op
+    unsigned int count;
+} bench_baseline_t;
+
+typedef struct {
+    bench_baseline_t* entries;
+    unsigned int count;
+    double alpha;
+    double threshold;                   // Allowed median slowdown, fraction
+    double tail_threshold;              // Allowed p99 slowdown, fraction
+    unsigned int compared;
+    unsigned int regressions;
+} bench_compare_t;
+
+typedef struct {
+    const char* filter;
+    unsigned int samples;               // Per repetition
+    unsigned int repetitions;
+    FILE* out;
+    bool first;
+    bench_compare_t* compare;           // NULL unless --baseline
+} bench_runner_t;
+
+static volatile uint64_t bench_sink;    // Keeps results observable
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, unsigned int count, double p) {
+    double rank = p / 100.0 * (count - 1);
+    unsigned int low = (unsigned int)rank;
+    if (low + 1 >= count) return sorted[count - 1];
+    return sorted[low] + (sorted[low + 1] - sorted[low]) * (rank - low);
+}
+
+// Baseline comparison
+
+// One-sided Mann-Whitney U: probability of ranks at least this skewed
+// towards x being larger if x and y came from the same distribution.
+// Normal approximation with tie correction; both inputs sorted.
+static double mann_whitney_greater(const double* x, unsigned int nx, const double* y, unsigned int ny) {
+    if (nx == 0 || ny == 0) return 1.0;
+
+    double rank_sum = 0, tie_term = 0;
+    unsigned int i = 0, j = 0, rank = 1;
+    while (i < nx || j < ny) {
+        double value = (j >= ny || (i < nx && x[i] <= y[j])) ? x[i] : y[j];
+        unsigned int in_x = 0, in_y = 0;
+        while (i < nx && x[i] == value) { i++; in_x++; }
+        while (j < ny && y[j] == value) { j++; in_y++; }
+
+        double ties = in_x + in_y;
+        rank_sum += in_x * (rank + (ties - 1) / 2.0);
+        tie_term += ties * ties * ties - ties;
+        rank += in_x + in_y;
+    }
+
+    double n = (double)nx + ny;
+    double u = rank_sum - (double)nx * (nx + 1) / 2.0;
+    double variance = (double)nx * ny / 12.0 * ((n + 1) - tie_term / (n * (n - 1)));
+    if (variance <= 0) return 1.0;
+    double z = (u - (double)nx * ny / 2.0 - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+// Read name and samples_ns of every benchmark in a file this runner wrote
+static bool load_baseline(const char* path, bench_compare_t* compare) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return false;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    char* text = size > 0 ? malloc((size_t)size + 1) : NULL;
+    if (!text || fread(text, 1, (size_t)size, in) != (size_t)size) {
+        fprintf(stderr, "%s: cannot read baseline\n", path);
+        free(text);
+        fclose(in);
+        return false;
+    }
+    text[size] = '\0';
+    fclose(in);
+
+    const char* cursor = text;
+    const char* name;
+    while ((name = strstr(cursor, "\"name\": \"")) != NULL) {
+        name += strlen("\"name\": \"");
+        const char* name_end = strchr(name, '"');
+        const char* list = strstr(name, "\"samples_ns\": [");
+        if (!name_end || !list || name_end - name >= BENCH_MAX_NAME) break;
+
+        bench_baseline_t* grown = realloc(compare->entries, (compare->count + 1) * sizeof(bench_baseline_t));
+        if (!grown) break;
+        compare->entries = grown;
+        bench_baseline_t* entry = &compare->entries[compare->count];
+        memcpy(entry->name, name, (size_t)(name_end - name));
+        entry->name[name_end - name] = '\0';
+        entry->count = 0;
+        entry->samples = NULL;
+
+        unsigned int capacity = 0;
+        char* end = (char*)list + strlen("\"samples_ns\": [");
+        for (;;) {
+            while (*end == ' ' || *end == ',' || *end == '\n') end++;
+            if (*end == ']' || *end == '\0') break;
+            char* next;
+            double value = strtod(end, &next);
+            if (next == end) break;
+            if (entry->count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                double* resized = realloc(entry->samples, capacity * sizeof(double));
+                if (!resized) break;
+                entry->samples = resized;
+            }
+            entry->samples[entry->count++] = value;
+            end = next;
+        }
+        qsort(entry->samples, entry->count, sizeof(double), compare_double);
+        if (entry->count > 0) compare->count++;
+        else free(entry->samples);
+        cursor = end;
+    }
+    free(text);
+
+    if (compare->count == 0) {
+        fprintf(stderr, "%s: no benchmarks with samples\n", path);
+        return false;
+    }
+    return true;
+}
+
+static void compare_with_baseline(bench_compare_t* compare, const char* name,
+                                  const double* sorted, unsigned int count) {
+    const bench_baseline_t* base = NULL;
+    for (unsigned int i = 0; i < compare->count && !base; i++) {
+        if (strcmp(compare->entries[i].name, name) == 0) base = &compare->entries[i];
+    }
+    if (!base) {
+        fprintf(stderr, "%-36s %10s\n", name, "new");
+        return;
+    }
+
+    double base_p50 = percentile(base->samples, base->count, 50.0);
+    double base_p99 = percentile(base->samples, base->count, 99.0);
+    double p50 = percentile(sorted, count, 50.0);
+    double p99 = percentile(sorted, count, 99.0);
+    double median_change = base_p50 > 0 ? p50 / base_p50 - 1.0 : 0.0;
+    double tail_change = base_p99 > 0 ? p99 / base_p99 - 1.0 : 0.0;
+
+    // Tail test on the slowest tenth of each side
+    unsigned int tail = (unsigned int)ceil(count * BENCH_TAIL_FRACTION);
+    unsigned int base_tail = (unsigned int)ceil(base->count * BENCH_TAIL_FRACTION);
+    if (tail < BENCH_MIN_TAIL_SAMPLES) tail = count < BENCH_MIN_TAIL_SAMPLES ? count : BENCH_MIN_TAIL_SAMPLES;
+    if (base_tail < BENCH_MIN_TAIL_SAMPLES) {
+        base_tail = base->count < BENCH_MIN_TAIL_SAMPLES ? base->count : BENCH_MIN_TAIL_SAMPLES;
+    }
+
+    double p_median = mann_whitney_greater(sorted, count, base->samples, base->count);
+    double p_tail = mann_whitney_greater(sorted + count - tail, tail,
+                                         base->samples + base->count - base_tail, base_tail);
+    double p_faster = mann_whitney_greater(base->samples, base->count, sorted, count);
+
+    const char* verdict = "ok";
+    if (p_median < compare->alpha && median_change > compare->threshold) {
+        verdict = "REGRESSION";
+    } else if (p_tail < compare->alpha && tail_change > compare->tail_threshold) {
+        verdict = "TAIL REGRESSION";
+    } else if (p_faster < compare->alpha && median_change < -compare->threshold) {
+        verdict = "faster";
+    }
+    if (verdict[0] == 'R' || verdict[0] == 'T') compare->regressions++;
+    compare->compared++;
+
+    fprintf(stderr, "%-36s %10.2f %10.2f %+7.1f%% %8.4f %10.2f %10.2f %+7.1f%% %8.4f  %s\n",
+            name, base_p50, p50, median_change * 100.0, p_median,
+            base_p99, p99, tail_change * 100.0, p_tail, verdict);
+}
+
+static uint64_t time_batch(bench_fn fn, void* arg, uint64_t iterations) {
+    uint64_t start = polycall_monotonic_ns();
+    fn(arg, iterations);
+    return polycall_monotonic_ns() - start;
+}
+
+// Run one benchmark; bytes_per_op > 0 adds a GB/s figure
+static void bench_run(bench_runner_t* runner, const char* name, bench_fn fn, void* arg,
+                      size_t bytes_per_op) {
+    if (runner->filter && !strstr(name, runner->filter)) return;
+
+    // Grow the batch until it fills a sample
+    uint64_t iterations = 1;
+    for (;;) {
+        uint64_t elapsed = time_batch(fn, arg, iterations);
+        if (elapsed >= BENCH_SAMPLE_NS / 4 || iterations >= (1ULL << 40)) {
+            if (elapsed > 0) {
+                double scaled = (double)iterations * BENCH_SAMPLE_NS / (double)elapsed;
+                iterations = scaled < 1.0 ? 1 : (uint64_t)scaled;
+            }
+            break;
+        }
+        iterations *= 4;
+    }
+
+    // Each repetition warms up again, so one unlucky stretch (a frequency
+    // change, a noisy neighbour) is diluted rather than the whole result
+    unsigned int count = runner->samples * runner->repetitions;
+    double* samples = malloc(count * sizeof(double));
+    double* sorted = malloc(count * sizeof(double));
+    if (!samples || !sorted) {
+        free(samples);
+        free(sorted);
+        return;
+    }
+
+    double total = 0;
+    for (unsigned int rep = 0, n = 0; rep < runner->repetitions; rep++) {
+        for (unsigned int i = 0; i < BENCH_WARMUP_SAMPLES; i++) time_batch(fn, arg, iterations);
+        for (unsigned int i = 0; i < runner->samples; i++, n++) {
+            samples[n] = (double)time_batch(fn, arg, iterations) / (double)iterations;
+            total += samples[n];
+        }
+    }
+    memcpy(sorted, samples, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), compare_double);
+
+    double mean = total / count;
+    double p50 = percentile(sorted, count, 50.0);
+
+    FILE* out = runner->out;
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"samples\": %u, \"repetitions\": %u,\n",
+            runner->first ? "" : ",", name, (unsigned long long)iterations, count, runner->repetitions);
+    fprintf(out, "     \"ns_per_op\": {\"mean\": %.3f, \"min\": %.3f, \"p50\": %.3f, "
+            "\"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+            mean, sorted[0], p50, percentile(sorted, count, 90.0),
+            percentile(sorted, count, 99.0), sorted[count - 1]);
+    fprintf(out, "     \"ops_per_sec\": %.1f", p50 > 0 ? 1e9 / p50 : 0.0);
+    if (bytes_per_op) {
+        fprintf(out, ", \"gb_per_sec\": %.3f", p50 > 0 ? (double)bytes_per_op / p50 : 0.0);
+    }
+    fprintf(out, ",\n     \"samples_ns\": [");
+    for (unsigned int i = 0; i < count; i++) {
+        fprintf(out, "%s%.3f", i ? ", " : "", samples[i]);
+    }
+    fprintf(out, "]}");
+    fflush(out);
+    runner->first = false;
+
+    if (runner->compare) compare_with_baseline(runner->compare, name, sorted, count);
+
+    free(samples);
+    free(sorted);
+}
+
+// Checksum
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+} checksum_arg_t;
+
+static void bench_checksum(void* arg, uint64_t iterations) {
+    checksum_arg_t* a = arg;
+    uint32_t acc = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc ^= polycall_protocol_calculate_checksum(a->data, a->size);
+    }
+    bench_sink = acc;
+}
+
+static void checksum_benchmarks(bench_runner_t* runner) {
+    static const size_t sizes[] = { 64, 256, 1024, 4096, 16384, 65536, 1024 * 1024 };
+    uint8_t* data = malloc(sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+    if (!data) return;
+    for (size_t i = 0; i < sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]; i++) {
+        data[i] = (uint8_t)(i * 131 + 7);
+    }
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "checksum/%zu", sizes[i]);
+        checksum_arg_t arg = { data, sizes[i] };
+        bench_run(runner, name, bench_checksum, &arg, sizes[i]);
+    }
+    free(data);
+}
+
+// Protocol
+
+typedef struct {
+    polycall_protocol_context_t protocol;
+    polycall_protocol_context_t peer;
+    NetworkEndpoint endpoints[2];
+    uint8_t* frame;
+    size_t frame_length;
+    uint64_t handled;
+} protocol_arg_t;
+
+static void count_command(polycall_protocol_context_t* ctx, const char* command, size_t length) {
+    (void)command;
+    ((protocol_arg_t*)ctx->user_data)->handled += length;
+}
+
+static void bench_header_create(void* arg, uint64_t iterations) {
+    (void)arg;
+    uint32_t acc = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        polycall_message_header_t header =
+            polycall_protocol_create_header(POLYCALL_MSG_COMMAND, (size_t)(i & 1023), POLYCALL_FLAG_NONE);
+        acc += header.payload_length + header.version;
+    }
+    bench_sink = acc;
+}
+
+static void bench_header_validate(void* arg, uint64_t iterations) {
+    protocol_arg_t* a = arg;
+    const polycall_message_header_t* header = (const polycall_message_header_t*)a->frame;
+    const uint8_t* payload = a->frame + sizeof(*header);
+    uint64_t ok = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        ok += polycall_protocol_version_compatible(header->version) &&
+              polycall_protocol_verify_checksum(header, payload, header->payload_length);
+    }
+    bench_sink = ok;
+}
+
+static void bench_process(void* arg, uint64_t iterations) {
+    protocol_arg_t* a = arg;
+    uint64_t ok = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        ok += polycall_protocol_process(&a->protocol, a->frame, a->frame_length);
+    }
+    bench_sink = ok;
+}
+
+// One command over the in-process loopback: frame, hand off, deframe, dispatch
+static void bench_loopback_round(void* arg, uint64_t iterations) {
+    protocol_arg_t* a = arg;
+    const uint8_t* payload = a->frame + sizeof(polycall_message_header_t);
+    size_t length = a->frame_length - sizeof(polycall_message_header_t);
+    for (uint64_t i = 0; i < iterations; i++) {
+        polycall_protocol_send(&a->peer, POLYCALL_MSG_COMMAND, payload, length, POLYCALL_FLAG_NONE);
+        polycall_protocol_receive(&a->protocol);
+    }
+    bench_sink = a->handled;
+}
+
+static bool build_frame(protocol_arg_t* arg, size_t payload_length) {
+    free(arg->frame);
+    arg->frame_length = sizeof(polycall_message_header_t) + payload_length;
+    arg->frame = malloc(arg->frame_length);
+    if (!arg->frame) return false;
+
+    uint8_t* payload = arg->frame + sizeof(polycall_message_header_t);
+    for (size_t i = 0; i < payload_length; i++) payload[i] = (uint8_t)('a' + i % 26);
+
+    polycall_message_header_t header =
+        polycall_protocol_create_header(POLYCALL_MSG_COMMAND, payload_length, POLYCALL_FLAG_NONE);
+    header.sequence = 1;
+    header.checksum = polycall_protocol_calculate_checksum(payload, payload_length);
+    memcpy(arg->frame, &header, sizeof(header));
+    return true;
+}
+
+static void protocol_benchmarks(bench_runner_t* runner, polycall_context_t ctx) {
+    static const size_t sizes[] = { 16, 256, 4096 };
+    protocol_arg_t* arg = calloc(1, sizeof(protocol_arg_t));
+    if (!arg || !net_loopback_pair(&arg->endpoints[0], &arg->endpoints[1], 0)) {
+        free(arg);
+        return;
+    }
+
+    polycall_protocol_config_t config = {
+        .callbacks = { .on_command = count_command },
+        .max_message_size = 1 << 20,
+        .user_data = arg
+    };
+    polycall_protocol_config_t peer_config = { .max_message_size = 1 << 20 };
+    if (!polycall_protocol_init(&arg->protocol, ctx, &arg->endpoints[0], &config) ||
+        !polycall_protocol_init(&arg->peer, ctx, &arg->endpoints[1], &peer_config)) {
+        net_close(&arg->endpoints[0]);
+        net_close(&arg->endpoints[1]);
+        free(arg);
+        return;
+    }
+
+    bench_run(runner, "header/create", bench_header_create, arg, 0);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (!build_frame(arg, sizes[i])) break;
+        char name[64];
+        snprintf(name, sizeof(name), "header/validate/%zu", sizes[i]);
+        bench_run(runner, name, bench_header_validate, arg, 0);
+        snprintf(name, sizeof(name), "protocol/process/%zu", sizes[i]);
+        bench_run(runner, name, bench_process, arg, arg->frame_length);
+        snprintf(name, sizeof(name), "protocol/loopback_round/%zu", sizes[i]);
+        bench_run(runner, name, bench_loopback_round, arg, arg->frame_length);
+    }
+
+    polycall_protocol_cleanup(&arg->protocol);
+    polycall_protocol_cleanup(&arg->peer);
+    net_close(&arg->endpoints[0]);
+    net_close(&arg->endpoints[1]);
+    free(arg->frame);
+    free(arg);
+}
+
+// State machine
+
+typedef struct {
+    PolyCall_StateMachine* sm;
+    PolyCall_StateMachine* standby;
+    unsigned int states;
+    char names[POLYCALL_MAX_STATES][POLYCALL_MAX_NAME_LENGTH];
+    uint8_t* buffer;
+    size_t capacity;
+    size_t length;
+    PolyCall_StateSnapshot snapshot;
+} sm_arg_t;
+
+// A ring of states; transition i moves state i to i + 1
+static PolyCall_StateMachine* build_ring(polycall_context_t ctx, sm_arg_t* arg) {
+    PolyCall_StateMachine* sm;
+    if (polycall_sm_create_with_integrity(ctx, &sm, NULL) != POLYCALL_SM_SUCCESS) return NULL;
+
+    for (unsigned int i = 0; i < arg->states; i++) {
+        char name[POLYCALL_MAX_NAME_LENGTH];
+        snprintf(name, sizeof(name), "state_%u", i);
+        polycall_sm_add_state(sm, name, NULL, NULL, false);
+    }
+    for (unsigned int i = 0; i < arg->states; i++) {
+        snprintf(arg->names[i], sizeof(arg->names[i]), "advance_%u", i);
+        polycall_sm_add_transition(sm, arg->names[i], i, (i + 1) % arg->states, NULL, NULL);
+    }
+    return sm;
+}
+
+static void bench_transition_name(void* arg, uint64_t iterations) {
+    sm_arg_t* a = arg;
+    uint64_t ok = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        ok += polycall_sm_execute_transition(a->sm, a->names[a->sm->current_state]) == POLYCALL_SM_SUCCESS;
+    }
+    bench_sink = ok;
+}
+
+static void bench_transition_id(void* arg, uint64_t iterations) {
+    sm_arg_t* a = arg;
+    uint64_t ok = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        ok += polycall_sm_execute_transition_id(a->sm, a->sm->current_state) == POLYCALL_SM_SUCCESS;
+    }
+    bench_sink = ok;
+}
+
+static void bench_state_snapshot(void* arg, uint64_t iterations) {
+    sm_arg_t* a = arg;
+    uint64_t ok = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        ok += polycall_sm_create_state_snapshot(a->sm, (unsigned int)(i % a->states), &a->snapshot) ==
+              POLYCALL_SM_SUCCESS;
+    }
+    bench_sink = ok;
+}
+
+// Restoring bumps the state's version, so each restore needs a fresh snapshot
+static void bench_state_round_trip(void* arg, uint64_t iterations) {
+    sm_arg_t* a = arg;
+    uint64_t ok = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        unsigned int state = (unsigned int)(i % a->states);
+        ok += polycall_sm_create_state_snapshot(a->sm, state, &a->snapshot) == POLYCALL_SM_SUCCESS &&
+              polycall_sm_restore_state_from_snapshot(a->sm, &a->snapshot) == POLYCALL_SM_SUCCESS;
+    }
+    bench_sink = ok;
+}
+
+static void bench_snapshot_base(void* arg, uint64_t iterations) {
+    sm_arg_t* a = arg;
+    uint64_t ok = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        ok += polycall_sm_snapshot_base(a->sm, a->buffer, a->capacity, &a->length) == POLYCALL_SM_SUCCESS;
+    }
+    bench_sink = ok;
+}
+
+static void bench_snapshot_apply(void* arg, uint64_t iterations) {
+    sm_arg_t* a = arg;
+    uint64_t ok = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        ok += polycall_sm_snapshot_apply(a->standby, a->buffer, a->length) == POLYCALL_SM_SUCCESS;
+    }
+    bench_sink = ok;
+}
+
+// One transition, then the delta it leaves behind
+static void bench_snapshot_delta(void* arg, uint64_t iterations) {
+    sm_arg_t* a = arg;
+    uint64_t ok = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        polycall_sm_execute_transition_id(a->sm, a->sm->current_state);
+        ok += polycall_sm_snapshot_delta(a->sm, a->buffer, a->capacity, &a->length) == POLYCALL_SM_SUCCESS;
+    }
+    bench_sink = ok;
+}
+
+static void state_machine_benchmarks(bench_runner_t* runner, polycall_context_t ctx) {
+    static const unsigned int counts[] = { 2, 8, POLYCALL_MAX_STATES };
+    sm_arg_t* arg = calloc(1, sizeof(sm_arg_t));
+    if (!arg) return;
+    arg->capacity = 64 * 1024;
+    arg->buffer = malloc(arg->capacity);
+
+    for (size_t i = 0; arg->buffer && i < sizeof(counts) / sizeof(counts[0]); i++) {
+        arg->states = counts[i];
+        arg->sm = build_ring(ctx, arg);
+        arg->standby = build_ring(ctx, arg);
+        if (!arg->sm || !arg->standby) break;
+
+        char name[64];
+        snprintf(name, sizeof(name), "sm/transition_name/%u", arg->states);
+        bench_run(runner, name, bench_transition_name, arg, 0);
+        snprintf(name, sizeof(name), "sm/transition_id/%u", arg->states);
+        bench_run(runner, name, bench_transition_id, arg, 0);
+
+        snprintf(name, sizeof(name), "sm/state_snapshot/%u", arg->states);
+        bench_run(runner, name, bench_state_snapshot, arg, 0);
+        snprintf(name, sizeof(name), "sm/state_snapshot_restore/%u", arg->states);
+        bench_run(runner, name, bench_state_round_trip, arg, 0);
+
+        snprintf(name, sizeof(name), "sm/snapshot_base/%u", arg->states);
+        bench_run(runner, name, bench_snapshot_base, arg, 0);
+        snprintf(name, sizeof(name), "sm/snapshot_apply/%u", arg->states);
+        bench_run(runner, name, bench_snapshot_apply, arg, 0);
+        snprintf(name, sizeof(name), "sm/snapshot_delta/%u", arg->states);
+        bench_run(runner, name, bench_snapshot_delta, arg, 0);
+
+        polycall_sm_destroy(arg->sm);
+        polycall_sm_destroy(arg->standby);
+        arg->sm = arg->standby = NULL;
+    }
+
+    if (arg->sm) polycall_sm_destroy(arg->sm);
+    if (arg->standby) polycall_sm_destroy(arg->standby);
+    free(arg->buffer);
+    free(arg);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [--filter SUBSTRING] [--samples N] [--repetitions N] [--output FILE]\n"
+            "       [--baseline FILE [--alpha P] [--threshold PCT] [--tail-threshold PCT]]\n",
+            program);
+}
+
+int main(int argc, char** argv) {
+    bench_runner_t runner = {
+        .samples = BENCH_DEFAULT_SAMPLES,
+        .repetitions = 1,
+        .out = stdout,
+        .first = true
+    };
+    bench_compare_t compare = { .alpha = 0.01, .threshold = 0.05, .tail_threshold = 0.10 };
+    const char* output = NULL;
+    const char* baseline = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            runner.filter = argv[++i];
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            runner.samples = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+            runner.repetitions = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc) {
+            compare.alpha = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            compare.threshold = strtod(argv[++i], NULL) / 100.0;
+        } else if (strcmp(argv[i], "--tail-threshold") == 0 && i + 1 < argc) {
+            compare.tail_threshold = strtod(argv[++i], NULL) / 100.0;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (runner.samples < 1 || runner.samples > BENCH_MAX_SAMPLES) {
+        fprintf(stderr, "--samples must be 1..%d\n", BENCH_MAX_SAMPLES);
+        return 2;
+    }
+    if (runner.repetitions < 1 || runner.repetitions > BENCH_MAX_REPETITIONS) {
+        fprintf(stderr, "--repetitions must be 1..%d\n", BENCH_MAX_REPETITIONS);
+        return 2;
+    }
+    if (compare.alpha <= 0 || compare.alpha >= 1 || compare.threshold < 0 || compare.tail_threshold < 0) {
+        fprintf(stderr, "--alpha must be in (0, 1) and thresholds >= 0\n");
+        return 2;
+    }
+    if (baseline) {
+        if (!load_baseline(baseline, &compare)) return 2;
+        runner.compare = &compare;
+        fprintf(stderr, "%-36s %10s %10s %8s %8s %10s %10s %8s %8s\n", "benchmark (ns/op)",
+                "base p50", "p50", "change", "p", "base p99", "p99", "change", "p");
+    }
+    if (output && !(runner.out = fopen(output, "w"))) {
+        perror(output);
+        return 1;
+    }
+
+    polycall_context_t ctx;
+    polycall_config_t config = { .memory_pool_size = 4 * 1024 * 1024 };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "polycall_init_with_config failed\n");
+        return 1;
+    }
+
+    fprintf(runner.out, "{\"library_version\": \"%s\", \"sample_target_ns\": %llu,\n \"benchmarks\": [",
+            polycall_get_version(), (unsigned long long)BENCH_SAMPLE_NS);
+    checksum_benchmarks(&runner);
+    protocol_benchmarks(&runner, ctx);
+    state_machine_benchmarks(&runner, ctx);
+    fprintf(runner.out, "\n]}\n");
+
+    polycall_cleanup(ctx);
+    if (runner.out != stdout) fclose(runner.out);
+
+    int status = 0;
+    if (runner.compare) {
+        fprintf(stderr, "%u benchmarks compared with %s, %u regressed\n",
+                compare.compared, baseline, compare.regressions);
+        if (compare.regressions > 0) status = 1;
+        for (unsigned int i = 0; i < compare.count; i++) free(compare.entries[i].samples);
+        free(compare.entries);
+    }
+    return status;
+}
@@ -29,6 +29,10 @@
     #include <unistd.h>
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 // Network Constants
 #define NET_MAX_CLIENTS 10
@@ -36,6 +40,8 @@
 #define NET_MAX_BACKLOG 5
 #define NET_TIMEOUT_SEC 1
 #define NET_TIMEOUT_USEC 0
+#define NET_LOOPBACK_CAPACITY 1024   // Default frames in flight per direction
+#define NET_WRITE_QUEUE_LIMIT (1024 * 1024)  // Queued output per connection before EAGAIN
 
 // Network Error Codes
 typedef enum {
@@ -55,6 +61,7 @@ typedef enum {
     NET_TCP,            // TCP protocol
     NET_UDP,            // UDP protocol
     NET_RAW,           // Raw sockets
+    NET_LOOPBACK,      // In-process pair, see net_loopback_pair
     NET_PROTOCOL_MAX   // Protocol count
 } NetworkProtocol;
 
@@ -66,8 +73,12 @@ typedef enum {
     NET_ROLE_MAX      // Role count
 } NetworkRole;
 
-// Forward declaration
+// Forward declarations
 typedef struct PhantomDaemon PhantomDaemon;
+typedef struct net_loopback_port net_loopback_port_t;
+typedef struct net_write_chunk net_write_chunk_t;
+struct polycall_context;
+struct polycall_worker_pool;
 
 // Client Connection State
 typedef struct {
@@ -75,6 +86,10 @@ typedef struct {
     bool is_active;                 // Active flag
     int socket_fd;                  // Socket descriptor
     struct sockaddr_in addr;        // Client address
+    uint32_t generation;            // Bumped for each connection in this slot
+    net_write_chunk_t* write_head;  // Output the socket has not accepted yet
+    net_write_chunk_t* write_tail;
+    size_t write_queued;            // Bytes waiting in the write queue
 } ClientState;
 
 // Network Endpoint
@@ -88,6 +103,9 @@ typedef struct {
     struct sockaddr_in addr;        // Socket address
     PhantomDaemon* phantom;         // Phantom daemon reference
     void* user_data;               // Added user data field
+    net_loopback_port_t* loopback;  // NET_LOOPBACK link, NULL otherwise
+    ClientState* client;            // Program connection this endpoint writes to
+    uint32_t client_generation;     // Connection the endpoint was made for
 } NetworkEndpoint;
 
 // Network Packet
@@ -110,6 +128,13 @@ typedef struct {
         void (*on_disconnect)(NetworkEndpoint*);               // Disconnect handler
     } handlers;
     PhantomDaemon* phantom;         // Phantom daemon reference
+    struct polycall_context* context; // Owner: allocator and metrics (NULL: heap, none)
+    char* recv_buffer;              // NET_BUFFER_SIZE receive buffer
+    struct polycall_worker_pool* worker_pool; // Runs on_receive (NULL: inline on net_run)
+    bool ordered_dispatch;          // Keep each connection's packets in order on the pool
+    int in_flight;                  // Packets queued on the pool, not yet handled
+    pthread_mutex_t dispatch_lock;  // Last pooled handler vs net_cleanup_program
+    pthread_cond_t dispatch_done;   // Signalled when in_flight drops to 0
 } NetworkProgram;
 
 // Core Network Functions
@@ -119,12 +144,47 @@ ssize_t net_send(NetworkEndpoint* endpoint, NetworkPacket* packet);
 ssize_t net_receive(NetworkEndpoint* endpoint, NetworkPacket* packet);
 void net_run(NetworkProgram* program);
 
+// With a worker pool, net_run hands each received packet (copied) to the
+// pool and returns to select() at once. Handlers may send on the endpoint
+// they were given from any thread: output goes straight to the socket and
+// whatever it cannot take is queued on the connection and flushed by
+// net_run, so replies keep their order. Once NET_WRITE_QUEUE_LIMIT bytes
+// are queued, further sends write nothing and fail with EAGAIN until
+// net_run has drained the queue; a send into an empty queue is always
+// accepted whole. Sends for a connection that has since closed fail with
+// EPIPE. net_cleanup_program waits for packets still on the pool.
+//
+// Handlers run with no program lock held, so they may take clients_lock
+// themselves, e.g. to walk the client table.
+
+// Loopback Transport
+//
+// Two endpoints joined by a pair of lock-free single-producer,
+// single-consumer frame rings; no sockets or system calls are involved.
+// Each endpoint may be sent on by one thread and received on by another.
+// net_send copies the frame; net_send_owned hands packet->data (from
+// net_packet_alloc) to the peer, which gets the same buffer back from
+// net_receive_owned. Both sides never block: a full ring fails with
+// EAGAIN, as does an empty one, and an empty ring whose peer has closed
+// returns 0 like recv() at end of stream. Capacity is rounded up to a
+// power of two, 0 selects NET_LOOPBACK_CAPACITY.
+bool net_loopback_pair(NetworkEndpoint* a, NetworkEndpoint* b, size_t capacity);
+ssize_t net_send_owned(NetworkEndpoint* endpoint, NetworkPacket* packet);
+ssize_t net_receive_owned(NetworkEndpoint* endpoint, NetworkPacket* packet);
+void* net_packet_alloc(size_t size);
+void net_packet_free(void* data);
+
 // Utility Functions
 bool net_is_port_in_use(uint16_t port);
 bool net_release_port(uint16_t port);
 void net_init_client_state(ClientState* state);
 void net_cleanup_client_state(ClientState* state);
 void net_init_program(NetworkProgram* program);
+void net_init_program_with_context(NetworkProgram* program, struct polycall_context* context);
 void net_cleanup_program(NetworkProgram* program);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // NETWORK_H
\ No newline at end of file
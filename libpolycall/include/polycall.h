@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include "polycall_error.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,6 +30,12 @@ typedef enum {
     POLYCALL_ERROR
 } polycall_status_t;
 
+/* Configuration flags: placement of the context's memory chunks. Each
+ * falls back silently when the system cannot honour it. */
+#define POLYCALL_MEM_HUGEPAGES  0x1u    /* 2 MB pages: hugetlb, else THP */
+#define POLYCALL_MEM_NUMA_LOCAL 0x2u    /* Prefer the reserving thread's node */
+#define POLYCALL_MEM_PREFAULT   0x4u    /* Fault chunks in when reserved */
+
 /* Configuration structure */
 typedef struct polycall_config {
     unsigned int flags;
@@ -65,10 +72,13 @@ void polycall_cleanup(polycall_context_t ctx);
 const char* polycall_get_version(void);
 
 /**
- * Get the last error message from the PolyCall library
+ * Get the last error message recorded by the calling thread
+ * 
+ * Errors are thread-local (see polycall_error.h); ctx is accepted for
+ * compatibility and not consulted.
  * 
- * @param ctx Context to get error from
- * @return Null-terminated error message string
+ * @param ctx Context the failing call used
+ * @return Null-terminated error message string, "" if none
  */
 const char* polycall_get_last_error(polycall_context_t ctx);
 
@@ -0,0 +1,942 @@
+#ifndef POLYCALL_HPP
+#define POLYCALL_HPP
+
+/*
+ * C++20 coroutine layer over the C core (header-only).
+ *
+ * RAII handles own contexts, endpoints, protocol sessions and state
+ * machines. polycall::task coroutines co_await calls, accepted
+ * connections and transitions; a polycall::event_loop resumes them.
+ *
+ * Received payloads are std::span views into the frame the protocol layer
+ * is processing, so the common path copies nothing. A view stays valid
+ * until the coroutine holding it next suspends; copy it into a
+ * polycall::buffer to keep it longer.
+ *
+ *   polycall::task<> client(polycall::session& s) {
+ *       for (int i = 0; i < 100; i++) {
+ *           polycall::message reply = co_await s.call(polycall::bytes("ping"));
+ *           if (!reply.ok) co_return;
+ *       }
+ *   }
+ *
+ *   polycall::event_loop loop;
+ *   loop.spawn(client(session));
+ *   loop.run();
+ *
+ * Calls on one session may be pipelined from several coroutines; replies
+ * are matched to calls in order. The loop is single-threaded: everything
+ * it resumes runs on the thread calling run(), and completions from other
+ * threads (async transitions on a worker pool) are posted back to it.
+ * Sessions must outlive the coroutines awaiting them.
+ */
+
+#if __cplusplus < 202002L
+#error "polycall.hpp requires C++20"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "polycall.h"
+#include "polycall_protocol.h"
+#include "polycall_state_machine.h"
+#include "network.h"
+
+namespace polycall {
+
+class event_loop;
+template <typename T = void> class task;
+
+// Thrown by constructors; carries this thread's polycall error code
+class error : public std::runtime_error {
+public:
+    explicit error(const char* what)
+        : std::runtime_error(what), code_(polycall_error_code()) {}
+
+    polycall_error_code_t code() const noexcept { return code_; }
+
+private:
+    polycall_error_code_t code_;
+};
+
+// Move-only bytes from net_packet_alloc
+class buffer {
+public:
+    buffer() noexcept = default;
+
+    explicit buffer(std::size_t size)
+        : data_(static_cast<std::byte*>(net_packet_alloc(size ? size : 1))), size_(size) {
+        if (!data_) throw std::bad_alloc();
+    }
+
+    // Take ownership of a block from net_packet_alloc
+    static buffer adopt(void* data, std::size_t size) noexcept {
+        buffer owned;
+        owned.data_ = static_cast<std::byte*>(data);
+        owned.size_ = size;
+        return owned;
+    }
+
+    static buffer copy_of(std::span<const std::byte> bytes) {
+        buffer copy(bytes.size());
+        if (!bytes.empty()) std::memcpy(copy.data_, bytes.data(), bytes.size());
+        return copy;
+    }
+
+    buffer(buffer&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+    buffer& operator=(buffer&& other) noexcept {
+        if (this != &other) {
+            net_packet_free(data_);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    buffer(const buffer&) = delete;
+    buffer& operator=(const buffer&) = delete;
+
+    ~buffer() { net_packet_free(data_); }
+
+    std::byte* data() noexcept { return data_; }
+    const std::byte* data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    std::span<std::byte> span() noexcept { return {data_, size_}; }
+    std::span<const std::byte> span() const noexcept { return {data_, size_}; }
+
+    // Give up ownership; release with net_packet_free
+    void* release() noexcept {
+        size_ = 0;
+        return std::exchange(data_, nullptr);
+    }
+
+private:
+    std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+inline std::span<const std::byte> bytes(std::string_view text) noexcept {
+    return std::as_bytes(std::span<const char>(text.data(), text.size()));
+}
+
+inline std::string_view text(std::span<const std::byte> bytes) noexcept {
+    return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+// A received payload: a view into the frame being processed, or into
+// storage when it arrived before anyone awaited it
+struct message {
+    bool ok = false;                        // false: peer replied ERROR, send failed or closed
+    std::span<const std::byte> payload;
+    buffer storage;
+};
+
+class context {
+public:
+    explicit context(const polycall_config_t* config = nullptr) {
+        if (polycall_init_with_config(&ctx_, config) != POLYCALL_SUCCESS) {
+            throw error("polycall: context initialization failed");
+        }
+    }
+
+    context(context&& other) noexcept : ctx_(std::exchange(other.ctx_, nullptr)) {}
+
+    context& operator=(context&& other) noexcept {
+        if (this != &other) {
+            reset();
+            ctx_ = std::exchange(other.ctx_, nullptr);
+        }
+        return *this;
+    }
+
+    context(const context&) = delete;
+    context& operator=(const context&) = delete;
+
+    ~context() { reset(); }
+
+    polycall_context_t get() const noexcept { return ctx_; }
+
+private:
+    void reset() noexcept {
+        if (ctx_) polycall_cleanup(ctx_);
+        ctx_ = nullptr;
+    }
+
+    polycall_context_t ctx_ = nullptr;
+};
+
+namespace detail {
+
+inline event_loop*& current_loop() noexcept {
+    thread_local event_loop* loop = nullptr;
+    return loop;
+}
+
+inline event_loop* require_loop() {
+    event_loop* loop = current_loop();
+    if (!loop) throw std::logic_error("polycall: awaited outside an event_loop");
+    return loop;
+}
+
+struct promise_base {
+    std::coroutine_handle<> continuation;
+    event_loop* owner = nullptr;            // Set for spawned tasks
+    std::exception_ptr exception;
+
+    struct final_awaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    final_awaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct promise : promise_base {
+    std::optional<T> value;
+
+    task<T> get_return_object() noexcept;
+    template <typename U>
+    void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+};
+
+template <>
+struct promise<void> : promise_base {
+    task<void> get_return_object() noexcept;
+    void return_void() const noexcept {}
+};
+
+struct waiter {
+    std::coroutine_handle<> handle;
+    message result;
+};
+
+struct session_state {
+    polycall_protocol_context_t protocol{};
+    NetworkEndpoint* endpoint = nullptr;
+    std::deque<waiter*> calls;              // Oldest first, replies match in order
+    std::deque<waiter*> commands;
+    std::deque<buffer> backlog;             // Commands nobody awaited yet
+    std::vector<std::byte> inbox;           // Partial stream frames
+    event_loop* loop = nullptr;             // Pumping loop while awaited
+    waiter* ready = nullptr;                // Completed by the frame being processed
+    bool* destroyed = nullptr;              // Set if the session dies while resuming
+
+    bool awaited() const noexcept { return !calls.empty() || !commands.empty(); }
+};
+
+inline void complete(waiter* w, bool ok, const void* payload, std::size_t length) {
+    w->result.ok = ok;
+    w->result.payload = {static_cast<const std::byte*>(payload), length};
+}
+
+// Callbacks only stage the waiter; it is resumed once the protocol layer
+// has returned, so the coroutine may end the session
+inline void stage(session_state* state, waiter* w, bool ok, const void* payload,
+                  std::size_t length) {
+    complete(w, ok, payload, length);
+    state->ready = w;
+}
+
+inline void on_response(polycall_protocol_context_t* ctx, const void* payload, size_t length) {
+    auto* state = static_cast<session_state*>(ctx->user_data);
+    if (state->calls.empty()) return;       // Unsolicited
+    waiter* w = state->calls.front();
+    state->calls.pop_front();
+    stage(state, w, true, payload, length);
+}
+
+inline void on_error(polycall_protocol_context_t* ctx, const char* detail) {
+    (void)detail;                           // Length is not reported for ERROR
+    auto* state = static_cast<session_state*>(ctx->user_data);
+    if (state->calls.empty()) return;
+    waiter* w = state->calls.front();
+    state->calls.pop_front();
+    stage(state, w, false, nullptr, 0);
+}
+
+inline void on_command(polycall_protocol_context_t* ctx, const char* command, size_t length) {
+    auto* state = static_cast<session_state*>(ctx->user_data);
+    if (state->commands.empty()) {
+        state->backlog.push_back(buffer::copy_of(
+            std::as_bytes(std::span<const char>(command, length))));
+        return;
+    }
+    waiter* w = state->commands.front();
+    state->commands.pop_front();
+    stage(state, w, true, command, length);
+}
+
+}  // namespace detail
+
+// Lazily started coroutine; co_await it or hand it to event_loop::spawn
+template <typename T>
+class [[nodiscard]] task {
+public:
+    using promise_type = detail::promise<T>;
+
+    task(task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    ~task() {
+        if (handle_) handle_.destroy();
+    }
+
+    auto operator co_await() && noexcept {
+        struct awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+                handle.promise().continuation = caller;
+                return handle;
+            }
+
+            T await_resume() {
+                promise_type& promise = handle.promise();
+                if (promise.exception) std::rethrow_exception(promise.exception);
+                if constexpr (!std::is_void_v<T>) return std::move(*promise.value);
+            }
+        };
+        return awaiter{handle_};
+    }
+
+private:
+    friend struct detail::promise<T>;
+    friend class event_loop;
+
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+task<T> detail::promise<T>::get_return_object() noexcept {
+    return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> detail::promise<void>::get_return_object() noexcept {
+    return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+// Single-threaded driver: waits in poll() on listening sockets, session
+// sockets and a wake pipe, pumps loopback sessions, and resumes whatever
+// became ready. Loopback sessions with pending awaits are polled without
+// sleeping.
+class event_loop {
+public:
+    event_loop() {
+        int fds[2];
+        if (::pipe(fds) != 0) throw error("polycall: event_loop pipe failed");
+        for (int fd : fds) ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        wake_read_ = fds[0];
+        wake_write_ = fds[1];
+    }
+
+    event_loop(const event_loop&) = delete;
+    event_loop& operator=(const event_loop&) = delete;
+
+    ~event_loop() {
+        for (std::coroutine_handle<> handle : spawned_) handle.destroy();
+        for (detail::session_state* state : watched_) state->loop = nullptr;
+        ::close(wake_read_);
+        ::close(wake_write_);
+    }
+
+    // The loop running on this thread, nullptr outside run()/run_once()
+    static event_loop* current() noexcept { return detail::current_loop(); }
+
+    // Start a task on the next iteration; the loop owns it until it ends
+    template <typename T>
+    void spawn(task<T> started) {
+        auto handle = std::exchange(started.handle_, {});
+        handle.promise().owner = this;
+        spawned_.push_back(handle);
+        post(handle);
+    }
+
+    // Resume handle on the loop thread; safe from any thread
+    void post(std::coroutine_handle<> handle) {
+        {
+            std::lock_guard<std::mutex> guard(posted_lock_);
+            posted_.push_back(handle);
+        }
+        char byte = 0;
+        (void)!::write(wake_write_, &byte, 1);
+    }
+
+    void wait_readable(int fd, std::coroutine_handle<> handle) {
+        readers_.push_back({fd, handle});
+    }
+
+    // Pump state's endpoint while it has pending awaits
+    void watch(detail::session_state* state) {
+        if (state->loop == this) return;
+        state->loop = this;
+        watched_.push_back(state);
+    }
+
+    void unwatch(detail::session_state* state) noexcept {
+        watched_.erase(std::remove(watched_.begin(), watched_.end(), state), watched_.end());
+        state->loop = nullptr;
+    }
+
+    // One iteration, waiting up to timeout_ms (-1: no limit) for work.
+    // Rethrows the first exception a spawned task ended with; returns
+    // false once no spawned task remains.
+    bool run_once(int timeout_ms = -1);
+
+    void run() {
+        while (run_once(-1)) {
+        }
+    }
+
+private:
+    friend struct detail::promise_base::final_awaiter;
+
+    struct reader {
+        int fd;
+        std::coroutine_handle<> handle;
+    };
+
+    void finished(std::coroutine_handle<> handle, std::exception_ptr exception) noexcept {
+        if (exception && !failure_) failure_ = exception;
+        spawned_.erase(std::remove(spawned_.begin(), spawned_.end(), handle), spawned_.end());
+        handle.destroy();
+    }
+
+    bool is_watched(detail::session_state* state) const noexcept {
+        return std::find(watched_.begin(), watched_.end(), state) != watched_.end();
+    }
+
+    static void fail_waiters(detail::session_state* state);
+    static bool deliver(detail::session_state* state, const std::byte* frame, std::size_t length);
+    static void pump(detail::session_state* state);
+
+    int wake_read_ = -1;
+    int wake_write_ = -1;
+    std::mutex posted_lock_;
+    std::vector<std::coroutine_handle<>> posted_;
+    std::vector<std::coroutine_handle<>> spawned_;
+    std::vector<reader> readers_;
+    std::vector<detail::session_state*> watched_;
+    std::vector<pollfd> poll_fds_;
+    std::exception_ptr failure_;
+};
+
+template <typename Promise>
+std::coroutine_handle<> detail::promise_base::final_awaiter::await_suspend(
+    std::coroutine_handle<Promise> handle) noexcept {
+    promise_base& promise = handle.promise();
+    if (promise.continuation) return promise.continuation;
+    if (promise.owner) promise.owner->finished(handle, promise.exception);
+    return std::noop_coroutine();
+}
+
+// Resume every pending await on a closed session with ok = false
+inline void event_loop::fail_waiters(detail::session_state* state) {
+    std::deque<detail::waiter*> failed;
+    failed.swap(state->calls);
+    for (detail::waiter* w : state->commands) failed.push_back(w);
+    state->commands.clear();
+    for (detail::waiter* w : failed) {
+        detail::complete(w, false, nullptr, 0);
+        w->handle.resume();
+    }
+}
+
+// Process one frame and resume the await it completed; false if the
+// resumed coroutine destroyed the session
+inline bool event_loop::deliver(detail::session_state* state, const std::byte* frame,
+                                std::size_t length) {
+    polycall_protocol_process(&state->protocol, frame, length);
+    detail::waiter* ready = std::exchange(state->ready, nullptr);
+    if (!ready) return true;
+
+    bool destroyed = false;
+    state->destroyed = &destroyed;
+    ready->handle.resume();
+    if (destroyed) return false;
+    state->destroyed = nullptr;
+    return true;
+}
+
+inline void event_loop::pump(detail::session_state* state) {
+    NetworkEndpoint* endpoint = state->endpoint;
+
+    if (endpoint->loopback) {
+        // Each frame is processed in the buffer the peer built
+        for (int i = 0; i < 64 && state->awaited(); i++) {
+            NetworkPacket frame = {nullptr, 0, 0};
+            ssize_t received = net_receive_owned(endpoint, &frame);
+            if (received == 0) fail_waiters(state);
+            if (received <= 0) return;
+            buffer owned = buffer::adopt(frame.data, frame.size);
+            if (!deliver(state, owned.data(), owned.size())) return;
+        }
+        return;
+    }
+
+    // Stream sockets: split the byte stream on header payload lengths
+    std::byte chunk[NET_BUFFER_SIZE];
+    NetworkPacket packet = {chunk, sizeof(chunk), 0};
+    ssize_t received = net_receive(endpoint, &packet);
+    if (received <= 0) {
+        fail_waiters(state);
+        return;
+    }
+
+    std::vector<std::byte>& inbox = state->inbox;
+    inbox.insert(inbox.end(), chunk, chunk + received);
+    std::size_t offset = 0;
+    while (inbox.size() - offset >= sizeof(polycall_message_header_t)) {
+        polycall_message_header_t header;
+        std::memcpy(&header, inbox.data() + offset, sizeof(header));
+        std::size_t frame = sizeof(header) + header.payload_length;
+        if (inbox.size() - offset < frame) break;
+        if (!deliver(state, inbox.data() + offset, frame)) return;
+        offset += frame;
+    }
+    inbox.erase(inbox.begin(), inbox.begin() + static_cast<std::ptrdiff_t>(offset));
+}
+
+inline bool event_loop::run_once(int timeout_ms) {
+    if (failure_) std::rethrow_exception(std::exchange(failure_, nullptr));
+    if (spawned_.empty()) return false;
+
+    event_loop* outer = std::exchange(detail::current_loop(), this);
+    struct restore {
+        event_loop* outer;
+        ~restore() { detail::current_loop() = outer; }
+    } restore_current{outer};
+
+    // Sessions nobody awaits are no longer pumped
+    for (detail::session_state* state : std::vector<detail::session_state*>(watched_)) {
+        if (!state->awaited()) unwatch(state);
+    }
+
+    bool busy = false;
+    poll_fds_.clear();
+    poll_fds_.push_back({wake_read_, POLLIN, 0});
+    for (const reader& r : readers_) poll_fds_.push_back({r.fd, POLLIN, 0});
+    for (detail::session_state* state : watched_) {
+        if (state->endpoint->loopback) {
+            busy = true;
+            poll_fds_.push_back({-1, 0, 0});
+        } else {
+            poll_fds_.push_back({state->endpoint->socket_fd, POLLIN, 0});
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(posted_lock_);
+        if (!posted_.empty()) busy = true;
+    }
+
+    if (::poll(poll_fds_.data(), poll_fds_.size(), busy ? 0 : timeout_ms) < 0) {
+        for (pollfd& fd : poll_fds_) fd.revents = 0;
+    }
+    if (poll_fds_[0].revents) {
+        char drain[64];
+        while (::read(wake_read_, drain, sizeof(drain)) > 0) {
+        }
+    }
+
+    // Collect everything ready before resuming, which may change the lists
+    std::vector<std::coroutine_handle<>> ready;
+    {
+        std::lock_guard<std::mutex> guard(posted_lock_);
+        ready.swap(posted_);
+    }
+    std::size_t index = 1;
+    std::vector<reader> waiting;
+    for (const reader& r : readers_) {
+        if (poll_fds_[index++].revents) ready.push_back(r.handle);
+        else waiting.push_back(r);
+    }
+    readers_.swap(waiting);
+    std::vector<detail::session_state*> pumped;
+    for (detail::session_state* state : watched_) {
+        if (state->endpoint->loopback || poll_fds_[index].revents) pumped.push_back(state);
+        index++;
+    }
+
+    for (std::coroutine_handle<> handle : ready) handle.resume();
+    for (detail::session_state* state : pumped) {
+        if (is_watched(state)) pump(state);
+    }
+
+    if (failure_) std::rethrow_exception(std::exchange(failure_, nullptr));
+    return !spawned_.empty();
+}
+
+class endpoint {
+public:
+    class accept_awaiter;
+
+    endpoint() noexcept = default;
+
+    // TCP listener on port; accept() never blocks the loop
+    static endpoint listen(std::uint16_t port) {
+        auto* raw = new NetworkEndpoint{};
+        raw->port = port;
+        raw->protocol = NET_TCP;
+        raw->role = NET_SERVER;
+        std::strncpy(raw->address, "0.0.0.0", INET_ADDRSTRLEN - 1);
+        if (!net_init(raw)) {
+            delete raw;
+            throw error("polycall: listen failed");
+        }
+        ::fcntl(raw->socket_fd, F_SETFL, ::fcntl(raw->socket_fd, F_GETFL, 0) | O_NONBLOCK);
+        return endpoint(raw);
+    }
+
+    // Connected TCP client (blocking connect)
+    static endpoint connect(const char* address, std::uint16_t port) {
+        endpoint result(new_endpoint(NET_CLIENT));
+        NetworkEndpoint* raw = result.get();
+        std::strncpy(raw->address, address, INET_ADDRSTRLEN - 1);
+        raw->port = port;
+        raw->addr.sin_family = AF_INET;
+        raw->addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, address, &raw->addr.sin_addr) != 1) {
+            throw error("polycall: invalid address");
+        }
+        raw->socket_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (raw->socket_fd < 0 ||
+            ::connect(raw->socket_fd, reinterpret_cast<sockaddr*>(&raw->addr),
+                      sizeof(raw->addr)) != 0) {
+            throw error("polycall: connect failed");
+        }
+        return result;
+    }
+
+    // In-process pair, see net_loopback_pair
+    static std::pair<endpoint, endpoint> loopback_pair(std::size_t capacity = 0) {
+        endpoint a(new NetworkEndpoint{});
+        endpoint b(new NetworkEndpoint{});
+        if (!net_loopback_pair(a.get(), b.get(), capacity)) {
+            // Never initialized, nothing for net_close to release
+            delete a.ep_.release();
+            delete b.ep_.release();
+            throw error("polycall: loopback pair failed");
+        }
+        return {std::move(a), std::move(b)};
+    }
+
+    // Next connection on a listener; an empty endpoint if it went away
+    accept_awaiter accept() noexcept;
+
+    NetworkEndpoint* get() const noexcept { return ep_.get(); }
+    explicit operator bool() const noexcept { return ep_ != nullptr; }
+
+private:
+    struct closer {
+        void operator()(NetworkEndpoint* raw) const noexcept {
+            net_close(raw);
+            delete raw;
+        }
+    };
+
+    explicit endpoint(NetworkEndpoint* raw) noexcept : ep_(raw) {}
+
+    static NetworkEndpoint* new_endpoint(NetworkRole role) {
+        auto* raw = new NetworkEndpoint{};
+        pthread_mutex_init(&raw->lock, nullptr);
+        raw->protocol = NET_TCP;
+        raw->role = role;
+        raw->socket_fd = -1;
+        return raw;
+    }
+
+    std::unique_ptr<NetworkEndpoint, closer> ep_;
+};
+
+class endpoint::accept_awaiter {
+public:
+    explicit accept_awaiter(NetworkEndpoint* listener) noexcept : listener_(listener) {}
+
+    bool await_ready() { return try_accept(); }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        detail::require_loop()->wait_readable(listener_->socket_fd, handle);
+    }
+
+    endpoint await_resume() {
+        if (!accepted_) try_accept();
+        return std::move(accepted_);
+    }
+
+private:
+    bool try_accept() {
+        endpoint candidate(new_endpoint(NET_CLIENT));
+        NetworkEndpoint* raw = candidate.get();
+        socklen_t length = sizeof(raw->addr);
+        raw->socket_fd = ::accept(listener_->socket_fd,
+                                  reinterpret_cast<sockaddr*>(&raw->addr), &length);
+        if (raw->socket_fd < 0) return false;
+        raw->port = ntohs(raw->addr.sin_port);
+        inet_ntop(AF_INET, &raw->addr.sin_addr, raw->address, INET_ADDRSTRLEN);
+        raw->phantom = listener_->phantom;
+        accepted_ = std::move(candidate);
+        return true;
+    }
+
+    NetworkEndpoint* listener_;
+    endpoint accepted_;
+};
+
+inline endpoint::accept_awaiter endpoint::accept() noexcept {
+    return accept_awaiter(ep_.get());
+}
+
+// Protocol session over an endpoint. The session installs its own
+// on_command, on_response and on_error callbacks.
+class session {
+public:
+    class message_awaiter;
+
+    session(context& ctx, endpoint& transport, polycall_protocol_config_t config = {})
+        : state_(std::make_unique<detail::session_state>()) {
+        config.callbacks.on_command = detail::on_command;
+        config.callbacks.on_response = detail::on_response;
+        config.callbacks.on_error = detail::on_error;
+        config.user_data = state_.get();
+        if (!polycall_protocol_init(&state_->protocol, ctx.get(), transport.get(), &config)) {
+            throw error("polycall: session initialization failed");
+        }
+        state_->endpoint = transport.get();
+    }
+
+    session(session&&) noexcept = default;
+    session& operator=(session&&) = delete;
+    session(const session&) = delete;
+    session& operator=(const session&) = delete;
+
+    ~session() {
+        if (!state_) return;
+        if (state_->destroyed) *state_->destroyed = true;
+        if (state_->loop) state_->loop->unwatch(state_.get());
+        polycall_protocol_cleanup(&state_->protocol);
+    }
+
+    // Send a COMMAND and resume with the peer's RESPONSE
+    message_awaiter call(std::span<const std::byte> command) noexcept;
+
+    // Resume with the next COMMAND the peer sends
+    message_awaiter next_command() noexcept;
+
+    bool respond(std::span<const std::byte> payload) {
+        return send(POLYCALL_MSG_RESPONSE, payload);
+    }
+
+    bool fail(std::span<const std::byte> detail) {
+        return send(POLYCALL_MSG_ERROR, detail);
+    }
+
+    bool send(polycall_message_type_t type, std::span<const std::byte> payload) {
+        return polycall_protocol_send(&state_->protocol, type, payload.data(), payload.size(),
+                                      POLYCALL_FLAG_NONE);
+    }
+
+    polycall_protocol_context_t* get() const noexcept { return &state_->protocol; }
+
+private:
+    std::unique_ptr<detail::session_state> state_;
+};
+
+class session::message_awaiter {
+public:
+    message_awaiter(detail::session_state* state, std::span<const std::byte> command,
+                    bool is_call) noexcept
+        : state_(state), command_(command), is_call_(is_call) {}
+
+    bool await_ready() noexcept {
+        return !is_call_ && !state_->backlog.empty();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        event_loop* loop = detail::require_loop();
+        if (is_call_ && !polycall_protocol_send(&state_->protocol, POLYCALL_MSG_COMMAND,
+                                                command_.data(), command_.size(),
+                                                POLYCALL_FLAG_NONE)) {
+            return false;                   // Resume now with ok = false
+        }
+        waiter_.handle = handle;
+        (is_call_ ? state_->calls : state_->commands).push_back(&waiter_);
+        loop->watch(state_);
+        return true;
+    }
+
+    message await_resume() {
+        if (!is_call_ && !waiter_.handle) {
+            // Arrived before it was awaited
+            waiter_.result.storage = std::move(state_->backlog.front());
+            state_->backlog.pop_front();
+            waiter_.result.payload = waiter_.result.storage.span();
+            waiter_.result.ok = true;
+        }
+        return std::move(waiter_.result);
+    }
+
+private:
+    detail::session_state* state_;
+    std::span<const std::byte> command_;
+    bool is_call_;
+    detail::waiter waiter_;
+};
+
+inline session::message_awaiter session::call(std::span<const std::byte> command) noexcept {
+    return message_awaiter(state_.get(), command, true);
+}
+
+inline session::message_awaiter session::next_command() noexcept {
+    return message_awaiter(state_.get(), {}, false);
+}
+
+class state_machine {
+public:
+    class transition_awaiter;
+
+    explicit state_machine(context& ctx) {
+        if (polycall_sm_create_with_integrity(ctx.get(), &sm_, nullptr) != POLYCALL_SM_SUCCESS) {
+            throw error("polycall: state machine creation failed");
+        }
+    }
+
+    state_machine(context& ctx, const PolyCall_StateMachineDef& def) {
+        if (polycall_sm_create_from_def(ctx.get(), &def, &sm_, nullptr) != POLYCALL_SM_SUCCESS) {
+            throw error("polycall: state machine creation failed");
+        }
+    }
+
+    state_machine(state_machine&& other) noexcept : sm_(std::exchange(other.sm_, nullptr)) {}
+
+    state_machine& operator=(state_machine&& other) noexcept {
+        if (this != &other) {
+            if (sm_) polycall_sm_destroy(sm_);
+            sm_ = std::exchange(other.sm_, nullptr);
+        }
+        return *this;
+    }
+
+    state_machine(const state_machine&) = delete;
+    state_machine& operator=(const state_machine&) = delete;
+
+    ~state_machine() {
+        if (sm_) polycall_sm_destroy(sm_);
+    }
+
+    // Resume with the transition's final status; async transitions finish
+    // on the machine's worker pool and resume on the loop
+    transition_awaiter transition(unsigned int transition_id) noexcept;
+    transition_awaiter transition(std::string_view name) noexcept;
+
+    PolyCall_StateMachine* get() const noexcept { return sm_; }
+
+private:
+    PolyCall_StateMachine* sm_ = nullptr;
+};
+
+class state_machine::transition_awaiter {
+public:
+    transition_awaiter(PolyCall_StateMachine* sm, unsigned int transition_id) noexcept
+        : sm_(sm), transition_id_(transition_id) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        handle_ = handle;
+        loop_ = detail::require_loop();
+        polycall_sm_status_t status =
+            polycall_sm_execute_transition_async(sm_, transition_id_, &completed, this);
+        if (status != POLYCALL_SM_PENDING) {
+            status_ = status;
+            return false;
+        }
+        // The worker may already have finished
+        return phase_.exchange(suspended, std::memory_order_acq_rel) != done;
+    }
+
+    polycall_sm_status_t await_resume() const noexcept { return status_; }
+
+private:
+    enum { running, done, suspended };
+
+    static void completed(PolyCall_StateMachine* sm, unsigned int transition_id,
+                          polycall_sm_status_t status, void* user_data) {
+        (void)sm;
+        (void)transition_id;
+        auto* self = static_cast<transition_awaiter*>(user_data);
+        self->status_ = status;
+        event_loop* loop = self->loop_;
+        std::coroutine_handle<> handle = self->handle_;
+        if (self->phase_.exchange(done, std::memory_order_acq_rel) == suspended) {
+            loop->post(handle);
+        }
+    }
+
+    PolyCall_StateMachine* sm_;
+    unsigned int transition_id_;
+    polycall_sm_status_t status_ = POLYCALL_SM_SUCCESS;
+    std::coroutine_handle<> handle_;
+    event_loop* loop_ = nullptr;
+    std::atomic<int> phase_{running};
+};
+
+inline state_machine::transition_awaiter state_machine::transition(
+    unsigned int transition_id) noexcept {
+    return transition_awaiter(sm_, transition_id);
+}
+
+inline state_machine::transition_awaiter state_machine::transition(
+    std::string_view name) noexcept {
+    unsigned int transition_id = sm_->num_transitions;   // Unknown names fail as invalid
+    for (unsigned int i = 0; i < sm_->num_transitions; i++) {
+        if (name == sm_->transitions[i].name) {
+            transition_id = i;
+            break;
+        }
+    }
+    return transition_awaiter(sm_, transition_id);
+}
+
+}  // namespace polycall
+
+#endif // POLYCALL_HPP
@@ -0,0 +1,307 @@
+#ifndef POLYCALL_COMMAND_HPP
+#define POLYCALL_COMMAND_HPP
+
+/*
+ * Compile-time typed commands (C++20, header-only).
+ *
+ * A command pairs a name with request and response types whose wire
+ * layout is declared once:
+ *
+ *   struct add_request { std::int32_t a, b; };
+ *   struct add_response { std::int64_t sum; };
+ *   POLYCALL_LAYOUT(add_request, &add_request::a, &add_request::b);
+ *   POLYCALL_LAYOUT(add_response, &add_response::sum);
+ *   using add = polycall::command<"add", add_request, add_response>;
+ *
+ *   add_response do_add(const add_request& r) { return {r.a + r.b}; }
+ *   constexpr polycall::dispatcher<polycall::handler<add, do_add>> commands;
+ *
+ *   loop.spawn(polycall::serve(session, commands));               // handler side
+ *   auto sum = co_await polycall::call<add>(session, {2, 3});      // caller side
+ *
+ * On the wire a command is its 32-bit id (FNV-1a of the name) followed by
+ * the encoded request, and the reply is the encoded response. Fields are
+ * written little-endian back to back without padding, so both ends agree
+ * whatever the compiler's struct layout. Ids are checked for collisions
+ * at compile time and dispatch is a fold over the handler list that calls
+ * each handler directly, so handlers inline into it.
+ *
+ * Handlers may take leading arguments, which dispatch() and serve()
+ * forward with their static types: handler<add, add_to_ledger> with
+ * add_response add_to_ledger(ledger&, const add_request&) is served by
+ * serve(session, commands, my_ledger).
+ */
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include "polycall.hpp"
+
+namespace polycall {
+
+// Wire layout of T: fields lists member pointers in encoding order
+template <typename T>
+struct layout;
+
+#define POLYCALL_LAYOUT(Type, ...)                                          \
+    template <>                                                             \
+    struct polycall::layout<Type> {                                         \
+        static constexpr auto fields = std::make_tuple(__VA_ARGS__);        \
+    }
+
+template <std::size_t N>
+struct fixed_string {
+    char value[N]{};
+
+    constexpr fixed_string(const char (&text)[N]) {
+        for (std::size_t i = 0; i < N; i++) value[i] = text[i];
+    }
+
+    constexpr std::string_view view() const { return {value, N - 1}; }
+};
+
+constexpr std::uint32_t command_id(std::string_view name) noexcept {
+    std::uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+namespace detail {
+
+template <typename T>
+concept wire_scalar = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+template <typename T>
+concept has_layout = requires { layout<T>::fields; };
+
+template <typename M>
+struct member_of;
+
+template <typename C, typename F>
+struct member_of<F C::*> {
+    using type = F;
+};
+
+template <typename M>
+using member_t = typename member_of<std::remove_cvref_t<M>>::type;
+
+template <typename T>
+struct codec {
+    static_assert(sizeof(T) == 0,
+                  "polycall: declare the wire layout with POLYCALL_LAYOUT");
+};
+
+template <wire_scalar T>
+struct codec<T> {
+    static constexpr std::size_t size = sizeof(T);
+
+    static void encode(const T& value, std::byte* out) noexcept {
+        auto raw = std::bit_cast<std::array<std::byte, sizeof(T)>>(value);
+        if constexpr (std::endian::native == std::endian::big) {
+            std::reverse(raw.begin(), raw.end());
+        }
+        std::memcpy(out, raw.data(), sizeof(T));
+    }
+
+    static T decode(const std::byte* in) noexcept {
+        std::array<std::byte, sizeof(T)> raw;
+        std::memcpy(raw.data(), in, sizeof(T));
+        if constexpr (std::endian::native == std::endian::big) {
+            std::reverse(raw.begin(), raw.end());
+        }
+        return std::bit_cast<T>(raw);
+    }
+};
+
+template <>
+struct codec<bool> {
+    static constexpr std::size_t size = 1;
+
+    static void encode(const bool& value, std::byte* out) noexcept {
+        *out = static_cast<std::byte>(value ? 1 : 0);
+    }
+
+    static bool decode(const std::byte* in) noexcept { return *in != std::byte{0}; }
+};
+
+template <typename T, std::size_t N>
+struct codec<std::array<T, N>> {
+    static constexpr std::size_t size = N * codec<T>::size;
+
+    static void encode(const std::array<T, N>& value, std::byte* out) noexcept {
+        for (std::size_t i = 0; i < N; i++) codec<T>::encode(value[i], out + i * codec<T>::size);
+    }
+
+    static std::array<T, N> decode(const std::byte* in) noexcept {
+        std::array<T, N> value{};
+        for (std::size_t i = 0; i < N; i++) value[i] = codec<T>::decode(in + i * codec<T>::size);
+        return value;
+    }
+};
+
+template <typename T>
+    requires has_layout<T>
+struct codec<T> {
+    static constexpr std::size_t size = std::apply(
+        [](auto... field) { return (std::size_t{0} + ... + codec<member_t<decltype(field)>>::size); },
+        layout<T>::fields);
+
+    static void encode(const T& value, std::byte* out) noexcept {
+        std::apply([&](auto... field) {
+            std::size_t offset = 0;
+            ((codec<member_t<decltype(field)>>::encode(value.*field, out + offset),
+              offset += codec<member_t<decltype(field)>>::size), ...);
+        }, layout<T>::fields);
+    }
+
+    static T decode(const std::byte* in) noexcept {
+        T value{};
+        std::apply([&](auto... field) {
+            std::size_t offset = 0;
+            ((value.*field = codec<member_t<decltype(field)>>::decode(in + offset),
+              offset += codec<member_t<decltype(field)>>::size), ...);
+        }, layout<T>::fields);
+        return value;
+    }
+};
+
+}  // namespace detail
+
+template <typename T>
+using codec = detail::codec<T>;
+
+template <fixed_string Name, typename Request, typename Response>
+struct command {
+    using request = Request;
+    using response = Response;
+
+    static constexpr std::string_view name = Name.view();
+    static constexpr std::uint32_t id = command_id(Name.view());
+    static constexpr std::size_t request_size = sizeof(std::uint32_t) + codec<Request>::size;
+    static constexpr std::size_t response_size = codec<Response>::size;
+
+    // polycall_protocol_send rejects empty payloads
+    static_assert(response_size > 0, "polycall: responses need at least one field");
+};
+
+template <typename Command, auto Function>
+struct handler {
+    using command = Command;
+    static constexpr auto function = Function;
+};
+
+enum class dispatch_status {
+    handled,
+    unknown_command,
+    malformed            // Request size does not match the command
+};
+
+template <typename... Handlers>
+class dispatcher {
+public:
+    static constexpr std::size_t size = sizeof...(Handlers);
+
+    // Sorted ids of every registered command
+    static constexpr std::array<std::uint32_t, size> ids = [] {
+        std::array<std::uint32_t, size> sorted{Handlers::command::id...};
+        std::sort(sorted.begin(), sorted.end());
+        return sorted;
+    }();
+
+    static_assert(std::adjacent_find(ids.begin(), ids.end()) == ids.end(),
+                  "polycall: two commands share an id; rename one");
+
+    static constexpr bool handles(std::uint32_t id) noexcept {
+        return std::binary_search(ids.begin(), ids.end(), id);
+    }
+
+    // Decode payload, run its handler with args and pass the encoded
+    // response to reply(std::span<const std::byte>)
+    template <typename Reply, typename... Args>
+    dispatch_status dispatch(std::span<const std::byte> payload, Reply&& reply,
+                             Args&&... args) const {
+        if (payload.size() < sizeof(std::uint32_t)) return dispatch_status::malformed;
+        std::uint32_t id = codec<std::uint32_t>::decode(payload.data());
+        std::span<const std::byte> body = payload.subspan(sizeof(std::uint32_t));
+
+        dispatch_status status = dispatch_status::unknown_command;
+        (void)(invoke<Handlers>(id, body, status, reply, args...) || ...);
+        return status;
+    }
+
+private:
+    template <typename Handler, typename Reply, typename... Args>
+    static bool invoke(std::uint32_t id, std::span<const std::byte> body,
+                       dispatch_status& status, Reply& reply, Args&... args) {
+        using command = typename Handler::command;
+        using request = typename command::request;
+        using response = typename command::response;
+
+        if (id != command::id) return false;
+        if (body.size() != codec<request>::size) {
+            status = dispatch_status::malformed;
+            return true;
+        }
+
+        const request decoded = codec<request>::decode(body.data());
+        const response result = std::invoke(Handler::function, args..., decoded);
+        std::array<std::byte, codec<response>::size> encoded;
+        codec<response>::encode(result, encoded.data());
+        reply(std::span<const std::byte>(encoded));
+        status = dispatch_status::handled;
+        return true;
+    }
+};
+
+// Answer commands on a session until the peer closes; unknown or
+// malformed commands are answered with an ERROR message
+template <typename... Handlers, typename... Args>
+task<> serve(session& peer, const dispatcher<Handlers...>& commands, Args&... args) {
+    for (;;) {
+        message request = co_await peer.next_command();
+        if (!request.ok) co_return;
+
+        dispatch_status status = commands.dispatch(
+            request.payload,
+            [&peer](std::span<const std::byte> reply) { peer.respond(reply); },
+            args...);
+        if (status == dispatch_status::unknown_command) {
+            peer.fail(bytes("unknown command"));
+        } else if (status == dispatch_status::malformed) {
+            peer.fail(bytes("malformed request"));
+        }
+    }
+}
+
+// Send a typed command; nullopt if it failed or the reply did not decode
+template <typename Command>
+task<std::optional<typename Command::response>> call(
+    session& peer,
+    typename Command::request request
+) {
+    using response = typename Command::response;
+
+    std::array<std::byte, Command::request_size> encoded;
+    codec<std::uint32_t>::encode(Command::id, encoded.data());
+    codec<typename Command::request>::encode(request, encoded.data() + sizeof(std::uint32_t));
+
+    message reply = co_await peer.call(encoded);
+    if (!reply.ok || reply.payload.size() != codec<response>::size) co_return std::nullopt;
+    co_return codec<response>::decode(reply.payload.data());
+}
+
+}  // namespace polycall
+
+#endif // POLYCALL_COMMAND_HPP
@@ -0,0 +1,61 @@
+#ifndef POLYCALL_ERROR_H
+#define POLYCALL_ERROR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Thread-local error records.
+ *
+ * A failing call records a code, a static message and optionally a detail
+ * format with up to two integer arguments. Nothing is formatted until the
+ * message is read, and successful calls leave the record alone, so it is
+ * only meaningful right after a call reported failure (like errno).
+ * Threads sharing a context each see their own last error.
+ */
+
+#define POLYCALL_ERROR_TEXT_LENGTH 256
+
+typedef enum {
+    POLYCALL_ERR_NONE = 0,
+    POLYCALL_ERR_INVALID_PARAMETERS,
+    POLYCALL_ERR_OUT_OF_MEMORY,
+    POLYCALL_ERR_INITIALIZATION_FAILED,
+    POLYCALL_ERR_STATE_MACHINE,         // Machine creation or transition failed
+    POLYCALL_ERR_SESSION_EXISTS,        // Session id already registered
+    POLYCALL_ERR_REGISTRY,
+    POLYCALL_ERR_PROTOCOL_VERSION,
+    POLYCALL_ERR_PROTOCOL_MESSAGE,      // Unknown message type
+    POLYCALL_ERR_PROTOCOL_CHECKSUM,
+    POLYCALL_ERR_PROTOCOL_SIZE,         // Message exceeds the buffer
+    POLYCALL_ERR_PROTOCOL_SESSION       // Raised by polycall_protocol_set_error
+} polycall_error_code_t;
+
+// This thread's last error code, POLYCALL_ERR_NONE if none was recorded
+polycall_error_code_t polycall_error_code(void);
+
+// This thread's last error message, formatted on first read; "" if none.
+// Valid until the thread records another error.
+const char* polycall_error_message(void);
+
+void polycall_error_clear(void);
+
+// Record an error; message must have static storage
+void polycall_error_set(polycall_error_code_t code, const char* message);
+
+// Record an error whose message is followed by detail_format rendered with
+// a and b (as %lld) when read; both strings must have static storage
+void polycall_error_set_detail(
+    polycall_error_code_t code,
+    const char* message,
+    const char* detail_format,
+    long long a,
+    long long b
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_ERROR_H
@@ -0,0 +1,73 @@
+#ifndef POLYCALL_HISTOGRAM_H
+#define POLYCALL_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Log-linear latency histogram.
+ *
+ * Values below 2^SUB_BITS get one bucket each; every power of two above
+ * that is split into 2^SUB_BITS linear sub-buckets, so the relative error
+ * of any bucket is bounded by 1/2^SUB_BITS. With the defaults the
+ * histogram covers 0 ns .. ~17 s in 256 buckets.
+ */
+#define POLYCALL_HISTOGRAM_SUB_BITS 3
+#define POLYCALL_HISTOGRAM_BUCKETS 256
+
+typedef struct polycall_histogram {
+    uint32_t buckets[POLYCALL_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} polycall_histogram_t;
+
+// Map a value to its bucket index
+static inline unsigned int polycall_histogram_bucket(uint64_t value) {
+    const unsigned int sub_count = 1u << POLYCALL_HISTOGRAM_SUB_BITS;
+    if (value < sub_count) return (unsigned int)value;
+
+    unsigned int msb = 63u - (unsigned int)__builtin_clzll(value);
+    unsigned int sub = (unsigned int)(value >> (msb - POLYCALL_HISTOGRAM_SUB_BITS)) & (sub_count - 1);
+    unsigned int index = ((msb - POLYCALL_HISTOGRAM_SUB_BITS + 1) << POLYCALL_HISTOGRAM_SUB_BITS) + sub;
+
+    return index < POLYCALL_HISTOGRAM_BUCKETS ? index : POLYCALL_HISTOGRAM_BUCKETS - 1;
+}
+
+// Record a single value
+static inline void polycall_histogram_record(polycall_histogram_t* hist, uint64_t value) {
+    if (hist->count == 0 || value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+    hist->buckets[polycall_histogram_bucket(value)]++;
+    hist->count++;
+    hist->sum += value;
+}
+
+// Reset all buckets and totals
+void polycall_histogram_reset(polycall_histogram_t* hist);
+
+// Add the contents of src into dst
+void polycall_histogram_merge(polycall_histogram_t* dst, const polycall_histogram_t* src);
+
+// Lowest value that maps to the given bucket
+uint64_t polycall_histogram_bucket_lower(unsigned int index);
+
+// Value at the given percentile (0.0 - 100.0), bucket midpoint resolution
+uint64_t polycall_histogram_percentile(const polycall_histogram_t* hist, double percentile);
+
+// Mean of all recorded values
+double polycall_histogram_mean(const polycall_histogram_t* hist);
+
+// Monotonic clock in nanoseconds used for all latency measurements
+uint64_t polycall_monotonic_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_HISTOGRAM_H
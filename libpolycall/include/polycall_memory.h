@@ -0,0 +1,72 @@
+#ifndef POLYCALL_MEMORY_H
+#define POLYCALL_MEMORY_H
+
+#include <stddef.h>
+#include "polycall.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-context memory.
+ *
+ * Every context owns an arena grown in chunks of memory_pool_size bytes.
+ * polycall_mem_arena_alloc bump-allocates objects that live exactly as
+ * long as the context (application tables, per-context singletons) and
+ * are never freed on their own; nothing inside the library qualifies.
+ * polycall_mem_alloc serves everything else, the library's own sessions,
+ * machines and buffers included, from power-of-two size classes carved out
+ * of the same chunks; freed blocks land in a per-thread cache first, so
+ * steady-state alloc/free takes no lock. Requests above the largest class
+ * go to the system heap but are still owned by the context.
+ *
+ * The POLYCALL_MEM_* config flags choose how chunks are mapped: on 2 MB
+ * pages (chunk sizes round up to whole pages), on the NUMA node of the
+ * thread that reserves them, and/or faulted in up front so the first
+ * chunk is resident before any traffic. Without them, and always on
+ * Windows, chunks come from malloc.
+ *
+ * polycall_cleanup releases all of it at once: memory allocated from a
+ * context must not be used or freed after the context is cleaned up.
+ */
+
+// Largest request served from a size class; larger ones use the heap
+#define POLYCALL_MEM_MAX_CLASS_SIZE (64 * 1024 - 16)
+
+typedef struct polycall_memory polycall_memory_t;
+
+typedef struct {
+    size_t chunk_size;          // memory_pool_size of the context
+    size_t chunks;              // Arena chunks reserved from the system
+    size_t arena_bytes;         // Bytes reserved for chunks
+    size_t arena_used;          // Bytes handed out by the bump pointer
+    size_t large_bytes;         // Live oversized allocations
+    size_t shared_refills;      // Thread-cache refills that took the lock
+    size_t huge_chunks;         // Chunks on huge pages (hugetlb or THP advice)
+    size_t local_chunks;        // Chunks bound to the reserving thread's node
+} polycall_memory_stats_t;
+
+// Long-lived allocation, zeroed, 16-byte aligned, freed with the context
+void* polycall_mem_arena_alloc(polycall_context_t ctx, size_t size);
+
+// Size-class allocation, 16-byte aligned; release with polycall_mem_free
+void* polycall_mem_alloc(polycall_context_t ctx, size_t size);
+void* polycall_mem_calloc(polycall_context_t ctx, size_t count, size_t size);
+void polycall_mem_free(polycall_context_t ctx, void* ptr);
+
+polycall_status_t polycall_mem_get_stats(
+    polycall_context_t ctx,
+    polycall_memory_stats_t* stats
+);
+
+// Context lifecycle, driven by polycall_init_with_config/polycall_cleanup
+polycall_memory_t* polycall_memory_create(size_t chunk_size, unsigned int flags);
+void polycall_memory_destroy(polycall_memory_t* memory);
+polycall_memory_t* polycall_context_memory(polycall_context_t ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_MEMORY_H
@@ -0,0 +1,121 @@
+#ifndef POLYCALL_METRICS_H
+#define POLYCALL_METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "polycall.h"
+#include "polycall_histogram.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Context metrics.
+ *
+ * Counters, gauges and log-linear histograms. Every thread updates its own
+ * cache-line aligned block with plain (relaxed) stores, so the hot path
+ * has no shared writes; blocks are summed only when a snapshot is taken.
+ * Gauges are kept as per-thread deltas and reported as their sum.
+ *
+ * Each context owns one registry with the built-in series below already
+ * registered; applications may register more.
+ */
+
+#define POLYCALL_METRICS_MAX 128
+#define POLYCALL_METRICS_MAX_HISTOGRAMS 8
+#define POLYCALL_METRICS_NAME_LENGTH 64
+#define POLYCALL_METRICS_HELP_LENGTH 128
+#define POLYCALL_METRICS_LABELS_LENGTH 64
+
+// Protocol series are per message type, POLYCALL_MSG_HANDSHAKE..HEARTBEAT
+#define POLYCALL_METRICS_MESSAGE_TYPES 6
+
+typedef enum {
+    POLYCALL_METRIC_COUNTER,
+    POLYCALL_METRIC_GAUGE,
+    POLYCALL_METRIC_HISTOGRAM
+} polycall_metric_kind_t;
+
+typedef unsigned int polycall_metric_id_t;
+
+// Built-in series; per-type ids are the base plus (message type - 1)
+enum {
+    POLYCALL_METRIC_PROTOCOL_RX_MESSAGES = 0,
+    POLYCALL_METRIC_PROTOCOL_RX_BYTES =
+        POLYCALL_METRIC_PROTOCOL_RX_MESSAGES + POLYCALL_METRICS_MESSAGE_TYPES,
+    POLYCALL_METRIC_PROTOCOL_TX_MESSAGES =
+        POLYCALL_METRIC_PROTOCOL_RX_BYTES + POLYCALL_METRICS_MESSAGE_TYPES,
+    POLYCALL_METRIC_PROTOCOL_TX_BYTES =
+        POLYCALL_METRIC_PROTOCOL_TX_MESSAGES + POLYCALL_METRICS_MESSAGE_TYPES,
+    POLYCALL_METRIC_PROTOCOL_REJECTED =
+        POLYCALL_METRIC_PROTOCOL_TX_BYTES + POLYCALL_METRICS_MESSAGE_TYPES,
+    POLYCALL_METRIC_PROTOCOL_MESSAGE_SIZE,      // Histogram of received sizes
+    POLYCALL_METRIC_NET_ACCEPTS,
+    POLYCALL_METRIC_NET_DISCONNECTS,
+    POLYCALL_METRIC_NET_LOOP_ITERATIONS,
+    POLYCALL_METRIC_NET_CLIENTS,                // Gauge
+    POLYCALL_METRIC_SM_TRANSITIONS,
+    POLYCALL_METRIC_SM_FAILURES,
+    POLYCALL_METRIC_BUILTIN_COUNT
+};
+
+typedef struct polycall_metrics polycall_metrics_t;
+typedef struct polycall_metrics_server polycall_metrics_server_t;
+
+typedef struct {
+    const char* name;           // Owned by the registry
+    const char* help;
+    const char* labels;         // Prometheus label set without braces, may be ""
+    polycall_metric_kind_t kind;
+    uint64_t counter;
+    int64_t gauge;
+    polycall_histogram_t histogram;
+} polycall_metric_sample_t;
+
+polycall_metrics_t* polycall_metrics_create(void);
+void polycall_metrics_destroy(polycall_metrics_t* metrics);
+
+// Registry of a context, NULL for an invalid context
+polycall_metrics_t* polycall_context_metrics(polycall_context_t ctx);
+
+// Register a series; series sharing a name should be registered together
+polycall_status_t polycall_metrics_register(
+    polycall_metrics_t* metrics,
+    polycall_metric_kind_t kind,
+    const char* name,
+    const char* help,
+    const char* labels,
+    polycall_metric_id_t* id
+);
+
+// Hot-path updates; a NULL registry or an unregistered id is ignored
+void polycall_metrics_counter_add(polycall_metrics_t* metrics, polycall_metric_id_t id, uint64_t n);
+void polycall_metrics_gauge_add(polycall_metrics_t* metrics, polycall_metric_id_t id, int64_t delta);
+void polycall_metrics_observe(polycall_metrics_t* metrics, polycall_metric_id_t id, uint64_t value);
+
+// Sum every thread's block into samples (registration order)
+polycall_status_t polycall_metrics_snapshot(
+    polycall_metrics_t* metrics,
+    polycall_metric_sample_t* samples,
+    size_t max_samples,
+    size_t* count
+);
+
+// Prometheus text exposition; returns the full length like snprintf
+size_t polycall_metrics_render(polycall_metrics_t* metrics, char* buffer, size_t capacity);
+
+// Serve the rendering over HTTP on 127.0.0.1:port (0 picks a free port)
+polycall_status_t polycall_metrics_serve(
+    polycall_metrics_t* metrics,
+    uint16_t port,
+    polycall_metrics_server_t** server
+);
+uint16_t polycall_metrics_server_port(const polycall_metrics_server_t* server);
+void polycall_metrics_server_stop(polycall_metrics_server_t* server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_METRICS_H
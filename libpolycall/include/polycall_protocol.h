@@ -3,10 +3,16 @@
 
 #include "polycall.h"
 #include "polycall_state_machine.h"
+#include "polycall_sm_registry.h"
+#include "polycall_sm_pool.h"
 #include "network.h"
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Protocol version
 #define POLYCALL_PROTOCOL_VERSION 1
 
@@ -49,6 +55,8 @@ typedef struct {
     uint32_t checksum;
 } polycall_message_header_t;
 
+struct polycall_protocol_internal;
+
 // Protocol session context
 typedef struct {
     polycall_context_t pc_ctx;
@@ -57,6 +65,8 @@ typedef struct {
     uint32_t next_sequence;
     polycall_protocol_state_t state;
     void* user_data;
+    uint64_t session_id;                        // 0 when not registered
+    struct polycall_protocol_internal* internal;  // Owned by the protocol layer
 } polycall_protocol_context_t;
 
 // Protocol callbacks
@@ -67,6 +77,8 @@ typedef struct {
     void (*on_error)(polycall_protocol_context_t* ctx, const char* error);
     void (*on_state_change)(polycall_protocol_context_t* ctx, polycall_protocol_state_t old_state, 
                            polycall_protocol_state_t new_state);
+    // Replies arrive in the order the peer handled the commands
+    void (*on_response)(polycall_protocol_context_t* ctx, const void* payload, size_t length);
 } polycall_protocol_callbacks_t;
 
 // Protocol configuration
@@ -76,6 +88,9 @@ typedef struct {
     size_t max_message_size;
     uint32_t timeout_ms;
     void* user_data;
+    polycall_sm_registry_t* registry;   // Optional, publishes the session machine
+    uint64_t session_id;                // Registry key, required with registry
+    polycall_sm_pool_t* sm_pool;        // Optional, recycles session machines
 } polycall_protocol_config_t;
 
 // Initialize protocol context
@@ -105,6 +120,14 @@ bool polycall_protocol_process(
     size_t length
 );
 
+// Receive one message from the session endpoint and process it. Loopback
+// frames are processed in the buffer the sender built; socket streams are
+// deframed, keeping a partial message (or the ones after it) buffered for
+// the next call. Returns false if no whole message was pending (errno
+// EAGAIN), the peer closed, or it was rejected; a payload over
+// max_message_size (64 KiB when 0) discards the buffered stream.
+bool polycall_protocol_receive(polycall_protocol_context_t* ctx);
+
 // Update protocol state
 void polycall_protocol_update(polycall_protocol_context_t* ctx);
 
@@ -156,6 +179,11 @@ bool polycall_protocol_verify_checksum(
 #define POLYCALL_TRANSITION_TO_ERROR "to_error"
 #define POLYCALL_TRANSITION_TO_CLOSED "to_closed"
 
+// Session machine every protocol context runs, states in
+// polycall_protocol_state_t order; also the definition to build an
+// sm_pool for polycall_protocol_config_t from
+extern const PolyCall_StateMachineDef polycall_protocol_sm_def;
+
 // Protocol version compatibility check
 bool polycall_protocol_version_compatible(uint8_t remote_version);
 
@@ -171,4 +199,8 @@ bool polycall_protocol_is_connected(const polycall_protocol_context_t* ctx);
 bool polycall_protocol_is_authenticated(const polycall_protocol_context_t* ctx);
 bool polycall_protocol_is_error(const polycall_protocol_context_t* ctx);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // POLYCALL_PROTOCOL_H
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef POLYCALL_QUEUE_H
+#define POLYCALL_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounded lock-free queues for handing items between threads.
+ *
+ * polycall_mpmc_t is Dmitry Vyukov's bounded multi-producer multi-consumer
+ * queue. Each cell carries a sequence number telling producers and
+ * consumers whether it is free or full for their lap, so an operation is
+ * one CAS on the shared position plus one store to the cell: no locks, no
+ * ABA, no allocation per item.
+ *
+ * polycall_spsc_t is a ring for exactly one producer thread and one
+ * consumer thread. Each side caches the other's position and reloads it
+ * only when the ring looks full (or empty), so the common case touches no
+ * shared cache line but the slot itself.
+ *
+ * Both copy fixed-size items in and out, round the capacity up to a power
+ * of two and keep the producer and consumer positions on separate cache
+ * lines. Push fails when full and pop when empty; nothing blocks.
+ */
+
+typedef struct polycall_mpmc polycall_mpmc_t;
+typedef struct polycall_spsc polycall_spsc_t;
+
+// NULL if item_size is 0 or memory runs out
+polycall_mpmc_t* polycall_mpmc_create(size_t capacity, size_t item_size);
+void polycall_mpmc_destroy(polycall_mpmc_t* queue);
+
+bool polycall_mpmc_push(polycall_mpmc_t* queue, const void* item);
+bool polycall_mpmc_pop(polycall_mpmc_t* queue, void* item);
+
+// Items pushed and not yet popped; exact only while the queue is quiet
+size_t polycall_mpmc_size(const polycall_mpmc_t* queue);
+size_t polycall_mpmc_capacity(const polycall_mpmc_t* queue);
+
+polycall_spsc_t* polycall_spsc_create(size_t capacity, size_t item_size);
+void polycall_spsc_destroy(polycall_spsc_t* ring);
+
+// Producer side
+bool polycall_spsc_push(polycall_spsc_t* ring, const void* item);
+
+// Consumer side. front() leaves the oldest item in place for inspection;
+// pop() copies it out (item may be NULL to discard it).
+void* polycall_spsc_front(polycall_spsc_t* ring);
+bool polycall_spsc_pop(polycall_spsc_t* ring, void* item);
+size_t polycall_spsc_pop_batch(polycall_spsc_t* ring, void* items, size_t max_items);
+
+// Any thread; exact only while the ring is quiet
+size_t polycall_spsc_size(const polycall_spsc_t* ring);
+size_t polycall_spsc_capacity(const polycall_spsc_t* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_QUEUE_H
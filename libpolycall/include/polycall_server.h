@@ -0,0 +1,133 @@
+#ifndef POLYCALL_SERVER_H
+#define POLYCALL_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "polycall.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Headless protocol server.
+ *
+ * Each I/O thread runs its own epoll loop with its own SO_REUSEPORT
+ * listener on every endpoint, so the kernel spreads new connections over
+ * the threads and a connection never leaves the thread that accepted it.
+ * Connections go through handshake and authentication and then have their
+ * commands answered by the handler: inline on the I/O thread, or on a
+ * worker pool in per-connection order, the replies coming back to the
+ * I/O thread through a lock-free queue.
+ *
+ * Reload swaps endpoints, limits, timeouts and the token while connections
+ * stay up; endpoints that did not change keep their listening sockets.
+ * Drain stops accepting and reading, answers every command already
+ * dispatched, flushes the replies and closes connections, forcing them
+ * after drain_timeout_ms. Commands still queued for a forced connection
+ * are dropped without calling the handler, so from then on drain only
+ * waits for handler calls already running; a handler that never returns
+ * keeps it from finishing.
+ */
+
+#define POLYCALL_SERVER_MAX_ENDPOINTS 16
+#define POLYCALL_SERVER_MAX_THREADS 64
+#define POLYCALL_SERVER_TOKEN_LENGTH 128
+
+// Largest reply payload: a protocol frame is at most 4096 bytes
+#define POLYCALL_SERVER_MAX_RESPONSE (4096 - 16)
+
+typedef struct polycall_server polycall_server_t;
+
+typedef struct {
+    char address[46];               // Numeric IPv4 or IPv6 address
+    uint16_t port;                  // 0 picks a free port
+} polycall_server_endpoint_t;
+
+typedef struct {
+    polycall_server_endpoint_t endpoints[POLYCALL_SERVER_MAX_ENDPOINTS];
+    size_t endpoint_count;
+    unsigned int io_threads;        // Event loops, 0 = one per online CPU
+    unsigned int workers;           // Handler threads, 0 = run handlers on the I/O threads
+    size_t max_connections;         // Over all threads; further accepts are closed at once
+    size_t max_inflight;            // Commands queued per connection before it stops being read
+    size_t recv_buffer_size;        // Bytes read per recv() call
+    size_t max_frame;               // Larger incoming frames close the connection
+    int backlog;
+    uint32_t idle_timeout_ms;       // 0 = never
+    uint32_t drain_timeout_ms;
+    char auth_token[POLYCALL_SERVER_TOKEN_LENGTH];  // Empty accepts any credentials
+} polycall_server_config_t;
+
+// Answer one command. Write at most capacity bytes to response and set
+// *response_length (0 replies "ok"); false replies with an ERROR frame
+// carrying the response bytes. Runs on an I/O or worker thread and may run
+// concurrently for different connections.
+typedef bool (*polycall_server_handler_t)(
+    void* user_data,
+    const void* request,
+    size_t request_length,
+    void* response,
+    size_t capacity,
+    size_t* response_length
+);
+
+// Defaults: one endpoint 0.0.0.0:8080, a thread per CPU, inline handlers
+void polycall_server_config_defaults(polycall_server_config_t* config);
+
+// Read a config file over the current values of config. One setting per
+// line, '#' starts a comment:
+//
+//     endpoint 0.0.0.0:8080          (repeatable; [::1]:9000 for IPv6)
+//     io_threads 4
+//     workers 0
+//     max_connections 65536
+//     max_inflight 128
+//     recv_buffer 16384
+//     max_frame 65536
+//     backlog 1024
+//     idle_timeout_ms 60000
+//     drain_timeout_ms 5000
+//     auth_token secret
+//
+// The first endpoint line replaces the default endpoints. On failure the
+// thread's error (polycall_error.h) names the offending line.
+polycall_status_t polycall_server_config_load(const char* path, polycall_server_config_t* config);
+
+// handler NULL echoes each command back
+polycall_status_t polycall_server_create(
+    polycall_context_t ctx,
+    const polycall_server_config_t* config,
+    polycall_server_handler_t handler,
+    void* user_data,
+    polycall_server_t** server
+);
+
+// Bind every endpoint and start the threads
+polycall_status_t polycall_server_start(polycall_server_t* server);
+
+// Apply a new configuration to the running server. io_threads and workers
+// only change on restart; a failed reload leaves the old settings in place.
+polycall_status_t polycall_server_reload(
+    polycall_server_t* server,
+    const polycall_server_config_t* config
+);
+
+// Port an endpoint is listening on (resolves port 0), 0 if not bound
+uint16_t polycall_server_port(const polycall_server_t* server, size_t endpoint);
+
+// Open connections over all threads
+size_t polycall_server_connections(const polycall_server_t* server);
+
+// Stop accepting, finish outstanding requests and join the threads
+void polycall_server_drain(polycall_server_t* server);
+
+// Drains first if still running
+void polycall_server_destroy(polycall_server_t* server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_SERVER_H
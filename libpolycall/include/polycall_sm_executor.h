@@ -0,0 +1,88 @@
+#ifndef POLYCALL_SM_EXECUTOR_H
+#define POLYCALL_SM_EXECUTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "polycall_state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Event-driven execution of state machines.
+ *
+ * Each attached machine gets a mailbox backed by a lock-free MPSC queue.
+ * Any thread may post events to a mailbox; exactly one executor shard
+ * (chosen by machine id) drains it, so transitions of a machine run to
+ * completion one at a time and in posting order without caller locking.
+ *
+ * Async transitions completed on a worker pool are posted back to the
+ * mailbox and committed on the shard; later events wait until then.
+ */
+
+typedef struct polycall_sm_executor polycall_sm_executor_t;
+typedef struct polycall_sm_mailbox polycall_sm_mailbox_t;
+
+// Invoked on the executor thread once an event's transition has finished
+typedef PolyCall_TransitionCallback polycall_sm_event_callback_t;
+
+// Executor configuration
+typedef struct {
+    unsigned int shard_count;   // Executor threads, 0 = one per online CPU
+    unsigned int batch_size;    // Events drained per mailbox turn, 0 = default
+    bool pin_threads;           // Pin shard N to CPU N (Linux only)
+} polycall_sm_executor_config_t;
+
+#define POLYCALL_SM_EXECUTOR_DEFAULT_BATCH 64
+
+// Start the executor shards
+polycall_sm_status_t polycall_sm_executor_create(
+    const polycall_sm_executor_config_t* config,
+    polycall_sm_executor_t** executor
+);
+
+// Drain all pending events, wait for async transitions still in flight (an
+// action that never completes blocks this), stop the shards and free the
+// remaining mailboxes, unhooking their machines
+void polycall_sm_executor_destroy(polycall_sm_executor_t* executor);
+
+// Attach a machine; its events are executed on shard (machine_id % shards)
+polycall_sm_status_t polycall_sm_executor_attach(
+    polycall_sm_executor_t* executor,
+    PolyCall_StateMachine* sm,
+    uint64_t machine_id,
+    polycall_sm_mailbox_t** mailbox
+);
+
+// Detach after all previously posted events ran; the mailbox is freed by
+// the executor and must not be used afterwards. Events that lose the race
+// with a detach are not run: their callbacks get
+// POLYCALL_SM_ERROR_INVALID_CONTEXT, possibly on the posting thread.
+polycall_sm_status_t polycall_sm_executor_detach(polycall_sm_mailbox_t* mailbox);
+
+// Post a transition by index (wait-free for the caller apart from allocation)
+polycall_sm_status_t polycall_sm_post_event(
+    polycall_sm_mailbox_t* mailbox,
+    unsigned int transition_id,
+    polycall_sm_event_callback_t callback,
+    void* user_data
+);
+
+// Post a transition by name; the name is resolved at post time
+polycall_sm_status_t polycall_sm_post_transition(
+    polycall_sm_mailbox_t* mailbox,
+    const char* transition_name,
+    polycall_sm_event_callback_t callback,
+    void* user_data
+);
+
+// Machine and id bound to a mailbox
+PolyCall_StateMachine* polycall_sm_mailbox_machine(const polycall_sm_mailbox_t* mailbox);
+uint64_t polycall_sm_mailbox_id(const polycall_sm_mailbox_t* mailbox);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_SM_EXECUTOR_H
@@ -0,0 +1,74 @@
+#ifndef POLYCALL_SM_OBSERVER_H
+#define POLYCALL_SM_OBSERVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "polycall_state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Multi-subscriber transition events.
+ *
+ * Each observer owns a bounded single-producer single-consumer ring
+ * (polycall_spsc_t). The thread running a transition pushes one event into
+ * every subscribed ring without locks or allocation and never waits for a
+ * consumer: when a ring is full the event is dropped and counted. Consumers
+ * drain their ring with polycall_sm_observer_poll from any one thread.
+ */
+
+typedef struct polycall_sm_observer polycall_sm_observer_t;
+
+typedef struct {
+    uint64_t sequence;          // Per-machine event number, gaps mean drops
+    uint64_t timestamp_ns;      // polycall_monotonic_ns() at publication
+    uint64_t machine_id;
+    unsigned int transition_id;
+    unsigned int from_state;
+    unsigned int to_state;
+    unsigned int version;       // Target state version after a commit
+    polycall_sm_status_t status;
+} polycall_sm_event_t;
+
+#define POLYCALL_SM_OBSERVER_DEFAULT_CAPACITY 256
+
+// Subscribe; capacity is rounded up to a power of two, 0 = default.
+// Safe to call while the machine is transitioning on another thread.
+polycall_sm_status_t polycall_sm_observe(
+    PolyCall_StateMachine* sm,
+    size_t capacity,
+    polycall_sm_observer_t** observer
+);
+
+// Unsubscribe and give up the handle, which must not be used afterwards.
+// Required even once the machine has been reset or destroyed.
+void polycall_sm_unobserve(polycall_sm_observer_t* observer);
+
+// Copy up to max_events pending events, oldest first
+size_t polycall_sm_observer_poll(
+    polycall_sm_observer_t* observer,
+    polycall_sm_event_t* events,
+    size_t max_events
+);
+
+// Events lost because the ring was full
+uint64_t polycall_sm_observer_dropped(const polycall_sm_observer_t* observer);
+
+// Transition-side fan-out, called by the state machine
+void polycall_sm_observers_publish(
+    PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    polycall_sm_status_t status
+);
+
+// Detach every observer of sm; used on destroy and reset. Subscribers can
+// still poll the events already queued until they unobserve.
+void polycall_sm_observers_clear(PolyCall_StateMachine* sm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_SM_OBSERVER_H
@@ -0,0 +1,71 @@
+#ifndef POLYCALL_SM_POOL_H
+#define POLYCALL_SM_POOL_H
+
+#include <stddef.h>
+#include "polycall_state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Recycled state machine instances for one definition.
+ *
+ * Machines are carved from slabs and never returned to the allocator
+ * while the pool lives. A released machine is reset with polycall_sm_reset,
+ * which rewrites only the states it touched, and parked on a per-thread
+ * free list so the next acquire on that thread takes no lock.
+ *
+ * polycall_sm_destroy() on a pooled machine releases it to its pool.
+ */
+
+typedef struct polycall_sm_pool polycall_sm_pool_t;
+
+typedef struct {
+    size_t slab_size;           // Machines allocated at once, 0 = default
+    size_t thread_cache;        // Machines kept per thread, 0 = default
+} polycall_sm_pool_config_t;
+
+#define POLYCALL_SM_POOL_DEFAULT_SLAB 64
+#define POLYCALL_SM_POOL_DEFAULT_CACHE 32
+
+typedef struct {
+    size_t allocated;           // Machines carved from slabs
+    size_t in_use;              // Acquired and not yet released
+    size_t slabs;
+} polycall_sm_pool_stats_t;
+
+// config may be NULL; def must outlive the pool
+polycall_sm_status_t polycall_sm_pool_create(
+    polycall_context_t ctx,
+    const PolyCall_StateMachineDef* def,
+    PolyCall_StateIntegrityCheck integrity_check,
+    const polycall_sm_pool_config_t* config,
+    polycall_sm_pool_t** pool
+);
+
+// Frees every slab; all machines must have been released
+void polycall_sm_pool_destroy(polycall_sm_pool_t* pool);
+
+// Machine in the definition's initial state
+polycall_sm_status_t polycall_sm_pool_acquire(
+    polycall_sm_pool_t* pool,
+    PolyCall_StateMachine** sm
+);
+
+// Reset and recycle; the machine must not be used afterwards. A machine
+// with an async transition in flight is parked and recycled by a later
+// acquire once the transition lands (POLYCALL_SM_PENDING; it counts as in
+// use until then). A machine from another pool is refused with
+// POLYCALL_SM_ERROR_INVALID_CONTEXT.
+polycall_sm_status_t polycall_sm_pool_release(polycall_sm_pool_t* pool, PolyCall_StateMachine* sm);
+
+void polycall_sm_pool_get_stats(polycall_sm_pool_t* pool, polycall_sm_pool_stats_t* stats);
+
+const PolyCall_StateMachineDef* polycall_sm_pool_def(const polycall_sm_pool_t* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_SM_POOL_H
@@ -0,0 +1,85 @@
+#ifndef POLYCALL_SM_REGISTRY_H
+#define POLYCALL_SM_REGISTRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "polycall_state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Concurrent map from 64-bit session id to state machine instance.
+ *
+ * The key space is split over power-of-two shards, each an open-addressing
+ * table with its own writer lock. Lookups take no locks. Tables grow by
+ * migrating a few slots on every write, so no caller ever waits for a
+ * whole table to be rehashed. Session id 0 is reserved.
+ *
+ * The registry does not own machines; removing an entry never destroys it.
+ */
+
+typedef struct polycall_sm_registry polycall_sm_registry_t;
+
+// Visitor verdicts for polycall_sm_registry_foreach
+typedef enum {
+    POLYCALL_SM_REGISTRY_CONTINUE = 0,
+    POLYCALL_SM_REGISTRY_STOP,
+    POLYCALL_SM_REGISTRY_REMOVE     // Drop this entry and continue
+} polycall_sm_registry_visit_t;
+
+// Runs with the entry's shard write-locked; must not call back into the
+// registry for other writes
+typedef polycall_sm_registry_visit_t (*polycall_sm_registry_visitor_t)(
+    uint64_t session_id,
+    PolyCall_StateMachine* sm,
+    void* user_data
+);
+
+#define POLYCALL_SM_REGISTRY_DEFAULT_SHARDS 64
+
+// shard_count is rounded up to a power of two, 0 = default
+polycall_sm_status_t polycall_sm_registry_create(
+    unsigned int shard_count,
+    size_t initial_capacity,
+    polycall_sm_registry_t** registry
+);
+
+void polycall_sm_registry_destroy(polycall_sm_registry_t* registry);
+
+// Fails with POLYCALL_SM_ERROR_ALREADY_EXISTS if the id is taken
+polycall_sm_status_t polycall_sm_registry_insert(
+    polycall_sm_registry_t* registry,
+    uint64_t session_id,
+    PolyCall_StateMachine* sm
+);
+
+// Lock-free; returns NULL when absent
+PolyCall_StateMachine* polycall_sm_registry_lookup(
+    polycall_sm_registry_t* registry,
+    uint64_t session_id
+);
+
+// removed may be NULL
+polycall_sm_status_t polycall_sm_registry_remove(
+    polycall_sm_registry_t* registry,
+    uint64_t session_id,
+    PolyCall_StateMachine** removed
+);
+
+// Number of live entries (approximate while writers are active)
+size_t polycall_sm_registry_count(polycall_sm_registry_t* registry);
+
+// Visit every entry one shard at a time; returns the number visited
+size_t polycall_sm_registry_foreach(
+    polycall_sm_registry_t* registry,
+    polycall_sm_registry_visitor_t visitor,
+    void* user_data
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_SM_REGISTRY_H
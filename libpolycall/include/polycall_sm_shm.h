@@ -0,0 +1,86 @@
+#ifndef POLYCALL_SM_SHM_H
+#define POLYCALL_SM_SHM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "polycall_state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Live machine state published into a named POSIX shared-memory region
+ * (unavailable on Windows, where creating or opening a region fails).
+ *
+ * Each attached machine owns one slot and rewrites it after every commit
+ * under a per-slot sequence lock: the writer never waits, and readers in
+ * any process retry until they copy a slot that was not being written.
+ * Monitors need no IPC round trip and put no load on the publisher.
+ */
+
+typedef struct polycall_sm_shm polycall_sm_shm_t;
+
+#define POLYCALL_SM_SHM_NAME_LENGTH 32
+
+// Consistent copy of one published slot
+typedef struct {
+    uint64_t machine_id;
+    unsigned int current_state;
+    unsigned int version;                   // Current state's version
+    unsigned int num_states;
+    uint64_t transition_count;              // Commits since attach
+    uint64_t failed_transitions;
+    uint64_t integrity_violations;
+    uint64_t updated;                       // Current state's timestamp
+    char state_name[POLYCALL_SM_SHM_NAME_LENGTH];
+} polycall_sm_shm_entry_t;
+
+// Create a region with room for slot_count machines. An existing region of
+// that name is never taken over: POLYCALL_SM_ERROR_ALREADY_EXISTS.
+polycall_sm_status_t polycall_sm_shm_create(
+    const char* name,
+    unsigned int slot_count,
+    polycall_sm_shm_t** shm
+);
+
+// Map an existing region read-only
+polycall_sm_status_t polycall_sm_shm_open(const char* name, polycall_sm_shm_t** shm);
+
+// Unmap; the creator also removes the name. Attached machines write into
+// the mapping, so the creator's close is refused with
+// POLYCALL_SM_ERROR_STATE_LOCKED until each one is detached or destroyed.
+polycall_sm_status_t polycall_sm_shm_close(polycall_sm_shm_t* shm);
+
+// Remove a name left behind by a publisher that exited without closing;
+// only call it once that publisher is known to be gone
+polycall_sm_status_t polycall_sm_shm_unlink(const char* name);
+
+unsigned int polycall_sm_shm_capacity(const polycall_sm_shm_t* shm);
+
+// Copy slot index; POLYCALL_SM_ERROR_NOT_FOUND when the slot is free
+polycall_sm_status_t polycall_sm_shm_read(
+    const polycall_sm_shm_t* shm,
+    unsigned int index,
+    polycall_sm_shm_entry_t* entry
+);
+
+// Claim a slot for sm and publish its current state; sm must be driven by
+// one thread at a time (as with executor mailboxes)
+polycall_sm_status_t polycall_sm_attach_shm(
+    PolyCall_StateMachine* sm,
+    polycall_sm_shm_t* shm,
+    uint64_t machine_id
+);
+
+// Free the machine's slot
+void polycall_sm_detach_shm(PolyCall_StateMachine* sm);
+
+// Rewrite the machine's slot; called on commit, committed counts one more
+void polycall_sm_shm_publish(PolyCall_StateMachine* sm, bool committed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_SM_SHM_H
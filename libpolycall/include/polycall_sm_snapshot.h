@@ -0,0 +1,80 @@
+#ifndef POLYCALL_SM_SNAPSHOT_H
+#define POLYCALL_SM_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "polycall_state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Incremental whole-machine snapshots for replication.
+ *
+ * A base snapshot carries every state. Each later delta carries only the
+ * states whose data or counters changed since the previous epoch (tracked
+ * by the machine's delta_dirty bitmap), plus the current state and machine
+ * counters. A standby applies a delta only on top of the epoch it was
+ * encoded against, so a lost delta is detected and answered with a base.
+ *
+ * Encoding is native-endian; primary and standby must share an ABI.
+ *
+ * Encoding reads the machine and consumes its delta_dirty bitmap, and
+ * applying rewrites it, so both run on the thread that drives the machine's
+ * transitions (for executor machines, between mailbox events), never
+ * concurrently with a transition.
+ */
+
+// Header plus every state: the largest possible encoding
+#define POLYCALL_SM_SNAPSHOT_MAX_SIZE (56 + POLYCALL_MAX_STATES * 24)
+
+typedef struct {
+    uint64_t machine_id;
+    uint64_t base_epoch;        // Epoch the delta applies to, 0 for a base
+    uint64_t epoch;             // Epoch reached after applying
+    unsigned int state_count;   // States carried
+    bool is_base;
+} polycall_sm_snapshot_info_t;
+
+// Encode every state and start a new epoch. A buffer below the encoded
+// size fails with BUFFER_TOO_SMALL, sets *length to the size needed and
+// leaves the epoch alone.
+polycall_sm_status_t polycall_sm_snapshot_base(
+    PolyCall_StateMachine* sm,
+    void* buffer,
+    size_t capacity,
+    size_t* length
+);
+
+// Encode what changed since the previous epoch and start a new one;
+// without a prior base this produces a base. Buffer sizing as for a base.
+polycall_sm_status_t polycall_sm_snapshot_delta(
+    PolyCall_StateMachine* sm,
+    void* buffer,
+    size_t capacity,
+    size_t* length
+);
+
+// Decode the header without applying (e.g. to route by machine id)
+polycall_sm_status_t polycall_sm_snapshot_peek(
+    const void* buffer,
+    size_t length,
+    polycall_sm_snapshot_info_t* info
+);
+
+// Apply on a standby built from the same definition; a delta whose base
+// epoch differs from the machine's fails with VERSION_MISMATCH. Restored
+// states are resealed, so integrity checks keep passing.
+polycall_sm_status_t polycall_sm_snapshot_apply(
+    PolyCall_StateMachine* sm,
+    const void* buffer,
+    size_t length
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_SM_SNAPSHOT_H
@@ -0,0 +1,108 @@
+#ifndef POLYCALL_SM_WAL_H
+#define POLYCALL_SM_WAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "polycall_state_machine.h"
+#include "polycall_sm_registry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Write-ahead log of committed transitions.
+ *
+ * Machines attached with polycall_sm_set_wal() append one fixed-size record
+ * per committed transition. Appends only copy into memory; a background
+ * thread writes whole batches and issues one fdatasync per batch (group
+ * commit), so the cost of a sync is shared by every transition that
+ * arrived while the previous one was in progress.
+ *
+ * Checkpoints store every registered machine and truncate the log.
+ * Recovery restores the checkpoint, then replays newer records in order.
+ */
+
+typedef struct polycall_sm_wal polycall_sm_wal_t;
+
+// On-disk record; lsn and checksum are filled in by the log
+typedef struct {
+    uint64_t lsn;
+    uint64_t machine_id;
+    uint64_t timestamp;         // State timestamp after the transition
+    uint32_t transition_id;
+    uint32_t from_state;
+    uint32_t to_state;
+    uint32_t version;           // Target state version after the transition
+    uint32_t reserved;
+    uint32_t checksum;
+} polycall_sm_wal_record_t;
+
+typedef struct {
+    const char* path;           // Log file; the checkpoint is path + ".ckpt"
+    size_t batch_records;       // Records buffered per batch, 0 = default
+    bool no_sync;               // Skip fdatasync (loses durability, keeps ordering)
+} polycall_sm_wal_config_t;
+
+#define POLYCALL_SM_WAL_DEFAULT_BATCH 4096
+
+// wal_lsn of a machine whose last commit the log refused; syncing it
+// reports POLYCALL_SM_ERROR_IO. UINT64_MAX still means "everything".
+#define POLYCALL_SM_WAL_LSN_LOST (UINT64_MAX - 1)
+
+// Result of polycall_sm_wal_recover
+typedef struct {
+    uint64_t checkpoint_lsn;
+    uint64_t last_lsn;
+    size_t machines_restored;
+    size_t records_applied;
+    size_t records_skipped;     // Unknown machine or invalid state
+} polycall_sm_wal_recovery_t;
+
+// Open (or create) the log and start the flusher; numbering continues
+// after the last valid record and a torn tail is discarded
+polycall_sm_status_t polycall_sm_wal_open(
+    const polycall_sm_wal_config_t* config,
+    polycall_sm_wal_t** wal
+);
+
+// Flush everything appended so far, stop the flusher and close the file
+void polycall_sm_wal_close(polycall_sm_wal_t* wal);
+
+// Queue a record; blocks only while the current batch is full
+polycall_sm_status_t polycall_sm_wal_append(
+    polycall_sm_wal_t* wal,
+    const polycall_sm_wal_record_t* record,
+    uint64_t* lsn
+);
+
+// Wait until every record up to lsn is on stable storage; fails for
+// POLYCALL_SM_WAL_LSN_LOST and once the log could not be written
+polycall_sm_status_t polycall_sm_wal_sync(polycall_sm_wal_t* wal, uint64_t lsn);
+
+uint64_t polycall_sm_wal_durable_lsn(polycall_sm_wal_t* wal);
+
+// Write a checkpoint of every machine in registry, then truncate the log.
+// Only the flusher waits while machines are copied; appends keep filling
+// the current batch. Machine state is read without synchronising with the
+// threads that drive the machines, so they must not transition until this
+// returns (e.g. call it between executor batches or with executors paused).
+polycall_sm_status_t polycall_sm_wal_checkpoint(
+    polycall_sm_wal_t* wal,
+    polycall_sm_registry_t* registry
+);
+
+// Restore machines already present in registry from the checkpoint and
+// log at path; call before polycall_sm_wal_open. result may be NULL.
+polycall_sm_status_t polycall_sm_wal_recover(
+    const char* path,
+    polycall_sm_registry_t* registry,
+    polycall_sm_wal_recovery_t* result
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_SM_WAL_H
@@ -9,6 +9,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "polycall.h"
+#include "polycall_histogram.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,6 +28,21 @@ typedef struct PolyCall_State {
     bool is_locked;
 } PolyCall_State;
 
+// Result of an async-capable transition action
+typedef enum {
+    POLYCALL_SM_ACTION_DONE = 0,
+    POLYCALL_SM_ACTION_PENDING
+} polycall_sm_action_result_t;
+
+// Handle for an in-flight async transition
+typedef struct PolyCall_AsyncToken PolyCall_AsyncToken;
+
+// Action that may finish later by calling polycall_sm_async_complete(token)
+typedef polycall_sm_action_result_t (*PolyCall_AsyncAction)(
+    polycall_context_t ctx,
+    PolyCall_AsyncToken* token
+);
+
 // Transition structure with validation
 typedef struct PolyCall_Transition {
     char name[POLYCALL_MAX_NAME_LENGTH];
@@ -36,11 +52,30 @@ typedef struct PolyCall_Transition {
     bool is_valid;
     bool (*guard_condition)(const PolyCall_State*, const PolyCall_State*);
     uint32_t guard_checksum;
+    bool is_async;                      // Run callbacks on the worker pool
+    PolyCall_AsyncAction async_action;  // Optional, may return PENDING
 } PolyCall_Transition;
 
 // State integrity verification function type
 typedef bool (*PolyCall_StateIntegrityCheck)(const PolyCall_State* state);
 
+// Opaque per-instance instrumentation (histograms and history ring)
+struct PolyCall_SMInstrumentation;
+struct polycall_worker_pool;
+struct polycall_sm_wal;
+struct polycall_sm_pool;
+struct polycall_sm_shm_slot;
+struct polycall_sm_observer;
+struct PolyCall_StateMachine;
+
+// Hook that applies a finished async transition; lets an owner (such as an
+// executor) move the commit onto the thread that serializes the machine
+typedef void (*PolyCall_AsyncCommitHook)(
+    struct PolyCall_StateMachine* sm,
+    PolyCall_AsyncToken* token,
+    void* hook_data
+);
+
 // State machine structure
 typedef struct PolyCall_StateMachine {
     PolyCall_State states[POLYCALL_MAX_STATES];
@@ -55,10 +90,43 @@ typedef struct PolyCall_StateMachine {
     struct {
         unsigned int failed_transitions;
         unsigned int integrity_violations;
+        unsigned int wal_failures;      // Commits the log refused
         uint64_t last_verification;
     } diagnostics;
+    struct {
+        unsigned int transition_count;
+        unsigned int integrity_check_count;
+    } state_stats[POLYCALL_MAX_STATES];
+    struct PolyCall_SMInstrumentation* instrumentation;
+    struct polycall_worker_pool* worker_pool;
+    unsigned int pending_transition;    // In-flight async transition id + 1, 0 when idle
+    PolyCall_AsyncCommitHook async_commit;
+    void* async_commit_data;
+    struct polycall_sm_wal* wal;        // Commit log, NULL when not durable
+    uint64_t machine_id;                // Identity used in log records
+    uint64_t wal_lsn;                   // LSN of the last logged transition, or
+                                        // POLYCALL_SM_WAL_LSN_LOST if it was refused
+    uint32_t dirty_states;              // States written since creation or reset
+    bool layout_dirty;                  // States or transitions edited after creation
+    struct polycall_sm_pool* pool;      // Owning pool, NULL when heap allocated
+    struct polycall_sm_shm_slot* shm_slot;  // Published shared-memory slot
+    struct polycall_sm_observer* observers; // Transition event subscribers
+    uint64_t event_sequence;            // Events published to observers
+    uint32_t delta_dirty;               // States changed since the last snapshot epoch
+    uint64_t snapshot_epoch;            // Last epoch encoded (primary) or applied (standby)
 } PolyCall_StateMachine;
 
+// Static machine definition: constant tables copied into an instance at
+// creation time. Normally emitted by the polycall-smc tool.
+typedef struct PolyCall_StateMachineDef {
+    const char* name;
+    const PolyCall_State* states;
+    unsigned int num_states;
+    const PolyCall_Transition* transitions;
+    unsigned int num_transitions;
+    unsigned int initial_state;
+} PolyCall_StateMachineDef;
+
 // Status codes
 typedef enum {
     POLYCALL_SM_SUCCESS = 0,
@@ -70,9 +138,24 @@ typedef enum {
     POLYCALL_SM_ERROR_NOT_INITIALIZED,
     POLYCALL_SM_ERROR_INTEGRITY_CHECK_FAILED,
     POLYCALL_SM_ERROR_STATE_LOCKED,
-    POLYCALL_SM_ERROR_VERSION_MISMATCH
+    POLYCALL_SM_ERROR_VERSION_MISMATCH,
+    POLYCALL_SM_PENDING,
+    POLYCALL_SM_ERROR_TRANSITION_PENDING,
+    POLYCALL_SM_ERROR_NOT_FOUND,
+    POLYCALL_SM_ERROR_ALREADY_EXISTS,
+    POLYCALL_SM_ERROR_IO,
+    POLYCALL_SM_ERROR_OUT_OF_MEMORY,
+    POLYCALL_SM_ERROR_BUFFER_TOO_SMALL
 } polycall_sm_status_t;
 
+// Completion callback for transitions that may finish asynchronously
+typedef void (*PolyCall_TransitionCallback)(
+    struct PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    polycall_sm_status_t status,
+    void* user_data
+);
+
 // State snapshot structure
 typedef struct PolyCall_StateSnapshot {
     PolyCall_State state;
@@ -91,6 +174,37 @@ typedef struct PolyCall_StateDiagnostics {
     uint32_t current_checksum;
 } PolyCall_StateDiagnostics;
 
+// Transition callback phases timed by instrumentation
+typedef enum {
+    POLYCALL_SM_PHASE_GUARD = 0,
+    POLYCALL_SM_PHASE_EXIT,
+    POLYCALL_SM_PHASE_ACTION,
+    POLYCALL_SM_PHASE_ENTER,
+    POLYCALL_SM_PHASE_COUNT
+} polycall_sm_phase_t;
+
+// Per-transition counters and latency histograms (nanoseconds)
+typedef struct PolyCall_TransitionStats {
+    uint64_t count;
+    uint64_t failures;
+    polycall_histogram_t phases[POLYCALL_SM_PHASE_COUNT];
+    polycall_histogram_t total;
+} PolyCall_TransitionStats;
+
+// Number of recent transitions kept in the history ring
+#define POLYCALL_SM_HISTORY_SIZE 64
+
+// Entry of the transition history ring
+typedef struct PolyCall_TransitionRecord {
+    uint64_t sequence;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    unsigned int transition_id;
+    unsigned int from_state;
+    unsigned int to_state;
+    polycall_sm_status_t status;
+} PolyCall_TransitionRecord;
+
 // API functions
 polycall_sm_status_t polycall_sm_create_with_integrity(
     polycall_context_t ctx, 
@@ -98,6 +212,21 @@ polycall_sm_status_t polycall_sm_create_with_integrity(
     PolyCall_StateIntegrityCheck integrity_check
 );
 
+// Create a machine pre-populated from a static definition
+polycall_sm_status_t polycall_sm_create_from_def(
+    polycall_context_t ctx,
+    const PolyCall_StateMachineDef* def,
+    PolyCall_StateMachine** sm,
+    PolyCall_StateIntegrityCheck integrity_check
+);
+
+// Return a machine built from def to its initial state. Only states marked
+// dirty are rewritten unless the layout itself was edited.
+polycall_sm_status_t polycall_sm_reset(
+    PolyCall_StateMachine* sm,
+    const PolyCall_StateMachineDef* def
+);
+
 polycall_sm_status_t polycall_sm_add_state(
     PolyCall_StateMachine* sm,
     const char* name,
@@ -120,6 +249,74 @@ polycall_sm_status_t polycall_sm_execute_transition(
     const char* transition_name
 );
 
+// Execute a transition by index, skipping the name lookup
+polycall_sm_status_t polycall_sm_execute_transition_id(
+    PolyCall_StateMachine* sm,
+    unsigned int transition_id
+);
+
+// Execute a transition and report its final status through callback, which
+// runs exactly once whenever sm is non-NULL: before returning for any status
+// but POLYCALL_SM_PENDING, failures included. Async transitions return
+// POLYCALL_SM_PENDING immediately; their on_exit, action and on_enter run on
+// the machine's worker pool (inline when none is set) and the state changes
+// once the work completes.
+polycall_sm_status_t polycall_sm_execute_transition_async(
+    PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    PolyCall_TransitionCallback callback,
+    void* user_data
+);
+
+// Mark a transition async; async_action may be NULL to only offload callbacks
+polycall_sm_status_t polycall_sm_set_transition_async(
+    PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    PolyCall_AsyncAction async_action
+);
+
+// Pool used for async transitions (not owned by the machine)
+polycall_sm_status_t polycall_sm_set_worker_pool(
+    PolyCall_StateMachine* sm,
+    struct polycall_worker_pool* pool
+);
+
+// Log every committed transition to wal under machine_id (NULL detaches);
+// use the registry session id so recovery can find the machine
+polycall_sm_status_t polycall_sm_set_wal(
+    PolyCall_StateMachine* sm,
+    struct polycall_sm_wal* wal,
+    uint64_t machine_id
+);
+
+// Overwrite a state's persisted fields and reseal its integrity checksum,
+// without touching current_state or the dirty maps; used when restoring
+// checkpoints and replicas
+polycall_sm_status_t polycall_sm_restore_state_fields(
+    PolyCall_StateMachine* sm,
+    unsigned int state_id,
+    unsigned int version,
+    uint64_t timestamp,
+    bool is_locked
+);
+
+// Force the current state without running callbacks; used by recovery
+polycall_sm_status_t polycall_sm_recover_state(
+    PolyCall_StateMachine* sm,
+    unsigned int state_id,
+    unsigned int version,
+    uint64_t timestamp
+);
+
+// Finish an action that returned POLYCALL_SM_ACTION_PENDING (any thread)
+void polycall_sm_async_complete(PolyCall_AsyncToken* token, polycall_sm_status_t status);
+
+// Apply a completed async transition; called by commit hooks
+void polycall_sm_async_commit(PolyCall_StateMachine* sm, PolyCall_AsyncToken* token);
+
+// True while an async transition is in flight
+bool polycall_sm_async_pending(const PolyCall_StateMachine* sm);
+
 polycall_sm_status_t polycall_sm_verify_state_integrity(
     PolyCall_StateMachine* sm,
     unsigned int state_id
@@ -158,6 +355,37 @@ polycall_sm_status_t polycall_sm_get_state_diagnostics(
     PolyCall_StateDiagnostics* diagnostics
 );
 
+// Instrumentation: disabled by default, costs one branch per transition when off.
+// Disabling only stops recording: the stats and history stay allocated and
+// readable (lock-free readers may still hold them) until the machine is
+// reset or destroyed, and enabling again resumes where they left off.
+polycall_sm_status_t polycall_sm_enable_instrumentation(
+    PolyCall_StateMachine* sm,
+    bool enable
+);
+
+// Safe from any thread while transitions run; the copy is never torn
+polycall_sm_status_t polycall_sm_get_transition_stats(
+    const PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    PolyCall_TransitionStats* stats
+);
+
+// Copy up to max_records recent transitions, newest first
+polycall_sm_status_t polycall_sm_get_transition_history(
+    const PolyCall_StateMachine* sm,
+    PolyCall_TransitionRecord* records,
+    size_t max_records,
+    size_t* record_count
+);
+
+// Write all diagnostics, transition stats and history as JSON
+polycall_sm_status_t polycall_sm_export_stats(
+    const PolyCall_StateMachine* sm,
+    FILE* out
+);
+
+// Pooled machines are handed back to their pool instead of being freed
 void polycall_sm_destroy(PolyCall_StateMachine* sm);
 
 
@@ -0,0 +1,48 @@
+#ifndef POLYCALL_TRACE_H
+#define POLYCALL_TRACE_H
+
+/*
+ * Static tracepoints (USDT).
+ *
+ * When <sys/sdt.h> is available each POLYCALL_TRACEn site compiles to a
+ * single nop plus an ELF note describing the probe and where its
+ * arguments live; nothing runs until a tracer patches the nop. Without
+ * the header, or with POLYCALL_DISABLE_TRACE defined, the macros expand
+ * to nothing and their arguments are not evaluated.
+ *
+ * Provider "polycall", probes and arguments:
+ *   accept           fd, port
+ *   recv             fd, bytes
+ *   send             fd, bytes
+ *   frame_decode     session_id, sequence, type, payload_length
+ *   dispatch         session_id, sequence, type
+ *   dispatch_done    session_id, sequence, type, ok
+ *   message_send     session_id, sequence, type, bytes
+ *   transition_begin machine_id, transition_id, from_state, to_state
+ *   transition_end   machine_id, transition_id, to_state, status
+ *   integrity_check  machine_id, state_id, ok
+ *
+ * e.g. per-message dispatch latency:
+ *   bpftrace -e 'usdt:./libpolycall.so:polycall:dispatch { @s[arg1] = nsecs; }
+ *     usdt:./libpolycall.so:polycall:dispatch_done /@s[arg1]/ {
+ *       @ns = hist(nsecs - @s[arg1]); delete(@s[arg1]); }'
+ */
+
+#if !defined(POLYCALL_DISABLE_TRACE) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define POLYCALL_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef POLYCALL_HAVE_USDT
+#define POLYCALL_TRACE2(name, a, b) DTRACE_PROBE2(polycall, name, a, b)
+#define POLYCALL_TRACE3(name, a, b, c) DTRACE_PROBE3(polycall, name, a, b, c)
+#define POLYCALL_TRACE4(name, a, b, c, d) DTRACE_PROBE4(polycall, name, a, b, c, d)
+#else
+#define POLYCALL_TRACE2(name, a, b) do { } while (0)
+#define POLYCALL_TRACE3(name, a, b, c) do { } while (0)
+#define POLYCALL_TRACE4(name, a, b, c, d) do { } while (0)
+#endif
+
+#endif // POLYCALL_TRACE_H
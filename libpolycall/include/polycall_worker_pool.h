@@ -0,0 +1,60 @@
+#ifndef POLYCALL_WORKER_POOL_H
+#define POLYCALL_WORKER_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "polycall.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Library-owned thread pool used to run application callbacks off the
+// network and executor threads.
+//
+// Each worker owns a Chase-Lev deque: tasks submitted from a worker go on
+// its own deque and run newest first, tasks from other threads go on a
+// shared injection queue, and idle workers steal the oldest task from a
+// random busy one, so a burst of CPU-heavy work spreads over every core.
+// Ordered submissions are keyed onto POLYCALL_WORKER_POOL_STRANDS strands;
+// tasks on one strand never overlap and run in submission order.
+#define POLYCALL_WORKER_POOL_STRANDS 64
+
+typedef struct polycall_worker_pool polycall_worker_pool_t;
+
+typedef void (*polycall_task_fn)(void* arg);
+
+// Start a pool; thread_count 0 = one thread per online CPU
+polycall_status_t polycall_worker_pool_create(
+    unsigned int thread_count,
+    polycall_worker_pool_t** pool
+);
+
+// Queue a task; returns false if the pool is shutting down or out of memory
+bool polycall_worker_pool_submit(
+    polycall_worker_pool_t* pool,
+    polycall_task_fn fn,
+    void* arg
+);
+
+// Queue a task after every earlier task submitted with the same key (e.g.
+// a session id). Distinct keys may share a strand and then also run in
+// order relative to each other.
+bool polycall_worker_pool_submit_ordered(
+    polycall_worker_pool_t* pool,
+    uint64_t key,
+    polycall_task_fn fn,
+    void* arg
+);
+
+// Number of worker threads
+unsigned int polycall_worker_pool_size(const polycall_worker_pool_t* pool);
+
+// Run all queued tasks, then stop and join the workers
+void polycall_worker_pool_destroy(polycall_worker_pool_t* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLYCALL_WORKER_POOL_H
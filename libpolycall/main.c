@@ -1,12 +1,21 @@
 #include "polycall.h"
 #include "polycall_protocol.h"
 #include "polycall_state_machine.h"
+#include "polycall_sm_shm.h"
+#include "polycall_metrics.h"
+#include "polycall_server.h"
+#include "polycall_error.h"
 #include "network.h"
+#include "polycall_cli_sm.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -17,6 +26,8 @@
 #define HISTORY_SIZE 10
 #define MAX_ENDPOINTS 16
 #define MAX_PROGRAMS 8
+#define SHM_SLOTS 64
+#define CLI_MACHINE_ID 1
 
 // Global state
 typedef struct {
@@ -24,6 +35,8 @@ typedef struct {
     size_t program_count;
     polycall_context_t pc_ctx;
     PolyCall_StateMachine* state_machine;
+    polycall_sm_shm_t* shm;
+    polycall_metrics_server_t* metrics_server;
     char command_history[HISTORY_SIZE][MAX_INPUT];
     int history_count;
     PolyCall_StateSnapshot snapshots[POLYCALL_MAX_STATES];
@@ -36,28 +49,28 @@ typedef struct {
 
 static PPI_Runtime g_runtime = {0};
 
-// State machine callbacks
-static void on_init(polycall_context_t ctx) {
+// State machine callbacks, bound by the generated polycall_cli_sm_def
+void on_init(polycall_context_t ctx) {
     (void)ctx;
     printf("State callback: System initialized\n");
 }
 
-static void on_ready(polycall_context_t ctx) {
+void on_ready(polycall_context_t ctx) {
     (void)ctx;
     printf("State callback: System ready\n");
 }
 
-static void on_running(polycall_context_t ctx) {
+void on_running(polycall_context_t ctx) {
     (void)ctx;
     printf("State callback: System running\n");
 }
 
-static void on_paused(polycall_context_t ctx) {
+void on_paused(polycall_context_t ctx) {
     (void)ctx;
     printf("State callback: System paused\n");
 }
 
-static void on_error(polycall_context_t ctx) {
+void on_error(polycall_context_t ctx) {
     (void)ctx;
     printf("State callback: System error\n");
     g_runtime.running = false;
@@ -93,6 +106,14 @@ static void print_help(void) {
     printf("  snapshot STATE_ID     - Create state snapshot\n");
     printf("  restore STATE_ID      - Restore from snapshot\n");
     printf("  diagnostics STATE_ID  - Get state diagnostics\n");
+    printf("  instrument on|off     - Toggle transition latency instrumentation\n");
+    printf("  stats                 - Export transition statistics as JSON\n");
+    printf("  publish_shm NAME      - Publish live state to shared memory NAME\n");
+    printf("  monitor NAME          - Show machines published under NAME\n");
+    
+    printf("\nMetrics Commands:\n");
+    printf("  metrics               - Print metrics in Prometheus text format\n");
+    printf("  serve_metrics PORT    - Serve metrics on 127.0.0.1:PORT\n");
     
     printf("\nMiscellaneous Commands:\n");
     printf("  list_states          - List all states\n");
@@ -175,6 +196,41 @@ static void list_clients(void) {
     }
 }
 
+static void print_metrics(void) {
+    polycall_metrics_t* metrics = polycall_context_metrics(g_runtime.pc_ctx);
+    size_t length = polycall_metrics_render(metrics, NULL, 0);
+    char* text = malloc(length + 1);
+    if (!text) return;
+    polycall_metrics_render(metrics, text, length + 1);
+    fputs(text, stdout);
+    free(text);
+}
+
+static void monitor_shm(const char* name) {
+    polycall_sm_shm_t* shm;
+    polycall_sm_status_t status = polycall_sm_shm_open(name, &shm);
+    if (status != POLYCALL_SM_SUCCESS) {
+        printf("Cannot open shared memory '%s' (status %d)\n", name, status);
+        return;
+    }
+
+    printf("\nMachines published in '%s':\n", name);
+    unsigned int shown = 0;
+    for (unsigned int i = 0; i < polycall_sm_shm_capacity(shm); i++) {
+        polycall_sm_shm_entry_t entry;
+        if (polycall_sm_shm_read(shm, i, &entry) != POLYCALL_SM_SUCCESS) continue;
+        printf("  [%llu] state %u (%s) v%u, transitions: %llu, failed: %llu, violations: %llu\n",
+               (unsigned long long)entry.machine_id, entry.current_state, entry.state_name,
+               entry.version, (unsigned long long)entry.transition_count,
+               (unsigned long long)entry.failed_transitions,
+               (unsigned long long)entry.integrity_violations);
+        shown++;
+    }
+    if (!shown) printf("  (none)\n");
+
+    polycall_sm_shm_close(shm);
+}
+
 static void show_status(void) {
     printf("\nSystem Status:\n");
     printf("  State Machine: %s\n", g_runtime.state_machine ? "Initialized" : "Not initialized");
@@ -184,6 +240,7 @@ static void show_status(void) {
     if (g_runtime.state_machine) {
         printf("  Current State: %u\n", g_runtime.state_machine->current_state);
     }
+    printf("  Shared Memory: %s\n", g_runtime.shm ? "Publishing" : "Off");
     
     list_endpoints();
     list_clients();
@@ -213,20 +270,14 @@ static bool initialize_runtime(void) {
         return false;
     }
 
-    // Initialize state machine
-    if (polycall_sm_create_with_integrity(g_runtime.pc_ctx, &g_runtime.state_machine, NULL) 
+    // Initialize state machine from the compiled definition (polycall_cli.sm)
+    if (polycall_sm_create_from_def(g_runtime.pc_ctx, &polycall_cli_sm_def,
+                                    &g_runtime.state_machine, NULL) 
         != POLYCALL_SM_SUCCESS) {
         fprintf(stderr, "Failed to create state machine\n");
         return false;
     }
 
-    // Add default states
-    polycall_sm_add_state(g_runtime.state_machine, "INIT", on_init, NULL, false);
-    polycall_sm_add_state(g_runtime.state_machine, "READY", on_ready, NULL, false);
-    polycall_sm_add_state(g_runtime.state_machine, "RUNNING", on_running, NULL, false);
-    polycall_sm_add_state(g_runtime.state_machine, "PAUSED", on_paused, NULL, false);
-    polycall_sm_add_state(g_runtime.state_machine, "ERROR", on_error, NULL, true);
-
     g_runtime.running = true;
     return true;
 }
@@ -245,6 +296,16 @@ static void cleanup_runtime(void) {
         polycall_sm_destroy(g_runtime.state_machine);
         g_runtime.state_machine = NULL;
     }
+
+    if (g_runtime.shm) {
+        polycall_sm_shm_close(g_runtime.shm);
+        g_runtime.shm = NULL;
+    }
+    
+    if (g_runtime.metrics_server) {
+        polycall_metrics_server_stop(g_runtime.metrics_server);
+        g_runtime.metrics_server = NULL;
+    }
     
     if (g_runtime.pc_ctx) {
         polycall_cleanup(g_runtime.pc_ctx);
@@ -290,11 +351,102 @@ static void on_network_disconnect(NetworkEndpoint* endpoint) {
 }
 
 
+#ifndef _WIN32
+// Headless daemon: no prompt, no per-connection output. SIGHUP re-reads the
+// config file, SIGTERM or SIGINT drains and exits.
+static int serve(const char* config_path) {
+    // Block the signals before any thread starts so only sigwait sees them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    polycall_server_config_t config;
+    polycall_server_config_defaults(&config);
+    if (polycall_server_config_load(config_path, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "polycall: %s: %s\n", config_path, polycall_error_message());
+        return 1;
+    }
+
+    polycall_context_t ctx;
+    polycall_config_t pc_config = {
+        .flags = 0,
+        .memory_pool_size = 4 * 1024 * 1024,
+        .user_data = NULL
+    };
+    if (polycall_init_with_config(&ctx, &pc_config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "polycall: failed to initialize PolyCall context\n");
+        return 1;
+    }
+
+    polycall_server_t* server;
+    if (polycall_server_create(ctx, &config, NULL, NULL, &server) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "polycall: %s\n", polycall_error_message());
+        polycall_cleanup(ctx);
+        return 1;
+    }
+    if (polycall_server_start(server) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "polycall: %s\n", polycall_error_message());
+        polycall_server_destroy(server);
+        polycall_cleanup(ctx);
+        return 1;
+    }
+    for (size_t i = 0; i < config.endpoint_count; i++) {
+        fprintf(stderr, "polycall: listening on %s port %u\n",
+                config.endpoints[i].address, polycall_server_port(server, i));
+    }
+
+    for (;;) {
+        int signal_number;
+        if (sigwait(&signals, &signal_number) != 0) continue;
+        if (signal_number != SIGHUP) break;
+
+        // Settings removed from the file fall back to their defaults; the
+        // thread counts carry over since they cannot change in place
+        polycall_server_config_t reloaded;
+        polycall_server_config_defaults(&reloaded);
+        reloaded.io_threads = config.io_threads;
+        reloaded.workers = config.workers;
+        if (polycall_server_config_load(config_path, &reloaded) != POLYCALL_SUCCESS ||
+            polycall_server_reload(server, &reloaded) != POLYCALL_SUCCESS) {
+            fprintf(stderr, "polycall: reload failed, keeping the running config: %s\n",
+                    polycall_error_message());
+            continue;
+        }
+        if (reloaded.io_threads != config.io_threads || reloaded.workers != config.workers) {
+            fprintf(stderr, "polycall: io_threads and workers take effect on restart\n");
+            reloaded.io_threads = config.io_threads;
+            reloaded.workers = config.workers;
+        }
+        config = reloaded;
+        fprintf(stderr, "polycall: reloaded %s\n", config_path);
+    }
+
+    fprintf(stderr, "polycall: draining %zu connections\n", polycall_server_connections(server));
+    polycall_server_destroy(server);
+    polycall_cleanup(ctx);
+    return 0;
+}
+#endif
+
 // Main program
-int main(void) {
+int main(int argc, char** argv) {
     char input[MAX_INPUT];
     char *command, *arg1, *arg2, *arg3;
     
+    if (argc > 1) {
+#ifndef _WIN32
+        if (argc == 4 && strcmp(argv[1], "serve") == 0 && strcmp(argv[2], "--config") == 0) {
+            return serve(argv[3]);
+        }
+#endif
+        fprintf(stderr, "usage: %s [serve --config FILE]\n", argv[0]);
+        return 2;
+    }
+
     printf("PolyCall CLI v%s - Type 'help' for commands\n", PPI_VERSION);
 
     if (!initialize_runtime()) {
@@ -334,7 +486,7 @@ int main(void) {
 } else if (strcmp(command, "start_network") == 0) {
     NetworkProgram* program = calloc(1, sizeof(NetworkProgram));
     if (program) {
-        net_init_program(program);
+        net_init_program_with_context(program, g_runtime.pc_ctx);
         if (program->endpoints && program->count > 0) {
             // Set up handlers
             program->handlers.on_receive = on_network_receive;
@@ -385,6 +537,93 @@ int main(void) {
             } else {
                 printf("Failed to add state\n");
             }
+        } else if (strcmp(command, "execute") == 0) {
+            if (!g_runtime.state_machine) {
+                printf("State machine not initialized\n");
+                continue;
+            }
+            if (!arg1) {
+                printf("Usage: execute TRANSITION_NAME\n");
+                continue;
+            }
+            if (polycall_sm_execute_transition(g_runtime.state_machine, arg1) 
+                == POLYCALL_SM_SUCCESS) {
+                printf("Transition '%s' executed successfully\n", arg1);
+            } else {
+                printf("Failed to execute transition\n");
+            }
+        } else if (strcmp(command, "instrument") == 0) {
+            if (!g_runtime.state_machine) {
+                printf("State machine not initialized\n");
+                continue;
+            }
+            if (!arg1 || (strcmp(arg1, "on") != 0 && strcmp(arg1, "off") != 0)) {
+                printf("Usage: instrument on|off\n");
+                continue;
+            }
+            bool enable = strcmp(arg1, "on") == 0;
+            if (polycall_sm_enable_instrumentation(g_runtime.state_machine, enable) 
+                == POLYCALL_SM_SUCCESS) {
+                printf("Instrumentation %s\n", enable ? "enabled" : "disabled");
+            } else {
+                printf("Failed to change instrumentation\n");
+            }
+        } else if (strcmp(command, "stats") == 0) {
+            if (!g_runtime.state_machine) {
+                printf("State machine not initialized\n");
+                continue;
+            }
+            polycall_sm_export_stats(g_runtime.state_machine, stdout);
+        } else if (strcmp(command, "publish_shm") == 0) {
+            if (!g_runtime.state_machine) {
+                printf("State machine not initialized\n");
+                continue;
+            }
+            if (!arg1) {
+                printf("Usage: publish_shm NAME (e.g. /polycall)\n");
+                continue;
+            }
+            if (g_runtime.shm) {
+                polycall_sm_detach_shm(g_runtime.state_machine);
+                polycall_sm_shm_close(g_runtime.shm);
+                g_runtime.shm = NULL;
+            }
+            polycall_sm_status_t shm_status = polycall_sm_shm_create(arg1, SHM_SLOTS, &g_runtime.shm);
+            if (shm_status == POLYCALL_SM_SUCCESS &&
+                polycall_sm_attach_shm(g_runtime.state_machine, g_runtime.shm, CLI_MACHINE_ID)
+                == POLYCALL_SM_SUCCESS) {
+                printf("Publishing state to shared memory '%s'\n", arg1);
+            } else if (shm_status == POLYCALL_SM_ERROR_ALREADY_EXISTS) {
+                printf("Shared memory '%s' is already in use by another publisher\n", arg1);
+            } else {
+                printf("Failed to publish to shared memory '%s'\n", arg1);
+            }
+        } else if (strcmp(command, "monitor") == 0) {
+            if (!arg1) {
+                printf("Usage: monitor NAME\n");
+                continue;
+            }
+            monitor_shm(arg1);
+        } else if (strcmp(command, "metrics") == 0) {
+            print_metrics();
+        } else if (strcmp(command, "serve_metrics") == 0) {
+            if (!arg1) {
+                printf("Usage: serve_metrics PORT\n");
+                continue;
+            }
+            if (g_runtime.metrics_server) {
+                printf("Metrics already served on port %u\n",
+                       polycall_metrics_server_port(g_runtime.metrics_server));
+                continue;
+            }
+            if (polycall_metrics_serve(polycall_context_metrics(g_runtime.pc_ctx),
+                                       (uint16_t)atoi(arg1), &g_runtime.metrics_server)
+                == POLYCALL_SUCCESS) {
+                printf("Serving metrics on http://127.0.0.1:%u/metrics\n",
+                       polycall_metrics_server_port(g_runtime.metrics_server));
+            } else {
+                printf("Failed to serve metrics on port %s\n", arg1);
+            }
         }
         // ... Handle other state machine commands similarly ...
         else {
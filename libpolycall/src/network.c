@@ -1,4 +1,10 @@
 #include "network.h"
+#include "polycall_memory.h"
+#include "polycall_metrics.h"
+#include "polycall_queue.h"
+#include "polycall_trace.h"
+#include "polycall_worker_pool.h"
+#include <stdlib.h>
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -27,12 +33,109 @@ static int set_nonblocking(int sockfd) {
 #endif
 }
 
+// Output queued behind a socket that would block
+struct net_write_chunk {
+    net_write_chunk_t* next;
+    size_t offset;
+    size_t size;
+    char data[];
+};
+
+static void client_release_writes(ClientState* state) {
+    while (state->write_head) {
+        net_write_chunk_t* chunk = state->write_head;
+        state->write_head = chunk->next;
+        free(chunk);
+    }
+    state->write_tail = NULL;
+    state->write_queued = 0;
+}
+
+// Caller holds state->lock
+static void client_close_locked(ClientState* state) {
+    if (state->socket_fd > 0) {
+        close(state->socket_fd);
+    }
+    state->socket_fd = 0;
+    state->is_active = false;
+    client_release_writes(state);
+}
+
+// Push queued output until the socket would block; caller holds state->lock
+static void client_flush_locked(ClientState* state) {
+    while (state->write_head) {
+        net_write_chunk_t* chunk = state->write_head;
+        ssize_t sent = send(state->socket_fd, chunk->data + chunk->offset,
+                            chunk->size - chunk->offset, 0);
+        if (sent <= 0) return;  // Errors surface as a disconnect on read
+        chunk->offset += (size_t)sent;
+        state->write_queued -= (size_t)sent;
+        if (chunk->offset < chunk->size) return;
+
+        state->write_head = chunk->next;
+        if (!state->write_head) state->write_tail = NULL;
+        free(chunk);
+    }
+}
+
+// Send to a program connection, queueing what the socket does not take
+static ssize_t client_send(NetworkEndpoint* endpoint, NetworkPacket* packet) {
+    ClientState* state = endpoint->client;
+    ssize_t result = (ssize_t)packet->size;
+
+    pthread_mutex_lock(&state->lock);
+    if (!state->is_active || state->generation != endpoint->client_generation) {
+        errno = EPIPE;
+        result = -1;
+    } else if (state->write_queued >= NET_WRITE_QUEUE_LIMIT) {
+        // The peer is not reading; push back rather than buffer without bound
+        errno = EAGAIN;
+        result = -1;
+    } else {
+        size_t sent = 0;
+        if (!state->write_head) {
+            ssize_t n = send(state->socket_fd, packet->data, packet->size, packet->flags);
+            if (n > 0) {
+                sent = (size_t)n;
+            } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                result = -1;
+            }
+        }
+
+        if (result >= 0 && sent < packet->size) {
+            size_t remaining = packet->size - sent;
+            net_write_chunk_t* chunk = malloc(sizeof(net_write_chunk_t) + remaining);
+            if (!chunk) {
+                errno = ENOMEM;
+                result = sent > 0 ? (ssize_t)sent : -1;
+            } else {
+                chunk->next = NULL;
+                chunk->offset = 0;
+                chunk->size = remaining;
+                memcpy(chunk->data, (const char*)packet->data + sent, remaining);
+                if (state->write_tail) state->write_tail->next = chunk;
+                else state->write_head = chunk;
+                state->write_tail = chunk;
+                state->write_queued += remaining;
+            }
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    POLYCALL_TRACE2(send, endpoint->socket_fd, result);
+    return result;
+}
+
 // Initialize client state
 void net_init_client_state(ClientState* state) {
     pthread_mutex_init(&state->lock, NULL);
     state->is_active = false;
     state->socket_fd = 0;
     memset(&state->addr, 0, sizeof(state->addr));
+    state->generation = 0;
+    state->write_head = NULL;
+    state->write_tail = NULL;
+    state->write_queued = 0;
 }
 
 static uint16_t find_available_port(uint16_t start_port, uint16_t end_port) {
@@ -47,11 +150,7 @@ static uint16_t find_available_port(uint16_t start_port, uint16_t end_port) {
 // Clean up client state
 void net_cleanup_client_state(ClientState* state) {
     pthread_mutex_lock(&state->lock);
-    if (state->socket_fd > 0) {
-        close(state->socket_fd);
-        state->socket_fd = 0;
-    }
-    state->is_active = false;
+    client_close_locked(state);
     pthread_mutex_unlock(&state->lock);
     pthread_mutex_destroy(&state->lock);
 }
@@ -100,10 +199,164 @@ bool net_release_port(uint16_t port) {
     return result >= 0;
 }
 
+// Loopback transport
+
+typedef struct {
+    void* data;
+    size_t size;
+} loopback_slot_t;
+
+struct net_loopback_port {
+    struct loopback_link* link;
+    polycall_spsc_t* inbound;       // Frames of loopback_slot_t
+    polycall_spsc_t* outbound;
+    net_loopback_port_t* peer;
+    bool closed;                    // Set by net_close
+};
+
+// Both directions of a pair; each ring has one producer and one consumer
+typedef struct loopback_link {
+    polycall_spsc_t* rings[2];
+    net_loopback_port_t ports[2];
+    int attached;                   // Endpoints not yet closed
+} loopback_link_t;
+
+static ssize_t loopback_send(net_loopback_port_t* port, void* data, size_t size) {
+    if (__atomic_load_n(&port->peer->closed, __ATOMIC_ACQUIRE)) {
+        errno = EPIPE;
+        return -1;
+    }
+    loopback_slot_t slot = { data, size };
+    if (!polycall_spsc_push(port->outbound, &slot)) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return (ssize_t)size;
+}
+
+// Next inbound frame, or NULL with *result 0 (peer closed) or -1 (EAGAIN)
+static loopback_slot_t* loopback_next(net_loopback_port_t* port, ssize_t* result) {
+    loopback_slot_t* slot = polycall_spsc_front(port->inbound);
+    if (slot) return slot;
+
+    // Frames pushed before the peer closed are still delivered
+    if (__atomic_load_n(&port->peer->closed, __ATOMIC_ACQUIRE)) {
+        slot = polycall_spsc_front(port->inbound);
+        if (slot) return slot;
+        *result = 0;
+        return NULL;
+    }
+    errno = EAGAIN;
+    *result = -1;
+    return NULL;
+}
+
+// The last endpoint to close frees the link and any undelivered frames
+static void loopback_close(net_loopback_port_t* port) {
+    loopback_link_t* link = port->link;
+    __atomic_store_n(&port->closed, true, __ATOMIC_RELEASE);
+    if (__atomic_sub_fetch(&link->attached, 1, __ATOMIC_ACQ_REL) > 0) return;
+
+    for (int i = 0; i < 2; i++) {
+        loopback_slot_t slot;
+        while (polycall_spsc_pop(link->rings[i], &slot)) net_packet_free(slot.data);
+        polycall_spsc_destroy(link->rings[i]);
+    }
+    free(link);
+}
+
+bool net_loopback_pair(NetworkEndpoint* a, NetworkEndpoint* b, size_t capacity) {
+    if (!a || !b || a == b) return false;
+
+    if (capacity == 0) capacity = NET_LOOPBACK_CAPACITY;
+
+    loopback_link_t* link = calloc(1, sizeof(loopback_link_t));
+    if (!link) return false;
+    for (int i = 0; i < 2; i++) {
+        link->rings[i] = polycall_spsc_create(capacity, sizeof(loopback_slot_t));
+        if (!link->rings[i]) {
+            polycall_spsc_destroy(link->rings[0]);
+            free(link);
+            return false;
+        }
+    }
+
+    NetworkEndpoint* endpoints[2] = { a, b };
+    for (int i = 0; i < 2; i++) {
+        net_loopback_port_t* port = &link->ports[i];
+        port->link = link;
+        port->inbound = link->rings[i];
+        port->outbound = link->rings[1 - i];
+        port->peer = &link->ports[1 - i];
+
+        NetworkEndpoint* endpoint = endpoints[i];
+        memset(endpoint, 0, sizeof(*endpoint));
+        pthread_mutex_init(&endpoint->lock, NULL);
+        strncpy(endpoint->address, "loopback", INET_ADDRSTRLEN);
+        endpoint->protocol = NET_LOOPBACK;
+        endpoint->role = NET_PEER;
+        endpoint->socket_fd = -1;
+        endpoint->loopback = port;
+    }
+    link->attached = 2;
+    return true;
+}
+
+void* net_packet_alloc(size_t size) {
+    return malloc(size);
+}
+
+void net_packet_free(void* data) {
+    free(data);
+}
+
+// Hand packet->data to the peer; on success packet->data is cleared
+ssize_t net_send_owned(NetworkEndpoint* endpoint, NetworkPacket* packet) {
+    if (!endpoint || !packet || !packet->data || packet->size == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!endpoint->loopback) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    ssize_t result = loopback_send(endpoint->loopback, packet->data, packet->size);
+    if (result > 0) packet->data = NULL;
+    POLYCALL_TRACE2(send, endpoint->socket_fd, result);
+    return result;
+}
+
+// Take the next frame; the caller releases packet->data with net_packet_free
+ssize_t net_receive_owned(NetworkEndpoint* endpoint, NetworkPacket* packet) {
+    if (!endpoint || !packet) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!endpoint->loopback) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    ssize_t result;
+    loopback_slot_t* slot = loopback_next(endpoint->loopback, &result);
+    if (slot) {
+        packet->data = slot->data;
+        packet->size = slot->size;
+        polycall_spsc_pop(endpoint->loopback->inbound, NULL);
+        result = (ssize_t)packet->size;
+    }
+    POLYCALL_TRACE2(recv, endpoint->socket_fd, result);
+    return result;
+}
+
 // Update net_init for cross-platform compatibility
 bool net_init(NetworkEndpoint* endpoint) {
     if (!endpoint) return false;
     
+    // Loopback endpoints are created in pairs by net_loopback_pair
+    if (endpoint->protocol == NET_LOOPBACK) return false;
+    
     // Check if port is in use
     if (net_is_port_in_use(endpoint->port)) {
         printf("Port %d is in use, attempting to release...\n", endpoint->port);
@@ -176,6 +429,11 @@ void net_close(NetworkEndpoint* endpoint) {
     
     pthread_mutex_lock(&endpoint->lock);
     
+    if (endpoint->loopback) {
+        loopback_close(endpoint->loopback);
+        endpoint->loopback = NULL;
+    }
+    
     if (endpoint->socket_fd > 0) {
         // Set linger to ensure complete socket shutdown
         struct linger ling = {1, 0};  // Immediate shutdown
@@ -195,10 +453,27 @@ void net_close(NetworkEndpoint* endpoint) {
 ssize_t net_send(NetworkEndpoint* endpoint, NetworkPacket* packet) {
     if (!endpoint || !packet) return -1;
     
+    if (endpoint->client) return client_send(endpoint, packet);
+    
     ssize_t result;
+    if (endpoint->loopback) {
+        // Copy into a frame the peer will own
+        if (packet->size == 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        NetworkPacket frame = { net_packet_alloc(packet->size), packet->size, 0 };
+        if (!frame.data) return -1;
+        memcpy(frame.data, packet->data, packet->size);
+        result = net_send_owned(endpoint, &frame);
+        net_packet_free(frame.data);
+        return result;
+    }
+
     pthread_mutex_lock(&endpoint->lock);
     result = send(endpoint->socket_fd, packet->data, packet->size, packet->flags);
     pthread_mutex_unlock(&endpoint->lock);
+    POLYCALL_TRACE2(send, endpoint->socket_fd, result);
     return result;
 }
 
@@ -207,9 +482,27 @@ ssize_t net_receive(NetworkEndpoint* endpoint, NetworkPacket* packet) {
     if (!endpoint || !packet) return -1;
     
     ssize_t result;
+    if (endpoint->loopback) {
+        // Frames are never split; one that does not fit stays queued
+        loopback_slot_t* slot = loopback_next(endpoint->loopback, &result);
+        if (slot) {
+            if (slot->size > packet->size) {
+                errno = EMSGSIZE;
+                return -1;
+            }
+            memcpy(packet->data, slot->data, slot->size);
+            result = (ssize_t)slot->size;
+            net_packet_free(slot->data);
+            polycall_spsc_pop(endpoint->loopback->inbound, NULL);
+        }
+        POLYCALL_TRACE2(recv, endpoint->socket_fd, result);
+        return result;
+    }
+
     pthread_mutex_lock(&endpoint->lock);
     result = recv(endpoint->socket_fd, packet->data, packet->size, packet->flags);
     pthread_mutex_unlock(&endpoint->lock);
+    POLYCALL_TRACE2(recv, endpoint->socket_fd, result);
     return result;
 }
 
@@ -226,6 +519,7 @@ bool net_add_client(NetworkProgram* program, int socket_fd, struct sockaddr_in a
             program->clients[i].socket_fd = socket_fd;
             program->clients[i].addr = addr;
             program->clients[i].is_active = true;
+            program->clients[i].generation++;
             added = true;
             pthread_mutex_unlock(&program->clients[i].lock);
             break;
@@ -246,27 +540,55 @@ void net_remove_client(NetworkProgram* program, int socket_fd) {
     for (int i = 0; i < NET_MAX_CLIENTS; i++) {
         pthread_mutex_lock(&program->clients[i].lock);
         if (program->clients[i].is_active && program->clients[i].socket_fd == socket_fd) {
-            close(program->clients[i].socket_fd);
-            program->clients[i].is_active = false;
-            program->clients[i].socket_fd = 0;
+            client_close_locked(&program->clients[i]);
         }
         pthread_mutex_unlock(&program->clients[i].lock);
     }
     
     pthread_mutex_unlock(&program->clients_lock);
 }
+// Program memory comes from its context when it has one
+static void* net_alloc(NetworkProgram* program, size_t size) {
+    return program->context ? polycall_mem_calloc(program->context, 1, size) : calloc(1, size);
+}
+
+static void net_free(NetworkProgram* program, void* ptr) {
+    if (program->context) {
+        polycall_mem_free(program->context, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+static void net_release_buffers(NetworkProgram* program) {
+    net_free(program, program->endpoints);
+    program->endpoints = NULL;
+    program->count = 0;
+    net_free(program, program->recv_buffer);
+    program->recv_buffer = NULL;
+}
+
 void net_init_program(NetworkProgram* program) {
+    net_init_program_with_context(program, NULL);
+}
+
+void net_init_program_with_context(NetworkProgram* program, struct polycall_context* context) {
     if (!program) return;
     
     // Initialize base program structure
     memset(program, 0, sizeof(NetworkProgram));
     pthread_mutex_init(&program->clients_lock, NULL);
+    pthread_mutex_init(&program->dispatch_lock, NULL);
+    pthread_cond_init(&program->dispatch_done, NULL);
     program->running = true;
+    program->context = context;
     
-    // Allocate endpoints
-    program->endpoints = calloc(1, sizeof(NetworkEndpoint));
-    if (!program->endpoints) {
+    // Allocate endpoints and the receive buffer
+    program->endpoints = net_alloc(program, sizeof(NetworkEndpoint));
+    program->recv_buffer = net_alloc(program, NET_BUFFER_SIZE);
+    if (!program->endpoints || !program->recv_buffer) {
         fprintf(stderr, "Failed to allocate endpoints\n");
+        net_release_buffers(program);
         return;
     }
     program->count = 1;
@@ -278,9 +600,7 @@ void net_init_program(NetworkProgram* program) {
     uint16_t port = find_available_port(8080, 8180);
     if (port == 0) {
         fprintf(stderr, "No available ports found in range 8080-8180\n");
-        free(program->endpoints);
-        program->endpoints = NULL;
-        program->count = 0;
+        net_release_buffers(program);
         return;
     }
     
@@ -294,9 +614,7 @@ void net_init_program(NetworkProgram* program) {
     // Initialize endpoint
     if (!net_init(endpoint)) {
         fprintf(stderr, "Failed to initialize endpoint on port %d\n", port);
-        free(program->endpoints);
-        program->endpoints = NULL;
-        program->count = 0;
+        net_release_buffers(program);
         return;
     }
     
@@ -311,6 +629,13 @@ void net_init_program(NetworkProgram* program) {
 void net_cleanup_program(NetworkProgram* program) {
     if (!program) return;
     
+    // Pooled handlers still use the clients and the program allocator
+    pthread_mutex_lock(&program->dispatch_lock);
+    while (__atomic_load_n(&program->in_flight, __ATOMIC_ACQUIRE) > 0) {
+        pthread_cond_wait(&program->dispatch_done, &program->dispatch_lock);
+    }
+    pthread_mutex_unlock(&program->dispatch_lock);
+    
     pthread_mutex_lock(&program->clients_lock);
     program->running = false;
     
@@ -319,18 +644,81 @@ void net_cleanup_program(NetworkProgram* program) {
         for (size_t i = 0; i < program->count; i++) {
             net_close(&program->endpoints[i]);
         }
-        free(program->endpoints);
-        program->endpoints = NULL;
     }
-    program->count = 0;
+    net_release_buffers(program);
     
-    // Clean up clients
+    // Clean up clients; connections dropped here count as disconnects too
+    polycall_metrics_t* metrics = polycall_context_metrics(program->context);
     for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+        if (program->clients[i].is_active) {
+            polycall_metrics_counter_add(metrics, POLYCALL_METRIC_NET_DISCONNECTS, 1);
+            polycall_metrics_gauge_add(metrics, POLYCALL_METRIC_NET_CLIENTS, -1);
+        }
         net_cleanup_client_state(&program->clients[i]);
     }
     
     pthread_mutex_unlock(&program->clients_lock);
     pthread_mutex_destroy(&program->clients_lock);
+    pthread_cond_destroy(&program->dispatch_done);
+    pthread_mutex_destroy(&program->dispatch_lock);
+}
+
+// A received packet waiting on the worker pool, payload follows
+typedef struct {
+    NetworkProgram* program;
+    NetworkEndpoint endpoint;
+    NetworkPacket packet;
+    char data[];
+} net_dispatch_t;
+
+// The wakeup happens under dispatch_lock, so net_cleanup_program cannot
+// destroy the program until this has returned
+static void net_dispatch_finished(NetworkProgram* program) {
+    pthread_mutex_lock(&program->dispatch_lock);
+    if (__atomic_sub_fetch(&program->in_flight, 1, __ATOMIC_RELEASE) == 0) {
+        pthread_cond_broadcast(&program->dispatch_done);
+    }
+    pthread_mutex_unlock(&program->dispatch_lock);
+}
+
+static void net_dispatch_job(void* arg) {
+    net_dispatch_t* job = (net_dispatch_t*)arg;
+    NetworkProgram* program = job->program;
+
+    program->handlers.on_receive(&job->endpoint, &job->packet);
+    net_free(program, job);
+    net_dispatch_finished(program);
+}
+
+// Run on_receive on the pool when there is one, otherwise inline
+static void net_dispatch(NetworkProgram* program, uint64_t key,
+                         NetworkEndpoint* endpoint, NetworkPacket* packet) {
+    if (!program->handlers.on_receive) return;
+
+    if (program->worker_pool) {
+        net_dispatch_t* job = net_alloc(program, sizeof(net_dispatch_t) + packet->size);
+        if (job) {
+            job->program = program;
+            job->endpoint = *endpoint;
+            job->packet.data = job->data;
+            job->packet.size = packet->size;
+            job->packet.flags = packet->flags;
+            memcpy(job->data, packet->data, packet->size);
+
+            __atomic_add_fetch(&program->in_flight, 1, __ATOMIC_RELAXED);
+            bool queued = program->ordered_dispatch
+                ? polycall_worker_pool_submit_ordered(program->worker_pool, key,
+                                                      net_dispatch_job, job)
+                : polycall_worker_pool_submit(program->worker_pool, net_dispatch_job, job);
+            if (queued) return;
+
+            // Pool is shutting down
+            net_free(program, job);
+            net_dispatch_finished(program);
+        }
+    }
+
+    program->handlers.on_receive(endpoint, packet);
 }
 
 void net_run(NetworkProgram* program) {
@@ -344,12 +732,16 @@ void net_run(NetworkProgram* program) {
         return;
     }
     
-    if (!program->endpoints || program->count == 0) {
+    if (!program->endpoints || program->count == 0 || !program->recv_buffer) {
         fprintf(stderr, "DEBUG: No endpoints initialized\n");
         return;
     }
 
+    polycall_metrics_t* metrics = polycall_context_metrics(program->context);
+    polycall_metrics_counter_add(metrics, POLYCALL_METRIC_NET_LOOP_ITERATIONS, 1);
+
     fd_set readfds;
+    fd_set writefds;
     struct timeval tv = {
         .tv_sec = 1,  // 1 second timeout
         .tv_usec = 0
@@ -357,6 +749,7 @@ void net_run(NetworkProgram* program) {
 
     // Setup file descriptors
     FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
     fprintf(stderr, "DEBUG: Setting up file descriptors for socket %d\n", 
             program->endpoints[0].socket_fd);
             
@@ -376,6 +769,7 @@ void net_run(NetworkProgram* program) {
             int fd = program->clients[i].socket_fd;
             if (fd > 0) {
                 FD_SET(fd, &readfds);
+                if (program->clients[i].write_head) FD_SET(fd, &writefds);
                 if (fd > max_fd) max_fd = fd;
             }
         }
@@ -386,7 +780,7 @@ void net_run(NetworkProgram* program) {
     fprintf(stderr, "DEBUG: Calling select with max_fd=%d\n", max_fd);
     
     // Wait for activity with timeout
-    int activity = select(max_fd + 1, &readfds, NULL, NULL, &tv);
+    int activity = select(max_fd + 1, &readfds, &writefds, NULL, &tv);
     
     if (activity < 0) {
         if (errno != EINTR) {
@@ -415,6 +809,9 @@ void net_run(NetworkProgram* program) {
 
             // Add client
             if (net_add_client(program, new_socket, client_addr)) {
+                polycall_metrics_counter_add(metrics, POLYCALL_METRIC_NET_ACCEPTS, 1);
+                POLYCALL_TRACE2(accept, new_socket, ntohs(client_addr.sin_port));
+                polycall_metrics_gauge_add(metrics, POLYCALL_METRIC_NET_CLIENTS, 1);
                 NetworkEndpoint client_endpoint = {
                     .socket_fd = new_socket,
                     .addr = client_addr,
@@ -430,53 +827,67 @@ void net_run(NetworkProgram* program) {
         }
     }
 
-    // Rest of the function remains unchanged...
-    // Handle client data
-    pthread_mutex_lock(&program->clients_lock);
+    // Handle client data. Each slot is read under its own lock only, so
+    // inline handlers run with no program lock held.
     for (int i = 0; i < NET_MAX_CLIENTS; i++) {
-        pthread_mutex_lock(&program->clients[i].lock);
-        if (program->clients[i].is_active &&
-            FD_ISSET(program->clients[i].socket_fd, &readfds)) {
-            
-            char buffer[NET_BUFFER_SIZE];
-            ssize_t bytes_read = recv(program->clients[i].socket_fd,
-                                    buffer,
-                                    sizeof(buffer) - 1,
-                                    0);
-
-            if (bytes_read <= 0) {
-                // Handle disconnection
-                NetworkEndpoint client_endpoint = {
-                    .socket_fd = program->clients[i].socket_fd,
-                    .addr = program->clients[i].addr,
-                    .phantom = program->phantom
-                };
-
-                if (program->handlers.on_disconnect) {
-                    program->handlers.on_disconnect(&client_endpoint);
-                }
-                
-                net_remove_client(program, program->clients[i].socket_fd);
-            } else {
-                // Handle received data
-                NetworkEndpoint client_endpoint = {
-                    .socket_fd = program->clients[i].socket_fd,
-                    .addr = program->clients[i].addr,
-                    .phantom = program->phantom
-                };
-
-                NetworkPacket packet = {
-                    .data = buffer,
-                    .size = bytes_read,
-                    .flags = 0
-                };
+        ClientState* state = &program->clients[i];
+        pthread_mutex_lock(&state->lock);
+        if (!state->is_active) {
+            pthread_mutex_unlock(&state->lock);
+            continue;
+        }
+        
+        if (FD_ISSET(state->socket_fd, &writefds)) {
+            client_flush_locked(state);
+        }
+        if (!FD_ISSET(state->socket_fd, &readfds)) {
+            pthread_mutex_unlock(&state->lock);
+            continue;
+        }
+        
+        char* buffer = program->recv_buffer;
+        ssize_t bytes_read = recv(state->socket_fd,
+                                buffer,
+                                NET_BUFFER_SIZE - 1,
+                                0);
+        POLYCALL_TRACE2(recv, state->socket_fd, bytes_read);
+        
+        NetworkEndpoint client_endpoint = {
+            .socket_fd = state->socket_fd,
+            .addr = state->addr,
+            .phantom = program->phantom,
+            .client = state,
+            .client_generation = state->generation
+        };
+        
+        // Handlers run without the slot lock so they can reply through it
+        pthread_mutex_unlock(&state->lock);
 
-                if (program->handlers.on_receive) {
-                    program->handlers.on_receive(&client_endpoint, &packet);
-                }
+        if (bytes_read <= 0) {
+            // Handle disconnection
+            if (program->handlers.on_disconnect) {
+                program->handlers.on_disconnect(&client_endpoint);
             }
+            
+            // Unless the connection was already closed meanwhile
+            pthread_mutex_lock(&state->lock);
+            bool closing = state->is_active && state->generation == client_endpoint.client_generation;
+            if (closing) client_close_locked(state);
+            pthread_mutex_unlock(&state->lock);
+            if (closing) {
+                polycall_metrics_counter_add(metrics, POLYCALL_METRIC_NET_DISCONNECTS, 1);
+                polycall_metrics_gauge_add(metrics, POLYCALL_METRIC_NET_CLIENTS, -1);
+            }
+        } else {
+            // Handle received data
+            NetworkPacket packet = {
+                .data = buffer,
+                .size = bytes_read,
+                .flags = 0
+            };
+            
+            net_dispatch(program, ((uint64_t)i << 32) | client_endpoint.client_generation,
+                         &client_endpoint, &packet);
         }
-        pthread_mutex_unlock(&program->clients[i].lock);
     }
-    pthread_mutex_unlock(&program->clients_lock);
 }
\ No newline at end of file
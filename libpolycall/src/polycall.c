@@ -1,27 +1,21 @@
 #include "polycall.h"
+#include "polycall_memory.h"
+#include "polycall_metrics.h"
 #include <stdlib.h>
 #include <string.h>
 
 #define POLYCALL_VERSION "1.0.0"
-#define MAX_ERROR_LENGTH 256
 
 /* Internal context structure */
 struct polycall_context {
-    char last_error[MAX_ERROR_LENGTH];
     void* user_data;
     size_t memory_pool_size;
+    polycall_memory_t* memory;
+    polycall_metrics_t* metrics;
     unsigned int flags;
     bool is_initialized;
 };
 
-/* Static helper functions */
-static void set_error(polycall_context_t ctx, const char* error) {
-    if (ctx && error) {
-        strncpy(ctx->last_error, error, MAX_ERROR_LENGTH - 1);
-        ctx->last_error[MAX_ERROR_LENGTH - 1] = '\0';
-    }
-}
-
 /* API Implementation */
 
 polycall_status_t polycall_init_with_config(
@@ -29,14 +23,14 @@ polycall_status_t polycall_init_with_config(
     const polycall_config_t* config
 ) {
     if (!ctx) {
-        // Use the error function
-        set_error(NULL, "Invalid context pointer");
+        polycall_error_set(POLYCALL_ERR_INVALID_PARAMETERS, "Invalid context pointer");
         return POLYCALL_ERROR_INVALID_PARAMETERS;
     }
 
     /* Allocate context */
     struct polycall_context* new_ctx = malloc(sizeof(struct polycall_context));
     if (!new_ctx) {
+        polycall_error_set(POLYCALL_ERR_OUT_OF_MEMORY, "Failed to allocate context");
         return POLYCALL_ERROR_OUT_OF_MEMORY;
     }
 
@@ -53,9 +47,24 @@ polycall_status_t polycall_init_with_config(
         new_ctx->user_data = config->user_data;
     }
 
+    /* Arena chunks are memory_pool_size bytes; the first is reserved now */
+    new_ctx->memory = polycall_memory_create(new_ctx->memory_pool_size, new_ctx->flags);
+    if (!new_ctx->memory) {
+        polycall_error_set(POLYCALL_ERR_OUT_OF_MEMORY, "Failed to reserve context memory");
+        free(new_ctx);
+        return POLYCALL_ERROR_OUT_OF_MEMORY;
+    }
+
+    new_ctx->metrics = polycall_metrics_create();
+    if (!new_ctx->metrics) {
+        polycall_error_set(POLYCALL_ERR_OUT_OF_MEMORY, "Failed to create context metrics");
+        polycall_memory_destroy(new_ctx->memory);
+        free(new_ctx);
+        return POLYCALL_ERROR_OUT_OF_MEMORY;
+    }
+
     /* Mark as initialized */
     new_ctx->is_initialized = true;
-    new_ctx->last_error[0] = '\0';
 
     *ctx = new_ctx;
     return POLYCALL_SUCCESS;
@@ -63,19 +72,29 @@ polycall_status_t polycall_init_with_config(
 
 void polycall_cleanup(polycall_context_t ctx) {
     if (ctx) {
-        /* Add any cleanup of internal resources here */
+        /* Releases everything allocated through the context */
+        polycall_memory_destroy(ctx->memory);
+        ctx->memory = NULL;
+        polycall_metrics_destroy(ctx->metrics);
+        ctx->metrics = NULL;
         ctx->is_initialized = false;
         free(ctx);
     }
 }
 
+polycall_memory_t* polycall_context_memory(polycall_context_t ctx) {
+    return ctx && ctx->is_initialized ? ctx->memory : NULL;
+}
+
+polycall_metrics_t* polycall_context_metrics(polycall_context_t ctx) {
+    return ctx && ctx->is_initialized ? ctx->metrics : NULL;
+}
+
 const char* polycall_get_version(void) {
     return POLYCALL_VERSION;
 }
 
 const char* polycall_get_last_error(polycall_context_t ctx) {
-    if (!ctx) {
-        return "Invalid context";
-    }
-    return ctx->last_error;
+    (void)ctx;  /* Errors are recorded per thread, not per context */
+    return polycall_error_message();
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "polycall_error.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef struct {
+    polycall_error_code_t code;
+    const char* message;
+    const char* detail_format;
+    long long args[2];
+    bool rendered;
+    char text[POLYCALL_ERROR_TEXT_LENGTH];
+} error_record_t;
+
+static _Thread_local error_record_t last_error;
+
+polycall_error_code_t polycall_error_code(void) {
+    return last_error.code;
+}
+
+const char* polycall_error_message(void) {
+    if (!last_error.message) return "";
+    if (!last_error.detail_format) return last_error.message;
+
+    if (!last_error.rendered) {
+        int length = snprintf(last_error.text, sizeof(last_error.text), "%s: ",
+                              last_error.message);
+        if (length > 0 && (size_t)length < sizeof(last_error.text)) {
+            snprintf(last_error.text + length, sizeof(last_error.text) - (size_t)length,
+                     last_error.detail_format, last_error.args[0], last_error.args[1]);
+        }
+        last_error.rendered = true;
+    }
+    return last_error.text;
+}
+
+void polycall_error_clear(void) {
+    last_error.code = POLYCALL_ERR_NONE;
+    last_error.message = NULL;
+    last_error.detail_format = NULL;
+}
+
+void polycall_error_set(polycall_error_code_t code, const char* message) {
+    last_error.code = code;
+    last_error.message = message;
+    last_error.detail_format = NULL;
+}
+
+void polycall_error_set_detail(
+    polycall_error_code_t code,
+    const char* message,
+    const char* detail_format,
+    long long a,
+    long long b
+) {
+    last_error.code = code;
+    last_error.message = message;
+    last_error.detail_format = detail_format;
+    last_error.args[0] = a;
+    last_error.args[1] = b;
+    last_error.rendered = false;
+}
@@ -0,0 +1,82 @@
+#include "polycall_histogram.h"
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+void polycall_histogram_reset(polycall_histogram_t* hist) {
+    if (!hist) return;
+    memset(hist, 0, sizeof(*hist));
+}
+
+void polycall_histogram_merge(polycall_histogram_t* dst, const polycall_histogram_t* src) {
+    if (!dst || !src || src->count == 0) return;
+
+    for (unsigned int i = 0; i < POLYCALL_HISTOGRAM_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+
+    if (dst->count == 0 || src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    dst->count += src->count;
+    dst->sum += src->sum;
+}
+
+uint64_t polycall_histogram_bucket_lower(unsigned int index) {
+    const unsigned int sub_count = 1u << POLYCALL_HISTOGRAM_SUB_BITS;
+    if (index < sub_count) return index;
+
+    unsigned int group = index >> POLYCALL_HISTOGRAM_SUB_BITS;
+    unsigned int sub = index & (sub_count - 1);
+    return (uint64_t)(sub_count + sub) << (group - 1);
+}
+
+uint64_t polycall_histogram_percentile(const polycall_histogram_t* hist, double percentile) {
+    if (!hist || hist->count == 0) return 0;
+    if (percentile <= 0.0) return hist->min;
+    if (percentile >= 100.0) return hist->max;
+
+    uint64_t target = (uint64_t)((percentile / 100.0) * (double)hist->count + 0.5);
+    if (target == 0) target = 1;
+
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < POLYCALL_HISTOGRAM_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            uint64_t lower = polycall_histogram_bucket_lower(i);
+            uint64_t upper = i + 1 < POLYCALL_HISTOGRAM_BUCKETS ?
+                             polycall_histogram_bucket_lower(i + 1) - 1 : hist->max;
+            uint64_t value = lower + (upper - lower) / 2;
+
+            // Never report outside the observed range
+            if (value < hist->min) value = hist->min;
+            if (value > hist->max) value = hist->max;
+            return value;
+        }
+    }
+
+    return hist->max;
+}
+
+double polycall_histogram_mean(const polycall_histogram_t* hist) {
+    if (!hist || hist->count == 0) return 0.0;
+    return (double)hist->sum / (double)hist->count;
+}
+
+uint64_t polycall_monotonic_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
@@ -0,0 +1,542 @@
+#include "polycall_memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#define MEM_ALIGN 16
+#define MEM_MIN_SHIFT 5                 // Smallest block: 32 bytes
+#define MEM_CLASS_COUNT 12              // 32 B .. 64 KiB blocks
+#define MEM_LARGE_CLASS UINT32_MAX
+#define MEM_THREAD_SLOTS 4              // Contexts cached per thread at once
+#define MEM_CACHE_BYTES (16 * 1024)     // Per class, per thread
+#define MEM_MIN_CHUNK (128 * 1024)      // Room for a batch of the largest class
+#define MEM_HUGE_PAGE (2 * 1024 * 1024)
+#define MEM_MPOL_PREFERRED 1            // From <numaif.h>, without needing libnuma
+#ifdef _WIN32
+#define MEM_MAPPED_FLAGS 0              // No mmap: chunks always come from malloc
+#else
+#define MEM_MAPPED_FLAGS (POLYCALL_MEM_HUGEPAGES | POLYCALL_MEM_NUMA_LOCAL | POLYCALL_MEM_PREFAULT)
+#endif
+
+#define CLASS_BLOCK(c) ((size_t)1 << ((c) + MEM_MIN_SHIFT))
+
+/* Every block handed out is preceded by this header; it survives while
+ * the block sits on a free list, whose link lives in the payload. */
+typedef struct {
+    uint32_t size_class;
+    uint32_t tag;               // Owning memory, catches foreign frees
+    uint64_t reserved;
+} block_header_t;
+
+typedef struct free_block {
+    struct free_block* next;
+} free_block_t;
+
+typedef struct large_block {
+    struct large_block* prev;
+    struct large_block* next;
+    size_t size;
+    size_t reserved;
+    block_header_t header;      // Must be last: the payload follows
+} large_block_t;
+
+typedef struct chunk {
+    struct chunk* next;
+    size_t size;                // Usable bytes after the header
+    size_t map_bytes;           // Length to munmap; 0 when from malloc
+    size_t reserved;
+} chunk_t;
+
+_Static_assert(sizeof(block_header_t) == MEM_ALIGN, "block header keeps payload aligned");
+_Static_assert(sizeof(large_block_t) % MEM_ALIGN == 0, "large header keeps payload aligned");
+_Static_assert(sizeof(chunk_t) % MEM_ALIGN == 0, "chunk header keeps blocks aligned");
+_Static_assert(CLASS_BLOCK(MEM_CLASS_COUNT - 1) - sizeof(block_header_t) ==
+               POLYCALL_MEM_MAX_CLASS_SIZE, "largest class matches the public limit");
+
+struct polycall_memory {
+    uint64_t id;                // Never reused; validates thread caches
+    uint32_t tag;
+    unsigned int flags;         // POLYCALL_MEM_* placement policy
+    size_t chunk_size;
+
+    pthread_mutex_t lock;       // Arena, shared free lists and large list
+    chunk_t* chunks;
+    uint8_t* bump;
+    uint8_t* bump_end;
+    free_block_t* shared[MEM_CLASS_COUNT];
+    large_block_t* large;
+    polycall_memory_stats_t stats;
+
+    struct polycall_memory* live_next;
+};
+
+/* Per-thread free lists, one slot per context as in the machine pool. A
+ * slot left behind by a destroyed context is recognised by its id and
+ * dropped: its blocks went away with the context's chunks. */
+typedef struct {
+    uint64_t memory_id;
+    polycall_memory_t* memory;
+    free_block_t* heads[MEM_CLASS_COUNT];
+    uint32_t counts[MEM_CLASS_COUNT];
+} thread_cache_t;
+
+static _Thread_local thread_cache_t thread_caches[MEM_THREAD_SLOTS];
+
+static pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+static polycall_memory_t* live_memories;
+static _Atomic uint64_t next_memory_id = 1;
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t exit_key;
+
+static inline block_header_t* header_of(void* ptr) {
+    return (block_header_t*)((uint8_t*)ptr - sizeof(block_header_t));
+}
+
+static inline unsigned int size_class_of(size_t size) {
+    size_t total = size + sizeof(block_header_t);
+    if (total <= CLASS_BLOCK(0)) return 0;
+    return (unsigned int)(64 - __builtin_clzll((unsigned long long)(total - 1))) - MEM_MIN_SHIFT;
+}
+
+static inline uint32_t cache_limit(unsigned int size_class) {
+    size_t limit = MEM_CACHE_BYTES / CLASS_BLOCK(size_class);
+    return limit < 2 ? 2 : (uint32_t)limit;
+}
+
+// Caller holds live_lock
+static bool memory_alive(uint64_t id) {
+    for (polycall_memory_t* memory = live_memories; memory; memory = memory->live_next) {
+        if (memory->id == id) return true;
+    }
+    return false;
+}
+
+// Caller holds memory->lock
+static void shared_push(polycall_memory_t* memory, unsigned int size_class,
+                        free_block_t* head, free_block_t* tail) {
+    tail->next = memory->shared[size_class];
+    memory->shared[size_class] = head;
+}
+
+// Hand a slot's blocks back to its context (if it still exists) and clear it
+static void flush_slot(thread_cache_t* slot) {
+    bool cached = false;
+    for (unsigned int c = 0; c < MEM_CLASS_COUNT; c++) cached |= slot->heads[c] != NULL;
+
+    if (cached) {
+        pthread_mutex_lock(&live_lock);
+        if (memory_alive(slot->memory_id)) {
+            polycall_memory_t* memory = slot->memory;
+            pthread_mutex_lock(&memory->lock);
+            for (unsigned int c = 0; c < MEM_CLASS_COUNT; c++) {
+                free_block_t* head = slot->heads[c];
+                if (!head) continue;
+                free_block_t* tail = head;
+                while (tail->next) tail = tail->next;
+                shared_push(memory, c, head, tail);
+            }
+            pthread_mutex_unlock(&memory->lock);
+        }
+        pthread_mutex_unlock(&live_lock);
+    }
+    memset(slot, 0, sizeof(*slot));
+}
+
+static void thread_exit(void* arg) {
+    (void)arg;
+    for (int i = 0; i < MEM_THREAD_SLOTS; i++) {
+        flush_slot(&thread_caches[i]);
+    }
+}
+
+static void exit_key_init(void) {
+    pthread_key_create(&exit_key, thread_exit);
+}
+
+static thread_cache_t* thread_slot(polycall_memory_t* memory) {
+    thread_cache_t* slot = &thread_caches[memory->id % MEM_THREAD_SLOTS];
+    if (slot->memory_id == memory->id) return slot;
+
+    flush_slot(slot);
+    slot->memory_id = memory->id;
+    slot->memory = memory;
+
+    // Make sure cached blocks go home when this thread exits
+    pthread_once(&exit_key_once, exit_key_init);
+    pthread_setspecific(exit_key, thread_caches);
+    return slot;
+}
+
+static size_t round_up(size_t size, size_t unit) {
+    return (size + unit - 1) / unit * unit;
+}
+
+#ifndef _WIN32
+// Prefer the calling thread's current node for [base, base + length)
+static bool chunk_bind_local(void* base, size_t length) {
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+    unsigned int cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= 63) return false;
+    unsigned long mask = 1UL << node;
+    return syscall(SYS_mbind, base, length, MEM_MPOL_PREFERRED, &mask,
+                   sizeof(mask) * 8, 0) == 0;
+#else
+    (void)base;
+    (void)length;
+    return false;
+#endif
+}
+
+static void chunk_prefault(uint8_t* base, size_t length) {
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(base, length, MADV_POPULATE_WRITE) == 0) return;
+#endif
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < length; offset += page) {
+        ((volatile uint8_t*)base)[offset] = 0;
+    }
+}
+
+/* Map at least size bytes following the memory's policy. Huge pages come
+ * from the hugetlb pool when one is configured, otherwise from THP on a
+ * 2 MB aligned mapping; the node is bound before the first touch so the
+ * prefault lands where it should. */
+static chunk_t* chunk_map(polycall_memory_t* memory, size_t size) {
+    bool huge_pages = memory->flags & POLYCALL_MEM_HUGEPAGES;
+    size_t page = huge_pages ? MEM_HUGE_PAGE : (size_t)sysconf(_SC_PAGESIZE);
+    size_t length = round_up(size, page);
+    uint8_t* base = MAP_FAILED;
+    bool huge = false;
+
+#ifdef MAP_HUGETLB
+    if (huge_pages) {
+        base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        huge = base != MAP_FAILED;
+    }
+#endif
+    if (base == MAP_FAILED) {
+        size_t span = huge_pages ? length + MEM_HUGE_PAGE : length;
+        uint8_t* raw = mmap(NULL, span, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return NULL;
+
+        // Trim to a huge-page boundary so THP can back the whole chunk
+        base = (uint8_t*)round_up((uintptr_t)raw, page);
+        if (base > raw) munmap(raw, (size_t)(base - raw));
+        if (raw + span > base + length) munmap(base + length, (size_t)(raw + span - (base + length)));
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) huge = madvise(base, length, MADV_HUGEPAGE) == 0;
+#endif
+    }
+
+    if ((memory->flags & POLYCALL_MEM_NUMA_LOCAL) && chunk_bind_local(base, length)) {
+        memory->stats.local_chunks++;
+    }
+    if (memory->flags & POLYCALL_MEM_PREFAULT) chunk_prefault(base, length);
+    if (huge) memory->stats.huge_chunks++;
+
+    chunk_t* chunk = (chunk_t*)base;
+    chunk->map_bytes = length;
+    chunk->size = length - sizeof(chunk_t);
+    return chunk;
+}
+#else
+static chunk_t* chunk_map(polycall_memory_t* memory, size_t size) {
+    (void)memory;
+    (void)size;
+    return NULL;
+}
+#endif
+
+static void chunk_release(chunk_t* chunk) {
+#ifndef _WIN32
+    if (chunk->map_bytes) {
+        munmap(chunk, chunk->map_bytes);
+        return;
+    }
+#endif
+    free(chunk);
+}
+
+// Caller holds memory->lock. Oversized requests get a dedicated chunk and
+// leave the current bump region alone.
+static uint8_t* chunk_reserve(polycall_memory_t* memory, size_t size) {
+    bool dedicated = size > memory->chunk_size;
+    size_t chunk_bytes = dedicated ? size : memory->chunk_size;
+
+    chunk_t* chunk;
+    if (memory->flags & MEM_MAPPED_FLAGS) {
+        chunk = chunk_map(memory, sizeof(chunk_t) + chunk_bytes);
+        if (!chunk) return NULL;
+    } else {
+        chunk = malloc(sizeof(chunk_t) + chunk_bytes);
+        if (!chunk) return NULL;
+        chunk->size = chunk_bytes;
+        chunk->map_bytes = 0;
+    }
+
+    chunk->next = memory->chunks;
+    memory->chunks = chunk;
+    memory->stats.chunks++;
+    memory->stats.arena_bytes += chunk->size;
+
+    uint8_t* base = (uint8_t*)(chunk + 1);
+    if (!dedicated) {
+        memory->bump = base;
+        memory->bump_end = base + chunk->size;
+    }
+    return base;
+}
+
+// Caller holds memory->lock
+static void* arena_take(polycall_memory_t* memory, size_t size) {
+    uint8_t* ptr;
+    if (size > memory->chunk_size) {
+        ptr = chunk_reserve(memory, size);
+    } else {
+        if ((size_t)(memory->bump_end - memory->bump) < size &&
+            !chunk_reserve(memory, size)) {
+            return NULL;
+        }
+        ptr = memory->bump;
+        memory->bump += size;
+    }
+    if (ptr) memory->stats.arena_used += size;
+    return ptr;
+}
+
+// Move up to half a cache of blocks into the slot: recycled ones from the
+// shared list first, then fresh ones carved from the arena
+static bool slot_refill(polycall_memory_t* memory, thread_cache_t* slot, unsigned int size_class) {
+    uint32_t want = cache_limit(size_class) / 2;
+    size_t block = CLASS_BLOCK(size_class);
+    uint32_t got = 0;
+
+    pthread_mutex_lock(&memory->lock);
+    memory->stats.shared_refills++;
+
+    while (got < want && memory->shared[size_class]) {
+        free_block_t* node = memory->shared[size_class];
+        memory->shared[size_class] = node->next;
+        node->next = slot->heads[size_class];
+        slot->heads[size_class] = node;
+        got++;
+    }
+
+    if (got == 0) {
+        size_t room = (size_t)(memory->bump_end - memory->bump) / block;
+        uint32_t carve = room < want ? (uint32_t)room : want;
+        if (carve == 0) carve = want;
+
+        uint8_t* base = arena_take(memory, carve * block);
+        for (uint32_t i = 0; base && i < carve; i++) {
+            block_header_t* header = (block_header_t*)(base + i * block);
+            header->size_class = size_class;
+            header->tag = memory->tag;
+            free_block_t* node = (free_block_t*)(header + 1);
+            node->next = slot->heads[size_class];
+            slot->heads[size_class] = node;
+            got++;
+        }
+    }
+    pthread_mutex_unlock(&memory->lock);
+
+    slot->counts[size_class] += got;
+    return got > 0;
+}
+
+polycall_memory_t* polycall_memory_create(size_t chunk_size, unsigned int flags) {
+    polycall_memory_t* memory = calloc(1, sizeof(polycall_memory_t));
+    if (!memory) return NULL;
+
+    if (chunk_size < MEM_MIN_CHUNK) chunk_size = MEM_MIN_CHUNK;
+    if (flags & POLYCALL_MEM_HUGEPAGES) {
+        // Whole huge pages per chunk, header included
+        chunk_size = round_up(chunk_size + sizeof(chunk_t), MEM_HUGE_PAGE) - sizeof(chunk_t);
+    }
+    memory->flags = flags & MEM_MAPPED_FLAGS;
+    memory->chunk_size = (chunk_size + MEM_ALIGN - 1) & ~(size_t)(MEM_ALIGN - 1);
+    memory->id = atomic_fetch_add(&next_memory_id, 1);
+    memory->tag = (uint32_t)(memory->id * 0x9E3779B1u) | 1u;
+    memory->stats.chunk_size = memory->chunk_size;
+    pthread_mutex_init(&memory->lock, NULL);
+
+    // Reserve the first chunk up front so a fresh context does not allocate
+    // (and, with POLYCALL_MEM_PREFAULT, does not page-fault) under traffic
+    if (!chunk_reserve(memory, memory->chunk_size)) {
+        pthread_mutex_destroy(&memory->lock);
+        free(memory);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&live_lock);
+    memory->live_next = live_memories;
+    live_memories = memory;
+    pthread_mutex_unlock(&live_lock);
+    return memory;
+}
+
+void polycall_memory_destroy(polycall_memory_t* memory) {
+    if (!memory) return;
+
+    pthread_mutex_lock(&live_lock);
+    for (polycall_memory_t** link = &live_memories; *link; link = &(*link)->live_next) {
+        if (*link == memory) {
+            *link = memory->live_next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&live_lock);
+
+    // Other threads' caches still name this context; its id retires them
+    thread_cache_t* slot = &thread_caches[memory->id % MEM_THREAD_SLOTS];
+    if (slot->memory_id == memory->id) memset(slot, 0, sizeof(*slot));
+
+    while (memory->chunks) {
+        chunk_t* next = memory->chunks->next;
+        chunk_release(memory->chunks);
+        memory->chunks = next;
+    }
+    while (memory->large) {
+        large_block_t* next = memory->large->next;
+        free(memory->large);
+        memory->large = next;
+    }
+
+    pthread_mutex_destroy(&memory->lock);
+    free(memory);
+}
+
+void* polycall_mem_arena_alloc(polycall_context_t ctx, size_t size) {
+    polycall_memory_t* memory = polycall_context_memory(ctx);
+    if (!memory || size > SIZE_MAX - MEM_ALIGN) return NULL;
+
+    size = (size + MEM_ALIGN - 1) & ~(size_t)(MEM_ALIGN - 1);
+    if (size == 0) size = MEM_ALIGN;
+
+    pthread_mutex_lock(&memory->lock);
+    void* ptr = arena_take(memory, size);
+    pthread_mutex_unlock(&memory->lock);
+
+    if (ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+static void* large_alloc(polycall_memory_t* memory, size_t size) {
+    if (size > SIZE_MAX - sizeof(large_block_t)) return NULL;
+
+    large_block_t* block = malloc(sizeof(large_block_t) + size);
+    if (!block) return NULL;
+
+    block->size = size;
+    block->header.size_class = MEM_LARGE_CLASS;
+    block->header.tag = memory->tag;
+    block->prev = NULL;
+
+    pthread_mutex_lock(&memory->lock);
+    block->next = memory->large;
+    if (memory->large) memory->large->prev = block;
+    memory->large = block;
+    memory->stats.large_bytes += size;
+    pthread_mutex_unlock(&memory->lock);
+
+    return block + 1;
+}
+
+static void large_free(polycall_memory_t* memory, block_header_t* header) {
+    large_block_t* block = (large_block_t*)((uint8_t*)header - offsetof(large_block_t, header));
+
+    pthread_mutex_lock(&memory->lock);
+    if (block->prev) block->prev->next = block->next;
+    else memory->large = block->next;
+    if (block->next) block->next->prev = block->prev;
+    memory->stats.large_bytes -= block->size;
+    pthread_mutex_unlock(&memory->lock);
+
+    free(block);
+}
+
+void* polycall_mem_alloc(polycall_context_t ctx, size_t size) {
+    polycall_memory_t* memory = polycall_context_memory(ctx);
+    if (!memory) return NULL;
+
+    if (size > POLYCALL_MEM_MAX_CLASS_SIZE) return large_alloc(memory, size);
+
+    unsigned int size_class = size_class_of(size);
+    thread_cache_t* slot = thread_slot(memory);
+
+    if (!slot->heads[size_class] && !slot_refill(memory, slot, size_class)) return NULL;
+
+    free_block_t* node = slot->heads[size_class];
+    slot->heads[size_class] = node->next;
+    slot->counts[size_class]--;
+    return node;
+}
+
+void* polycall_mem_calloc(polycall_context_t ctx, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+
+    void* ptr = polycall_mem_alloc(ctx, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void polycall_mem_free(polycall_context_t ctx, void* ptr) {
+    polycall_memory_t* memory = polycall_context_memory(ctx);
+    if (!memory || !ptr) return;
+
+    block_header_t* header = header_of(ptr);
+    if (header->tag != memory->tag) return;     // Not ours; leaking beats corrupting
+
+    if (header->size_class == MEM_LARGE_CLASS) {
+        large_free(memory, header);
+        return;
+    }
+
+    unsigned int size_class = header->size_class;
+    thread_cache_t* slot = thread_slot(memory);
+    free_block_t* node = ptr;
+    node->next = slot->heads[size_class];
+    slot->heads[size_class] = node;
+
+    uint32_t limit = cache_limit(size_class);
+    if (++slot->counts[size_class] <= limit) return;
+
+    // Over the cap: give the older half back to the context
+    free_block_t* keep_tail = node;
+    for (uint32_t i = 1; i < limit / 2; i++) keep_tail = keep_tail->next;
+    free_block_t* head = keep_tail->next;
+    free_block_t* tail = head;
+    uint32_t moved = 1;
+    while (tail->next) {
+        tail = tail->next;
+        moved++;
+    }
+    keep_tail->next = NULL;
+    slot->counts[size_class] -= moved;
+
+    pthread_mutex_lock(&memory->lock);
+    shared_push(memory, size_class, head, tail);
+    pthread_mutex_unlock(&memory->lock);
+}
+
+polycall_status_t polycall_mem_get_stats(
+    polycall_context_t ctx,
+    polycall_memory_stats_t* stats
+) {
+    polycall_memory_t* memory = polycall_context_memory(ctx);
+    if (!memory || !stats) return POLYCALL_ERROR_INVALID_PARAMETERS;
+
+    pthread_mutex_lock(&memory->lock);
+    *stats = memory->stats;
+    pthread_mutex_unlock(&memory->lock);
+    return POLYCALL_SUCCESS;
+}
@@ -0,0 +1,572 @@
+#include "polycall_metrics.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #include <windows.h>
+    #define poll WSAPoll
+    #define close_socket closesocket
+    #define MSG_NOSIGNAL 0
+    typedef char* sock_opt_type;
+#else
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/time.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #define close_socket close
+    typedef void* sock_opt_type;
+#endif
+
+#define METRICS_CACHE_LINE 64
+#define METRICS_THREAD_SLOTS 4          // Registries cached per thread at once
+#define METRICS_HISTOGRAM_GROUPS (POLYCALL_HISTOGRAM_BUCKETS >> POLYCALL_HISTOGRAM_SUB_BITS)
+#define METRICS_POLL_MS 200
+
+typedef struct {
+    char name[POLYCALL_METRICS_NAME_LENGTH];
+    char help[POLYCALL_METRICS_HELP_LENGTH];
+    char labels[POLYCALL_METRICS_LABELS_LENGTH];
+    polycall_metric_kind_t kind;
+    unsigned int histogram;     // Histogram index for histogram series
+} metric_def_t;
+
+/* One per thread that ever touched the registry. Only the owning thread
+ * writes it; snapshots read it concurrently with relaxed atomics. A block
+ * outlives its thread and is handed to the next new thread, keeping its
+ * totals. */
+typedef struct thread_block {
+    struct thread_block* next;
+    bool in_use;                // Guarded by the registry lock
+    _Alignas(METRICS_CACHE_LINE) uint64_t values[POLYCALL_METRICS_MAX];
+    polycall_histogram_t histograms[POLYCALL_METRICS_MAX_HISTOGRAMS];
+} thread_block_t;
+
+struct polycall_metrics {
+    uint64_t id;                // Never reused; validates thread slots
+    pthread_mutex_t lock;       // Registration and the block list
+    _Atomic unsigned int count;
+    unsigned int histogram_count;
+    metric_def_t defs[POLYCALL_METRICS_MAX];
+    thread_block_t* blocks;
+    struct polycall_metrics* live_next;
+};
+
+struct polycall_metrics_server {
+    polycall_metrics_t* metrics;
+    int listen_fd;
+    uint16_t port;
+    _Atomic bool stop;
+    pthread_t thread;
+};
+
+typedef struct {
+    uint64_t metrics_id;
+    polycall_metrics_t* metrics;
+    thread_block_t* block;
+} thread_slot_t;
+
+static _Thread_local thread_slot_t thread_slots[METRICS_THREAD_SLOTS];
+
+static pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+static polycall_metrics_t* live_metrics;
+static _Atomic uint64_t next_metrics_id = 1;
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t exit_key;
+
+static const char* const message_type_labels[POLYCALL_METRICS_MESSAGE_TYPES] = {
+    "type=\"handshake\"", "type=\"auth\"", "type=\"command\"",
+    "type=\"response\"", "type=\"error\"", "type=\"heartbeat\""
+};
+
+// Caller holds live_lock
+static bool metrics_alive(uint64_t id) {
+    for (polycall_metrics_t* metrics = live_metrics; metrics; metrics = metrics->live_next) {
+        if (metrics->id == id) return true;
+    }
+    return false;
+}
+
+// Give a slot's block back to its registry (if it still exists) and clear it
+static void release_slot(thread_slot_t* slot) {
+    if (slot->block) {
+        pthread_mutex_lock(&live_lock);
+        if (metrics_alive(slot->metrics_id)) {
+            pthread_mutex_lock(&slot->metrics->lock);
+            slot->block->in_use = false;
+            pthread_mutex_unlock(&slot->metrics->lock);
+        }
+        pthread_mutex_unlock(&live_lock);
+    }
+    memset(slot, 0, sizeof(*slot));
+}
+
+static void thread_exit(void* arg) {
+    (void)arg;
+    for (int i = 0; i < METRICS_THREAD_SLOTS; i++) {
+        release_slot(&thread_slots[i]);
+    }
+}
+
+static void exit_key_init(void) {
+    pthread_key_create(&exit_key, thread_exit);
+}
+
+static thread_block_t* acquire_block(polycall_metrics_t* metrics) {
+    pthread_mutex_lock(&metrics->lock);
+    thread_block_t* block = metrics->blocks;
+    while (block && block->in_use) block = block->next;
+
+    if (!block) {
+        size_t size = (sizeof(thread_block_t) + METRICS_CACHE_LINE - 1) &
+                      ~(size_t)(METRICS_CACHE_LINE - 1);
+        block = aligned_alloc(METRICS_CACHE_LINE, size);
+        if (block) {
+            memset(block, 0, size);
+            block->next = metrics->blocks;
+            metrics->blocks = block;
+        }
+    }
+    if (block) block->in_use = true;
+    pthread_mutex_unlock(&metrics->lock);
+    return block;
+}
+
+static inline thread_block_t* thread_block(polycall_metrics_t* metrics) {
+    thread_slot_t* slot = &thread_slots[metrics->id % METRICS_THREAD_SLOTS];
+    if (slot->metrics_id == metrics->id) return slot->block;
+
+    release_slot(slot);
+    slot->block = acquire_block(metrics);
+    if (!slot->block) return NULL;
+    slot->metrics_id = metrics->id;
+    slot->metrics = metrics;
+
+    // Make sure the block is handed back when this thread exits
+    pthread_once(&exit_key_once, exit_key_init);
+    pthread_setspecific(exit_key, thread_slots);
+    return slot->block;
+}
+
+// Single-writer increment that concurrent readers may observe
+static inline void relaxed_add64(uint64_t* value, uint64_t n) {
+    __atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static polycall_status_t register_locked(
+    polycall_metrics_t* metrics,
+    polycall_metric_kind_t kind,
+    const char* name,
+    const char* help,
+    const char* labels,
+    polycall_metric_id_t* id
+) {
+    unsigned int count = atomic_load_explicit(&metrics->count, memory_order_relaxed);
+    if (count >= POLYCALL_METRICS_MAX) return POLYCALL_ERROR_OUT_OF_MEMORY;
+    if (kind == POLYCALL_METRIC_HISTOGRAM &&
+        metrics->histogram_count >= POLYCALL_METRICS_MAX_HISTOGRAMS)
+        return POLYCALL_ERROR_OUT_OF_MEMORY;
+
+    metric_def_t* def = &metrics->defs[count];
+    snprintf(def->name, sizeof(def->name), "%s", name);
+    snprintf(def->help, sizeof(def->help), "%s", help ? help : "");
+    snprintf(def->labels, sizeof(def->labels), "%s", labels ? labels : "");
+    def->kind = kind;
+    def->histogram = kind == POLYCALL_METRIC_HISTOGRAM ? metrics->histogram_count++ : 0;
+
+    atomic_store_explicit(&metrics->count, count + 1, memory_order_release);
+    if (id) *id = count;
+    return POLYCALL_SUCCESS;
+}
+
+static void register_per_type(polycall_metrics_t* metrics, const char* name, const char* help) {
+    for (unsigned int i = 0; i < POLYCALL_METRICS_MESSAGE_TYPES; i++) {
+        register_locked(metrics, POLYCALL_METRIC_COUNTER, name, help, message_type_labels[i], NULL);
+    }
+}
+
+// Order must match the built-in ids in polycall_metrics.h
+static void register_builtins(polycall_metrics_t* metrics) {
+    register_per_type(metrics, "polycall_protocol_messages_received_total",
+                      "Protocol messages accepted by type");
+    register_per_type(metrics, "polycall_protocol_bytes_received_total",
+                      "Protocol bytes accepted by type, headers included");
+    register_per_type(metrics, "polycall_protocol_messages_sent_total",
+                      "Protocol messages sent by type");
+    register_per_type(metrics, "polycall_protocol_bytes_sent_total",
+                      "Protocol bytes sent by type, headers included");
+    register_locked(metrics, POLYCALL_METRIC_COUNTER, "polycall_protocol_messages_rejected_total",
+                    "Messages failing version, type or checksum validation", "", NULL);
+    register_locked(metrics, POLYCALL_METRIC_HISTOGRAM, "polycall_protocol_message_size_bytes",
+                    "Size of received protocol messages", "", NULL);
+    register_locked(metrics, POLYCALL_METRIC_COUNTER, "polycall_net_accepts_total",
+                    "Connections accepted", "", NULL);
+    register_locked(metrics, POLYCALL_METRIC_COUNTER, "polycall_net_disconnects_total",
+                    "Clients disconnected", "", NULL);
+    register_locked(metrics, POLYCALL_METRIC_COUNTER, "polycall_net_loop_iterations_total",
+                    "Network event loop iterations", "", NULL);
+    register_locked(metrics, POLYCALL_METRIC_GAUGE, "polycall_net_clients",
+                    "Connected clients", "", NULL);
+    register_locked(metrics, POLYCALL_METRIC_COUNTER, "polycall_sm_transitions_total",
+                    "State machine transitions committed", "", NULL);
+    register_locked(metrics, POLYCALL_METRIC_COUNTER, "polycall_sm_failed_transitions_total",
+                    "State machine transitions rejected or failed", "", NULL);
+}
+
+polycall_metrics_t* polycall_metrics_create(void) {
+    polycall_metrics_t* metrics = calloc(1, sizeof(polycall_metrics_t));
+    if (!metrics) return NULL;
+
+    metrics->id = atomic_fetch_add(&next_metrics_id, 1);
+    pthread_mutex_init(&metrics->lock, NULL);
+    atomic_init(&metrics->count, 0);
+    register_builtins(metrics);
+
+    pthread_mutex_lock(&live_lock);
+    metrics->live_next = live_metrics;
+    live_metrics = metrics;
+    pthread_mutex_unlock(&live_lock);
+    return metrics;
+}
+
+void polycall_metrics_destroy(polycall_metrics_t* metrics) {
+    if (!metrics) return;
+
+    pthread_mutex_lock(&live_lock);
+    for (polycall_metrics_t** link = &live_metrics; *link; link = &(*link)->live_next) {
+        if (*link == metrics) {
+            *link = metrics->live_next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&live_lock);
+
+    // Other threads' slots still name this registry; its id retires them
+    thread_slot_t* slot = &thread_slots[metrics->id % METRICS_THREAD_SLOTS];
+    if (slot->metrics_id == metrics->id) memset(slot, 0, sizeof(*slot));
+
+    while (metrics->blocks) {
+        thread_block_t* next = metrics->blocks->next;
+        free(metrics->blocks);
+        metrics->blocks = next;
+    }
+
+    pthread_mutex_destroy(&metrics->lock);
+    free(metrics);
+}
+
+polycall_status_t polycall_metrics_register(
+    polycall_metrics_t* metrics,
+    polycall_metric_kind_t kind,
+    const char* name,
+    const char* help,
+    const char* labels,
+    polycall_metric_id_t* id
+) {
+    if (!metrics || !name || !name[0] || !id) return POLYCALL_ERROR_INVALID_PARAMETERS;
+
+    pthread_mutex_lock(&metrics->lock);
+    polycall_status_t status = register_locked(metrics, kind, name, help, labels, id);
+    pthread_mutex_unlock(&metrics->lock);
+    return status;
+}
+
+void polycall_metrics_counter_add(polycall_metrics_t* metrics, polycall_metric_id_t id, uint64_t n) {
+    if (!metrics || id >= atomic_load_explicit(&metrics->count, memory_order_acquire)) return;
+
+    thread_block_t* block = thread_block(metrics);
+    if (block) relaxed_add64(&block->values[id], n);
+}
+
+void polycall_metrics_gauge_add(polycall_metrics_t* metrics, polycall_metric_id_t id, int64_t delta) {
+    // Two's complement: per-thread deltas sum to the signed total
+    polycall_metrics_counter_add(metrics, id, (uint64_t)delta);
+}
+
+void polycall_metrics_observe(polycall_metrics_t* metrics, polycall_metric_id_t id, uint64_t value) {
+    if (!metrics || id >= atomic_load_explicit(&metrics->count, memory_order_acquire)) return;
+    if (metrics->defs[id].kind != POLYCALL_METRIC_HISTOGRAM) return;
+
+    thread_block_t* block = thread_block(metrics);
+    if (!block) return;
+
+    polycall_histogram_t* hist = &block->histograms[metrics->defs[id].histogram];
+    uint32_t* bucket = &hist->buckets[polycall_histogram_bucket(value)];
+    __atomic_store_n(bucket, __atomic_load_n(bucket, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+
+    uint64_t count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+    if (count == 0 || value < __atomic_load_n(&hist->min, __ATOMIC_RELAXED))
+        __atomic_store_n(&hist->min, value, __ATOMIC_RELAXED);
+    if (value > __atomic_load_n(&hist->max, __ATOMIC_RELAXED))
+        __atomic_store_n(&hist->max, value, __ATOMIC_RELAXED);
+    relaxed_add64(&hist->sum, value);
+    __atomic_store_n(&hist->count, count + 1, __ATOMIC_RELAXED);
+}
+
+static void merge_histogram(polycall_histogram_t* dst, const polycall_histogram_t* src) {
+    polycall_histogram_t copy;
+    copy.count = __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+    if (copy.count == 0) return;
+
+    copy.sum = __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+    copy.min = __atomic_load_n(&src->min, __ATOMIC_RELAXED);
+    copy.max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+    for (unsigned int i = 0; i < POLYCALL_HISTOGRAM_BUCKETS; i++) {
+        copy.buckets[i] = __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+    }
+    polycall_histogram_merge(dst, &copy);
+}
+
+polycall_status_t polycall_metrics_snapshot(
+    polycall_metrics_t* metrics,
+    polycall_metric_sample_t* samples,
+    size_t max_samples,
+    size_t* count
+) {
+    if (!metrics || (!samples && max_samples) || !count) return POLYCALL_ERROR_INVALID_PARAMETERS;
+
+    pthread_mutex_lock(&metrics->lock);
+    size_t total = atomic_load_explicit(&metrics->count, memory_order_relaxed);
+    size_t n = total < max_samples ? total : max_samples;
+
+    for (size_t i = 0; i < n; i++) {
+        const metric_def_t* def = &metrics->defs[i];
+        polycall_metric_sample_t* sample = &samples[i];
+        memset(sample, 0, sizeof(*sample));
+        sample->name = def->name;
+        sample->help = def->help;
+        sample->labels = def->labels;
+        sample->kind = def->kind;
+
+        uint64_t sum = 0;
+        for (thread_block_t* block = metrics->blocks; block; block = block->next) {
+            if (def->kind == POLYCALL_METRIC_HISTOGRAM) {
+                merge_histogram(&sample->histogram, &block->histograms[def->histogram]);
+            } else {
+                sum += __atomic_load_n(&block->values[i], __ATOMIC_RELAXED);
+            }
+        }
+        sample->counter = sum;
+        sample->gauge = (int64_t)sum;
+    }
+    pthread_mutex_unlock(&metrics->lock);
+
+    *count = n;
+    return POLYCALL_SUCCESS;
+}
+
+typedef struct {
+    char* buffer;
+    size_t capacity;
+    size_t length;
+} text_out_t;
+
+static void out_printf(text_out_t* out, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void out_printf(text_out_t* out, const char* format, ...) {
+    char* at = out->length < out->capacity ? out->buffer + out->length : NULL;
+    size_t room = at ? out->capacity - out->length : 0;
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(at, room, format, args);
+    va_end(args);
+    if (written > 0) out->length += (size_t)written;
+}
+
+// name{labels,extra} without dangling separators
+static void out_series(text_out_t* out, const char* name, const char* suffix,
+                       const char* labels, const char* extra) {
+    bool has_labels = labels && labels[0];
+    bool has_extra = extra && extra[0];
+    out_printf(out, "%s%s", name, suffix);
+    if (has_labels || has_extra) {
+        out_printf(out, "{%s%s%s}", has_labels ? labels : "",
+                   has_labels && has_extra ? "," : "", has_extra ? extra : "");
+    }
+}
+
+static void render_histogram(text_out_t* out, const polycall_metric_sample_t* sample) {
+    const polycall_histogram_t* hist = &sample->histogram;
+    uint64_t cumulative = 0;
+    char le[48];
+
+    // One boundary per power of two keeps the bucket set stable across scrapes
+    for (unsigned int group = 1; group < METRICS_HISTOGRAM_GROUPS; group++) {
+        unsigned int first = group << POLYCALL_HISTOGRAM_SUB_BITS;
+        for (unsigned int i = (group - 1) << POLYCALL_HISTOGRAM_SUB_BITS; i < first; i++) {
+            cumulative += hist->buckets[i];
+        }
+        snprintf(le, sizeof(le), "le=\"%llu\"",
+                 (unsigned long long)(polycall_histogram_bucket_lower(first) - 1));
+        out_series(out, sample->name, "_bucket", sample->labels, le);
+        out_printf(out, " %llu\n", (unsigned long long)cumulative);
+    }
+
+    out_series(out, sample->name, "_bucket", sample->labels, "le=\"+Inf\"");
+    out_printf(out, " %llu\n", (unsigned long long)hist->count);
+    out_series(out, sample->name, "_sum", sample->labels, NULL);
+    out_printf(out, " %llu\n", (unsigned long long)hist->sum);
+    out_series(out, sample->name, "_count", sample->labels, NULL);
+    out_printf(out, " %llu\n", (unsigned long long)hist->count);
+}
+
+size_t polycall_metrics_render(polycall_metrics_t* metrics, char* buffer, size_t capacity) {
+    if (!metrics) return 0;
+
+    polycall_metric_sample_t* samples = malloc(POLYCALL_METRICS_MAX * sizeof(*samples));
+    if (!samples) return 0;
+
+    size_t count = 0;
+    polycall_metrics_snapshot(metrics, samples, POLYCALL_METRICS_MAX, &count);
+
+    static const char* const type_names[] = { "counter", "gauge", "histogram" };
+    text_out_t out = { .buffer = buffer, .capacity = buffer ? capacity : 0, .length = 0 };
+    if (out.capacity) buffer[0] = '\0';
+
+    for (size_t i = 0; i < count; i++) {
+        const polycall_metric_sample_t* sample = &samples[i];
+        if (i == 0 || strcmp(sample->name, samples[i - 1].name) != 0) {
+            out_printf(&out, "# HELP %s %s\n# TYPE %s %s\n", sample->name, sample->help,
+                       sample->name, type_names[sample->kind]);
+        }
+
+        if (sample->kind == POLYCALL_METRIC_HISTOGRAM) {
+            render_histogram(&out, sample);
+        } else {
+            out_series(&out, sample->name, "", sample->labels, NULL);
+            if (sample->kind == POLYCALL_METRIC_GAUGE) {
+                out_printf(&out, " %lld\n", (long long)sample->gauge);
+            } else {
+                out_printf(&out, " %llu\n", (unsigned long long)sample->counter);
+            }
+        }
+    }
+
+    free(samples);
+    return out.length;
+}
+
+static void serve_client(polycall_metrics_server_t* server, int fd) {
+#ifdef _WIN32
+    DWORD timeout = 1000;
+#else
+    struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+#endif
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (sock_opt_type)&timeout, sizeof(timeout));
+
+    // Read the request head; the path is not interpreted
+    char request[2048];
+    size_t received = 0;
+    while (received < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + received, sizeof(request) - 1 - received, 0);
+        if (n <= 0) break;
+        received += (size_t)n;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n")) break;
+    }
+
+    size_t length = polycall_metrics_render(server->metrics, NULL, 0);
+    char* body = malloc(length + 1);
+    if (body) length = polycall_metrics_render(server->metrics, body, length + 1);
+
+    char head[160];
+    int head_length = snprintf(head, sizeof(head),
+                               "HTTP/1.0 %s\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: %zu\r\n"
+                               "Connection: close\r\n\r\n",
+                               body ? "200 OK" : "500 Internal Server Error",
+                               body ? length : (size_t)0);
+    send(fd, head, (size_t)head_length, MSG_NOSIGNAL);
+    for (size_t sent = 0; body && sent < length; ) {
+        ssize_t n = send(fd, body + sent, length - sent, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        sent += (size_t)n;
+    }
+    free(body);
+}
+
+static void* server_thread(void* arg) {
+    polycall_metrics_server_t* server = arg;
+    struct pollfd pfd = { .fd = server->listen_fd, .events = POLLIN };
+
+    while (!atomic_load_explicit(&server->stop, memory_order_acquire)) {
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) continue;
+
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        serve_client(server, fd);
+        close_socket(fd);
+    }
+    return NULL;
+}
+
+polycall_status_t polycall_metrics_serve(
+    polycall_metrics_t* metrics,
+    uint16_t port,
+    polycall_metrics_server_t** server
+) {
+    if (!metrics || !server) return POLYCALL_ERROR_INVALID_PARAMETERS;
+    *server = NULL;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return POLYCALL_ERROR_INITIALIZATION_FAILED;
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (sock_opt_type)&reuse, sizeof(reuse));
+
+    // Admin endpoint: loopback only
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    socklen_t addr_length = sizeof(addr);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &addr_length) < 0) {
+        close_socket(fd);
+        polycall_error_set(POLYCALL_ERR_INITIALIZATION_FAILED, "Failed to bind metrics port");
+        return POLYCALL_ERROR_INITIALIZATION_FAILED;
+    }
+
+    polycall_metrics_server_t* s = calloc(1, sizeof(polycall_metrics_server_t));
+    if (!s) {
+        close_socket(fd);
+        return POLYCALL_ERROR_OUT_OF_MEMORY;
+    }
+    s->metrics = metrics;
+    s->listen_fd = fd;
+    s->port = ntohs(addr.sin_port);
+    atomic_init(&s->stop, false);
+
+    if (pthread_create(&s->thread, NULL, server_thread, s) != 0) {
+        close_socket(fd);
+        free(s);
+        return POLYCALL_ERROR_INITIALIZATION_FAILED;
+    }
+
+    *server = s;
+    return POLYCALL_SUCCESS;
+}
+
+uint16_t polycall_metrics_server_port(const polycall_metrics_server_t* server) {
+    return server ? server->port : 0;
+}
+
+void polycall_metrics_server_stop(polycall_metrics_server_t* server) {
+    if (!server) return;
+
+    atomic_store_explicit(&server->stop, true, memory_order_release);
+    pthread_join(server->thread, NULL);
+    close_socket(server->listen_fd);
+    free(server);
+}
@@ -1,24 +1,63 @@
 #include "polycall_protocol.h"
+#include "polycall_memory.h"
+#include "polycall_metrics.h"
+#include "polycall_trace.h"
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 
 #define MAX_ERROR_LENGTH 256
 #define PROTOCOL_BUFFER_SIZE 4096
+#define PROTOCOL_DEFAULT_MAX_MESSAGE 65536
 #define PROTOCOL_MAGIC 0x504C43 // "PLC"
 #define PROTOCOL_TIMEOUT_MS 5000
 #define MAX_SEQUENCE_NUMBER 0xFFFFFFFF
 
-// Internal protocol error states
-static char protocol_error_buffer[MAX_ERROR_LENGTH] = {0};
-
 // Internal protocol context structure
-typedef struct {
-    polycall_protocol_context_t base;  // Base context
+typedef struct polycall_protocol_internal {
     polycall_protocol_callbacks_t callbacks;  // Callback functions
-    char last_error[MAX_ERROR_LENGTH];  // Error buffer
+    char last_error[MAX_ERROR_LENGTH];  // Reason the session entered ERROR
+    polycall_sm_registry_t* registry;  // Registry holding state_machine, or NULL
+    size_t max_message_size;           // Largest payload accepted from a stream
+    uint8_t* rx;                       // Stream bytes not yet processed
+    size_t rx_length;
+    size_t rx_capacity;
 } protocol_context_internal_t;
 
+// The protocol functions check the source state before moving, so each
+// transition is declared once: to_error and to_closed leave from READY
+// but are taken from any state
+static const PolyCall_State protocol_states[] = {
+    { .name = "INIT", .id = POLYCALL_STATE_INIT, .version = 1 },
+    { .name = "HANDSHAKE", .id = POLYCALL_STATE_HANDSHAKE, .version = 1 },
+    { .name = "AUTH", .id = POLYCALL_STATE_AUTH, .version = 1 },
+    { .name = "READY", .id = POLYCALL_STATE_READY, .version = 1 },
+    { .name = "ERROR", .id = POLYCALL_STATE_ERROR, .is_final = true, .version = 1 },
+    { .name = "CLOSED", .id = POLYCALL_STATE_CLOSED, .is_final = true, .version = 1 },
+};
+
+static const PolyCall_Transition protocol_transitions[] = {
+    { .name = POLYCALL_TRANSITION_TO_HANDSHAKE, .from_state = POLYCALL_STATE_INIT,
+      .to_state = POLYCALL_STATE_HANDSHAKE, .is_valid = true },
+    { .name = POLYCALL_TRANSITION_TO_AUTH, .from_state = POLYCALL_STATE_HANDSHAKE,
+      .to_state = POLYCALL_STATE_AUTH, .is_valid = true },
+    { .name = POLYCALL_TRANSITION_TO_READY, .from_state = POLYCALL_STATE_AUTH,
+      .to_state = POLYCALL_STATE_READY, .is_valid = true },
+    { .name = POLYCALL_TRANSITION_TO_ERROR, .from_state = POLYCALL_STATE_READY,
+      .to_state = POLYCALL_STATE_ERROR, .is_valid = true },
+    { .name = POLYCALL_TRANSITION_TO_CLOSED, .from_state = POLYCALL_STATE_READY,
+      .to_state = POLYCALL_STATE_CLOSED, .is_valid = true },
+};
+
+const PolyCall_StateMachineDef polycall_protocol_sm_def = {
+    .name = "polycall_protocol",
+    .states = protocol_states,
+    .num_states = sizeof(protocol_states) / sizeof(protocol_states[0]),
+    .transitions = protocol_transitions,
+    .num_transitions = sizeof(protocol_transitions) / sizeof(protocol_transitions[0]),
+    .initial_state = POLYCALL_STATE_INIT
+};
+
 // Internal protocol error states
 // Protocol message validation helper
 static bool validate_message_header(const polycall_message_header_t* header) {
@@ -26,30 +65,46 @@ static bool validate_message_header(const polycall_message_header_t* header) {
     
     // Check version compatibility
     if (header->version != POLYCALL_PROTOCOL_VERSION) {
-        snprintf(protocol_error_buffer, MAX_ERROR_LENGTH,
-                "Protocol version mismatch: expected %d, got %d",
-                POLYCALL_PROTOCOL_VERSION, header->version);
+        polycall_error_set_detail(POLYCALL_ERR_PROTOCOL_VERSION, "Protocol version mismatch",
+                                  "expected %lld, got %lld",
+                                  POLYCALL_PROTOCOL_VERSION, header->version);
         return false;
     }
     
     // Validate message type
     if (header->type < POLYCALL_MSG_HANDSHAKE || header->type > POLYCALL_MSG_HEARTBEAT) {
-        snprintf(protocol_error_buffer, MAX_ERROR_LENGTH,
-                "Invalid message type: %d", header->type);
+        polycall_error_set_detail(POLYCALL_ERR_PROTOCOL_MESSAGE, "Invalid message type",
+                                  "%lld", header->type, 0);
         return false;
     }
     
     return true;
 }
 
+// Count a message against its type's series
+static void count_message(
+    polycall_context_t pc_ctx,
+    polycall_metric_id_t messages_base,
+    polycall_metric_id_t bytes_base,
+    uint8_t type,
+    size_t length
+) {
+    if (type < POLYCALL_MSG_HANDSHAKE || type > POLYCALL_MSG_HEARTBEAT) return;
+
+    polycall_metrics_t* metrics = polycall_context_metrics(pc_ctx);
+    unsigned int index = type - POLYCALL_MSG_HANDSHAKE;
+    polycall_metrics_counter_add(metrics, messages_base + index, 1);
+    polycall_metrics_counter_add(metrics, bytes_base + index, length);
+}
+
 // Protocol state transition helper
 static bool transition_protocol_state(
-    protocol_context_internal_t* ctx,
+    polycall_protocol_context_t* ctx,
     polycall_protocol_state_t new_state
 ) {
-    if (!ctx || !ctx->base.state_machine) return false;
+    if (!ctx || !ctx->internal || !ctx->state_machine) return false;
     
-    polycall_protocol_state_t old_state = ctx->base.state;
+    polycall_protocol_state_t old_state = ctx->state;
     const char* transition_name = NULL;
     
     // Determine appropriate transition
@@ -74,16 +129,16 @@ static bool transition_protocol_state(
     }
     
     // Execute state machine transition
-    if (polycall_sm_execute_transition(ctx->base.state_machine, transition_name) 
+    if (polycall_sm_execute_transition(ctx->state_machine, transition_name) 
         != POLYCALL_SM_SUCCESS) {
         return false;
     }
     
-    ctx->base.state = new_state;
+    ctx->state = new_state;
     
     // Notify state change
-    if (ctx->base.state != old_state && ctx->callbacks.on_state_change) {
-        ctx->callbacks.on_state_change(&ctx->base, old_state, new_state);
+    if (ctx->state != old_state && ctx->internal->callbacks.on_state_change) {
+        ctx->internal->callbacks.on_state_change(ctx, old_state, new_state);
     }
     
     return true;
@@ -97,42 +152,74 @@ bool polycall_protocol_init(
     const polycall_protocol_config_t* config
 ) {
     if (!ctx || !pc_ctx || !endpoint || !config) {
-        snprintf(protocol_error_buffer, MAX_ERROR_LENGTH, "Invalid parameters");
+        polycall_error_set(POLYCALL_ERR_INVALID_PARAMETERS, "Invalid parameters");
         return false;
     }
     
-    protocol_context_internal_t* internal_ctx = calloc(1, sizeof(protocol_context_internal_t));
+    if (config->registry && config->session_id == 0) {
+        polycall_error_set(POLYCALL_ERR_INVALID_PARAMETERS, "Registry requires a session id");
+        return false;
+    }
+    
+    protocol_context_internal_t* internal_ctx =
+        polycall_mem_calloc(pc_ctx, 1, sizeof(protocol_context_internal_t));
     if (!internal_ctx) {
-        snprintf(protocol_error_buffer, MAX_ERROR_LENGTH, "Memory allocation failed");
+        polycall_error_set(POLYCALL_ERR_OUT_OF_MEMORY, "Memory allocation failed");
         return false;
     }
 
     // Initialize base context
-    internal_ctx->base.pc_ctx = pc_ctx;
-    internal_ctx->base.endpoint = endpoint;
-    internal_ctx->base.state = POLYCALL_STATE_INIT;
-    internal_ctx->base.next_sequence = 1;
-    internal_ctx->base.user_data = config->user_data;
+    memset(ctx, 0, sizeof(polycall_protocol_context_t));
+    ctx->pc_ctx = pc_ctx;
+    ctx->endpoint = endpoint;
+    ctx->state = POLYCALL_STATE_INIT;
+    ctx->next_sequence = 1;
+    ctx->user_data = config->user_data;
+    ctx->internal = internal_ctx;
     
     // Copy callbacks
     memcpy(&internal_ctx->callbacks, &config->callbacks, sizeof(polycall_protocol_callbacks_t));
+    internal_ctx->max_message_size = config->max_message_size ? config->max_message_size
+                                                              : PROTOCOL_DEFAULT_MAX_MESSAGE;
     
     // Initialize state machine
-    polycall_sm_status_t sm_status = polycall_sm_create_with_integrity(
-        pc_ctx,
-        &internal_ctx->base.state_machine,
-        NULL  // No integrity check for now
-    );
+    polycall_sm_status_t sm_status = config->sm_pool ?
+        polycall_sm_pool_acquire(config->sm_pool, &ctx->state_machine) :
+        polycall_sm_create_from_def(
+            pc_ctx,
+            &polycall_protocol_sm_def,
+            &ctx->state_machine,
+            NULL  // No integrity check for now
+        );
     
     if (sm_status != POLYCALL_SM_SUCCESS) {
-        snprintf(protocol_error_buffer, MAX_ERROR_LENGTH,
-                "Failed to create protocol state machine");
-        free(internal_ctx);
+        polycall_error_set_detail(POLYCALL_ERR_STATE_MACHINE,
+                                  "Failed to create protocol state machine",
+                                  "status %lld", sm_status, 0);
+        polycall_mem_free(pc_ctx, internal_ctx);
+        ctx->internal = NULL;
         return false;
     }
     
-    // Copy internal context back to provided context
-    memcpy(ctx, &internal_ctx->base, sizeof(polycall_protocol_context_t));
+    // Publish the session so other threads can find its machine by id
+    if (config->registry) {
+        sm_status = polycall_sm_registry_insert(config->registry, config->session_id,
+                                                ctx->state_machine);
+        if (sm_status != POLYCALL_SM_SUCCESS) {
+            if (sm_status == POLYCALL_SM_ERROR_ALREADY_EXISTS) {
+                polycall_error_set(POLYCALL_ERR_SESSION_EXISTS, "Session id already registered");
+            } else {
+                polycall_error_set(POLYCALL_ERR_REGISTRY, "Failed to register session");
+            }
+            polycall_sm_destroy(ctx->state_machine);
+            ctx->state_machine = NULL;
+            polycall_mem_free(pc_ctx, internal_ctx);
+            ctx->internal = NULL;
+            return false;
+        }
+        internal_ctx->registry = config->registry;
+        ctx->session_id = config->session_id;
+    }
     
     return true;
 }
@@ -140,7 +227,13 @@ bool polycall_protocol_init(
 void polycall_protocol_cleanup(polycall_protocol_context_t* ctx) {
     if (!ctx) return;
     
-    protocol_context_internal_t* internal_ctx = (protocol_context_internal_t*)ctx;
+    protocol_context_internal_t* internal_ctx = ctx->internal;
+    
+    // Unpublish before the machine goes away
+    if (internal_ctx && internal_ctx->registry) {
+        polycall_sm_registry_remove(internal_ctx->registry, ctx->session_id, NULL);
+        ctx->session_id = 0;
+    }
     
     // Clean up state machine
     if (ctx->state_machine) {
@@ -149,7 +242,9 @@ void polycall_protocol_cleanup(polycall_protocol_context_t* ctx) {
     }
     
     // Clean up context
-    free(internal_ctx);
+    if (internal_ctx) polycall_mem_free(ctx->pc_ctx, internal_ctx->rx);
+    polycall_mem_free(ctx->pc_ctx, internal_ctx);
+    ctx->internal = NULL;
 }
 
 // Protocol message handling
@@ -177,30 +272,123 @@ bool polycall_protocol_send(
     // Calculate checksum
     header.checksum = polycall_protocol_calculate_checksum(payload, payload_length);
     
-    // Prepare network packet
-    uint8_t buffer[PROTOCOL_BUFFER_SIZE];
-    
-    // Copy header and payload to buffer
     size_t total_size = sizeof(header) + payload_length;
     if (total_size > PROTOCOL_BUFFER_SIZE) {
-        snprintf(protocol_error_buffer, MAX_ERROR_LENGTH,
-                "Message too large: %zu bytes", total_size);
+        polycall_error_set_detail(POLYCALL_ERR_PROTOCOL_SIZE, "Message too large",
+                                  "%lld bytes", (long long)total_size, 0);
         return false;
     }
     
-    memcpy(buffer, &header, sizeof(header));
-    memcpy(buffer + sizeof(header), payload, payload_length);
+    if (ctx->endpoint->loopback) {
+        // Build the frame in a buffer the peer takes over; no further copies
+        NetworkPacket frame = { net_packet_alloc(total_size), total_size, 0 };
+        if (!frame.data) {
+            polycall_error_set(POLYCALL_ERR_OUT_OF_MEMORY, "Failed to allocate frame");
+            return false;
+        }
+        memcpy(frame.data, &header, sizeof(header));
+        memcpy((uint8_t*)frame.data + sizeof(header), payload, payload_length);
+        if (net_send_owned(ctx->endpoint, &frame) != (ssize_t)total_size) {
+            net_packet_free(frame.data);
+            return false;
+        }
+    } else {
+        // Prepare network packet
+        uint8_t buffer[PROTOCOL_BUFFER_SIZE];
+        memcpy(buffer, &header, sizeof(header));
+        memcpy(buffer + sizeof(header), payload, payload_length);
+        
+        NetworkPacket packet = {
+            .data = buffer,
+            .size = total_size,
+            .flags = 0
+        };
+        
+        if (net_send(ctx->endpoint, &packet) != (ssize_t)total_size) return false;
+    }
     
-    NetworkPacket packet = {
-        .data = buffer,
-        .size = total_size,
-        .flags = 0
-    };
+    POLYCALL_TRACE4(message_send, ctx->session_id, header.sequence, type, total_size);
     
-    return net_send(ctx->endpoint, &packet) == (ssize_t)total_size;
+    count_message(ctx->pc_ctx, POLYCALL_METRIC_PROTOCOL_TX_MESSAGES,
+                  POLYCALL_METRIC_PROTOCOL_TX_BYTES, type, total_size);
+    return true;
 }
 
 
+// Grow the stream buffer to hold at least size bytes
+static bool rx_reserve(polycall_protocol_context_t* ctx,
+                       protocol_context_internal_t* internal_ctx, size_t size) {
+    if (internal_ctx->rx_capacity >= size) return true;
+    
+    size_t capacity = internal_ctx->rx_capacity ? internal_ctx->rx_capacity * 2 : size;
+    if (capacity < size) capacity = size;
+    uint8_t* rx = polycall_mem_alloc(ctx->pc_ctx, capacity);
+    if (!rx) {
+        polycall_error_set(POLYCALL_ERR_OUT_OF_MEMORY, "Failed to grow receive buffer");
+        return false;
+    }
+    if (internal_ctx->rx) {
+        memcpy(rx, internal_ctx->rx, internal_ctx->rx_length);
+        polycall_mem_free(ctx->pc_ctx, internal_ctx->rx);
+    }
+    internal_ctx->rx = rx;
+    internal_ctx->rx_capacity = capacity;
+    return true;
+}
+
+bool polycall_protocol_receive(polycall_protocol_context_t* ctx) {
+    if (!ctx || !ctx->endpoint) return false;
+    
+    if (ctx->endpoint->loopback) {
+        // Process the peer's frame in place, then release it
+        NetworkPacket frame = { NULL, 0, 0 };
+        if (net_receive_owned(ctx->endpoint, &frame) <= 0) return false;
+        bool processed = polycall_protocol_process(ctx, frame.data, frame.size);
+        net_packet_free(frame.data);
+        return processed;
+    }
+    
+    protocol_context_internal_t* internal_ctx = ctx->internal;
+    if (!internal_ctx) return false;
+    
+    // A stream delivers bytes, not messages: read until the buffer holds a
+    // whole frame, process exactly one, and keep whatever follows it
+    for (;;) {
+        size_t wanted = PROTOCOL_BUFFER_SIZE;
+        if (internal_ctx->rx_length >= sizeof(polycall_message_header_t)) {
+            polycall_message_header_t header;
+            memcpy(&header, internal_ctx->rx, sizeof(header));
+            if (header.payload_length > internal_ctx->max_message_size) {
+                // Framing is lost; nothing after this can be trusted
+                polycall_error_set(POLYCALL_ERR_PROTOCOL_MESSAGE, "Message exceeds max_message_size");
+                polycall_metrics_counter_add(polycall_context_metrics(ctx->pc_ctx),
+                                             POLYCALL_METRIC_PROTOCOL_REJECTED, 1);
+                internal_ctx->rx_length = 0;
+                return false;
+            }
+            
+            size_t frame = sizeof(header) + header.payload_length;
+            if (internal_ctx->rx_length >= frame) {
+                bool processed = polycall_protocol_process(ctx, internal_ctx->rx, frame);
+                internal_ctx->rx_length -= frame;
+                memmove(internal_ctx->rx, internal_ctx->rx + frame, internal_ctx->rx_length);
+                return processed;
+            }
+            if (frame > wanted) wanted = frame;
+        }
+        
+        if (!rx_reserve(ctx, internal_ctx, wanted)) return false;
+        NetworkPacket packet = {
+            .data = internal_ctx->rx + internal_ctx->rx_length,
+            .size = internal_ctx->rx_capacity - internal_ctx->rx_length,
+            .flags = 0
+        };
+        ssize_t received = net_receive(ctx->endpoint, &packet);
+        if (received <= 0) return false;
+        internal_ctx->rx_length += (size_t)received;
+    }
+}
+
 bool polycall_protocol_process(
     polycall_protocol_context_t* ctx,
     const void* data,
@@ -210,45 +398,63 @@ bool polycall_protocol_process(
         return false;
     }
     
-    protocol_context_internal_t* internal_ctx = (protocol_context_internal_t*)ctx;
+    protocol_context_internal_t* internal_ctx = ctx->internal;
+    if (!internal_ctx) return false;
+    
     const polycall_message_header_t* header = (const polycall_message_header_t*)data;
     const void* payload = (const uint8_t*)data + sizeof(polycall_message_header_t);
     size_t payload_length = length - sizeof(polycall_message_header_t);
     
+    polycall_metrics_t* metrics = polycall_context_metrics(ctx->pc_ctx);
+    
     // Validate message
     if (!validate_message_header(header)) {
+        polycall_metrics_counter_add(metrics, POLYCALL_METRIC_PROTOCOL_REJECTED, 1);
         return false;
     }
     
     // Verify checksum
     if (!polycall_protocol_verify_checksum(header, payload, payload_length)) {
-        snprintf(protocol_error_buffer, MAX_ERROR_LENGTH, "Checksum verification failed");
+        polycall_error_set(POLYCALL_ERR_PROTOCOL_CHECKSUM, "Checksum verification failed");
+        polycall_metrics_counter_add(metrics, POLYCALL_METRIC_PROTOCOL_REJECTED, 1);
         return false;
     }
     
+    count_message(ctx->pc_ctx, POLYCALL_METRIC_PROTOCOL_RX_MESSAGES,
+                  POLYCALL_METRIC_PROTOCOL_RX_BYTES, header->type, length);
+    polycall_metrics_observe(metrics, POLYCALL_METRIC_PROTOCOL_MESSAGE_SIZE, length);
+    POLYCALL_TRACE4(frame_decode, ctx->session_id, header->sequence, header->type, payload_length);
+    
     // Process message based on type
+    POLYCALL_TRACE3(dispatch, ctx->session_id, header->sequence, header->type);
     switch (header->type) {
         case POLYCALL_MSG_HANDSHAKE:
             if (internal_ctx->callbacks.on_handshake) {
-                internal_ctx->callbacks.on_handshake(&internal_ctx->base);
+                internal_ctx->callbacks.on_handshake(ctx);
             }
             break;
             
         case POLYCALL_MSG_AUTH:
             if (internal_ctx->callbacks.on_auth_request) {
-                internal_ctx->callbacks.on_auth_request(&internal_ctx->base, payload);
+                internal_ctx->callbacks.on_auth_request(ctx, payload);
             }
             break;
             
         case POLYCALL_MSG_COMMAND:
             if (internal_ctx->callbacks.on_command) {
-                internal_ctx->callbacks.on_command(&internal_ctx->base, payload, payload_length);
+                internal_ctx->callbacks.on_command(ctx, payload, payload_length);
+            }
+            break;
+            
+        case POLYCALL_MSG_RESPONSE:
+            if (internal_ctx->callbacks.on_response) {
+                internal_ctx->callbacks.on_response(ctx, payload, payload_length);
             }
             break;
             
         case POLYCALL_MSG_ERROR:
             if (internal_ctx->callbacks.on_error) {
-                internal_ctx->callbacks.on_error(&internal_ctx->base, payload);
+                internal_ctx->callbacks.on_error(ctx, payload);
             }
             break;
             
@@ -257,17 +463,17 @@ bool polycall_protocol_process(
             break;
             
         default:
+            POLYCALL_TRACE4(dispatch_done, ctx->session_id, header->sequence, header->type, 0);
             return false;
     }
     
+    POLYCALL_TRACE4(dispatch_done, ctx->session_id, header->sequence, header->type, 1);
     return true;
 }
 
 void polycall_protocol_update(polycall_protocol_context_t* ctx) {
     if (!ctx) return;
     
-    protocol_context_internal_t* internal_ctx = (protocol_context_internal_t*)ctx;
-    
     // Process any pending state transitions
     switch (ctx->state) {
         case POLYCALL_STATE_INIT:
@@ -278,13 +484,13 @@ void polycall_protocol_update(polycall_protocol_context_t* ctx) {
             
         case POLYCALL_STATE_HANDSHAKE:
             if (polycall_protocol_can_transition(ctx, POLYCALL_STATE_AUTH)) {
-                transition_protocol_state(internal_ctx, POLYCALL_STATE_AUTH);
+                transition_protocol_state(ctx, POLYCALL_STATE_AUTH);
             }
             break;
             
         case POLYCALL_STATE_AUTH:
             if (polycall_protocol_can_transition(ctx, POLYCALL_STATE_READY)) {
-                transition_protocol_state(internal_ctx, POLYCALL_STATE_READY);
+                transition_protocol_state(ctx, POLYCALL_STATE_READY);
             }
             break;
             
@@ -334,8 +540,6 @@ bool polycall_protocol_can_transition(
 bool polycall_protocol_start_handshake(polycall_protocol_context_t* ctx) {
     if (!ctx || ctx->state != POLYCALL_STATE_INIT) return false;
     
-    protocol_context_internal_t* internal_ctx = (protocol_context_internal_t*)ctx;
-    
     // Create handshake payload
     struct {
         uint32_t magic;
@@ -354,13 +558,12 @@ bool polycall_protocol_start_handshake(polycall_protocol_context_t* ctx) {
         return false;
     }
     
-    return transition_protocol_state(internal_ctx, POLYCALL_STATE_HANDSHAKE);
+    return transition_protocol_state(ctx, POLYCALL_STATE_HANDSHAKE);
 }
 
 bool polycall_protocol_complete_handshake(polycall_protocol_context_t* ctx) {
     if (!ctx || ctx->state != POLYCALL_STATE_HANDSHAKE) return false;
-    protocol_context_internal_t* internal_ctx = (protocol_context_internal_t*)ctx;
-    return transition_protocol_state(internal_ctx, POLYCALL_STATE_AUTH);
+    return transition_protocol_state(ctx, POLYCALL_STATE_AUTH);
 }
 
 bool polycall_protocol_authenticate(
@@ -370,8 +573,6 @@ bool polycall_protocol_authenticate(
 ) {
     if (!ctx || !credentials || credentials_length == 0) return false;
     
-    protocol_context_internal_t* internal_ctx = (protocol_context_internal_t*)ctx;
-    
     // Send authentication message
     if (!polycall_protocol_send(ctx, POLYCALL_MSG_AUTH,
                                credentials, credentials_length,
@@ -379,17 +580,26 @@ bool polycall_protocol_authenticate(
         return false;
     }
     
-    return transition_protocol_state(internal_ctx, POLYCALL_STATE_READY);
+    return transition_protocol_state(ctx, POLYCALL_STATE_READY);
 }
 
 
 
 
+const char* polycall_protocol_get_error(const polycall_protocol_context_t* ctx) {
+    // A session that was put into ERROR keeps its reason; otherwise report
+    // the calling thread's last failure
+    if (ctx && ctx->internal && ctx->internal->last_error[0]) {
+        return ctx->internal->last_error;
+    }
+    return polycall_error_message();
+}
+
 void polycall_protocol_set_error(polycall_protocol_context_t* ctx, const char* error) {
-    if (!ctx || !error) return;
-    protocol_context_internal_t* internal_ctx = (protocol_context_internal_t*)ctx;
-    snprintf(internal_ctx->last_error, MAX_ERROR_LENGTH, "%s", error);
-    transition_protocol_state(internal_ctx, POLYCALL_STATE_ERROR);
+    if (!ctx || !ctx->internal || !error) return;
+    snprintf(ctx->internal->last_error, MAX_ERROR_LENGTH, "%s", error);
+    polycall_error_set(POLYCALL_ERR_PROTOCOL_SESSION, "Protocol session entered error state");
+    transition_protocol_state(ctx, POLYCALL_STATE_ERROR);
 }
 
 // Protocol utility functions
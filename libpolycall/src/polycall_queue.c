@@ -0,0 +1,220 @@
+#include "polycall_queue.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define QUEUE_CACHE_LINE 64
+#define QUEUE_ITEM_ALIGN 16             // front() hands out pointers into slots
+
+struct polycall_mpmc {
+    _Alignas(QUEUE_CACHE_LINE) size_t enqueue_pos;
+    _Alignas(QUEUE_CACHE_LINE) size_t dequeue_pos;
+    _Alignas(QUEUE_CACHE_LINE) size_t mask;
+    size_t item_size;
+    size_t stride;                  // Sequence word plus item, padded
+    unsigned char* cells;
+};
+
+struct polycall_spsc {
+    _Alignas(QUEUE_CACHE_LINE) size_t head;     // Next slot to fill, stored by the producer
+    size_t tail_cache;
+    _Alignas(QUEUE_CACHE_LINE) size_t tail;     // Next slot to drain, stored by the consumer
+    size_t head_cache;
+    _Alignas(QUEUE_CACHE_LINE) size_t mask;
+    size_t item_size;
+    size_t stride;
+    unsigned char* slots;
+};
+
+static size_t round_up(size_t size, size_t unit) {
+    return (size + unit - 1) / unit * unit;
+}
+
+// Header plus slot storage in one cache-line aligned block
+static void* queue_alloc(size_t header, size_t capacity, size_t stride, size_t* slots) {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+        if (rounded > SIZE_MAX / 4 / stride) return NULL;
+        rounded <<= 1;
+    }
+
+    size_t offset = round_up(header, QUEUE_CACHE_LINE);
+    void* block = aligned_alloc(QUEUE_CACHE_LINE, round_up(offset + rounded * stride, QUEUE_CACHE_LINE));
+    if (!block) return NULL;
+    memset(block, 0, offset);
+    *slots = rounded;
+    return block;
+}
+
+// MPMC
+
+static inline size_t* mpmc_cell(const polycall_mpmc_t* queue, size_t pos) {
+    return (size_t*)(queue->cells + (pos & queue->mask) * queue->stride);
+}
+
+polycall_mpmc_t* polycall_mpmc_create(size_t capacity, size_t item_size) {
+    if (item_size == 0 || item_size > SIZE_MAX / 8) return NULL;
+    if (capacity < 2) capacity = 2;
+
+    size_t stride = round_up(sizeof(size_t) + item_size, sizeof(size_t));
+    size_t slots;
+    polycall_mpmc_t* queue = queue_alloc(sizeof(polycall_mpmc_t), capacity, stride, &slots);
+    if (!queue) return NULL;
+
+    queue->mask = slots - 1;
+    queue->item_size = item_size;
+    queue->stride = stride;
+    queue->cells = (unsigned char*)queue + round_up(sizeof(polycall_mpmc_t), QUEUE_CACHE_LINE);
+
+    // Cell i is free for the producer whose position is i
+    for (size_t i = 0; i < slots; i++) *mpmc_cell(queue, i) = i;
+    return queue;
+}
+
+void polycall_mpmc_destroy(polycall_mpmc_t* queue) {
+    free(queue);
+}
+
+bool polycall_mpmc_push(polycall_mpmc_t* queue, const void* item) {
+    size_t pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+
+    for (;;) {
+        size_t* cell = mpmc_cell(queue, pos);
+        size_t sequence = __atomic_load_n(cell, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+        if (diff == 0) {
+            // seq_cst so a consumer that announces itself asleep and then
+            // checks polycall_mpmc_size cannot miss this push
+            if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                memcpy(cell + 1, item, queue->item_size);
+                __atomic_store_n(cell, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;           // Full: the cell still holds last lap's item
+        } else {
+            pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+bool polycall_mpmc_pop(polycall_mpmc_t* queue, void* item) {
+    size_t pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+
+    for (;;) {
+        size_t* cell = mpmc_cell(queue, pos);
+        size_t sequence = __atomic_load_n(cell, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->dequeue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                memcpy(item, cell + 1, queue->item_size);
+                __atomic_store_n(cell, pos + queue->mask + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;           // Empty, or the producer has not published yet
+        } else {
+            pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+size_t polycall_mpmc_size(const polycall_mpmc_t* queue) {
+    // Dequeue first: it never passes enqueue, so the difference stays >= 0
+    size_t dequeued = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_SEQ_CST);
+    size_t enqueued = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_SEQ_CST);
+    size_t size = enqueued - dequeued;
+    return size > queue->mask + 1 ? queue->mask + 1 : size;
+}
+
+size_t polycall_mpmc_capacity(const polycall_mpmc_t* queue) {
+    return queue->mask + 1;
+}
+
+// SPSC
+
+static inline unsigned char* spsc_slot(const polycall_spsc_t* ring, size_t pos) {
+    return ring->slots + (pos & ring->mask) * ring->stride;
+}
+
+polycall_spsc_t* polycall_spsc_create(size_t capacity, size_t item_size) {
+    if (item_size == 0 || item_size > SIZE_MAX / 8) return NULL;
+    if (capacity < 1) capacity = 1;
+
+    size_t stride = round_up(item_size, QUEUE_ITEM_ALIGN);
+    size_t slots;
+    polycall_spsc_t* ring = queue_alloc(sizeof(polycall_spsc_t), capacity, stride, &slots);
+    if (!ring) return NULL;
+
+    ring->mask = slots - 1;
+    ring->item_size = item_size;
+    ring->stride = stride;
+    ring->slots = (unsigned char*)ring + round_up(sizeof(polycall_spsc_t), QUEUE_CACHE_LINE);
+    return ring;
+}
+
+void polycall_spsc_destroy(polycall_spsc_t* ring) {
+    free(ring);
+}
+
+bool polycall_spsc_push(polycall_spsc_t* ring, const void* item) {
+    size_t head = ring->head;
+    if (head - ring->tail_cache > ring->mask) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head - ring->tail_cache > ring->mask) return false;
+    }
+    memcpy(spsc_slot(ring, head), item, ring->item_size);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Items the consumer can take, reloading the producer's position if needed
+static size_t spsc_available(polycall_spsc_t* ring) {
+    size_t tail = ring->tail;
+    if (tail == ring->head_cache) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    }
+    return ring->head_cache - tail;
+}
+
+void* polycall_spsc_front(polycall_spsc_t* ring) {
+    return spsc_available(ring) ? spsc_slot(ring, ring->tail) : NULL;
+}
+
+bool polycall_spsc_pop(polycall_spsc_t* ring, void* item) {
+    if (!spsc_available(ring)) return false;
+    if (item) memcpy(item, spsc_slot(ring, ring->tail), ring->item_size);
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+size_t polycall_spsc_pop_batch(polycall_spsc_t* ring, void* items, size_t max_items) {
+    size_t tail = ring->tail;
+    size_t count = ring->head_cache - tail;
+    if (count < max_items) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        count = ring->head_cache - tail;
+    }
+    if (count > max_items) count = max_items;
+
+    unsigned char* out = items;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(out + i * ring->item_size, spsc_slot(ring, tail + i), ring->item_size);
+    }
+    __atomic_store_n(&ring->tail, tail + count, __ATOMIC_RELEASE);
+    return count;
+}
+
+size_t polycall_spsc_size(const polycall_spsc_t* ring) {
+    size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+size_t polycall_spsc_capacity(const polycall_spsc_t* ring) {
+    return ring->mask + 1;
+}
@@ -0,0 +1,1191 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "polycall_server.h"
+#include "polycall_error.h"
+#include "polycall_memory.h"
+#include "polycall_metrics.h"
+#include "polycall_protocol.h"
+#include "polycall_queue.h"
+#include "polycall_sm_pool.h"
+#include "polycall_worker_pool.h"
+#include "network.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#define SERVER_EVENTS 256
+#define SERVER_WIRE_CAPACITY 64         // Frames between the protocol layer and a socket
+#define SERVER_COMPLETIONS 4096         // Worker replies queued per I/O thread
+#define SERVER_SWEEP_MS 1000            // Idle check period
+#define SERVER_DRAIN_POLL_MS 50
+#define SERVER_OUTPUT_LIMIT (1u << 20)  // Unsent reply bytes before a connection stops being read
+#define SERVER_MAX_LINE 512
+
+// What an epoll event points at; the first member of each source
+typedef enum {
+    SOURCE_LISTENER,
+    SOURCE_WAKE,
+    SOURCE_CONN
+} source_kind_t;
+
+typedef struct {
+    source_kind_t kind;
+    int fd;
+} source_t;
+
+struct io_thread;
+
+typedef struct conn {
+    source_kind_t kind;             // SOURCE_CONN
+    struct io_thread* io;
+    struct conn* prev;              // Open or closed list of the I/O thread
+    struct conn* next;
+    struct conn* dirty_next;        // Replies to flush after a completion batch
+    bool dirty;
+    int fd;                         // -1 once closed
+    bool closed;                    // Atomic copy of fd < 0 for the workers
+    uint64_t id;                    // Strand key on the worker pool
+    uint32_t events;                // Armed epoll events
+    bool reading;
+    bool finishing;                 // Close once pending work is answered and flushed
+    bool protocol_ready;
+    polycall_protocol_context_t protocol;
+    NetworkEndpoint local;          // The protocol context sends here...
+    NetworkEndpoint wire;           // ...and this end is drained to the socket
+    uint8_t* in;
+    size_t in_length;
+    size_t in_capacity;
+    uint8_t* out;
+    size_t out_offset;
+    size_t out_length;
+    size_t out_capacity;
+    size_t frame_payload;           // Payload length of the frame being processed
+    size_t pending;                 // Commands out on the worker pool
+    uint64_t last_active_ms;
+} conn_t;
+
+// A command on its way through the worker pool and back
+typedef struct {
+    conn_t* conn;
+    bool ok;
+    size_t request_length;
+    size_t response_length;
+    uint8_t response[POLYCALL_SERVER_MAX_RESPONSE];
+    uint8_t request[];
+} task_t;
+
+typedef struct io_thread {
+    polycall_server_t* server;
+    unsigned int index;
+    pthread_t thread;
+    bool thread_started;
+    int epoll_fd;
+    source_t wake;                  // eventfd: worker replies, reload and drain
+    int wake_pending;               // Set by the first poster until the thread wakes
+    source_t listeners[POLYCALL_SERVER_MAX_ENDPOINTS];
+    polycall_mpmc_t* completions;
+    conn_t* open;
+    conn_t* closed;                 // Waiting for their last worker replies
+    size_t open_count;
+    uint64_t applied;               // Server generation in effect
+    polycall_server_config_t config;
+    bool draining;
+    uint64_t drain_deadline_ms;
+    uint64_t next_sweep_ms;
+    uint8_t response[POLYCALL_SERVER_MAX_RESPONSE];  // Inline handler output
+} io_thread_t;
+
+struct polycall_server {
+    polycall_context_t ctx;
+    polycall_metrics_t* metrics;
+    polycall_server_handler_t handler;
+    void* user_data;
+    polycall_sm_pool_t* sm_pool;
+    polycall_worker_pool_t* workers;
+    io_thread_t* threads;
+    unsigned int thread_count;
+
+    // Guarded by lock; I/O threads copy them when generation moves
+    pthread_mutex_t lock;
+    pthread_cond_t applied_cond;
+    polycall_server_config_t config;
+    int* listen_fds;                // [thread][endpoint], -1 where unused
+    uint16_t ports[POLYCALL_SERVER_MAX_ENDPOINTS];
+    uint64_t generation;
+    bool draining;
+
+    bool started;
+    bool stopped;
+    size_t connections;
+    uint64_t next_conn_id;
+};
+
+static uint64_t now_ms(void) {
+    return polycall_monotonic_ns() / 1000000u;
+}
+
+static bool echo_handler(void* user_data, const void* request, size_t request_length,
+                         void* response, size_t capacity, size_t* response_length) {
+    (void)user_data;
+    if (request_length > capacity) {
+        static const char message[] = "command too large to echo";
+        memcpy(response, message, sizeof(message) - 1);
+        *response_length = sizeof(message) - 1;
+        return false;
+    }
+    memcpy(response, request, request_length);
+    *response_length = request_length;
+    return true;
+}
+
+// Config
+
+void polycall_server_config_defaults(polycall_server_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    strcpy(config->endpoints[0].address, "0.0.0.0");
+    config->endpoints[0].port = 8080;
+    config->endpoint_count = 1;
+    config->max_connections = 65536;
+    config->max_inflight = 128;
+    config->recv_buffer_size = 16384;
+    config->max_frame = 65536;
+    config->backlog = 1024;
+    config->drain_timeout_ms = 5000;
+}
+
+static bool config_valid(const polycall_server_config_t* config) {
+    if (config->endpoint_count == 0 || config->endpoint_count > POLYCALL_SERVER_MAX_ENDPOINTS ||
+        config->io_threads > POLYCALL_SERVER_MAX_THREADS || config->max_connections == 0 ||
+        config->max_inflight == 0 || config->recv_buffer_size == 0 ||
+        config->max_frame == 0 || config->backlog <= 0 ||
+        memchr(config->auth_token, '\0', sizeof(config->auth_token)) == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < config->endpoint_count; i++) {
+        unsigned char scratch[sizeof(struct in6_addr)];
+        const char* address = config->endpoints[i].address;
+        if (inet_pton(AF_INET, address, scratch) != 1 && inet_pton(AF_INET6, address, scratch) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_number(const char* text, unsigned long long max, unsigned long long* value) {
+    char* end;
+    errno = 0;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (errno || end == text || *end || text[0] == '-' || parsed > max) return false;
+    *value = parsed;
+    return true;
+}
+
+// ADDRESS:PORT, with the address in brackets for IPv6
+static bool parse_endpoint(char* text, polycall_server_endpoint_t* endpoint) {
+    char* colon = strrchr(text, ':');
+    if (!colon) return false;
+    *colon = '\0';
+    char* address = text;
+    size_t length = strlen(address);
+    if (address[0] == '[' && length >= 2 && address[length - 1] == ']') {
+        address[length - 1] = '\0';
+        address++;
+    }
+
+    unsigned long long port;
+    if (!parse_number(colon + 1, 65535, &port) || strlen(address) >= sizeof(endpoint->address)) {
+        return false;
+    }
+    strcpy(endpoint->address, address);
+    endpoint->port = (uint16_t)port;
+    return true;
+}
+
+polycall_status_t polycall_server_config_load(const char* path, polycall_server_config_t* config) {
+    if (!path || !config) {
+        polycall_error_set(POLYCALL_ERR_INVALID_PARAMETERS, "Invalid parameters");
+        return POLYCALL_ERROR_INVALID_PARAMETERS;
+    }
+
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        polycall_error_set_detail(POLYCALL_ERR_INVALID_PARAMETERS, "Cannot open server config",
+                                  "errno %lld", errno, 0);
+        return POLYCALL_ERROR_INVALID_PARAMETERS;
+    }
+
+    // Parse into a copy so a bad file leaves config untouched
+    polycall_server_config_t parsed = *config;
+    bool endpoints_given = false;
+    char line[SERVER_MAX_LINE];
+    long long line_number = 0;
+    const char* problem = NULL;
+
+    while (!problem && fgets(line, sizeof(line), in)) {
+        line_number++;
+
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char* tokens[3];
+        int count = 0;
+        for (char* tok = strtok(line, " \t\r\n"); tok && count < 3; tok = strtok(NULL, " \t\r\n")) {
+            tokens[count++] = tok;
+        }
+        if (count == 0) continue;
+        if (count != 2) {
+            problem = "Expected 'setting value' in server config";
+            break;
+        }
+
+        const char* key = tokens[0];
+        char* value = tokens[1];
+        unsigned long long number = 0;
+
+        if (strcmp(key, "endpoint") == 0) {
+            if (!endpoints_given) {
+                parsed.endpoint_count = 0;
+                endpoints_given = true;
+            }
+            if (parsed.endpoint_count == POLYCALL_SERVER_MAX_ENDPOINTS) {
+                problem = "Too many endpoints in server config";
+            } else if (!parse_endpoint(value, &parsed.endpoints[parsed.endpoint_count++])) {
+                problem = "Invalid endpoint in server config";
+            }
+        } else if (strcmp(key, "auth_token") == 0) {
+            if (strlen(value) >= sizeof(parsed.auth_token)) {
+                problem = "auth_token too long in server config";
+            } else {
+                strcpy(parsed.auth_token, value);
+            }
+        } else if (strcmp(key, "io_threads") == 0 &&
+                   parse_number(value, POLYCALL_SERVER_MAX_THREADS, &number)) {
+            parsed.io_threads = (unsigned int)number;
+        } else if (strcmp(key, "workers") == 0 && parse_number(value, 1024, &number)) {
+            parsed.workers = (unsigned int)number;
+        } else if (strcmp(key, "max_connections") == 0 && parse_number(value, SIZE_MAX, &number)) {
+            parsed.max_connections = (size_t)number;
+        } else if (strcmp(key, "max_inflight") == 0 && parse_number(value, SIZE_MAX, &number)) {
+            parsed.max_inflight = (size_t)number;
+        } else if (strcmp(key, "recv_buffer") == 0 && parse_number(value, 1u << 24, &number)) {
+            parsed.recv_buffer_size = (size_t)number;
+        } else if (strcmp(key, "max_frame") == 0 && parse_number(value, 1u << 30, &number)) {
+            parsed.max_frame = (size_t)number;
+        } else if (strcmp(key, "backlog") == 0 && parse_number(value, 65535, &number)) {
+            parsed.backlog = (int)number;
+        } else if (strcmp(key, "idle_timeout_ms") == 0 && parse_number(value, UINT32_MAX, &number)) {
+            parsed.idle_timeout_ms = (uint32_t)number;
+        } else if (strcmp(key, "drain_timeout_ms") == 0 && parse_number(value, UINT32_MAX, &number)) {
+            parsed.drain_timeout_ms = (uint32_t)number;
+        } else {
+            problem = "Unknown setting or bad value in server config";
+        }
+    }
+    fclose(in);
+
+    if (!problem && !config_valid(&parsed)) problem = "Inconsistent server config";
+    if (problem) {
+        polycall_error_set_detail(POLYCALL_ERR_INVALID_PARAMETERS, problem,
+                                  "line %lld", line_number, 0);
+        return POLYCALL_ERROR_INVALID_PARAMETERS;
+    }
+
+    *config = parsed;
+    return POLYCALL_SUCCESS;
+}
+
+// Listening sockets
+
+static int open_listener(const polycall_server_endpoint_t* endpoint, uint16_t port, int backlog) {
+    struct sockaddr_storage address;
+    socklen_t length;
+    memset(&address, 0, sizeof(address));
+
+    struct sockaddr_in* v4 = (struct sockaddr_in*)&address;
+    struct sockaddr_in6* v6 = (struct sockaddr_in6*)&address;
+    if (inet_pton(AF_INET, endpoint->address, &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        length = sizeof(*v4);
+    } else if (inet_pton(AF_INET6, endpoint->address, &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        length = sizeof(*v6);
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0 ||
+        bind(fd, (struct sockaddr*)&address, length) != 0 || listen(fd, backlog) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+// One listener per I/O thread into column endpoint of fds; port 0 is
+// resolved by the first and shared by the rest
+static bool bind_endpoint(polycall_server_t* server, const polycall_server_config_t* config,
+                          size_t endpoint, int* fds, uint16_t* port) {
+    *port = config->endpoints[endpoint].port;
+    for (unsigned int t = 0; t < server->thread_count; t++) {
+        int fd = open_listener(&config->endpoints[endpoint], *port, config->backlog);
+        if (fd < 0) {
+            polycall_error_set_detail(POLYCALL_ERR_INITIALIZATION_FAILED, "Cannot listen on endpoint",
+                                      "endpoint %lld, errno %lld", (long long)endpoint, errno);
+            for (unsigned int u = 0; u < t; u++) {
+                close(fds[u * POLYCALL_SERVER_MAX_ENDPOINTS + endpoint]);
+                fds[u * POLYCALL_SERVER_MAX_ENDPOINTS + endpoint] = -1;
+            }
+            return false;
+        }
+        fds[t * POLYCALL_SERVER_MAX_ENDPOINTS + endpoint] = fd;
+
+        if (*port == 0) {
+            struct sockaddr_storage bound;
+            socklen_t length = sizeof(bound);
+            getsockname(fd, (struct sockaddr*)&bound, &length);
+            *port = ntohs(bound.ss_family == AF_INET6 ? ((struct sockaddr_in6*)&bound)->sin6_port
+                                                      : ((struct sockaddr_in*)&bound)->sin_port);
+        }
+    }
+    return true;
+}
+
+static void close_listeners(const polycall_server_t* server, int* fds, const bool* keep) {
+    for (unsigned int t = 0; t < server->thread_count; t++) {
+        for (size_t e = 0; e < POLYCALL_SERVER_MAX_ENDPOINTS; e++) {
+            int* fd = &fds[t * POLYCALL_SERVER_MAX_ENDPOINTS + e];
+            if (*fd >= 0 && !(keep && keep[e])) close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+static size_t fd_table_size(const polycall_server_t* server) {
+    return (size_t)server->thread_count * POLYCALL_SERVER_MAX_ENDPOINTS;
+}
+
+// Publish the locked state to every I/O thread and wait until each has it
+static void publish(polycall_server_t* server) {
+    // I/O threads poll it unlocked at the top of every loop
+    uint64_t generation = server->generation + 1;
+    __atomic_store_n(&server->generation, generation, __ATOMIC_RELEASE);
+    for (unsigned int t = 0; t < server->thread_count; t++) {
+        uint64_t one = 1;
+        ssize_t ignored = write(server->threads[t].wake.fd, &one, sizeof(one));
+        (void)ignored;
+    }
+    if (!server->started) return;
+    for (unsigned int t = 0; t < server->thread_count; t++) {
+        while (server->threads[t].applied != generation) {
+            pthread_cond_wait(&server->applied_cond, &server->lock);
+        }
+    }
+}
+
+// Connections
+
+static void conn_list_remove(conn_t** head, conn_t* conn) {
+    if (conn->prev) conn->prev->next = conn->next;
+    else *head = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    conn->prev = conn->next = NULL;
+}
+
+static void conn_list_push(conn_t** head, conn_t* conn) {
+    conn->prev = NULL;
+    conn->next = *head;
+    if (*head) (*head)->prev = conn;
+    *head = conn;
+}
+
+static void conn_free(conn_t* conn) {
+    polycall_context_t ctx = conn->io->server->ctx;
+    if (conn->protocol_ready) polycall_protocol_cleanup(&conn->protocol);
+    if (conn->local.loopback) {
+        // Frames never drained still belong to us
+        NetworkPacket frame;
+        while (net_receive_owned(&conn->wire, &frame) > 0) net_packet_free(frame.data);
+        net_close(&conn->local);
+        net_close(&conn->wire);
+    }
+    polycall_mem_free(ctx, conn->in);
+    polycall_mem_free(ctx, conn->out);
+    polycall_mem_free(ctx, conn);
+}
+
+// Close the socket at once; the connection is freed when no worker holds it
+static void conn_close(conn_t* conn) {
+    if (conn->fd < 0) return;
+    io_thread_t* io = conn->io;
+    polycall_server_t* server = io->server;
+
+    // Before the close, so no worker runs a command the peer saw hang up on
+    __atomic_store_n(&conn->closed, true, __ATOMIC_RELAXED);
+    close(conn->fd);                // Also drops it from the epoll set
+    conn->fd = -1;
+    conn_list_remove(&io->open, conn);
+    conn_list_push(&io->closed, conn);
+    io->open_count--;
+    __atomic_sub_fetch(&server->connections, 1, __ATOMIC_RELAXED);
+    polycall_metrics_gauge_add(server->metrics, POLYCALL_METRIC_NET_CLIENTS, -1);
+    polycall_metrics_counter_add(server->metrics, POLYCALL_METRIC_NET_DISCONNECTS, 1);
+}
+
+static bool conn_reserve(conn_t* conn, uint8_t** buffer, size_t* capacity, size_t needed) {
+    if (needed <= *capacity) return true;
+    size_t grown = *capacity ? *capacity : 4096;
+    while (grown < needed) grown *= 2;
+    polycall_context_t ctx = conn->io->server->ctx;
+    uint8_t* resized = polycall_mem_alloc(ctx, grown);
+    if (!resized) return false;
+    if (*buffer) {
+        memcpy(resized, *buffer, *capacity);
+        polycall_mem_free(ctx, *buffer);
+    }
+    *buffer = resized;
+    *capacity = grown;
+    return true;
+}
+
+static void conn_watch(conn_t* conn) {
+    uint32_t events = (conn->reading ? EPOLLIN : 0) |
+                      (conn->out_offset < conn->out_length ? EPOLLOUT : 0);
+    if (conn->fd < 0 || events == conn->events) return;
+    struct epoll_event event = { .events = events, .data.ptr = conn };
+    epoll_ctl(conn->io->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->events = events;
+}
+
+// Too much work or output queued to take more requests
+static bool conn_backlogged(const conn_t* conn) {
+    return conn->pending >= conn->io->config.max_inflight ||
+           conn->out_length - conn->out_offset >= SERVER_OUTPUT_LIMIT;
+}
+
+static void conn_process(conn_t* conn);
+
+static void conn_try_finish(conn_t* conn) {
+    if (conn->finishing && conn->pending == 0 && conn->out_offset == conn->out_length) {
+        conn_close(conn);
+    }
+}
+
+// Move frames the protocol layer produced into the output buffer
+static void conn_collect(conn_t* conn) {
+    NetworkPacket frame;
+    while (net_receive_owned(&conn->wire, &frame) > 0) {
+        size_t needed = conn->out_length + frame.size;
+        if (conn->out_offset > 0 && needed > conn->out_capacity) {
+            memmove(conn->out, conn->out + conn->out_offset, conn->out_length - conn->out_offset);
+            conn->out_length -= conn->out_offset;
+            conn->out_offset = 0;
+            needed = conn->out_length + frame.size;
+        }
+        if (!conn_reserve(conn, &conn->out, &conn->out_capacity, needed)) {
+            net_packet_free(frame.data);
+            conn_close(conn);
+            return;
+        }
+        memcpy(conn->out + conn->out_length, frame.data, frame.size);
+        conn->out_length += frame.size;
+        net_packet_free(frame.data);
+    }
+}
+
+// Write the output buffer; whatever the kernel does not take waits for
+// EPOLLOUT. A connection paused by backpressure runs its buffered frames
+// and resumes reading once it has room again.
+static void conn_flush(conn_t* conn) {
+    for (;;) {
+        while (conn->out_offset < conn->out_length) {
+            ssize_t sent = send(conn->fd, conn->out + conn->out_offset,
+                                conn->out_length - conn->out_offset, MSG_NOSIGNAL);
+            if (sent > 0) {
+                conn->out_offset += (size_t)sent;
+                continue;
+            }
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            conn_close(conn);
+            return;
+        }
+        if (conn->out_offset == conn->out_length) conn->out_offset = conn->out_length = 0;
+        if (conn->reading || conn->finishing || conn_backlogged(conn)) break;
+
+        conn_process(conn);
+        if (conn->fd < 0) return;
+        if (!conn->finishing && !conn_backlogged(conn)) conn->reading = true;
+        if (conn->out_offset == conn->out_length) break;
+    }
+    conn_watch(conn);
+    conn_try_finish(conn);
+}
+
+static void conn_stop_reading(conn_t* conn) {
+    conn->reading = false;
+    conn_watch(conn);
+}
+
+static void conn_send(conn_t* conn, polycall_message_type_t type, const void* payload, size_t length) {
+    if (conn->fd < 0) return;
+    if (!polycall_protocol_send(&conn->protocol, type, payload, length, POLYCALL_FLAG_NONE)) {
+        conn_close(conn);
+        return;
+    }
+    conn_collect(conn);
+}
+
+// Tell the peer why and hang up once that is flushed
+static void conn_fail(conn_t* conn, const char* reason) {
+    conn_send(conn, POLYCALL_MSG_ERROR, reason, strlen(reason));
+    conn->finishing = true;
+    conn_stop_reading(conn);
+}
+
+static void conn_reply(conn_t* conn, bool ok, const void* response, size_t length) {
+    if (length == 0) {
+        response = ok ? "ok" : "error";
+        length = strlen(response);
+    }
+    conn_send(conn, ok ? POLYCALL_MSG_RESPONSE : POLYCALL_MSG_ERROR, response, length);
+}
+
+static void task_run(void* arg) {
+    task_t* task = arg;
+    io_thread_t* io = task->conn->io;
+    polycall_server_t* server = io->server;
+
+    // Nobody will read the reply of a closed connection; skipping its
+    // queued commands is what keeps a forced drain short
+    task->response_length = 0;
+    if (__atomic_load_n(&task->conn->closed, __ATOMIC_RELAXED)) {
+        task->ok = false;
+    } else {
+        task->ok = server->handler(server->user_data, task->request, task->request_length,
+                                   task->response, sizeof(task->response), &task->response_length);
+        if (task->response_length > sizeof(task->response)) task->response_length = sizeof(task->response);
+    }
+
+    // The I/O thread drains the queue on every wake-up, so this only spins
+    // while it is catching up
+    while (!polycall_mpmc_push(io->completions, &task)) sched_yield();
+    if (!__atomic_exchange_n(&io->wake_pending, 1, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+        ssize_t ignored = write(io->wake.fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+// Protocol callbacks, on the connection's I/O thread
+
+static void on_server_handshake(polycall_protocol_context_t* ctx) {
+    conn_t* conn = ctx->user_data;
+    if (ctx->state != POLYCALL_STATE_INIT || !polycall_protocol_start_handshake(ctx) ||
+        !polycall_protocol_complete_handshake(ctx)) {
+        conn_fail(conn, "unexpected handshake");
+        return;
+    }
+    conn_collect(conn);
+}
+
+static bool token_matches(const char* token, const char* credentials, size_t length) {
+    size_t expected = strlen(token);
+    if (expected == 0) return true;
+    if (length != expected) return false;
+    unsigned char difference = 0;
+    for (size_t i = 0; i < length; i++) difference |= (unsigned char)(token[i] ^ credentials[i]);
+    return difference == 0;
+}
+
+static void on_server_auth(polycall_protocol_context_t* ctx, const char* credentials) {
+    conn_t* conn = ctx->user_data;
+    if (ctx->state != POLYCALL_STATE_AUTH) {
+        conn_fail(conn, "unexpected authentication");
+        return;
+    }
+    if (!token_matches(conn->io->config.auth_token, credentials, conn->frame_payload)) {
+        conn_fail(conn, "authentication failed");
+        return;
+    }
+    polycall_protocol_update(ctx);
+    if (ctx->state != POLYCALL_STATE_READY) {
+        conn_fail(conn, "authentication failed");
+        return;
+    }
+    conn_reply(conn, true, NULL, 0);
+}
+
+static void on_server_command(polycall_protocol_context_t* ctx, const char* command, size_t length) {
+    conn_t* conn = ctx->user_data;
+    io_thread_t* io = conn->io;
+    polycall_server_t* server = io->server;
+
+    if (ctx->state != POLYCALL_STATE_READY) {
+        conn_fail(conn, "not authenticated");
+        return;
+    }
+
+    if (!server->workers) {
+        size_t response_length = 0;
+        bool ok = server->handler(server->user_data, command, length,
+                                  io->response, sizeof(io->response), &response_length);
+        if (response_length > sizeof(io->response)) response_length = sizeof(io->response);
+        conn_reply(conn, ok, io->response, response_length);
+        return;
+    }
+
+    task_t* task = malloc(sizeof(task_t) + length);
+    if (!task) {
+        conn_fail(conn, "out of memory");
+        return;
+    }
+    task->conn = conn;
+    task->request_length = length;
+    memcpy(task->request, command, length);
+    if (!polycall_worker_pool_submit_ordered(server->workers, conn->id, task_run, task)) {
+        free(task);
+        conn_fail(conn, "server busy");
+        return;
+    }
+    conn->pending++;
+}
+
+static void on_server_error(polycall_protocol_context_t* ctx, const char* error) {
+    (void)error;
+    conn_close(ctx->user_data);
+}
+
+// Hand complete frames in the input buffer to the protocol layer while the
+// connection may take more work
+static void conn_process(conn_t* conn) {
+    const polycall_server_config_t* config = &conn->io->config;
+    size_t offset = 0;
+
+    while (conn->fd >= 0 && !conn->finishing && !conn_backlogged(conn) &&
+           conn->in_length - offset >= sizeof(polycall_message_header_t)) {
+        polycall_message_header_t header;
+        memcpy(&header, conn->in + offset, sizeof(header));
+        if (header.payload_length > config->max_frame) {
+            conn_close(conn);
+            return;
+        }
+        size_t frame = sizeof(header) + header.payload_length;
+        if (conn->in_length - offset < frame) break;
+
+        conn->frame_payload = header.payload_length;
+        if (!polycall_protocol_process(&conn->protocol, conn->in + offset, frame)) {
+            conn_fail(conn, "malformed frame");
+        }
+        offset += frame;
+    }
+    if (conn->fd < 0) return;
+
+    memmove(conn->in, conn->in + offset, conn->in_length - offset);
+    conn->in_length -= offset;
+    if (conn->reading && conn_backlogged(conn)) conn_stop_reading(conn);
+}
+
+static void conn_read(conn_t* conn) {
+    size_t chunk = conn->io->config.recv_buffer_size;
+    while (conn->fd >= 0 && conn->reading) {
+        if (!conn_reserve(conn, &conn->in, &conn->in_capacity, conn->in_length + chunk)) {
+            conn_close(conn);
+            return;
+        }
+        ssize_t got = recv(conn->fd, conn->in + conn->in_length, chunk, 0);
+        if (got == 0) {
+            conn_close(conn);
+            return;
+        }
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) conn_close(conn);
+            break;
+        }
+        conn->in_length += (size_t)got;
+        conn->last_active_ms = now_ms();
+        conn_process(conn);
+        if ((size_t)got < chunk) break;
+    }
+    if (conn->fd >= 0) conn_flush(conn);
+}
+
+static bool conn_open(io_thread_t* io, int fd) {
+    polycall_server_t* server = io->server;
+    conn_t* conn = polycall_mem_calloc(server->ctx, 1, sizeof(conn_t));
+    if (!conn) {
+        close(fd);
+        return false;
+    }
+    conn->kind = SOURCE_CONN;
+    conn->io = io;
+    conn->fd = -1;
+    conn->id = __atomic_add_fetch(&server->next_conn_id, 1, __ATOMIC_RELAXED);
+
+    polycall_protocol_config_t config = {
+        .callbacks = {
+            .on_handshake = on_server_handshake,
+            .on_auth_request = on_server_auth,
+            .on_command = on_server_command,
+            .on_error = on_server_error
+        },
+        .max_message_size = io->config.max_frame,
+        .user_data = conn,
+        .sm_pool = server->sm_pool
+    };
+    if (!net_loopback_pair(&conn->local, &conn->wire, SERVER_WIRE_CAPACITY) ||
+        !polycall_protocol_init(&conn->protocol, server->ctx, &conn->local, &config)) {
+        close(fd);
+        conn_free(conn);
+        return false;
+    }
+    conn->protocol_ready = true;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    conn->fd = fd;
+    conn->reading = true;
+    conn->events = EPOLLIN;
+    conn->last_active_ms = now_ms();
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = conn };
+    if (epoll_ctl(io->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        close(fd);
+        conn_free(conn);
+        return false;
+    }
+
+    conn_list_push(&io->open, conn);
+    io->open_count++;
+    polycall_metrics_counter_add(server->metrics, POLYCALL_METRIC_NET_ACCEPTS, 1);
+    polycall_metrics_gauge_add(server->metrics, POLYCALL_METRIC_NET_CLIENTS, 1);
+    return true;
+}
+
+// I/O thread
+
+static void io_accept(io_thread_t* io, source_t* listener) {
+    polycall_server_t* server = io->server;
+    while (listener->fd >= 0) {
+        int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;                 // EAGAIN, or out of descriptors until some close
+        }
+        size_t open = __atomic_add_fetch(&server->connections, 1, __ATOMIC_RELAXED);
+        if (open > io->config.max_connections) {
+            __atomic_sub_fetch(&server->connections, 1, __ATOMIC_RELAXED);
+            close(fd);
+            continue;
+        }
+        if (!conn_open(io, fd)) __atomic_sub_fetch(&server->connections, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Answer commands the workers finished, then flush each connection once
+static void io_complete(io_thread_t* io) {
+    conn_t* dirty = NULL;
+    task_t* task;
+
+    while (polycall_mpmc_pop(io->completions, &task)) {
+        conn_t* conn = task->conn;
+        conn->pending--;
+        if (conn->fd >= 0) {
+            conn_reply(conn, task->ok, task->response, task->response_length);
+            if (!conn->dirty) {
+                conn->dirty = true;
+                conn->dirty_next = dirty;
+                dirty = conn;
+            }
+        }
+        free(task);
+    }
+
+    while (dirty) {
+        conn_t* conn = dirty;
+        dirty = conn->dirty_next;
+        conn->dirty = false;
+        if (conn->fd >= 0) conn_flush(conn);
+    }
+}
+
+// Free closed connections no worker still refers to
+static void io_reap(io_thread_t* io) {
+    conn_t* conn = io->closed;
+    while (conn) {
+        conn_t* next = conn->next;
+        if (conn->pending == 0) {
+            conn_list_remove(&io->closed, conn);
+            conn_free(conn);
+        }
+        conn = next;
+    }
+}
+
+// Take over the server's current listeners, limits and drain request
+static void io_apply(io_thread_t* io) {
+    polycall_server_t* server = io->server;
+    int fds[POLYCALL_SERVER_MAX_ENDPOINTS];
+
+    pthread_mutex_lock(&server->lock);
+    uint64_t generation = server->generation;
+    io->config = server->config;
+    memcpy(fds, &server->listen_fds[io->index * POLYCALL_SERVER_MAX_ENDPOINTS], sizeof(fds));
+    bool draining = server->draining;
+    pthread_mutex_unlock(&server->lock);
+
+    // Drop every changed listener before adding, since a kept socket may
+    // have moved to another slot
+    for (size_t e = 0; e < POLYCALL_SERVER_MAX_ENDPOINTS; e++) {
+        if (io->listeners[e].fd != fds[e] && io->listeners[e].fd >= 0) {
+            epoll_ctl(io->epoll_fd, EPOLL_CTL_DEL, io->listeners[e].fd, NULL);
+            io->listeners[e].fd = -1;
+        }
+    }
+    for (size_t e = 0; e < POLYCALL_SERVER_MAX_ENDPOINTS; e++) {
+        if (io->listeners[e].fd != fds[e] && fds[e] >= 0) {
+            struct epoll_event event = { .events = EPOLLIN, .data.ptr = &io->listeners[e] };
+            if (epoll_ctl(io->epoll_fd, EPOLL_CTL_ADD, fds[e], &event) == 0) io->listeners[e].fd = fds[e];
+        }
+    }
+
+    if (draining && !io->draining) {
+        io->draining = true;
+        io->drain_deadline_ms = now_ms() + io->config.drain_timeout_ms;
+        for (conn_t* conn = io->open; conn; ) {
+            conn_t* next = conn->next;
+            conn->finishing = true;
+            conn_stop_reading(conn);
+            conn_try_finish(conn);
+            conn = next;
+        }
+    }
+
+    pthread_mutex_lock(&server->lock);
+    io->applied = generation;
+    pthread_cond_broadcast(&server->applied_cond);
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void io_sweep(io_thread_t* io, uint64_t now) {
+    uint64_t timeout = io->config.idle_timeout_ms;
+    for (conn_t* conn = io->open; conn; ) {
+        conn_t* next = conn->next;
+        if (conn->pending == 0 && now - conn->last_active_ms >= timeout) conn_close(conn);
+        conn = next;
+    }
+}
+
+static void* io_main(void* arg) {
+    io_thread_t* io = arg;
+    polycall_server_t* server = io->server;
+    struct epoll_event events[SERVER_EVENTS];
+
+    for (;;) {
+        if (__atomic_load_n(&server->generation, __ATOMIC_ACQUIRE) != io->applied) io_apply(io);
+
+        uint64_t now = now_ms();
+        int timeout = -1;
+        if (io->draining) {
+            if (!io->open && !io->closed) break;
+            if (now >= io->drain_deadline_ms) {
+                while (io->open) conn_close(io->open);
+            }
+            timeout = SERVER_DRAIN_POLL_MS;
+        } else if (io->config.idle_timeout_ms) {
+            if (now >= io->next_sweep_ms) {
+                io_sweep(io, now);
+                io->next_sweep_ms = now + SERVER_SWEEP_MS;
+            }
+            timeout = SERVER_SWEEP_MS;
+        }
+
+        int count = epoll_wait(io->epoll_fd, events, SERVER_EVENTS, timeout);
+        for (int i = 0; i < count; i++) {
+            source_kind_t* kind = events[i].data.ptr;
+            if (*kind == SOURCE_LISTENER) {
+                io_accept(io, (source_t*)kind);
+            } else if (*kind == SOURCE_WAKE) {
+                uint64_t value;
+                ssize_t ignored = read(io->wake.fd, &value, sizeof(value));
+                (void)ignored;
+                __atomic_store_n(&io->wake_pending, 0, __ATOMIC_SEQ_CST);
+                io_complete(io);
+            } else {
+                conn_t* conn = (conn_t*)kind;
+                if (conn->fd < 0) continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    conn_close(conn);
+                    continue;
+                }
+                if (events[i].events & EPOLLIN) conn_read(conn);
+                if (conn->fd >= 0 && (events[i].events & EPOLLOUT)) conn_flush(conn);
+            }
+        }
+        if (io->closed) io_reap(io);
+    }
+    return NULL;
+}
+
+// Lifecycle
+
+polycall_status_t polycall_server_create(
+    polycall_context_t ctx,
+    const polycall_server_config_t* config,
+    polycall_server_handler_t handler,
+    void* user_data,
+    polycall_server_t** server
+) {
+    if (!ctx || !config || !server || !config_valid(config)) {
+        polycall_error_set(POLYCALL_ERR_INVALID_PARAMETERS, "Invalid parameters");
+        return POLYCALL_ERROR_INVALID_PARAMETERS;
+    }
+
+    polycall_server_t* s = calloc(1, sizeof(polycall_server_t));
+    if (!s) {
+        polycall_error_set(POLYCALL_ERR_OUT_OF_MEMORY, "Memory allocation failed");
+        return POLYCALL_ERROR_OUT_OF_MEMORY;
+    }
+    s->ctx = ctx;
+    s->metrics = polycall_context_metrics(ctx);
+    s->handler = handler ? handler : echo_handler;
+    s->user_data = user_data;
+    s->config = *config;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->applied_cond, NULL);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    s->thread_count = config->io_threads ? config->io_threads : (unsigned int)(cpus > 0 ? cpus : 1);
+    if (s->thread_count > POLYCALL_SERVER_MAX_THREADS) s->thread_count = POLYCALL_SERVER_MAX_THREADS;
+
+    s->threads = calloc(s->thread_count, sizeof(io_thread_t));
+    s->listen_fds = malloc(fd_table_size(s) * sizeof(int));
+    if (!s->threads || !s->listen_fds) goto out_of_memory;
+    for (size_t i = 0; i < fd_table_size(s); i++) s->listen_fds[i] = -1;
+
+    for (unsigned int t = 0; t < s->thread_count; t++) {
+        s->threads[t].epoll_fd = -1;
+        s->threads[t].wake.fd = -1;
+    }
+    for (unsigned int t = 0; t < s->thread_count; t++) {
+        io_thread_t* io = &s->threads[t];
+        io->server = s;
+        io->index = t;
+        io->wake.kind = SOURCE_WAKE;
+        for (size_t e = 0; e < POLYCALL_SERVER_MAX_ENDPOINTS; e++) {
+            io->listeners[e].kind = SOURCE_LISTENER;
+            io->listeners[e].fd = -1;
+        }
+        io->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        io->wake.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        io->completions = polycall_mpmc_create(SERVER_COMPLETIONS, sizeof(task_t*));
+        if (io->epoll_fd < 0 || io->wake.fd < 0 || !io->completions) goto out_of_memory;
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = &io->wake };
+        if (epoll_ctl(io->epoll_fd, EPOLL_CTL_ADD, io->wake.fd, &event) != 0) goto out_of_memory;
+    }
+
+    if (polycall_sm_pool_create(ctx, &polycall_protocol_sm_def, NULL, NULL, &s->sm_pool)
+        != POLYCALL_SM_SUCCESS) {
+        goto out_of_memory;
+    }
+    if (config->workers &&
+        polycall_worker_pool_create(config->workers, &s->workers) != POLYCALL_SUCCESS) {
+        goto out_of_memory;
+    }
+
+    *server = s;
+    return POLYCALL_SUCCESS;
+
+out_of_memory:
+    s->stopped = true;
+    polycall_server_destroy(s);
+    polycall_error_set(POLYCALL_ERR_OUT_OF_MEMORY, "Failed to allocate server resources");
+    return POLYCALL_ERROR_OUT_OF_MEMORY;
+}
+
+polycall_status_t polycall_server_start(polycall_server_t* server) {
+    if (!server || server->started || server->stopped) {
+        polycall_error_set(POLYCALL_ERR_INVALID_PARAMETERS, "Invalid parameters");
+        return POLYCALL_ERROR_INVALID_PARAMETERS;
+    }
+
+    for (size_t e = 0; e < server->config.endpoint_count; e++) {
+        if (!bind_endpoint(server, &server->config, e, server->listen_fds, &server->ports[e])) {
+            close_listeners(server, server->listen_fds, NULL);
+            return POLYCALL_ERROR_INITIALIZATION_FAILED;
+        }
+    }
+
+    pthread_mutex_lock(&server->lock);
+    publish(server);                // Threads apply it as they start
+    pthread_mutex_unlock(&server->lock);
+
+    for (unsigned int t = 0; t < server->thread_count; t++) {
+        io_thread_t* io = &server->threads[t];
+        if (pthread_create(&io->thread, NULL, io_main, io) != 0) {
+            polycall_error_set(POLYCALL_ERR_INITIALIZATION_FAILED, "Failed to start I/O thread");
+            server->started = true;
+            polycall_server_drain(server);
+            return POLYCALL_ERROR_INITIALIZATION_FAILED;
+        }
+        io->thread_started = true;
+    }
+    server->started = true;
+    return POLYCALL_SUCCESS;
+}
+
+polycall_status_t polycall_server_reload(
+    polycall_server_t* server,
+    const polycall_server_config_t* config
+) {
+    if (!server || !config || !server->started || server->stopped || !config_valid(config)) {
+        polycall_error_set(POLYCALL_ERR_INVALID_PARAMETERS, "Invalid parameters");
+        return POLYCALL_ERROR_INVALID_PARAMETERS;
+    }
+
+    int* fds = malloc(fd_table_size(server) * sizeof(int));
+    if (!fds) {
+        polycall_error_set(POLYCALL_ERR_OUT_OF_MEMORY, "Memory allocation failed");
+        return POLYCALL_ERROR_OUT_OF_MEMORY;
+    }
+    for (size_t i = 0; i < fd_table_size(server); i++) fds[i] = -1;
+
+    // Only the reload caller changes endpoints, so they can be read unlocked
+    const polycall_server_config_t* old = &server->config;
+    bool kept[POLYCALL_SERVER_MAX_ENDPOINTS] = { false };
+    bool reused[POLYCALL_SERVER_MAX_ENDPOINTS] = { false };
+    uint16_t ports[POLYCALL_SERVER_MAX_ENDPOINTS] = { 0 };
+
+    for (size_t e = 0; e < config->endpoint_count; e++) {
+        const polycall_server_endpoint_t* endpoint = &config->endpoints[e];
+        size_t match = POLYCALL_SERVER_MAX_ENDPOINTS;
+        for (size_t o = 0; o < old->endpoint_count; o++) {
+            if (!kept[o] && old->endpoints[o].port == endpoint->port &&
+                strcmp(old->endpoints[o].address, endpoint->address) == 0) {
+                match = o;
+                break;
+            }
+        }
+
+        if (match < POLYCALL_SERVER_MAX_ENDPOINTS) {
+            kept[match] = true;
+            reused[e] = true;
+            ports[e] = server->ports[match];
+            for (unsigned int t = 0; t < server->thread_count; t++) {
+                fds[t * POLYCALL_SERVER_MAX_ENDPOINTS + e] =
+                    server->listen_fds[t * POLYCALL_SERVER_MAX_ENDPOINTS + match];
+            }
+        } else if (!bind_endpoint(server, config, e, fds, &ports[e])) {
+            close_listeners(server, fds, reused);
+            free(fds);
+            return POLYCALL_ERROR_INITIALIZATION_FAILED;
+        }
+    }
+
+    pthread_mutex_lock(&server->lock);
+    unsigned int io_threads = server->config.io_threads;
+    unsigned int workers = server->config.workers;
+    server->config = *config;
+    server->config.io_threads = io_threads;
+    server->config.workers = workers;
+
+    int* retired = server->listen_fds;
+    server->listen_fds = fds;
+    for (size_t e = 0; e < POLYCALL_SERVER_MAX_ENDPOINTS; e++) {
+        __atomic_store_n(&server->ports[e], ports[e], __ATOMIC_RELAXED);
+    }
+    publish(server);
+    pthread_mutex_unlock(&server->lock);
+
+    // No thread polls the old sockets any more
+    close_listeners(server, retired, kept);
+    free(retired);
+    return POLYCALL_SUCCESS;
+}
+
+uint16_t polycall_server_port(const polycall_server_t* server, size_t endpoint) {
+    if (!server || endpoint >= POLYCALL_SERVER_MAX_ENDPOINTS) return 0;
+    return __atomic_load_n(&server->ports[endpoint], __ATOMIC_RELAXED);
+}
+
+size_t polycall_server_connections(const polycall_server_t* server) {
+    return server ? __atomic_load_n(&server->connections, __ATOMIC_RELAXED) : 0;
+}
+
+void polycall_server_drain(polycall_server_t* server) {
+    if (!server || server->stopped) return;
+    server->stopped = true;
+    if (!server->started) return;
+
+    int* retired = malloc(fd_table_size(server) * sizeof(int));
+    pthread_mutex_lock(&server->lock);
+    if (retired) memcpy(retired, server->listen_fds, fd_table_size(server) * sizeof(int));
+    for (size_t i = 0; i < fd_table_size(server); i++) server->listen_fds[i] = -1;
+    server->draining = true;
+    for (size_t e = 0; e < POLYCALL_SERVER_MAX_ENDPOINTS; e++) {
+        __atomic_store_n(&server->ports[e], 0, __ATOMIC_RELAXED);
+    }
+    // Threads that never started cannot acknowledge; don't wait for them
+    bool all_started = true;
+    for (unsigned int t = 0; t < server->thread_count; t++) {
+        all_started = all_started && server->threads[t].thread_started;
+    }
+    if (all_started) {
+        publish(server);
+    } else {
+        __atomic_store_n(&server->generation, server->generation + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (retired) {
+        close_listeners(server, retired, NULL);
+        free(retired);
+    }
+    for (unsigned int t = 0; t < server->thread_count; t++) {
+        if (server->threads[t].thread_started) pthread_join(server->threads[t].thread, NULL);
+        server->threads[t].thread_started = false;
+    }
+}
+
+void polycall_server_destroy(polycall_server_t* server) {
+    if (!server) return;
+    polycall_server_drain(server);
+
+    // Workers are idle: every connection waited for its tasks
+    if (server->workers) polycall_worker_pool_destroy(server->workers);
+    if (server->threads) {
+        for (unsigned int t = 0; t < server->thread_count; t++) {
+            io_thread_t* io = &server->threads[t];
+            if (io->epoll_fd >= 0) close(io->epoll_fd);
+            if (io->wake.fd >= 0) close(io->wake.fd);
+            if (io->completions) polycall_mpmc_destroy(io->completions);
+        }
+    }
+    if (server->sm_pool) polycall_sm_pool_destroy(server->sm_pool);
+    if (server->listen_fds) close_listeners(server, server->listen_fds, NULL);
+    pthread_cond_destroy(&server->applied_cond);
+    pthread_mutex_destroy(&server->lock);
+    free(server->listen_fds);
+    free(server->threads);
+    free(server);
+}
@@ -0,0 +1,494 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "polycall_sm_executor.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/* Intrusive multi-producer single-consumer queue (Vyukov). Producers
+ * publish with a single atomic exchange; the consumer never blocks them. */
+typedef struct mpsc_node {
+    _Atomic(struct mpsc_node*) next;
+} mpsc_node_t;
+
+typedef struct {
+    _Atomic(mpsc_node_t*) head;
+    mpsc_node_t* tail;
+    mpsc_node_t stub;
+} mpsc_queue_t;
+
+static void mpsc_init(mpsc_queue_t* q) {
+    atomic_init(&q->stub.next, NULL);
+    atomic_init(&q->head, &q->stub);
+    q->tail = &q->stub;
+}
+
+static void mpsc_push(mpsc_queue_t* q, mpsc_node_t* node) {
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    mpsc_node_t* prev = atomic_exchange_explicit(&q->head, node, memory_order_seq_cst);
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+// Returns NULL when empty or when a producer is between its two steps
+static mpsc_node_t* mpsc_pop(mpsc_queue_t* q) {
+    mpsc_node_t* tail = q->tail;
+    mpsc_node_t* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &q->stub) {
+        if (!next) return NULL;
+        q->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire)) return NULL;
+
+    mpsc_push(q, &q->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+// Consumer-side check, includes pushes that are still being linked
+static bool mpsc_pending(mpsc_queue_t* q) {
+    return atomic_load_explicit(&q->head, memory_order_seq_cst) != q->tail ||
+           atomic_load_explicit(&q->tail->next, memory_order_acquire) != NULL;
+}
+
+typedef enum {
+    SM_EVENT_TRANSITION = 0,
+    SM_EVENT_DETACH
+} sm_event_kind_t;
+
+typedef struct {
+    mpsc_node_t node;               // Must be first
+    sm_event_kind_t kind;
+    unsigned int transition_id;
+    polycall_sm_event_callback_t callback;
+    void* user_data;
+} sm_event_t;
+
+// Async transition result waiting to be committed on the shard. A machine
+// has at most one transition in flight, so each mailbox embeds its own.
+typedef struct {
+    mpsc_node_t node;               // Must be first
+    PolyCall_AsyncToken* token;
+} sm_completion_t;
+
+typedef struct executor_shard executor_shard_t;
+
+struct polycall_sm_mailbox {
+    mpsc_node_t ready_node;         // Must be first; links into the shard ready queue
+    mpsc_queue_t events;
+    mpsc_queue_t completions;
+    sm_completion_t completion;
+    _Atomic bool scheduled;
+    _Atomic unsigned int refs;      // Owner reference plus posters in flight
+    PolyCall_StateMachine* sm;
+    uint64_t machine_id;
+    executor_shard_t* shard;
+    polycall_sm_mailbox_t* prev;    // Executor ownership list
+    polycall_sm_mailbox_t* next;
+};
+
+struct executor_shard {
+    mpsc_queue_t ready;
+    _Atomic bool sleeping;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    unsigned int index;
+    polycall_sm_executor_t* executor;
+};
+
+struct polycall_sm_executor {
+    executor_shard_t* shards;
+    unsigned int shard_count;
+    unsigned int batch_size;
+    bool pin_threads;
+    _Atomic bool stopping;
+    _Atomic unsigned int in_flight;  // Async transitions whose commit hook has not returned
+    pthread_mutex_t drain_lock;     // Held by the hook while it finishes
+    pthread_mutex_t mailboxes_lock;
+    polycall_sm_mailbox_t* mailboxes;
+};
+
+static void shard_wake(executor_shard_t* shard) {
+    if (atomic_exchange_explicit(&shard->sleeping, false, memory_order_seq_cst)) {
+        pthread_mutex_lock(&shard->lock);
+        pthread_cond_signal(&shard->wake);
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+static void schedule_mailbox(polycall_sm_mailbox_t* mailbox) {
+    if (!atomic_exchange_explicit(&mailbox->scheduled, true, memory_order_seq_cst)) {
+        mpsc_push(&mailbox->shard->ready, &mailbox->ready_node);
+        shard_wake(mailbox->shard);
+    }
+}
+
+// Fail events that can no longer run, so every callback fires exactly once
+static void drop_events(polycall_sm_mailbox_t* mailbox) {
+    mpsc_node_t* node;
+    while ((node = mpsc_pop(&mailbox->events)) != NULL) {
+        sm_event_t* event = (sm_event_t*)node;
+        if (event->kind == SM_EVENT_TRANSITION && event->callback) {
+            event->callback(mailbox->sm, event->transition_id,
+                            POLYCALL_SM_ERROR_INVALID_CONTEXT, event->user_data);
+        }
+        free(event);
+    }
+}
+
+static void free_mailbox(polycall_sm_executor_t* executor, polycall_sm_mailbox_t* mailbox) {
+    pthread_mutex_lock(&executor->mailboxes_lock);
+    if (mailbox->prev) mailbox->prev->next = mailbox->next;
+    else executor->mailboxes = mailbox->next;
+    if (mailbox->next) mailbox->next->prev = mailbox->prev;
+    pthread_mutex_unlock(&executor->mailboxes_lock);
+
+    drop_events(mailbox);
+    free(mailbox);
+}
+
+/* Posters touch the mailbox after publishing their event, so a detached
+ * mailbox is only freed once the last in-flight poster lets go of it. */
+static void release_mailbox(polycall_sm_executor_t* executor, polycall_sm_mailbox_t* mailbox) {
+    if (atomic_fetch_sub_explicit(&mailbox->refs, 1, memory_order_acq_rel) == 1) {
+        free_mailbox(executor, mailbox);
+    }
+}
+
+/* An async transition counts as in flight until its commit hook has
+ * returned, since the worker finishing it still touches the mailbox and the
+ * shard; the lock keeps destroy from freeing them under the hook. */
+static void async_finished(polycall_sm_executor_t* executor) {
+    pthread_mutex_lock(&executor->drain_lock);
+    if (atomic_fetch_sub_explicit(&executor->in_flight, 1, memory_order_seq_cst) == 1 &&
+        atomic_load_explicit(&executor->stopping, memory_order_seq_cst)) {
+        // Last one out: let the stopping shards exit
+        for (unsigned int i = 0; i < executor->shard_count; i++) {
+            shard_wake(&executor->shards[i]);
+        }
+    }
+    pthread_mutex_unlock(&executor->drain_lock);
+}
+
+// Run up to one batch of a mailbox's events to completion
+static void run_mailbox(executor_shard_t* shard, polycall_sm_mailbox_t* mailbox) {
+    polycall_sm_executor_t* executor = shard->executor;
+    unsigned int processed = 0;
+    mpsc_node_t* node;
+
+    while ((node = mpsc_pop(&mailbox->completions)) != NULL) {
+        sm_completion_t* completion = (sm_completion_t*)node;
+        polycall_sm_async_commit(mailbox->sm, completion->token);
+    }
+
+    /* Events stay queued while an async transition is in flight */
+    while (processed < executor->batch_size && !polycall_sm_async_pending(mailbox->sm)) {
+        sm_event_t* event = (sm_event_t*)mpsc_pop(&mailbox->events);
+        if (!event) break;
+        processed++;
+
+        if (event->kind == SM_EVENT_DETACH) {
+            free(event);
+            mailbox->sm->async_commit = NULL;
+            mailbox->sm->async_commit_data = NULL;
+            drop_events(mailbox);
+            release_mailbox(executor, mailbox);
+            return;
+        }
+
+        // Counted before it starts: the hook may run before this returns
+        bool async = event->transition_id < mailbox->sm->num_transitions &&
+                     mailbox->sm->transitions[event->transition_id].is_async;
+        if (async) atomic_fetch_add_explicit(&executor->in_flight, 1, memory_order_seq_cst);
+
+        polycall_sm_execute_transition_async(mailbox->sm, event->transition_id,
+                                             event->callback, event->user_data);
+        free(event);
+
+        // Refused before starting, so the hook will never run
+        if (async && !polycall_sm_async_pending(mailbox->sm)) async_finished(executor);
+    }
+
+    bool parked = polycall_sm_async_pending(mailbox->sm);
+    if (!parked && processed == executor->batch_size) {
+        // Still scheduled: go to the back of the ready queue for fairness
+        mpsc_push(&shard->ready, &mailbox->ready_node);
+        return;
+    }
+
+    /* A parked mailbox is rescheduled by its completion */
+    atomic_store_explicit(&mailbox->scheduled, false, memory_order_seq_cst);
+    if (mpsc_pending(&mailbox->completions) ||
+        (!parked && mpsc_pending(&mailbox->events))) {
+        schedule_mailbox(mailbox);
+    }
+}
+
+// Shards outlive a stop request until every async transition is finished
+static bool executor_done(polycall_sm_executor_t* executor) {
+    return atomic_load_explicit(&executor->stopping, memory_order_seq_cst) &&
+           atomic_load_explicit(&executor->in_flight, memory_order_seq_cst) == 0;
+}
+
+static void* shard_main(void* arg) {
+    executor_shard_t* shard = (executor_shard_t*)arg;
+    polycall_sm_executor_t* executor = shard->executor;
+
+#ifdef __linux__
+    if (executor->pin_threads) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(shard->index % CPU_SETSIZE, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+
+    for (;;) {
+        polycall_sm_mailbox_t* mailbox = (polycall_sm_mailbox_t*)mpsc_pop(&shard->ready);
+        if (mailbox) {
+            run_mailbox(shard, mailbox);
+            continue;
+        }
+
+        if (mpsc_pending(&shard->ready)) continue;
+        if (executor_done(executor)) break;
+
+        // Announce sleep, then re-check so a concurrent post is never missed
+        atomic_store_explicit(&shard->sleeping, true, memory_order_seq_cst);
+        if (mpsc_pending(&shard->ready) || executor_done(executor)) {
+            atomic_store_explicit(&shard->sleeping, false, memory_order_relaxed);
+            continue;
+        }
+
+        pthread_mutex_lock(&shard->lock);
+        while (atomic_load_explicit(&shard->sleeping, memory_order_seq_cst)) {
+            pthread_cond_wait(&shard->wake, &shard->lock);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return NULL;
+}
+
+static unsigned int online_cpus(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > 0) return (unsigned int)count;
+#endif
+    return 1;
+}
+
+polycall_sm_status_t polycall_sm_executor_create(
+    const polycall_sm_executor_config_t* config,
+    polycall_sm_executor_t** executor
+) {
+    if (!executor) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    polycall_sm_executor_t* exec = calloc(1, sizeof(polycall_sm_executor_t));
+    if (!exec) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    exec->shard_count = config && config->shard_count ? config->shard_count : online_cpus();
+    exec->batch_size = config && config->batch_size ? config->batch_size
+                                                    : POLYCALL_SM_EXECUTOR_DEFAULT_BATCH;
+    exec->pin_threads = config ? config->pin_threads : false;
+    atomic_init(&exec->stopping, false);
+    atomic_init(&exec->in_flight, 0);
+    pthread_mutex_init(&exec->drain_lock, NULL);
+    pthread_mutex_init(&exec->mailboxes_lock, NULL);
+
+    exec->shards = calloc(exec->shard_count, sizeof(executor_shard_t));
+    if (!exec->shards) {
+        pthread_mutex_destroy(&exec->drain_lock);
+        pthread_mutex_destroy(&exec->mailboxes_lock);
+        free(exec);
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    }
+
+    for (unsigned int i = 0; i < exec->shard_count; i++) {
+        executor_shard_t* shard = &exec->shards[i];
+        mpsc_init(&shard->ready);
+        atomic_init(&shard->sleeping, false);
+        pthread_mutex_init(&shard->lock, NULL);
+        pthread_cond_init(&shard->wake, NULL);
+        shard->index = i;
+        shard->executor = exec;
+
+        if (pthread_create(&shard->thread, NULL, shard_main, shard) != 0) {
+            exec->shard_count = i;
+            polycall_sm_executor_destroy(exec);
+            return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+        }
+    }
+
+    *executor = exec;
+    return POLYCALL_SM_SUCCESS;
+}
+
+void polycall_sm_executor_destroy(polycall_sm_executor_t* executor) {
+    if (!executor) return;
+
+    atomic_store_explicit(&executor->stopping, true, memory_order_seq_cst);
+    for (unsigned int i = 0; i < executor->shard_count; i++) {
+        executor_shard_t* shard = &executor->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        atomic_store_explicit(&shard->sleeping, false, memory_order_seq_cst);
+        pthread_cond_signal(&shard->wake);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    for (unsigned int i = 0; i < executor->shard_count; i++) {
+        executor_shard_t* shard = &executor->shards[i];
+        pthread_join(shard->thread, NULL);
+        pthread_mutex_destroy(&shard->lock);
+        pthread_cond_destroy(&shard->wake);
+    }
+
+    // The last hook may still be returning from async_finished
+    pthread_mutex_lock(&executor->drain_lock);
+    pthread_mutex_unlock(&executor->drain_lock);
+    pthread_mutex_destroy(&executor->drain_lock);
+
+    // Still attached: unhook the machines so they can run on their own again
+    while (executor->mailboxes) {
+        polycall_sm_mailbox_t* mailbox = executor->mailboxes;
+        mailbox->sm->async_commit = NULL;
+        mailbox->sm->async_commit_data = NULL;
+        free_mailbox(executor, mailbox);
+    }
+
+    pthread_mutex_destroy(&executor->mailboxes_lock);
+    free(executor->shards);
+    free(executor);
+}
+
+// Commit hook: route async results back through the owning shard
+static void mailbox_async_commit(PolyCall_StateMachine* sm, PolyCall_AsyncToken* token, void* data) {
+    (void)sm;
+    polycall_sm_mailbox_t* mailbox = (polycall_sm_mailbox_t*)data;
+    sm_completion_t* completion = &mailbox->completion;
+
+    completion->token = token;
+    polycall_sm_executor_t* executor = mailbox->shard->executor;
+    atomic_fetch_add_explicit(&mailbox->refs, 1, memory_order_relaxed);
+    mpsc_push(&mailbox->completions, &completion->node);
+    schedule_mailbox(mailbox);
+    release_mailbox(executor, mailbox);
+    async_finished(executor);
+}
+
+polycall_sm_status_t polycall_sm_executor_attach(
+    polycall_sm_executor_t* executor,
+    PolyCall_StateMachine* sm,
+    uint64_t machine_id,
+    polycall_sm_mailbox_t** mailbox
+) {
+    if (!executor || !mailbox) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    if (!sm || !sm->is_initialized) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    polycall_sm_mailbox_t* mb = calloc(1, sizeof(polycall_sm_mailbox_t));
+    if (!mb) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    mpsc_init(&mb->events);
+    mpsc_init(&mb->completions);
+    atomic_init(&mb->scheduled, false);
+    atomic_init(&mb->refs, 1);
+    mb->sm = sm;
+    mb->machine_id = machine_id;
+    mb->shard = &executor->shards[machine_id % executor->shard_count];
+    sm->async_commit = mailbox_async_commit;
+    sm->async_commit_data = mb;
+
+    pthread_mutex_lock(&executor->mailboxes_lock);
+    mb->next = executor->mailboxes;
+    if (mb->next) mb->next->prev = mb;
+    executor->mailboxes = mb;
+    pthread_mutex_unlock(&executor->mailboxes_lock);
+
+    *mailbox = mb;
+    return POLYCALL_SM_SUCCESS;
+}
+
+static polycall_sm_status_t post(
+    polycall_sm_mailbox_t* mailbox,
+    sm_event_kind_t kind,
+    unsigned int transition_id,
+    polycall_sm_event_callback_t callback,
+    void* user_data
+) {
+    sm_event_t* event = malloc(sizeof(sm_event_t));
+    if (!event) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    event->kind = kind;
+    event->transition_id = transition_id;
+    event->callback = callback;
+    event->user_data = user_data;
+
+    executor_shard_t* shard = mailbox->shard;
+    atomic_fetch_add_explicit(&mailbox->refs, 1, memory_order_relaxed);
+    mpsc_push(&mailbox->events, &event->node);
+    schedule_mailbox(mailbox);
+    release_mailbox(shard->executor, mailbox);
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_executor_detach(polycall_sm_mailbox_t* mailbox) {
+    if (!mailbox) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    return post(mailbox, SM_EVENT_DETACH, 0, NULL, NULL);
+}
+
+polycall_sm_status_t polycall_sm_post_event(
+    polycall_sm_mailbox_t* mailbox,
+    unsigned int transition_id,
+    polycall_sm_event_callback_t callback,
+    void* user_data
+) {
+    if (!mailbox) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    return post(mailbox, SM_EVENT_TRANSITION, transition_id, callback, user_data);
+}
+
+polycall_sm_status_t polycall_sm_post_transition(
+    polycall_sm_mailbox_t* mailbox,
+    const char* transition_name,
+    polycall_sm_event_callback_t callback,
+    void* user_data
+) {
+    if (!mailbox || !transition_name) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    /* Transition tables are fixed once a machine is attached */
+    const PolyCall_StateMachine* sm = mailbox->sm;
+    for (unsigned int i = 0; i < sm->num_transitions; i++) {
+        if (strcmp(sm->transitions[i].name, transition_name) == 0) {
+            return post(mailbox, SM_EVENT_TRANSITION, i, callback, user_data);
+        }
+    }
+
+    return POLYCALL_SM_ERROR_INVALID_TRANSITION;
+}
+
+PolyCall_StateMachine* polycall_sm_mailbox_machine(const polycall_sm_mailbox_t* mailbox) {
+    return mailbox ? mailbox->sm : NULL;
+}
+
+uint64_t polycall_sm_mailbox_id(const polycall_sm_mailbox_t* mailbox) {
+    return mailbox ? mailbox->machine_id : 0;
+}
@@ -0,0 +1,149 @@
+#include "polycall_sm_observer.h"
+#include "polycall_queue.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+/* Subscribers form a singly linked list hanging off the machine. New
+ * observers are pushed at the head with a CAS, so subscribing never
+ * blocks the publisher. Unsubscribing only sets a flag; the publisher
+ * (the sole thread running transitions of the machine) unlinks closed
+ * observers while it walks the list.
+ *
+ * An observer has two owners, the machine's list and the subscriber's
+ * handle, and whichever lets go last frees it: a machine that is reset or
+ * destroyed detaches its observers without invalidating handles that are
+ * still being polled. */
+struct polycall_sm_observer {
+    _Atomic(struct polycall_sm_observer*) next;
+    _Atomic bool closed;
+    _Atomic unsigned int refs;      // Machine list + subscriber handle
+    _Atomic uint64_t dropped;
+    polycall_spsc_t* events;        // Publisher produces, the poller consumes
+};
+
+static _Atomic(polycall_sm_observer_t*)* observer_list(PolyCall_StateMachine* sm) {
+    return (_Atomic(polycall_sm_observer_t*)*)&sm->observers;
+}
+
+polycall_sm_status_t polycall_sm_observe(
+    PolyCall_StateMachine* sm,
+    size_t capacity,
+    polycall_sm_observer_t** observer
+) {
+    if (!observer) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    *observer = NULL;
+    if (!sm || !sm->is_initialized) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    if (capacity == 0) capacity = POLYCALL_SM_OBSERVER_DEFAULT_CAPACITY;
+
+    polycall_sm_observer_t* obs = malloc(sizeof(polycall_sm_observer_t));
+    if (!obs) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    obs->events = polycall_spsc_create(capacity, sizeof(polycall_sm_event_t));
+    if (!obs->events) {
+        free(obs);
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    }
+    atomic_init(&obs->closed, false);
+    atomic_init(&obs->refs, 2);
+    atomic_init(&obs->dropped, 0);
+
+    _Atomic(polycall_sm_observer_t*)* list = observer_list(sm);
+    polycall_sm_observer_t* first = atomic_load_explicit(list, memory_order_relaxed);
+    do {
+        atomic_init(&obs->next, first);
+    } while (!atomic_compare_exchange_weak_explicit(list, &first, obs,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+
+    *observer = obs;
+    return POLYCALL_SM_SUCCESS;
+}
+
+// Drop one owner's reference; the last one frees the ring
+static void observer_release(polycall_sm_observer_t* observer) {
+    if (atomic_fetch_sub_explicit(&observer->refs, 1, memory_order_acq_rel) == 1) {
+        polycall_spsc_destroy(observer->events);
+        free(observer);
+    }
+}
+
+void polycall_sm_unobserve(polycall_sm_observer_t* observer) {
+    if (!observer) return;
+    atomic_store_explicit(&observer->closed, true, memory_order_release);
+    observer_release(observer);
+}
+
+size_t polycall_sm_observer_poll(
+    polycall_sm_observer_t* observer,
+    polycall_sm_event_t* events,
+    size_t max_events
+) {
+    if (!observer || !events) return 0;
+
+    return polycall_spsc_pop_batch(observer->events, events, max_events);
+}
+
+uint64_t polycall_sm_observer_dropped(const polycall_sm_observer_t* observer) {
+    return observer ? atomic_load_explicit(&observer->dropped, memory_order_relaxed) : 0;
+}
+
+void polycall_sm_observers_publish(
+    PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    polycall_sm_status_t status
+) {
+    if (!sm) return;
+
+    const PolyCall_Transition* transition = &sm->transitions[transition_id];
+    polycall_sm_event_t event = {
+        .sequence = ++sm->event_sequence,
+        .timestamp_ns = polycall_monotonic_ns(),
+        .machine_id = sm->machine_id,
+        .transition_id = transition_id,
+        .from_state = transition->from_state,
+        .to_state = transition->to_state,
+        .version = sm->states[transition->to_state].version,
+        .status = status
+    };
+
+    _Atomic(polycall_sm_observer_t*)* link = observer_list(sm);
+    polycall_sm_observer_t* obs = atomic_load_explicit(link, memory_order_acquire);
+
+    while (obs) {
+        polycall_sm_observer_t* next = atomic_load_explicit(&obs->next, memory_order_acquire);
+
+        if (atomic_load_explicit(&obs->closed, memory_order_acquire)) {
+            // Unlink; at the head a concurrent subscribe may win, retry later
+            polycall_sm_observer_t* expected = obs;
+            if (atomic_compare_exchange_strong_explicit(link, &expected, next,
+                                                        memory_order_acq_rel,
+                                                        memory_order_relaxed)) {
+                observer_release(obs);
+            } else {
+                link = &obs->next;
+            }
+            obs = next;
+            continue;
+        }
+
+        if (!polycall_spsc_push(obs->events, &event)) {
+            atomic_fetch_add_explicit(&obs->dropped, 1, memory_order_relaxed);
+        }
+
+        link = &obs->next;
+        obs = next;
+    }
+}
+
+void polycall_sm_observers_clear(PolyCall_StateMachine* sm) {
+    if (!sm) return;
+
+    polycall_sm_observer_t* obs = atomic_exchange_explicit(observer_list(sm), NULL,
+                                                           memory_order_acq_rel);
+    while (obs) {
+        polycall_sm_observer_t* next = atomic_load_explicit(&obs->next, memory_order_relaxed);
+        observer_release(obs);
+        obs = next;
+    }
+}
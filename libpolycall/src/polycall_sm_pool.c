@@ -0,0 +1,314 @@
+#include "polycall_sm_pool.h"
+#include "polycall_memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define POOL_THREAD_SLOTS 4     // Pools cached per thread at once
+
+typedef struct pool_node {
+    PolyCall_StateMachine sm;   // Must be first
+    struct pool_node* next;
+} pool_node_t;
+
+typedef struct pool_slab {
+    struct pool_slab* next;
+    pool_node_t nodes[];
+} pool_slab_t;
+
+struct polycall_sm_pool {
+    uint64_t id;                // Never reused; validates thread caches
+    polycall_context_t ctx;
+    const PolyCall_StateMachineDef* def;
+    PolyCall_StateIntegrityCheck integrity_check;
+    size_t slab_size;
+    size_t thread_cache;
+
+    pthread_mutex_t lock;       // Shared free list and slabs
+    pool_node_t* free_list;
+    pool_node_t* deferred;      // Released with an async transition in flight
+    pool_slab_t* slabs;
+    size_t slab_count;
+    size_t allocated;
+    _Atomic size_t in_use;
+
+    struct polycall_sm_pool* live_next;
+};
+
+/* Per-thread free lists. A slot belongs to one pool at a time; a slot left
+ * behind by a destroyed pool is recognised by its id and dropped. */
+typedef struct {
+    uint64_t pool_id;
+    polycall_sm_pool_t* pool;
+    pool_node_t* head;
+    size_t count;
+} thread_cache_t;
+
+static _Thread_local thread_cache_t thread_caches[POOL_THREAD_SLOTS];
+
+static pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+static polycall_sm_pool_t* live_pools;
+static _Atomic uint64_t next_pool_id = 1;
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t exit_key;
+
+// Caller holds live_lock
+static bool pool_alive(uint64_t id) {
+    for (polycall_sm_pool_t* pool = live_pools; pool; pool = pool->live_next) {
+        if (pool->id == id) return true;
+    }
+    return false;
+}
+
+// Hand a slot's machines back to its pool (if it still exists) and clear it
+static void flush_slot(thread_cache_t* slot) {
+    if (slot->head) {
+        pthread_mutex_lock(&live_lock);
+        if (pool_alive(slot->pool_id)) {
+            polycall_sm_pool_t* pool = slot->pool;
+            pool_node_t* tail = slot->head;
+            while (tail->next) tail = tail->next;
+
+            pthread_mutex_lock(&pool->lock);
+            tail->next = pool->free_list;
+            pool->free_list = slot->head;
+            pthread_mutex_unlock(&pool->lock);
+        }
+        pthread_mutex_unlock(&live_lock);
+    }
+    memset(slot, 0, sizeof(*slot));
+}
+
+static void thread_exit(void* arg) {
+    (void)arg;
+    for (int i = 0; i < POOL_THREAD_SLOTS; i++) {
+        flush_slot(&thread_caches[i]);
+    }
+}
+
+static void exit_key_init(void) {
+    pthread_key_create(&exit_key, thread_exit);
+}
+
+static thread_cache_t* thread_slot(polycall_sm_pool_t* pool) {
+    thread_cache_t* slot = &thread_caches[pool->id % POOL_THREAD_SLOTS];
+    if (slot->pool_id == pool->id) return slot;
+
+    flush_slot(slot);
+    slot->pool_id = pool->id;
+    slot->pool = pool;
+
+    // Make sure cached machines go home when this thread exits
+    pthread_once(&exit_key_once, exit_key_init);
+    pthread_setspecific(exit_key, thread_caches);
+    return slot;
+}
+
+// Caller holds pool->lock
+static bool pool_grow(polycall_sm_pool_t* pool) {
+    pool_slab_t* slab = polycall_mem_calloc(pool->ctx, 1,
+                                            sizeof(pool_slab_t) + pool->slab_size * sizeof(pool_node_t));
+    if (!slab) return false;
+
+    for (size_t i = 0; i < pool->slab_size; i++) {
+        PolyCall_StateMachine* sm = &slab->nodes[i].sm;
+        sm->ctx = pool->ctx;
+        sm->is_initialized = true;
+        sm->integrity_check = pool->integrity_check;
+        sm->pool = pool;
+        sm->layout_dirty = true;    // Forces a full copy of the definition
+        polycall_sm_reset(sm, pool->def);
+
+        slab->nodes[i].next = pool->free_list;
+        pool->free_list = &slab->nodes[i];
+    }
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->slab_count++;
+    pool->allocated += pool->slab_size;
+    return true;
+}
+
+// Recycle deferred machines whose transition has landed; caller holds pool->lock
+static void pool_reclaim(polycall_sm_pool_t* pool) {
+    pool_node_t** link = &pool->deferred;
+    while (*link) {
+        pool_node_t* node = *link;
+        if (polycall_sm_reset(&node->sm, pool->def) != POLYCALL_SM_SUCCESS) {
+            link = &node->next;
+            continue;
+        }
+        *link = node->next;
+        node->next = pool->free_list;
+        pool->free_list = node;
+        atomic_fetch_sub_explicit(&pool->in_use, 1, memory_order_relaxed);
+    }
+}
+
+polycall_sm_status_t polycall_sm_pool_create(
+    polycall_context_t ctx,
+    const PolyCall_StateMachineDef* def,
+    PolyCall_StateIntegrityCheck integrity_check,
+    const polycall_sm_pool_config_t* config,
+    polycall_sm_pool_t** pool
+) {
+    if (!ctx || !pool) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    *pool = NULL;
+
+    if (!def || def->num_states > POLYCALL_MAX_STATES ||
+        def->num_transitions > POLYCALL_MAX_TRANSITIONS ||
+        (def->num_states > 0 && def->initial_state >= def->num_states))
+        return POLYCALL_SM_ERROR_INVALID_STATE;
+
+    polycall_sm_pool_t* p = polycall_mem_calloc(ctx, 1, sizeof(polycall_sm_pool_t));
+    if (!p) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    p->id = atomic_fetch_add(&next_pool_id, 1);
+    p->ctx = ctx;
+    p->def = def;
+    p->integrity_check = integrity_check;
+    p->slab_size = config && config->slab_size ? config->slab_size
+                                               : POLYCALL_SM_POOL_DEFAULT_SLAB;
+    p->thread_cache = config && config->thread_cache ? config->thread_cache
+                                                     : POLYCALL_SM_POOL_DEFAULT_CACHE;
+    pthread_mutex_init(&p->lock, NULL);
+    atomic_init(&p->in_use, 0);
+
+    pthread_mutex_lock(&live_lock);
+    p->live_next = live_pools;
+    live_pools = p;
+    pthread_mutex_unlock(&live_lock);
+
+    *pool = p;
+    return POLYCALL_SM_SUCCESS;
+}
+
+void polycall_sm_pool_destroy(polycall_sm_pool_t* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&live_lock);
+    for (polycall_sm_pool_t** link = &live_pools; *link; link = &(*link)->live_next) {
+        if (*link == pool) {
+            *link = pool->live_next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&live_lock);
+
+    // Other threads' caches still name this pool; its id retires them
+    thread_cache_t* slot = &thread_caches[pool->id % POOL_THREAD_SLOTS];
+    if (slot->pool_id == pool->id) memset(slot, 0, sizeof(*slot));
+
+    while (pool->slabs) {
+        pool_slab_t* next = pool->slabs->next;
+        for (size_t i = 0; i < pool->slab_size; i++) {
+            PolyCall_StateMachine* sm = &pool->slabs->nodes[i].sm;
+            polycall_sm_reset(sm, pool->def);   // Drops instrumentation
+        }
+        polycall_mem_free(pool->ctx, pool->slabs);
+        pool->slabs = next;
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    polycall_mem_free(pool->ctx, pool);
+}
+
+polycall_sm_status_t polycall_sm_pool_acquire(
+    polycall_sm_pool_t* pool,
+    PolyCall_StateMachine** sm
+) {
+    if (!pool || !sm) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    *sm = NULL;
+
+    thread_cache_t* slot = thread_slot(pool);
+    pool_node_t* node = slot->head;
+
+    if (!node) {
+        // Refill half the thread cache in one trip to the shared list
+        pthread_mutex_lock(&pool->lock);
+        if (!pool->free_list) pool_reclaim(pool);
+        if (!pool->free_list && !pool_grow(pool)) {
+            pthread_mutex_unlock(&pool->lock);
+            return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+        }
+        size_t batch = pool->thread_cache / 2 + 1;
+        while (pool->free_list && slot->count < batch) {
+            pool_node_t* taken = pool->free_list;
+            pool->free_list = taken->next;
+            taken->next = slot->head;
+            slot->head = taken;
+            slot->count++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        node = slot->head;
+    }
+
+    slot->head = node->next;
+    slot->count--;
+    node->next = NULL;
+
+    atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed);
+    *sm = &node->sm;
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_pool_release(polycall_sm_pool_t* pool, PolyCall_StateMachine* sm) {
+    if (!pool || !sm || sm->pool != pool) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    pool_node_t* node = (pool_node_t*)sm;
+    polycall_sm_status_t status = polycall_sm_reset(sm, pool->def);
+    if (status == POLYCALL_SM_ERROR_TRANSITION_PENDING) {
+        // Cannot be reset mid-transition; an acquire retries it later
+        pthread_mutex_lock(&pool->lock);
+        node->next = pool->deferred;
+        pool->deferred = node;
+        pthread_mutex_unlock(&pool->lock);
+        return POLYCALL_SM_PENDING;
+    }
+    if (status != POLYCALL_SM_SUCCESS) return status;
+    atomic_fetch_sub_explicit(&pool->in_use, 1, memory_order_relaxed);
+
+    thread_cache_t* slot = thread_slot(pool);
+    node->next = slot->head;
+    slot->head = node;
+    slot->count++;
+
+    if (slot->count <= pool->thread_cache) return POLYCALL_SM_SUCCESS;
+
+    // Overflow: give half back so other threads can reuse them
+    size_t keep = pool->thread_cache / 2;
+    pool_node_t* cut = slot->head;
+    for (size_t i = 1; i < keep; i++) cut = cut->next;
+    pool_node_t* spill = keep ? cut->next : slot->head;
+    if (keep) {
+        cut->next = NULL;
+    } else {
+        slot->head = NULL;
+    }
+
+    pool_node_t* tail = spill;
+    while (tail->next) tail = tail->next;
+
+    pthread_mutex_lock(&pool->lock);
+    tail->next = pool->free_list;
+    pool->free_list = spill;
+    pthread_mutex_unlock(&pool->lock);
+    slot->count = keep;
+    return POLYCALL_SM_SUCCESS;
+}
+
+void polycall_sm_pool_get_stats(polycall_sm_pool_t* pool, polycall_sm_pool_stats_t* stats) {
+    if (!pool || !stats) return;
+
+    pthread_mutex_lock(&pool->lock);
+    stats->allocated = pool->allocated;
+    stats->slabs = pool->slab_count;
+    pthread_mutex_unlock(&pool->lock);
+    stats->in_use = atomic_load_explicit(&pool->in_use, memory_order_relaxed);
+}
+
+const PolyCall_StateMachineDef* polycall_sm_pool_def(const polycall_sm_pool_t* pool) {
+    return pool ? pool->def : NULL;
+}
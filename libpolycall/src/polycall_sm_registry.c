@@ -0,0 +1,411 @@
+#include "polycall_sm_registry.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define REGISTRY_MIN_CAPACITY 16
+#define REGISTRY_MAX_SHARDS 65536
+#define REGISTRY_MIGRATE_STEP 64      // Old slots moved per write operation
+#define REGISTRY_CACHE_LINE 64
+
+// Marks an old-table slot whose entry now lives in the current table
+#define SLOT_MOVED ((PolyCall_StateMachine*)(uintptr_t)1)
+
+/* A slot is empty while key == 0. Once claimed its key never changes for
+ * the life of the table; a NULL value is a tombstone, reused only by the
+ * same key, so readers never see a key change under them. */
+typedef struct {
+    _Atomic uint64_t key;
+    _Atomic(PolyCall_StateMachine*) value;
+} registry_slot_t;
+
+typedef struct registry_table {
+    size_t mask;
+    size_t used;                        // Claimed slots, tombstones included
+    struct registry_table* retired_next;
+    registry_slot_t slots[];
+} registry_table_t;
+
+/* Readers pin a shard by bumping its reader count; retired tables are only
+ * freed by a writer that observes the count at zero after unlinking them. */
+typedef struct {
+    _Alignas(REGISTRY_CACHE_LINE) _Atomic uint64_t readers;
+    _Atomic(registry_table_t*) current;
+    _Atomic(registry_table_t*) old;     // Being migrated into current, or NULL
+    _Atomic size_t live;
+    size_t migrate_cursor;
+    registry_table_t* retired;
+    pthread_mutex_t lock;
+} registry_shard_t;
+
+struct polycall_sm_registry {
+    registry_shard_t* shards;
+    unsigned int shard_mask;
+};
+
+typedef enum {
+    LOOKUP_ABSENT = 0,
+    LOOKUP_FOUND,
+    LOOKUP_MOVED
+} lookup_result_t;
+
+static uint64_t hash_session(uint64_t id) {
+    id ^= id >> 30;
+    id *= 0xbf58476d1ce4e5b9ULL;
+    id ^= id >> 27;
+    id *= 0x94d049bb133111ebULL;
+    id ^= id >> 31;
+    return id;
+}
+
+static size_t next_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+static registry_table_t* table_create(size_t capacity) {
+    registry_table_t* table = calloc(1, sizeof(registry_table_t) +
+                                        capacity * sizeof(registry_slot_t));
+    if (!table) return NULL;
+    table->mask = capacity - 1;
+    return table;
+}
+
+static lookup_result_t table_find(registry_table_t* table, uint64_t key, uint64_t hash,
+                                  PolyCall_StateMachine** value) {
+    size_t i = hash & table->mask;
+    for (size_t probes = 0; probes <= table->mask; probes++) {
+        uint64_t k = atomic_load_explicit(&table->slots[i].key, memory_order_acquire);
+        if (k == 0) return LOOKUP_ABSENT;
+        if (k == key) {
+            PolyCall_StateMachine* v =
+                atomic_load_explicit(&table->slots[i].value, memory_order_acquire);
+            if (v == SLOT_MOVED) return LOOKUP_MOVED;
+            if (!v) return LOOKUP_ABSENT;
+            *value = v;
+            return LOOKUP_FOUND;
+        }
+        i = (i + 1) & table->mask;
+    }
+    return LOOKUP_ABSENT;
+}
+
+// Writer only: slot holding key (live or tombstone), or NULL
+static registry_slot_t* table_slot(registry_table_t* table, uint64_t key, uint64_t hash) {
+    size_t i = hash & table->mask;
+    for (size_t probes = 0; probes <= table->mask; probes++) {
+        uint64_t k = atomic_load_explicit(&table->slots[i].key, memory_order_relaxed);
+        if (k == 0) return NULL;
+        if (k == key) return &table->slots[i];
+        i = (i + 1) & table->mask;
+    }
+    return NULL;
+}
+
+// Writer only: caller guarantees key is not live in table and a slot is free
+static void table_put(registry_table_t* table, uint64_t key, uint64_t hash,
+                      PolyCall_StateMachine* value) {
+    size_t i = hash & table->mask;
+    for (;;) {
+        registry_slot_t* slot = &table->slots[i];
+        uint64_t k = atomic_load_explicit(&slot->key, memory_order_relaxed);
+        if (k == key) break;
+        if (k == 0) {
+            atomic_store_explicit(&slot->key, key, memory_order_release);
+            table->used++;
+            break;
+        }
+        i = (i + 1) & table->mask;
+    }
+    atomic_store_explicit(&table->slots[i].value, value, memory_order_release);
+}
+
+static void shard_reclaim(registry_shard_t* shard) {
+    if (!shard->retired) return;
+    if (atomic_load_explicit(&shard->readers, memory_order_seq_cst) != 0) return;
+
+    while (shard->retired) {
+        registry_table_t* next = shard->retired->retired_next;
+        free(shard->retired);
+        shard->retired = next;
+    }
+}
+
+// Move up to budget old slots into the current table
+static void shard_migrate(registry_shard_t* shard, size_t budget) {
+    registry_table_t* old = atomic_load_explicit(&shard->old, memory_order_relaxed);
+    if (!old) {
+        shard_reclaim(shard);
+        return;
+    }
+    registry_table_t* current = atomic_load_explicit(&shard->current, memory_order_relaxed);
+
+    while (budget-- > 0 && shard->migrate_cursor <= old->mask) {
+        registry_slot_t* slot = &old->slots[shard->migrate_cursor++];
+        uint64_t key = atomic_load_explicit(&slot->key, memory_order_relaxed);
+        PolyCall_StateMachine* value =
+            atomic_load_explicit(&slot->value, memory_order_relaxed);
+        if (key == 0 || !value || value == SLOT_MOVED) continue;
+
+        // Publish the copy before readers of the old slot are redirected
+        table_put(current, key, hash_session(key), value);
+        atomic_store_explicit(&slot->value, SLOT_MOVED, memory_order_release);
+    }
+
+    if (shard->migrate_cursor > old->mask) {
+        atomic_store_explicit(&shard->old, NULL, memory_order_seq_cst);
+        old->retired_next = shard->retired;
+        shard->retired = old;
+        shard->migrate_cursor = 0;
+    }
+    shard_reclaim(shard);
+}
+
+// Make room for one more claimed slot in the current table
+static bool shard_reserve(registry_shard_t* shard) {
+    registry_table_t* current = atomic_load_explicit(&shard->current, memory_order_relaxed);
+    size_t capacity = current->mask + 1;
+    if ((current->used + 1) * 4 <= capacity * 3) return true;
+
+    // Finish any earlier resize first so at most two tables are live
+    shard_migrate(shard, SIZE_MAX);
+
+    size_t live = atomic_load_explicit(&shard->live, memory_order_relaxed);
+    size_t new_capacity = (live + 1) * 2 > capacity ? capacity * 2 : capacity;
+    registry_table_t* table = table_create(new_capacity);
+    if (!table) return current->used < capacity;
+
+    atomic_store_explicit(&shard->old, current, memory_order_seq_cst);
+    atomic_store_explicit(&shard->current, table, memory_order_seq_cst);
+    shard->migrate_cursor = 0;
+    return true;
+}
+
+static registry_shard_t* shard_for(polycall_sm_registry_t* registry, uint64_t hash) {
+    return &registry->shards[(hash >> 48) & registry->shard_mask];
+}
+
+polycall_sm_status_t polycall_sm_registry_create(
+    unsigned int shard_count,
+    size_t initial_capacity,
+    polycall_sm_registry_t** registry
+) {
+    if (!registry) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    *registry = NULL;
+
+    if (shard_count == 0) shard_count = POLYCALL_SM_REGISTRY_DEFAULT_SHARDS;
+    if (shard_count > REGISTRY_MAX_SHARDS) shard_count = REGISTRY_MAX_SHARDS;
+    shard_count = (unsigned int)next_pow2(shard_count);
+
+    size_t per_shard = next_pow2((initial_capacity / shard_count) * 4 / 3 + 1);
+    if (per_shard < REGISTRY_MIN_CAPACITY) per_shard = REGISTRY_MIN_CAPACITY;
+
+    polycall_sm_registry_t* reg = calloc(1, sizeof(polycall_sm_registry_t));
+    if (!reg) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    reg->shards = aligned_alloc(REGISTRY_CACHE_LINE, shard_count * sizeof(registry_shard_t));
+    if (!reg->shards) {
+        free(reg);
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    }
+    memset(reg->shards, 0, shard_count * sizeof(registry_shard_t));
+    reg->shard_mask = shard_count - 1;
+
+    for (unsigned int i = 0; i < shard_count; i++) {
+        registry_shard_t* shard = &reg->shards[i];
+        registry_table_t* table = table_create(per_shard);
+        if (!table) {
+            for (unsigned int j = 0; j < i; j++) {
+                free(atomic_load(&reg->shards[j].current));
+                pthread_mutex_destroy(&reg->shards[j].lock);
+            }
+            free(reg->shards);
+            free(reg);
+            return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+        }
+        atomic_init(&shard->current, table);
+        atomic_init(&shard->old, NULL);
+        atomic_init(&shard->readers, 0);
+        atomic_init(&shard->live, 0);
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+
+    *registry = reg;
+    return POLYCALL_SM_SUCCESS;
+}
+
+void polycall_sm_registry_destroy(polycall_sm_registry_t* registry) {
+    if (!registry) return;
+
+    for (unsigned int i = 0; i <= registry->shard_mask; i++) {
+        registry_shard_t* shard = &registry->shards[i];
+        free(atomic_load(&shard->current));
+        free(atomic_load(&shard->old));
+        while (shard->retired) {
+            registry_table_t* next = shard->retired->retired_next;
+            free(shard->retired);
+            shard->retired = next;
+        }
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(registry->shards);
+    free(registry);
+}
+
+polycall_sm_status_t polycall_sm_registry_insert(
+    polycall_sm_registry_t* registry,
+    uint64_t session_id,
+    PolyCall_StateMachine* sm
+) {
+    if (!registry || !sm || session_id == 0) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    uint64_t hash = hash_session(session_id);
+    registry_shard_t* shard = shard_for(registry, hash);
+    polycall_sm_status_t status = POLYCALL_SM_SUCCESS;
+
+    pthread_mutex_lock(&shard->lock);
+    shard_migrate(shard, REGISTRY_MIGRATE_STEP);
+
+    PolyCall_StateMachine* existing;
+    registry_table_t* old = atomic_load_explicit(&shard->old, memory_order_relaxed);
+    registry_table_t* current = atomic_load_explicit(&shard->current, memory_order_relaxed);
+    if ((old && table_find(old, session_id, hash, &existing) == LOOKUP_FOUND) ||
+        table_find(current, session_id, hash, &existing) == LOOKUP_FOUND) {
+        status = POLYCALL_SM_ERROR_ALREADY_EXISTS;
+    } else if (!table_slot(current, session_id, hash) && !shard_reserve(shard)) {
+        status = POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    } else {
+        current = atomic_load_explicit(&shard->current, memory_order_relaxed);
+        table_put(current, session_id, hash, sm);
+        atomic_fetch_add_explicit(&shard->live, 1, memory_order_relaxed);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+PolyCall_StateMachine* polycall_sm_registry_lookup(
+    polycall_sm_registry_t* registry,
+    uint64_t session_id
+) {
+    if (!registry || session_id == 0) return NULL;
+
+    uint64_t hash = hash_session(session_id);
+    registry_shard_t* shard = shard_for(registry, hash);
+    PolyCall_StateMachine* value = NULL;
+
+    atomic_fetch_add_explicit(&shard->readers, 1, memory_order_seq_cst);
+    for (;;) {
+        registry_table_t* current = atomic_load_explicit(&shard->current, memory_order_seq_cst);
+        registry_table_t* old = atomic_load_explicit(&shard->old, memory_order_seq_cst);
+
+        // Old first: a migrated entry is copied before its old slot is marked
+        if (old && table_find(old, session_id, hash, &value) == LOOKUP_FOUND) break;
+        if (table_find(current, session_id, hash, &value) == LOOKUP_FOUND) break;
+
+        // A resize that started after we loaded the tables may have moved it
+        value = NULL;
+        if (atomic_load_explicit(&shard->current, memory_order_seq_cst) == current) break;
+    }
+    atomic_fetch_sub_explicit(&shard->readers, 1, memory_order_release);
+
+    return value;
+}
+
+polycall_sm_status_t polycall_sm_registry_remove(
+    polycall_sm_registry_t* registry,
+    uint64_t session_id,
+    PolyCall_StateMachine** removed
+) {
+    if (removed) *removed = NULL;
+    if (!registry || session_id == 0) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    uint64_t hash = hash_session(session_id);
+    registry_shard_t* shard = shard_for(registry, hash);
+    polycall_sm_status_t status = POLYCALL_SM_ERROR_NOT_FOUND;
+
+    pthread_mutex_lock(&shard->lock);
+    shard_migrate(shard, REGISTRY_MIGRATE_STEP);
+
+    registry_table_t* tables[2] = {
+        atomic_load_explicit(&shard->old, memory_order_relaxed),
+        atomic_load_explicit(&shard->current, memory_order_relaxed)
+    };
+    for (int t = 0; t < 2 && status != POLYCALL_SM_SUCCESS; t++) {
+        if (!tables[t]) continue;
+        registry_slot_t* slot = table_slot(tables[t], session_id, hash);
+        if (!slot) continue;
+
+        PolyCall_StateMachine* value =
+            atomic_load_explicit(&slot->value, memory_order_relaxed);
+        if (!value || value == SLOT_MOVED) continue;
+
+        atomic_store_explicit(&slot->value, NULL, memory_order_release);
+        atomic_fetch_sub_explicit(&shard->live, 1, memory_order_relaxed);
+        if (removed) *removed = value;
+        status = POLYCALL_SM_SUCCESS;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+size_t polycall_sm_registry_count(polycall_sm_registry_t* registry) {
+    if (!registry) return 0;
+
+    size_t count = 0;
+    for (unsigned int i = 0; i <= registry->shard_mask; i++) {
+        count += atomic_load_explicit(&registry->shards[i].live, memory_order_relaxed);
+    }
+    return count;
+}
+
+size_t polycall_sm_registry_foreach(
+    polycall_sm_registry_t* registry,
+    polycall_sm_registry_visitor_t visitor,
+    void* user_data
+) {
+    if (!registry || !visitor) return 0;
+
+    size_t visited = 0;
+    bool stop = false;
+
+    for (unsigned int i = 0; i <= registry->shard_mask && !stop; i++) {
+        registry_shard_t* shard = &registry->shards[i];
+        pthread_mutex_lock(&shard->lock);
+
+        registry_table_t* tables[2] = {
+            atomic_load_explicit(&shard->old, memory_order_relaxed),
+            atomic_load_explicit(&shard->current, memory_order_relaxed)
+        };
+        for (int t = 0; t < 2 && !stop; t++) {
+            if (!tables[t]) continue;
+            for (size_t s = 0; s <= tables[t]->mask && !stop; s++) {
+                registry_slot_t* slot = &tables[t]->slots[s];
+                uint64_t key = atomic_load_explicit(&slot->key, memory_order_relaxed);
+                PolyCall_StateMachine* value =
+                    atomic_load_explicit(&slot->value, memory_order_relaxed);
+                if (key == 0 || !value || value == SLOT_MOVED) continue;
+
+                visited++;
+                switch (visitor(key, value, user_data)) {
+                    case POLYCALL_SM_REGISTRY_STOP:
+                        stop = true;
+                        break;
+                    case POLYCALL_SM_REGISTRY_REMOVE:
+                        atomic_store_explicit(&slot->value, NULL, memory_order_release);
+                        atomic_fetch_sub_explicit(&shard->live, 1, memory_order_relaxed);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return visited;
+}
@@ -0,0 +1,374 @@
+#include "polycall_sm_shm.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SHM_MAGIC "PCSHM001"
+#define SHM_NAME_WORDS (POLYCALL_SM_SHM_NAME_LENGTH / sizeof(uint64_t))
+#define SHM_READ_SPINS 1024
+
+/* Region layout shared with other processes. Every field of a slot is
+ * accessed with atomic builtins so concurrent readers are well defined. */
+typedef struct {
+    uint64_t magic;             // SHM_MAGIC, stored last by the creator
+    uint32_t slot_count;
+    uint32_t slot_size;
+} shm_header_t;
+
+struct polycall_sm_shm_slot {
+    uint64_t sequence;          // Odd while the owner is writing
+    uint64_t claimed;           // Nonzero while owned (writer process only)
+    uint64_t machine_id;
+    uint64_t transition_count;
+    uint64_t failed_transitions;
+    uint64_t integrity_violations;
+    uint64_t updated;
+    uint32_t current_state;
+    uint32_t version;
+    uint32_t num_states;
+    uint32_t in_use;
+    uint64_t state_name[SHM_NAME_WORDS];
+} __attribute__((aligned(64)));
+
+typedef struct polycall_sm_shm_slot shm_slot_t;
+
+struct polycall_sm_shm {
+    char name[256];
+    void* base;
+    size_t size;
+    shm_slot_t* slots;
+    unsigned int slot_count;
+    bool owner;
+};
+
+static uint64_t shm_magic(void) {
+    uint64_t word;
+    memcpy(&word, SHM_MAGIC, sizeof(word));
+    return word;
+}
+
+static size_t region_size(unsigned int slot_count) {
+    return sizeof(shm_slot_t) + (size_t)slot_count * sizeof(shm_slot_t);
+}
+
+// The header gets a slot-sized cell so slots stay cache-line aligned
+static shm_slot_t* region_slots(void* base) {
+    return (shm_slot_t*)((uint8_t*)base + sizeof(shm_slot_t));
+}
+
+static polycall_sm_shm_t* shm_wrap(const char* name, void* base, size_t size,
+                                   unsigned int slot_count, bool owner) {
+    polycall_sm_shm_t* shm = calloc(1, sizeof(polycall_sm_shm_t));
+    if (!shm) return NULL;
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+    shm->base = base;
+    shm->size = size;
+    shm->slots = region_slots(base);
+    shm->slot_count = slot_count;
+    shm->owner = owner;
+    return shm;
+}
+
+polycall_sm_status_t polycall_sm_shm_create(
+    const char* name,
+    unsigned int slot_count,
+    polycall_sm_shm_t** shm
+) {
+    if (!name || !shm || slot_count == 0) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    *shm = NULL;
+
+    // Never take over a name: it may belong to a live publisher
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return errno == EEXIST ? POLYCALL_SM_ERROR_ALREADY_EXISTS : POLYCALL_SM_ERROR_IO;
+
+    size_t size = region_size(slot_count);
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        return POLYCALL_SM_ERROR_IO;
+    }
+
+    // Fresh pages are zero: every slot starts free with an even sequence
+    shm_header_t* header = (shm_header_t*)base;
+    header->slot_count = slot_count;
+    header->slot_size = sizeof(shm_slot_t);
+    __atomic_store_n(&header->magic, shm_magic(), __ATOMIC_RELEASE);
+
+    *shm = shm_wrap(name, base, size, slot_count, true);
+    if (!*shm) {
+        munmap(base, size);
+        shm_unlink(name);
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    }
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_shm_open(const char* name, polycall_sm_shm_t** shm) {
+    if (!name || !shm) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    *shm = NULL;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return POLYCALL_SM_ERROR_NOT_FOUND;
+
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(shm_slot_t)) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) return POLYCALL_SM_ERROR_IO;
+
+    const shm_header_t* header = (const shm_header_t*)base;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != shm_magic() ||
+        header->slot_size != sizeof(shm_slot_t) ||
+        region_size(header->slot_count) > (size_t)st.st_size) {
+        munmap(base, (size_t)st.st_size);
+        return POLYCALL_SM_ERROR_VERSION_MISMATCH;
+    }
+
+    *shm = shm_wrap(name, base, (size_t)st.st_size, header->slot_count, false);
+    if (!*shm) {
+        munmap(base, (size_t)st.st_size);
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    }
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_shm_close(polycall_sm_shm_t* shm) {
+    if (!shm) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    // A claimed slot is a machine still holding a pointer into the mapping
+    if (shm->owner) {
+        for (unsigned int i = 0; i < shm->slot_count; i++) {
+            if (__atomic_load_n(&shm->slots[i].claimed, __ATOMIC_ACQUIRE)) {
+                return POLYCALL_SM_ERROR_STATE_LOCKED;
+            }
+        }
+    }
+
+    munmap(shm->base, shm->size);
+    if (shm->owner) shm_unlink(shm->name);
+    free(shm);
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_shm_unlink(const char* name) {
+    if (!name) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    if (shm_unlink(name) == 0) return POLYCALL_SM_SUCCESS;
+    return errno == ENOENT ? POLYCALL_SM_ERROR_NOT_FOUND : POLYCALL_SM_ERROR_IO;
+}
+
+unsigned int polycall_sm_shm_capacity(const polycall_sm_shm_t* shm) {
+    return shm ? shm->slot_count : 0;
+}
+
+polycall_sm_status_t polycall_sm_shm_read(
+    const polycall_sm_shm_t* shm,
+    unsigned int index,
+    polycall_sm_shm_entry_t* entry
+) {
+    if (!shm || !entry) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    if (index >= shm->slot_count) return POLYCALL_SM_ERROR_INVALID_STATE;
+
+    shm_slot_t* slot = &shm->slots[index];
+    uint64_t name[SHM_NAME_WORDS];
+
+    for (unsigned int spin = 0; spin < SHM_READ_SPINS; spin++) {
+        uint64_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+
+        uint32_t in_use = __atomic_load_n(&slot->in_use, __ATOMIC_ACQUIRE);
+        entry->machine_id = __atomic_load_n(&slot->machine_id, __ATOMIC_ACQUIRE);
+        entry->transition_count = __atomic_load_n(&slot->transition_count, __ATOMIC_ACQUIRE);
+        entry->failed_transitions = __atomic_load_n(&slot->failed_transitions, __ATOMIC_ACQUIRE);
+        entry->integrity_violations =
+            __atomic_load_n(&slot->integrity_violations, __ATOMIC_ACQUIRE);
+        entry->updated = __atomic_load_n(&slot->updated, __ATOMIC_ACQUIRE);
+        entry->current_state = __atomic_load_n(&slot->current_state, __ATOMIC_ACQUIRE);
+        entry->version = __atomic_load_n(&slot->version, __ATOMIC_ACQUIRE);
+        entry->num_states = __atomic_load_n(&slot->num_states, __ATOMIC_ACQUIRE);
+        for (size_t i = 0; i < SHM_NAME_WORDS; i++) {
+            name[i] = __atomic_load_n(&slot->state_name[i], __ATOMIC_ACQUIRE);
+        }
+
+        // The acquire loads above keep this check after every field read
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != before) continue;
+
+        if (!in_use) return POLYCALL_SM_ERROR_NOT_FOUND;
+        memcpy(entry->state_name, name, sizeof(entry->state_name));
+        entry->state_name[POLYCALL_SM_SHM_NAME_LENGTH - 1] = '\0';
+        return POLYCALL_SM_SUCCESS;
+    }
+
+    return POLYCALL_SM_ERROR_STATE_LOCKED;
+}
+
+// How a slot write changes the commit counter
+typedef enum {
+    SLOT_COUNT_KEEP = 0,
+    SLOT_COUNT_ADD,             // A transition committed
+    SLOT_COUNT_RESET            // A new machine took the slot
+} slot_count_t;
+
+// Owner-side seqlock write; the owner is the only writer of a claimed slot
+static void slot_write(shm_slot_t* slot, const PolyCall_StateMachine* sm,
+                       bool in_use, slot_count_t count) {
+    uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+
+    // Release stores: none of them can become visible before the odd
+    // sequence, so a reader that saw their value also sees it changed
+    __atomic_store_n(&slot->in_use, in_use ? 1u : 0u, __ATOMIC_RELEASE);
+    if (in_use) {
+        const PolyCall_State* state = sm->current_state < sm->num_states ?
+                                      &sm->states[sm->current_state] : NULL;
+        uint64_t name[SHM_NAME_WORDS] = {0};
+        if (state) {
+            strncpy((char*)name, state->name, POLYCALL_SM_SHM_NAME_LENGTH - 1);
+        }
+
+        __atomic_store_n(&slot->machine_id, sm->machine_id, __ATOMIC_RELEASE);
+        if (count != SLOT_COUNT_KEEP) {
+            uint64_t transitions = count == SLOT_COUNT_RESET ? 0 :
+                __atomic_load_n(&slot->transition_count, __ATOMIC_RELAXED) + 1;
+            __atomic_store_n(&slot->transition_count, transitions, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&slot->failed_transitions,
+                         (uint64_t)sm->diagnostics.failed_transitions, __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->integrity_violations,
+                         (uint64_t)sm->diagnostics.integrity_violations, __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->updated, state ? state->timestamp : 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->current_state, sm->current_state, __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->version, state ? state->version : 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->num_states, sm->num_states, __ATOMIC_RELEASE);
+        for (size_t i = 0; i < SHM_NAME_WORDS; i++) {
+            __atomic_store_n(&slot->state_name[i], name[i], __ATOMIC_RELEASE);
+        }
+    }
+
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+polycall_sm_status_t polycall_sm_attach_shm(
+    PolyCall_StateMachine* sm,
+    polycall_sm_shm_t* shm,
+    uint64_t machine_id
+) {
+    if (!sm || !sm->is_initialized) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    if (!shm || !shm->owner) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    polycall_sm_detach_shm(sm);
+
+    for (unsigned int i = 0; i < shm->slot_count; i++) {
+        shm_slot_t* slot = &shm->slots[i];
+        uint64_t expected = 0;
+        if (!__atomic_compare_exchange_n(&slot->claimed, &expected, 1, false,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        sm->machine_id = machine_id;
+        sm->shm_slot = slot;
+        slot_write(slot, sm, true, SLOT_COUNT_RESET);
+        return POLYCALL_SM_SUCCESS;
+    }
+
+    return POLYCALL_SM_ERROR_MAX_STATES_REACHED;
+}
+
+void polycall_sm_detach_shm(PolyCall_StateMachine* sm) {
+    if (!sm || !sm->shm_slot) return;
+
+    shm_slot_t* slot = sm->shm_slot;
+    sm->shm_slot = NULL;
+    slot_write(slot, sm, false, SLOT_COUNT_KEEP);
+    __atomic_store_n(&slot->claimed, 0, __ATOMIC_RELEASE);
+}
+
+void polycall_sm_shm_publish(PolyCall_StateMachine* sm, bool committed) {
+    if (sm && sm->shm_slot) {
+        slot_write(sm->shm_slot, sm, true, committed ? SLOT_COUNT_ADD : SLOT_COUNT_KEEP);
+    }
+}
+
+#else
+
+/* No POSIX shared memory: regions cannot be created or opened, so no
+ * machine ever holds a slot and the commit-path hooks are no-ops. */
+
+polycall_sm_status_t polycall_sm_shm_create(
+    const char* name,
+    unsigned int slot_count,
+    polycall_sm_shm_t** shm
+) {
+    (void)name;
+    (void)slot_count;
+    if (shm) *shm = NULL;
+    return POLYCALL_SM_ERROR_IO;
+}
+
+polycall_sm_status_t polycall_sm_shm_open(const char* name, polycall_sm_shm_t** shm) {
+    (void)name;
+    if (shm) *shm = NULL;
+    return POLYCALL_SM_ERROR_IO;
+}
+
+polycall_sm_status_t polycall_sm_shm_close(polycall_sm_shm_t* shm) {
+    (void)shm;
+    return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+}
+
+polycall_sm_status_t polycall_sm_shm_unlink(const char* name) {
+    (void)name;
+    return POLYCALL_SM_ERROR_IO;
+}
+
+unsigned int polycall_sm_shm_capacity(const polycall_sm_shm_t* shm) {
+    (void)shm;
+    return 0;
+}
+
+polycall_sm_status_t polycall_sm_shm_read(
+    const polycall_sm_shm_t* shm,
+    unsigned int index,
+    polycall_sm_shm_entry_t* entry
+) {
+    (void)shm;
+    (void)index;
+    (void)entry;
+    return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+}
+
+polycall_sm_status_t polycall_sm_attach_shm(
+    PolyCall_StateMachine* sm,
+    polycall_sm_shm_t* shm,
+    uint64_t machine_id
+) {
+    (void)sm;
+    (void)shm;
+    (void)machine_id;
+    return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+}
+
+void polycall_sm_detach_shm(PolyCall_StateMachine* sm) {
+    (void)sm;
+}
+
+void polycall_sm_shm_publish(PolyCall_StateMachine* sm, bool committed) {
+    (void)sm;
+    (void)committed;
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include "polycall_sm_snapshot.h"
+#include <string.h>
+
+#define SNAPSHOT_MAGIC 0x53444350u     // "PCDS"
+#define SNAPSHOT_FORMAT 1
+#define SNAPSHOT_FLAG_BASE 0x0001
+
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t flags;
+    uint64_t machine_id;
+    uint64_t base_epoch;
+    uint64_t epoch;
+    uint32_t current_state;
+    uint32_t num_states;
+    uint32_t failed_transitions;
+    uint32_t integrity_violations;
+    uint32_t state_mask;        // Bit i set: a record for state i follows
+    uint32_t reserved;
+} snapshot_header_t;
+
+typedef struct {
+    uint64_t timestamp;
+    uint32_t version;
+    uint32_t transition_count;
+    uint32_t integrity_check_count;
+    uint32_t is_locked;
+} snapshot_state_t;
+
+_Static_assert(sizeof(snapshot_header_t) == 56, "snapshot header layout");
+_Static_assert(sizeof(snapshot_state_t) == 24, "snapshot state layout");
+
+static unsigned int popcount32(uint32_t mask) {
+    return (unsigned int)__builtin_popcount(mask);
+}
+
+static uint32_t all_states(const PolyCall_StateMachine* sm) {
+    return sm->num_states < 32 ? (1u << sm->num_states) - 1 : ~0u;
+}
+
+static polycall_sm_status_t encode(
+    PolyCall_StateMachine* sm,
+    bool base,
+    void* buffer,
+    size_t capacity,
+    size_t* length
+) {
+    if (!sm || !sm->is_initialized) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    if (!buffer || !length) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    uint32_t mask = base ? all_states(sm) : (sm->delta_dirty & all_states(sm));
+    size_t size = sizeof(snapshot_header_t) + popcount32(mask) * sizeof(snapshot_state_t);
+    if (capacity < size) {
+        *length = size;
+        return POLYCALL_SM_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    snapshot_header_t header = {
+        .magic = SNAPSHOT_MAGIC,
+        .format = SNAPSHOT_FORMAT,
+        .flags = base ? SNAPSHOT_FLAG_BASE : 0,
+        .machine_id = sm->machine_id,
+        .base_epoch = base ? 0 : sm->snapshot_epoch,
+        .epoch = sm->snapshot_epoch + 1,
+        .current_state = sm->current_state,
+        .num_states = sm->num_states,
+        .failed_transitions = sm->diagnostics.failed_transitions,
+        .integrity_violations = sm->diagnostics.integrity_violations,
+        .state_mask = mask
+    };
+
+    uint8_t* out = (uint8_t*)buffer;
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+
+    for (uint32_t bits = mask; bits; bits &= bits - 1) {
+        unsigned int i = (unsigned int)__builtin_ctz(bits);
+        snapshot_state_t record = {
+            .timestamp = sm->states[i].timestamp,
+            .version = sm->states[i].version,
+            .transition_count = sm->state_stats[i].transition_count,
+            .integrity_check_count = sm->state_stats[i].integrity_check_count,
+            .is_locked = sm->states[i].is_locked
+        };
+        memcpy(out, &record, sizeof(record));
+        out += sizeof(record);
+    }
+
+    sm->delta_dirty = 0;
+    sm->snapshot_epoch = header.epoch;
+    *length = size;
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_snapshot_base(
+    PolyCall_StateMachine* sm,
+    void* buffer,
+    size_t capacity,
+    size_t* length
+) {
+    return encode(sm, true, buffer, capacity, length);
+}
+
+polycall_sm_status_t polycall_sm_snapshot_delta(
+    PolyCall_StateMachine* sm,
+    void* buffer,
+    size_t capacity,
+    size_t* length
+) {
+    return encode(sm, sm && sm->snapshot_epoch == 0, buffer, capacity, length);
+}
+
+static polycall_sm_status_t decode_header(
+    const void* buffer,
+    size_t length,
+    snapshot_header_t* header
+) {
+    if (!buffer || length < sizeof(snapshot_header_t)) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    memcpy(header, buffer, sizeof(*header));
+    if (header->magic != SNAPSHOT_MAGIC || header->format != SNAPSHOT_FORMAT)
+        return POLYCALL_SM_ERROR_VERSION_MISMATCH;
+
+    if (header->num_states > POLYCALL_MAX_STATES ||
+        length != sizeof(*header) + popcount32(header->state_mask) * sizeof(snapshot_state_t))
+        return POLYCALL_SM_ERROR_INTEGRITY_CHECK_FAILED;
+
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_snapshot_peek(
+    const void* buffer,
+    size_t length,
+    polycall_sm_snapshot_info_t* info
+) {
+    if (!info) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    snapshot_header_t header;
+    polycall_sm_status_t status = decode_header(buffer, length, &header);
+    if (status != POLYCALL_SM_SUCCESS) return status;
+
+    info->machine_id = header.machine_id;
+    info->base_epoch = header.base_epoch;
+    info->epoch = header.epoch;
+    info->state_count = popcount32(header.state_mask);
+    info->is_base = (header.flags & SNAPSHOT_FLAG_BASE) != 0;
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_snapshot_apply(
+    PolyCall_StateMachine* sm,
+    const void* buffer,
+    size_t length
+) {
+    if (!sm || !sm->is_initialized) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    snapshot_header_t header;
+    polycall_sm_status_t status = decode_header(buffer, length, &header);
+    if (status != POLYCALL_SM_SUCCESS) return status;
+
+    // Same definition on both sides, and deltas only in epoch order
+    if (header.num_states != sm->num_states || header.current_state >= sm->num_states ||
+        (header.state_mask & ~all_states(sm)))
+        return POLYCALL_SM_ERROR_INVALID_STATE;
+
+    if (!(header.flags & SNAPSHOT_FLAG_BASE) && header.base_epoch != sm->snapshot_epoch)
+        return POLYCALL_SM_ERROR_VERSION_MISMATCH;
+
+    const uint8_t* in = (const uint8_t*)buffer + sizeof(header);
+    for (uint32_t bits = header.state_mask; bits; bits &= bits - 1) {
+        unsigned int i = (unsigned int)__builtin_ctz(bits);
+        snapshot_state_t record;
+        memcpy(&record, in, sizeof(record));
+        in += sizeof(record);
+
+        polycall_sm_restore_state_fields(sm, i, record.version, record.timestamp,
+                                         record.is_locked != 0);
+        sm->state_stats[i].transition_count = record.transition_count;
+        sm->state_stats[i].integrity_check_count = record.integrity_check_count;
+    }
+
+    sm->dirty_states |= header.state_mask;
+    sm->current_state = header.current_state;
+    sm->diagnostics.failed_transitions = header.failed_transitions;
+    sm->diagnostics.integrity_violations = header.integrity_violations;
+    sm->snapshot_epoch = header.epoch;
+    return POLYCALL_SM_SUCCESS;
+}
@@ -0,0 +1,682 @@
+#include "polycall_sm_wal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#endif
+
+#define WAL_MAGIC "PCWAL001"
+#define CHECKPOINT_MAGIC "PCCKPT01"
+#define CHECKPOINT_SUFFIX ".ckpt"
+#define CHECKPOINT_TMP_SUFFIX ".ckpt.tmp"
+#define WAL_SCAN_RECORDS 256
+
+// Log file header
+typedef struct {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+} wal_file_header_t;
+
+// Checkpoint layout: header, then per machine an entry followed by
+// num_states state entries, then the machine count and a 32-bit checksum
+// of everything before it
+typedef struct {
+    char magic[8];
+    uint64_t lsn;
+} checkpoint_header_t;
+
+typedef struct {
+    uint64_t machine_id;
+    uint32_t current_state;
+    uint32_t num_states;
+} checkpoint_machine_t;
+
+typedef struct {
+    uint64_t timestamp;
+    uint32_t version;
+    uint32_t is_locked;
+} checkpoint_state_t;
+
+struct polycall_sm_wal {
+    int fd;
+    char* path;
+    bool sync;
+
+    pthread_mutex_t lock;               // Batches, LSNs and flags
+    pthread_cond_t work;                // Flusher wakeup
+    pthread_cond_t space;               // Appenders waiting on a full batch
+    pthread_cond_t durable;             // polycall_sm_wal_sync waiters
+    polycall_sm_wal_record_t* active;   // Batch being filled
+    polycall_sm_wal_record_t* spare;    // Batch being written
+    size_t active_count;
+    size_t capacity;
+    uint64_t next_lsn;
+    uint64_t durable_lsn;
+    bool stopping;
+    bool failed;
+
+    pthread_mutex_t io_lock;            // File writes vs checkpoint truncation
+    off_t file_offset;
+    uint64_t written_lsn;               // Highest LSN in the file, under io_lock
+
+    pthread_t flusher;
+};
+
+#ifdef _WIN32
+/* The Windows CRT has no positional I/O or fsync. Positional calls go
+ * through an OVERLAPPED offset (they also move the file pointer, which the
+ * log never relies on), and _commit flushes data and metadata alike. */
+static ssize_t wal_pio(int fd, void* data, size_t length, off_t offset, bool write) {
+    OVERLAPPED at = {0};
+    at.Offset = (DWORD)((uint64_t)offset & 0xffffffffu);
+    at.OffsetHigh = (DWORD)((uint64_t)offset >> 32);
+    HANDLE handle = (HANDLE)_get_osfhandle(fd);
+    DWORD done = 0;
+    BOOL ok = write ? WriteFile(handle, data, (DWORD)length, &done, &at)
+                    : ReadFile(handle, data, (DWORD)length, &done, &at);
+    if (!ok) return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+    return (ssize_t)done;
+}
+
+#define pwrite(fd, data, length, offset) wal_pio((fd), (void*)(data), (length), (offset), true)
+#define pread(fd, data, length, offset) wal_pio((fd), (data), (length), (offset), false)
+#define fsync(fd) _commit(fd)
+#define fdatasync(fd) _commit(fd)
+#define ftruncate(fd, length) _chsize_s((fd), (length))
+#define WAL_OPEN_FLAGS O_BINARY
+#else
+#define WAL_OPEN_FLAGS 0
+#endif
+
+static uint32_t fnv1a(uint32_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#define FNV_SEED 2166136261u
+
+static uint32_t record_checksum(const polycall_sm_wal_record_t* record) {
+    return fnv1a(FNV_SEED, record, offsetof(polycall_sm_wal_record_t, checksum));
+}
+
+static bool write_all(int fd, const void* data, size_t length, off_t offset) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (length > 0) {
+        ssize_t n = pwrite(fd, bytes, length, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += n;
+        offset += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static char* path_with_suffix(const char* path, const char* suffix) {
+    size_t length = strlen(path) + strlen(suffix) + 1;
+    char* result = malloc(length);
+    if (result) snprintf(result, length, "%s%s", path, suffix);
+    return result;
+}
+
+// Move a finished checkpoint over the previous one
+static int replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    // rename() refuses to overwrite here; write-through covers the directory
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+// Make a rename in the directory holding path durable
+static void sync_parent_dir(const char* path) {
+#ifdef _WIN32
+    (void)path;     // Directories cannot be opened for fsync
+#else
+    char dir[4096];
+    const char* slash = strrchr(path, '/');
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+    } else if (slash == path) {
+        snprintf(dir, sizeof(dir), "/");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+    }
+
+    int fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+}
+
+/* Checkpoint loading */
+
+// Read and verify a whole checkpoint; NULL data with SUCCESS when absent
+static polycall_sm_status_t checkpoint_load(const char* path, uint8_t** data, size_t* size) {
+    *data = NULL;
+    *size = 0;
+
+    char* ckpt_path = path_with_suffix(path, CHECKPOINT_SUFFIX);
+    if (!ckpt_path) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    FILE* file = fopen(ckpt_path, "rb");
+    free(ckpt_path);
+    if (!file) return errno == ENOENT ? POLYCALL_SM_SUCCESS : POLYCALL_SM_ERROR_IO;
+
+    polycall_sm_status_t status = POLYCALL_SM_ERROR_IO;
+    uint8_t* buffer = NULL;
+    long length = -1;
+
+    if (fseek(file, 0, SEEK_END) == 0) length = ftell(file);
+    if (length >= (long)(sizeof(checkpoint_header_t) + sizeof(uint64_t) + sizeof(uint32_t)) &&
+        fseek(file, 0, SEEK_SET) == 0 && (buffer = malloc((size_t)length)) &&
+        fread(buffer, 1, (size_t)length, file) == (size_t)length) {
+        uint32_t stored;
+        size_t body = (size_t)length - sizeof(uint32_t);
+        memcpy(&stored, buffer + body, sizeof(stored));
+
+        if (memcmp(buffer, CHECKPOINT_MAGIC, 8) != 0 || fnv1a(FNV_SEED, buffer, body) != stored) {
+            status = POLYCALL_SM_ERROR_INTEGRITY_CHECK_FAILED;
+        } else {
+            *data = buffer;
+            *size = body;
+            buffer = NULL;
+            status = POLYCALL_SM_SUCCESS;
+        }
+    }
+
+    free(buffer);
+    fclose(file);
+    return status;
+}
+
+static uint64_t checkpoint_lsn(const char* path) {
+    uint8_t* data;
+    size_t size;
+    if (checkpoint_load(path, &data, &size) != POLYCALL_SM_SUCCESS || !data) return 0;
+
+    checkpoint_header_t header;
+    memcpy(&header, data, sizeof(header));
+    free(data);
+    return header.lsn;
+}
+
+/* Log scanning */
+
+typedef bool (*record_visitor_t)(const polycall_sm_wal_record_t* record, void* user_data);
+
+// Validate the header and walk records up to the first torn or corrupt one.
+// Returns the offset just past the last valid record, or -1 on error.
+static off_t scan_log(int fd, uint64_t* last_lsn, record_visitor_t visitor, void* user_data) {
+    wal_file_header_t header;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, WAL_MAGIC, 8) != 0 ||
+        header.record_size != sizeof(polycall_sm_wal_record_t)) {
+        return -1;
+    }
+
+    polycall_sm_wal_record_t records[WAL_SCAN_RECORDS];
+    off_t offset = sizeof(header);
+    uint64_t previous = 0;
+
+    for (;;) {
+        ssize_t n = pread(fd, records, sizeof(records), offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        size_t count = (size_t)n / sizeof(polycall_sm_wal_record_t);
+        for (size_t i = 0; i < count; i++) {
+            if (records[i].checksum != record_checksum(&records[i]) ||
+                records[i].lsn <= previous) {
+                *last_lsn = previous;
+                return offset;
+            }
+            previous = records[i].lsn;
+            offset += sizeof(polycall_sm_wal_record_t);
+            if (visitor) visitor(&records[i], user_data);
+        }
+        if (count < WAL_SCAN_RECORDS) break;
+    }
+
+    *last_lsn = previous;
+    return offset;
+}
+
+/* Group commit */
+
+static void* flusher_main(void* arg) {
+    polycall_sm_wal_t* wal = (polycall_sm_wal_t*)arg;
+
+    pthread_mutex_lock(&wal->lock);
+    for (;;) {
+        while (!wal->active_count && !wal->stopping) {
+            pthread_cond_wait(&wal->work, &wal->lock);
+        }
+        if (!wal->active_count) break;
+
+        // Everything appended while the previous batch synced goes out together
+        polycall_sm_wal_record_t* batch = wal->active;
+        size_t count = wal->active_count;
+        uint64_t last_lsn = batch[count - 1].lsn;
+        wal->active = wal->spare;
+        wal->spare = batch;
+        wal->active_count = 0;
+        pthread_cond_broadcast(&wal->space);
+        pthread_mutex_unlock(&wal->lock);
+
+        pthread_mutex_lock(&wal->io_lock);
+        size_t bytes = count * sizeof(polycall_sm_wal_record_t);
+        bool ok = write_all(wal->fd, batch, bytes, wal->file_offset);
+        if (ok) {
+            wal->file_offset += (off_t)bytes;
+            wal->written_lsn = last_lsn;
+            if (wal->sync) ok = fdatasync(wal->fd) == 0;
+        }
+        pthread_mutex_unlock(&wal->io_lock);
+
+        pthread_mutex_lock(&wal->lock);
+        if (ok) {
+            wal->durable_lsn = last_lsn;
+        } else {
+            wal->failed = true;
+        }
+        pthread_cond_broadcast(&wal->durable);
+        if (wal->failed) break;
+    }
+    pthread_cond_broadcast(&wal->space);
+    pthread_mutex_unlock(&wal->lock);
+
+    return NULL;
+}
+
+polycall_sm_status_t polycall_sm_wal_open(
+    const polycall_sm_wal_config_t* config,
+    polycall_sm_wal_t** wal
+) {
+    if (!config || !config->path || !wal) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    *wal = NULL;
+
+    polycall_sm_wal_t* w = calloc(1, sizeof(polycall_sm_wal_t));
+    if (!w) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    w->capacity = config->batch_records ? config->batch_records : POLYCALL_SM_WAL_DEFAULT_BATCH;
+    w->sync = !config->no_sync;
+    w->path = strdup(config->path);
+    w->active = malloc(w->capacity * sizeof(polycall_sm_wal_record_t));
+    w->spare = malloc(w->capacity * sizeof(polycall_sm_wal_record_t));
+    w->fd = open(config->path, O_RDWR | O_CREAT | WAL_OPEN_FLAGS, 0644);
+
+    if (!w->path || !w->active || !w->spare || w->fd < 0) {
+        polycall_sm_status_t status = w->fd < 0 ? POLYCALL_SM_ERROR_IO
+                                                : POLYCALL_SM_ERROR_NOT_INITIALIZED;
+        if (w->fd >= 0) close(w->fd);
+        free(w->active);
+        free(w->spare);
+        free(w->path);
+        free(w);
+        return status;
+    }
+
+    struct stat st;
+    uint64_t last_lsn = 0;
+    bool ok = fstat(w->fd, &st) == 0;
+
+    if (ok && st.st_size == 0) {
+        wal_file_header_t header = {0};
+        memcpy(header.magic, WAL_MAGIC, 8);
+        header.record_size = sizeof(polycall_sm_wal_record_t);
+        ok = write_all(w->fd, &header, sizeof(header), 0) && fsync(w->fd) == 0;
+        w->file_offset = sizeof(header);
+    } else if (ok) {
+        // Drop a torn tail so new records follow the last valid one
+        w->file_offset = scan_log(w->fd, &last_lsn, NULL, NULL);
+        ok = w->file_offset >= 0 &&
+             (w->file_offset == st.st_size || ftruncate(w->fd, w->file_offset) == 0);
+    }
+
+    if (!ok) {
+        close(w->fd);
+        free(w->active);
+        free(w->spare);
+        free(w->path);
+        free(w);
+        return POLYCALL_SM_ERROR_IO;
+    }
+
+    uint64_t ckpt_lsn = checkpoint_lsn(config->path);
+    if (ckpt_lsn > last_lsn) last_lsn = ckpt_lsn;
+    w->next_lsn = last_lsn + 1;
+    w->durable_lsn = last_lsn;
+    w->written_lsn = last_lsn;
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_mutex_init(&w->io_lock, NULL);
+    pthread_cond_init(&w->work, NULL);
+    pthread_cond_init(&w->space, NULL);
+    pthread_cond_init(&w->durable, NULL);
+
+    if (pthread_create(&w->flusher, NULL, flusher_main, w) != 0) {
+        pthread_mutex_destroy(&w->lock);
+        pthread_mutex_destroy(&w->io_lock);
+        pthread_cond_destroy(&w->work);
+        pthread_cond_destroy(&w->space);
+        pthread_cond_destroy(&w->durable);
+        close(w->fd);
+        free(w->active);
+        free(w->spare);
+        free(w->path);
+        free(w);
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    }
+
+    *wal = w;
+    return POLYCALL_SM_SUCCESS;
+}
+
+void polycall_sm_wal_close(polycall_sm_wal_t* wal) {
+    if (!wal) return;
+
+    pthread_mutex_lock(&wal->lock);
+    wal->stopping = true;
+    pthread_cond_signal(&wal->work);
+    pthread_mutex_unlock(&wal->lock);
+    pthread_join(wal->flusher, NULL);
+
+    close(wal->fd);
+    pthread_mutex_destroy(&wal->lock);
+    pthread_mutex_destroy(&wal->io_lock);
+    pthread_cond_destroy(&wal->work);
+    pthread_cond_destroy(&wal->space);
+    pthread_cond_destroy(&wal->durable);
+    free(wal->active);
+    free(wal->spare);
+    free(wal->path);
+    free(wal);
+}
+
+polycall_sm_status_t polycall_sm_wal_append(
+    polycall_sm_wal_t* wal,
+    const polycall_sm_wal_record_t* record,
+    uint64_t* lsn
+) {
+    if (!wal || !record) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    pthread_mutex_lock(&wal->lock);
+    while (wal->active_count == wal->capacity && !wal->failed) {
+        pthread_cond_wait(&wal->space, &wal->lock);
+    }
+    if (wal->failed) {
+        pthread_mutex_unlock(&wal->lock);
+        return POLYCALL_SM_ERROR_IO;
+    }
+
+    polycall_sm_wal_record_t* slot = &wal->active[wal->active_count++];
+    *slot = *record;
+    slot->lsn = wal->next_lsn++;
+    slot->reserved = 0;
+    slot->checksum = record_checksum(slot);
+    if (lsn) *lsn = slot->lsn;
+
+    // The first record of a batch wakes the flusher; the rest ride along
+    if (wal->active_count == 1) pthread_cond_signal(&wal->work);
+    pthread_mutex_unlock(&wal->lock);
+
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_wal_sync(polycall_sm_wal_t* wal, uint64_t lsn) {
+    if (!wal) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+    if (lsn == POLYCALL_SM_WAL_LSN_LOST) return POLYCALL_SM_ERROR_IO;
+
+    pthread_mutex_lock(&wal->lock);
+    if (lsn >= wal->next_lsn) lsn = wal->next_lsn - 1;
+    while (wal->durable_lsn < lsn && !wal->failed) {
+        pthread_cond_wait(&wal->durable, &wal->lock);
+    }
+    polycall_sm_status_t status = wal->durable_lsn >= lsn ? POLYCALL_SM_SUCCESS
+                                                          : POLYCALL_SM_ERROR_IO;
+    pthread_mutex_unlock(&wal->lock);
+
+    return status;
+}
+
+uint64_t polycall_sm_wal_durable_lsn(polycall_sm_wal_t* wal) {
+    if (!wal) return 0;
+
+    pthread_mutex_lock(&wal->lock);
+    uint64_t lsn = wal->durable_lsn;
+    pthread_mutex_unlock(&wal->lock);
+    return lsn;
+}
+
+/* Checkpoints */
+
+typedef struct {
+    FILE* file;
+    uint32_t checksum;
+    uint64_t count;
+    bool ok;
+} checkpoint_writer_t;
+
+static void checkpoint_write(checkpoint_writer_t* writer, const void* data, size_t length) {
+    if (!writer->ok) return;
+    writer->checksum = fnv1a(writer->checksum, data, length);
+    writer->ok = fwrite(data, 1, length, writer->file) == length;
+}
+
+static polycall_sm_registry_visit_t checkpoint_machine(
+    uint64_t session_id,
+    PolyCall_StateMachine* sm,
+    void* user_data
+) {
+    checkpoint_writer_t* writer = (checkpoint_writer_t*)user_data;
+
+    checkpoint_machine_t entry = {
+        .machine_id = session_id,
+        .current_state = sm->current_state,
+        .num_states = sm->num_states
+    };
+    checkpoint_write(writer, &entry, sizeof(entry));
+
+    for (unsigned int i = 0; i < sm->num_states; i++) {
+        checkpoint_state_t state = {
+            .timestamp = sm->states[i].timestamp,
+            .version = sm->states[i].version,
+            .is_locked = sm->states[i].is_locked
+        };
+        checkpoint_write(writer, &state, sizeof(state));
+    }
+
+    writer->count++;
+    return writer->ok ? POLYCALL_SM_REGISTRY_CONTINUE : POLYCALL_SM_REGISTRY_STOP;
+}
+
+polycall_sm_status_t polycall_sm_wal_checkpoint(
+    polycall_sm_wal_t* wal,
+    polycall_sm_registry_t* registry
+) {
+    if (!wal || !registry) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    char* tmp_path = path_with_suffix(wal->path, CHECKPOINT_TMP_SUFFIX);
+    char* ckpt_path = path_with_suffix(wal->path, CHECKPOINT_SUFFIX);
+    if (!tmp_path || !ckpt_path) {
+        free(tmp_path);
+        free(ckpt_path);
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    }
+
+    /* With the flusher held off, the file holds exactly the records up to
+     * written_lsn, and the io_lock handoff from the flusher makes the state
+     * those records describe visible here. Appends carry on meanwhile, so
+     * the copy may already include newer transitions; replaying them is
+     * idempotent since records carry the target state rather than a delta.
+     * The machines themselves are read unlocked: callers keep them from
+     * transitioning until this returns (see the header). */
+    pthread_mutex_lock(&wal->io_lock);
+
+    checkpoint_writer_t writer = {
+        .file = fopen(tmp_path, "wb"),
+        .checksum = FNV_SEED,
+        .ok = true
+    };
+    polycall_sm_status_t status = POLYCALL_SM_ERROR_IO;
+
+    if (writer.file) {
+        checkpoint_header_t header = {0};
+        memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+        header.lsn = wal->written_lsn;
+        checkpoint_write(&writer, &header, sizeof(header));
+
+        polycall_sm_registry_foreach(registry, checkpoint_machine, &writer);
+        checkpoint_write(&writer, &writer.count, sizeof(writer.count));
+
+        uint32_t checksum = writer.checksum;
+        writer.ok = writer.ok &&
+                    fwrite(&checksum, sizeof(checksum), 1, writer.file) == 1 &&
+                    fflush(writer.file) == 0 &&
+                    fsync(fileno(writer.file)) == 0;
+
+        if (fclose(writer.file) != 0) writer.ok = false;
+
+        if (writer.ok && replace_file(tmp_path, ckpt_path) == 0) {
+            sync_parent_dir(ckpt_path);
+
+            // Everything in the log is now covered by the checkpoint
+            if (ftruncate(wal->fd, sizeof(wal_file_header_t)) == 0 &&
+                (!wal->sync || fdatasync(wal->fd) == 0)) {
+                wal->file_offset = sizeof(wal_file_header_t);
+                status = POLYCALL_SM_SUCCESS;
+            }
+        } else {
+            unlink(tmp_path);
+        }
+    }
+
+    pthread_mutex_unlock(&wal->io_lock);
+    free(tmp_path);
+    free(ckpt_path);
+    return status;
+}
+
+/* Recovery */
+
+typedef struct {
+    polycall_sm_registry_t* registry;
+    polycall_sm_wal_recovery_t* result;
+} replay_context_t;
+
+static bool replay_record(const polycall_sm_wal_record_t* record, void* user_data) {
+    replay_context_t* replay = (replay_context_t*)user_data;
+    if (record->lsn <= replay->result->checkpoint_lsn) return true;
+
+    PolyCall_StateMachine* sm = polycall_sm_registry_lookup(replay->registry, record->machine_id);
+    if (sm && polycall_sm_recover_state(sm, record->to_state, record->version,
+                                        record->timestamp) == POLYCALL_SM_SUCCESS) {
+        replay->result->records_applied++;
+    } else {
+        replay->result->records_skipped++;
+    }
+    return true;
+}
+
+static polycall_sm_status_t restore_checkpoint(
+    const uint8_t* data,
+    size_t size,
+    polycall_sm_registry_t* registry,
+    polycall_sm_wal_recovery_t* result
+) {
+    checkpoint_header_t header;
+    uint64_t machine_count;
+    memcpy(&header, data, sizeof(header));
+    size -= sizeof(machine_count);
+    memcpy(&machine_count, data + size, sizeof(machine_count));
+    result->checkpoint_lsn = header.lsn;
+
+    size_t offset = sizeof(header);
+    for (uint64_t m = 0; m < machine_count; m++) {
+        checkpoint_machine_t entry;
+        if (size - offset < sizeof(entry)) return POLYCALL_SM_ERROR_INTEGRITY_CHECK_FAILED;
+        memcpy(&entry, data + offset, sizeof(entry));
+        offset += sizeof(entry);
+
+        size_t states_size = (size_t)entry.num_states * sizeof(checkpoint_state_t);
+        if (entry.num_states > POLYCALL_MAX_STATES || size - offset < states_size)
+            return POLYCALL_SM_ERROR_INTEGRITY_CHECK_FAILED;
+
+        PolyCall_StateMachine* sm = polycall_sm_registry_lookup(registry, entry.machine_id);
+        if (sm && sm->num_states == entry.num_states && entry.current_state < entry.num_states) {
+            for (unsigned int i = 0; i < entry.num_states; i++) {
+                checkpoint_state_t state;
+                memcpy(&state, data + offset + i * sizeof(state), sizeof(state));
+                polycall_sm_restore_state_fields(sm, i, state.version, state.timestamp,
+                                                 state.is_locked != 0);
+            }
+            sm->dirty_states = entry.num_states < 32 ? (1u << entry.num_states) - 1 : ~0u;
+            sm->delta_dirty = sm->dirty_states;
+            sm->current_state = entry.current_state;
+            result->machines_restored++;
+        }
+        offset += states_size;
+    }
+
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_wal_recover(
+    const char* path,
+    polycall_sm_registry_t* registry,
+    polycall_sm_wal_recovery_t* result
+) {
+    if (!path || !registry) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
+
+    polycall_sm_wal_recovery_t local;
+    if (!result) result = &local;
+    memset(result, 0, sizeof(*result));
+
+    uint8_t* data;
+    size_t size;
+    polycall_sm_status_t status = checkpoint_load(path, &data, &size);
+    if (status != POLYCALL_SM_SUCCESS) return status;
+
+    if (data) {
+        status = restore_checkpoint(data, size, registry, result);
+        free(data);
+        if (status != POLYCALL_SM_SUCCESS) return status;
+    }
+    result->last_lsn = result->checkpoint_lsn;
+
+    int fd = open(path, O_RDONLY | WAL_OPEN_FLAGS);
+    if (fd < 0) return errno == ENOENT ? POLYCALL_SM_SUCCESS : POLYCALL_SM_ERROR_IO;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0) {
+        close(fd);
+        return POLYCALL_SM_SUCCESS;
+    }
+
+    replay_context_t replay = { .registry = registry, .result = result };
+    uint64_t last_lsn = 0;
+    off_t end = scan_log(fd, &last_lsn, replay_record, &replay);
+    close(fd);
+
+    if (end < 0) return POLYCALL_SM_ERROR_IO;
+    if (last_lsn > result->last_lsn) result->last_lsn = last_lsn;
+    return POLYCALL_SM_SUCCESS;
+}
@@ -1,8 +1,39 @@
 #include "polycall_state_machine.h"
 #include "polycall.h"
+#include "polycall_worker_pool.h"
+#include "polycall_sm_wal.h"
+#include "polycall_sm_pool.h"
+#include "polycall_sm_shm.h"
+#include "polycall_sm_observer.h"
+#include "polycall_memory.h"
+#include "polycall_metrics.h"
+#include "polycall_trace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+/* Instrumentation storage, allocated only while enabled */
+typedef struct {
+    _Atomic uint64_t seq;
+    PolyCall_TransitionRecord record;
+} history_slot_t;
+
+// Stats of one transition, behind the same odd-while-writing sequence
+typedef struct {
+    uint64_t seq;
+    PolyCall_TransitionStats stats;
+} stats_slot_t;
+
+struct PolyCall_SMInstrumentation {
+    polycall_context_t ctx;     // Owner of every allocation below
+    _Atomic bool enabled;       // Cleared on disable; the block lives until reset
+    stats_slot_t* transitions[POLYCALL_MAX_TRANSITIONS];
+    _Atomic uint64_t history_head;
+    history_slot_t history[POLYCALL_SM_HISTORY_SIZE];
+};
+
 // Utility functions
 static inline uint32_t calculate_state_checksum(const PolyCall_State* state) {
     uint32_t checksum = 0;
@@ -21,7 +52,150 @@ static inline void update_state_timestamp(PolyCall_State* state) {
     state->version++;
 }
 
+_Static_assert(POLYCALL_MAX_STATES <= 32, "dirty_states is a 32-bit mask");
+
+static inline bool async_in_flight(const PolyCall_StateMachine* sm) {
+    return __atomic_load_n(&sm->pending_transition, __ATOMIC_ACQUIRE) != 0;
+}
+
+// Observers may be added from other threads while transitions run
+static inline bool has_observers(const PolyCall_StateMachine* sm) {
+    return __atomic_load_n(&sm->observers, __ATOMIC_RELAXED) != NULL;
+}
+
+// Record that a state (or its stats) differs from the definition
+static inline void mark_state_dirty(PolyCall_StateMachine* sm, unsigned int state_id) {
+    sm->dirty_states |= 1u << state_id;
+    sm->delta_dirty |= 1u << state_id;
+}
+
+// Failed attempts feed both the machine diagnostics and the context metrics
+static void count_failure(PolyCall_StateMachine* sm) {
+    sm->diagnostics.failed_transitions++;
+    polycall_metrics_counter_add(polycall_context_metrics(sm->ctx), POLYCALL_METRIC_SM_FAILURES, 1);
+}
+
+// Instrumentation block, published with release so readers see it whole
+static inline struct PolyCall_SMInstrumentation* instrumentation_of(const PolyCall_StateMachine* sm) {
+    return __atomic_load_n(&sm->instrumentation, __ATOMIC_ACQUIRE);
+}
+
+// The block to record into, NULL while instrumentation is off
+static inline struct PolyCall_SMInstrumentation* instrumentation_active(const PolyCall_StateMachine* sm) {
+    struct PolyCall_SMInstrumentation* inst = instrumentation_of(sm);
+    return inst && atomic_load_explicit(&inst->enabled, memory_order_relaxed) ? inst : NULL;
+}
+
+static stats_slot_t* instrumentation_stats(
+    struct PolyCall_SMInstrumentation* inst,
+    unsigned int transition_id
+) {
+    stats_slot_t* slot = inst->transitions[transition_id];
+    if (!slot) {
+        slot = polycall_mem_calloc(inst->ctx, 1, sizeof(stats_slot_t));
+        __atomic_store_n(&inst->transitions[transition_id], slot, __ATOMIC_RELEASE);
+    }
+    return slot;
+}
+
+/* Fields of the seqlocked blocks below are only touched atomically: the
+ * writer loads its own values relaxed and stores them with release, so
+ * none can become visible before the odd sequence; readers load them with
+ * acquire, so the closing sequence check cannot move ahead of them. */
+static inline void shared_add(uint64_t* field, uint64_t value) {
+    __atomic_store_n(field, __atomic_load_n(field, __ATOMIC_RELAXED) + value, __ATOMIC_RELEASE);
+}
+
+static void shared_histogram_record(polycall_histogram_t* hist, uint64_t value) {
+    uint64_t count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+    if (count == 0 || value < __atomic_load_n(&hist->min, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&hist->min, value, __ATOMIC_RELEASE);
+    }
+    if (value > __atomic_load_n(&hist->max, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&hist->max, value, __ATOMIC_RELEASE);
+    }
+    uint32_t* bucket = &hist->buckets[polycall_histogram_bucket(value)];
+    __atomic_store_n(bucket, __atomic_load_n(bucket, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&hist->count, count + 1, __ATOMIC_RELEASE);
+    shared_add(&hist->sum, value);
+}
+
+static void shared_histogram_load(polycall_histogram_t* dst, const polycall_histogram_t* src) {
+    for (unsigned int i = 0; i < POLYCALL_HISTOGRAM_BUCKETS; i++) {
+        dst->buckets[i] = __atomic_load_n(&src->buckets[i], __ATOMIC_ACQUIRE);
+    }
+    dst->count = __atomic_load_n(&src->count, __ATOMIC_ACQUIRE);
+    dst->sum = __atomic_load_n(&src->sum, __ATOMIC_ACQUIRE);
+    dst->min = __atomic_load_n(&src->min, __ATOMIC_ACQUIRE);
+    dst->max = __atomic_load_n(&src->max, __ATOMIC_ACQUIRE);
+}
+
+/* Single writer: transitions on one machine are already serialized by the
+ * caller. The stats block and each history slot carry a sequence (odd while
+ * being written) so readers on other threads can detect and retry torn
+ * copies without locking. */
+static void instrumentation_record(
+    struct PolyCall_SMInstrumentation* inst,
+    const PolyCall_Transition* transition,
+    unsigned int transition_id,
+    polycall_sm_status_t status,
+    uint64_t start_ns,
+    const uint64_t phase_ns[POLYCALL_SM_PHASE_COUNT]
+) {
+    uint64_t end_ns = polycall_monotonic_ns();
+    stats_slot_t* stats_slot = instrumentation_stats(inst, transition_id);
+
+    if (stats_slot) {
+        PolyCall_TransitionStats* stats = &stats_slot->stats;
+        uint64_t stats_seq = __atomic_load_n(&stats_slot->seq, __ATOMIC_RELAXED);
+        __atomic_store_n(&stats_slot->seq, stats_seq + 1, __ATOMIC_RELAXED);
+        shared_add(&stats->count, 1);
+        if (status != POLYCALL_SM_SUCCESS) shared_add(&stats->failures, 1);
+        for (int phase = 0; phase < POLYCALL_SM_PHASE_COUNT; phase++) {
+            if (phase_ns[phase]) shared_histogram_record(&stats->phases[phase], phase_ns[phase]);
+        }
+        shared_histogram_record(&stats->total, end_ns - start_ns);
+        __atomic_store_n(&stats_slot->seq, stats_seq + 2, __ATOMIC_RELEASE);
+    }
+
+    uint64_t sequence = atomic_load_explicit(&inst->history_head, memory_order_relaxed);
+    history_slot_t* slot = &inst->history[sequence % POLYCALL_SM_HISTORY_SIZE];
+    PolyCall_TransitionRecord* record = &slot->record;
+
+    atomic_store_explicit(&slot->seq, sequence * 2 + 1, memory_order_relaxed);
+    __atomic_store_n(&record->sequence, sequence, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->start_ns, start_ns, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->duration_ns, end_ns - start_ns, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->transition_id, transition_id, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->from_state, transition->from_state, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->to_state, transition->to_state, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->status, status, __ATOMIC_RELEASE);
+    atomic_store_explicit(&slot->seq, sequence * 2 + 2, memory_order_release);
+    atomic_store_explicit(&inst->history_head, sequence + 1, memory_order_release);
+}
+
+static void instrumentation_free(struct PolyCall_SMInstrumentation* inst) {
+    if (!inst) return;
+    for (unsigned int i = 0; i < POLYCALL_MAX_TRANSITIONS; i++) {
+        polycall_mem_free(inst->ctx, inst->transitions[i]);
+    }
+    polycall_mem_free(inst->ctx, inst);
+}
+
+
 
+/* In-flight async transition, handed from the caller to a worker and back */
+struct PolyCall_AsyncToken {
+    PolyCall_StateMachine* sm;
+    unsigned int transition_id;
+    polycall_sm_status_t status;
+    bool timed;
+    uint64_t start_ns;
+    uint64_t mark_ns;
+    uint64_t phase_ns[POLYCALL_SM_PHASE_COUNT];
+    PolyCall_TransitionCallback callback;
+    void* user_data;
+};
 
 /* Core state machine functions */
 
@@ -32,7 +206,7 @@ polycall_sm_status_t polycall_sm_create_with_integrity(
 ) {
     if (!ctx || !sm) return POLYCALL_SM_ERROR_INVALID_CONTEXT;
     
-    *sm = (PolyCall_StateMachine*)calloc(1, sizeof(PolyCall_StateMachine));
+    *sm = polycall_mem_calloc(ctx, 1, sizeof(PolyCall_StateMachine));
     if (!*sm) return POLYCALL_SM_ERROR_NOT_INITIALIZED;
     
     (*sm)->ctx = ctx;
@@ -44,11 +218,113 @@ polycall_sm_status_t polycall_sm_create_with_integrity(
     return POLYCALL_SM_SUCCESS;
 }
 
+polycall_sm_status_t polycall_sm_create_from_def(
+    polycall_context_t ctx,
+    const PolyCall_StateMachineDef* def,
+    PolyCall_StateMachine** sm,
+    PolyCall_StateIntegrityCheck integrity_check
+) {
+    if (!def || def->num_states > POLYCALL_MAX_STATES ||
+        def->num_transitions > POLYCALL_MAX_TRANSITIONS ||
+        (def->num_states > 0 && def->initial_state >= def->num_states))
+        return POLYCALL_SM_ERROR_INVALID_STATE;
+
+    polycall_sm_status_t status = polycall_sm_create_with_integrity(ctx, sm, integrity_check);
+    if (status != POLYCALL_SM_SUCCESS) return status;
+
+    PolyCall_StateMachine* machine = *sm;
+
+    /* Tables are already laid out; only per-instance fields need filling */
+    memcpy(machine->states, def->states, def->num_states * sizeof(PolyCall_State));
+    memcpy(machine->transitions, def->transitions,
+           def->num_transitions * sizeof(PolyCall_Transition));
+    machine->num_states = def->num_states;
+    machine->num_transitions = def->num_transitions;
+    machine->current_state = def->initial_state;
+
+    uint64_t now = (uint64_t)time(NULL);
+    for (unsigned int i = 0; i < machine->num_states; i++) {
+        machine->states[i].timestamp = now;
+        machine->states[i].checksum = calculate_state_checksum(&machine->states[i]);
+    }
+
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_reset(
+    PolyCall_StateMachine* sm,
+    const PolyCall_StateMachineDef* def
+) {
+    if (!sm || !sm->is_initialized || !def) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    if (async_in_flight(sm)) 
+        return POLYCALL_SM_ERROR_TRANSITION_PENDING;
+
+    uint64_t now = (uint64_t)time(NULL);
+
+    if (sm->layout_dirty || sm->num_states != def->num_states ||
+        sm->num_transitions != def->num_transitions) {
+        /* Structure was edited; fall back to a full copy of the tables */
+        memcpy(sm->states, def->states, def->num_states * sizeof(PolyCall_State));
+        memcpy(sm->transitions, def->transitions,
+               def->num_transitions * sizeof(PolyCall_Transition));
+        sm->num_states = def->num_states;
+        sm->num_transitions = def->num_transitions;
+        for (unsigned int i = 0; i < sm->num_states; i++) {
+            sm->states[i].timestamp = now;
+            sm->states[i].checksum = calculate_state_checksum(&sm->states[i]);
+        }
+        memset(sm->state_stats, 0, sizeof(sm->state_stats));
+        sm->layout_dirty = false;
+    } else {
+        uint32_t dirty = sm->dirty_states;
+        while (dirty) {
+            unsigned int i = (unsigned int)__builtin_ctz(dirty);
+            dirty &= dirty - 1;
+            sm->states[i] = def->states[i];
+            sm->states[i].timestamp = now;
+            sm->states[i].checksum = calculate_state_checksum(&sm->states[i]);
+            memset(&sm->state_stats[i], 0, sizeof(sm->state_stats[i]));
+        }
+    }
+    sm->dirty_states = 0;
+    sm->delta_dirty = 0;
+    sm->snapshot_epoch = 0;
+
+    sm->current_state = def->initial_state;
+    memset(&sm->diagnostics, 0, sizeof(sm->diagnostics));
+    sm->diagnostics.last_verification = now;
+
+    instrumentation_free(sm->instrumentation);
+    sm->instrumentation = NULL;
+    sm->worker_pool = NULL;
+    sm->async_commit = NULL;
+    sm->async_commit_data = NULL;
+    polycall_sm_detach_shm(sm);
+    polycall_sm_observers_clear(sm);
+    sm->event_sequence = 0;
+    sm->wal = NULL;
+    sm->machine_id = 0;
+    sm->wal_lsn = 0;
+
+    return POLYCALL_SM_SUCCESS;
+}
+
 void polycall_sm_destroy(PolyCall_StateMachine* sm) {
+    if (sm && sm->pool) {
+        // Mid-transition machines are parked by the pool, so nothing leaks
+        (void)polycall_sm_pool_release(sm->pool, sm);
+        return;
+    }
     if (sm) {
+        polycall_sm_detach_shm(sm);
+        polycall_sm_observers_clear(sm);
+        instrumentation_free(sm->instrumentation);
         /* Clear sensitive data before freeing */
+        polycall_context_t ctx = sm->ctx;
         memset(sm, 0, sizeof(PolyCall_StateMachine));
-        free(sm);
+        polycall_mem_free(ctx, sm);
     }
 }
 
@@ -83,6 +359,7 @@ polycall_sm_status_t polycall_sm_add_state(
     state->checksum = calculate_state_checksum(state);
     
     sm->num_states++;
+    sm->layout_dirty = true;
     return POLYCALL_SM_SUCCESS;
 }
 
@@ -117,6 +394,7 @@ polycall_sm_status_t polycall_sm_add_transition(
     transition->is_valid = true;
 
     sm->num_transitions++;
+    sm->layout_dirty = true;
     return POLYCALL_SM_SUCCESS;
 }
 
@@ -128,41 +406,331 @@ polycall_sm_status_t polycall_sm_execute_transition(
         return POLYCALL_SM_ERROR_INVALID_TRANSITION;
 
     /* Find the requested transition */
-    PolyCall_Transition* transition = NULL;
     for (unsigned int i = 0; i < sm->num_transitions; i++) {
         if (strcmp(sm->transitions[i].name, transition_name) == 0) {
-            transition = &sm->transitions[i];
-            break;
+            return polycall_sm_execute_transition_id(sm, i);
         }
     }
 
+    count_failure(sm);
+    return POLYCALL_SM_ERROR_INVALID_TRANSITION;
+}
+
+polycall_sm_status_t polycall_sm_execute_transition_id(
+    PolyCall_StateMachine* sm,
+    unsigned int transition_id
+) {
+    return polycall_sm_execute_transition_async(sm, transition_id, NULL, NULL);
+}
+
+// Run a callback, charging its duration to a phase when instrumented
+static inline void run_phase(
+    PolyCall_StateAction fn,
+    polycall_context_t ctx,
+    bool timed,
+    uint64_t* phase_ns,
+    uint64_t* mark_ns
+) {
+    if (!fn) return;
+    fn(ctx);
+    if (timed) {
+        uint64_t now = polycall_monotonic_ns();
+        *phase_ns = now - *mark_ns;
+        *mark_ns = now;
+    }
+}
+
+// Apply a successful transition and log it when the machine is durable
+static void commit_transition(
+    PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    const PolyCall_Transition* transition
+) {
+    PolyCall_State* to_state = &sm->states[transition->to_state];
+
+    sm->current_state = transition->to_state;
+    update_state_timestamp(to_state);
+    sm->state_stats[transition->to_state].transition_count++;
+    mark_state_dirty(sm, transition->to_state);
+    polycall_metrics_counter_add(polycall_context_metrics(sm->ctx), POLYCALL_METRIC_SM_TRANSITIONS, 1);
+
+    if (sm->wal) {
+        polycall_sm_wal_record_t record = {
+            .machine_id = sm->machine_id,
+            .timestamp = to_state->timestamp,
+            .transition_id = transition_id,
+            .from_state = transition->from_state,
+            .to_state = transition->to_state,
+            .version = to_state->version
+        };
+        // The transition stands either way; make the next sync report the loss
+        if (polycall_sm_wal_append(sm->wal, &record, &sm->wal_lsn) != POLYCALL_SM_SUCCESS) {
+            sm->diagnostics.wal_failures++;
+            sm->wal_lsn = POLYCALL_SM_WAL_LSN_LOST;
+        }
+    }
+
+    if (sm->shm_slot) polycall_sm_shm_publish(sm, true);
+    if (has_observers(sm)) polycall_sm_observers_publish(sm, transition_id, POLYCALL_SM_SUCCESS);
+    POLYCALL_TRACE4(transition_end, sm->machine_id, transition_id, transition->to_state,
+                    POLYCALL_SM_SUCCESS);
+}
+
+// Worker-side half of an async transition
+static void async_transition_job(void* arg) {
+    PolyCall_AsyncToken* token = (PolyCall_AsyncToken*)arg;
+    PolyCall_StateMachine* sm = token->sm;
+    const PolyCall_Transition* transition = &sm->transitions[token->transition_id];
+
+    token->mark_ns = token->timed ? polycall_monotonic_ns() : 0;
+    run_phase(sm->states[transition->from_state].on_exit, sm->ctx, token->timed,
+              &token->phase_ns[POLYCALL_SM_PHASE_EXIT], &token->mark_ns);
+    run_phase(transition->action, sm->ctx, token->timed,
+              &token->phase_ns[POLYCALL_SM_PHASE_ACTION], &token->mark_ns);
+
+    if (transition->async_action &&
+        transition->async_action(sm->ctx, token) == POLYCALL_SM_ACTION_PENDING) {
+        return;  /* The action calls polycall_sm_async_complete() later */
+    }
+
+    polycall_sm_async_complete(token, POLYCALL_SM_SUCCESS);
+}
+
+polycall_sm_status_t polycall_sm_execute_transition_async(
+    PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    PolyCall_TransitionCallback callback,
+    void* user_data
+) {
+    if (!sm) return POLYCALL_SM_ERROR_INVALID_TRANSITION;
+    if (!sm->is_initialized) {
+        if (callback) callback(sm, transition_id, POLYCALL_SM_ERROR_INVALID_TRANSITION, user_data);
+        return POLYCALL_SM_ERROR_INVALID_TRANSITION;
+    }
+
+    PolyCall_Transition* transition = transition_id < sm->num_transitions ?
+                                      &sm->transitions[transition_id] : NULL;
+
     if (!transition || !transition->is_valid) {
-        sm->diagnostics.failed_transitions++;
+        count_failure(sm);
+        if (callback) callback(sm, transition_id, POLYCALL_SM_ERROR_INVALID_TRANSITION, user_data);
         return POLYCALL_SM_ERROR_INVALID_TRANSITION;
     }
 
+    /* The machine sits in a transitional sub-state until the work completes */
+    if (async_in_flight(sm)) {
+        if (callback) callback(sm, transition_id, POLYCALL_SM_ERROR_TRANSITION_PENDING, user_data);
+        return POLYCALL_SM_ERROR_TRANSITION_PENDING;
+    }
+
     PolyCall_State* from_state = &sm->states[transition->from_state];
     PolyCall_State* to_state = &sm->states[transition->to_state];
+    POLYCALL_TRACE4(transition_begin, sm->machine_id, transition_id,
+                    transition->from_state, transition->to_state);
+
+    struct PolyCall_SMInstrumentation* inst = instrumentation_active(sm);
+    uint64_t phase_ns[POLYCALL_SM_PHASE_COUNT] = {0};
+    uint64_t start_ns = inst ? polycall_monotonic_ns() : 0;
+    uint64_t mark_ns = start_ns;
+    polycall_sm_status_t status = POLYCALL_SM_SUCCESS;
 
     /* Check state locks and guard conditions */
-    if (from_state->is_locked || to_state->is_locked) 
-        return POLYCALL_SM_ERROR_STATE_LOCKED;
-    
-    if (transition->guard_condition && 
-        !transition->guard_condition(from_state, to_state)) {
-        sm->diagnostics.failed_transitions++;
-        return POLYCALL_SM_ERROR_INVALID_TRANSITION;
+    if (from_state->is_locked || to_state->is_locked) {
+        status = POLYCALL_SM_ERROR_STATE_LOCKED;
+    } else if (transition->guard_condition) {
+        bool allowed = transition->guard_condition(from_state, to_state);
+        if (inst) {
+            uint64_t now = polycall_monotonic_ns();
+            phase_ns[POLYCALL_SM_PHASE_GUARD] = now - mark_ns;
+            mark_ns = now;
+        }
+        if (!allowed) {
+            count_failure(sm);
+            status = POLYCALL_SM_ERROR_INVALID_TRANSITION;
+        }
+    }
+
+    if (status != POLYCALL_SM_SUCCESS) {
+        if (sm->shm_slot) polycall_sm_shm_publish(sm, false);
+        if (has_observers(sm)) polycall_sm_observers_publish(sm, transition_id, status);
+        POLYCALL_TRACE4(transition_end, sm->machine_id, transition_id, transition->to_state, status);
+        if (inst) instrumentation_record(inst, transition, transition_id, status, start_ns, phase_ns);
+        if (callback) callback(sm, transition_id, status, user_data);
+        return status;
+    }
+
+    /* Async transitions hand their callbacks to the worker pool */
+    if (transition->is_async) {
+        PolyCall_AsyncToken* token = polycall_mem_calloc(sm->ctx, 1, sizeof(PolyCall_AsyncToken));
+        if (!token) {
+            if (callback) callback(sm, transition_id, POLYCALL_SM_ERROR_OUT_OF_MEMORY, user_data);
+            return POLYCALL_SM_ERROR_OUT_OF_MEMORY;
+        }
+
+        token->sm = sm;
+        token->transition_id = transition_id;
+        token->timed = inst != NULL;
+        token->start_ns = start_ns;
+        token->phase_ns[POLYCALL_SM_PHASE_GUARD] = phase_ns[POLYCALL_SM_PHASE_GUARD];
+        token->callback = callback;
+        token->user_data = user_data;
+
+        __atomic_store_n(&sm->pending_transition, transition_id + 1, __ATOMIC_RELEASE);
+        if (!sm->worker_pool ||
+            !polycall_worker_pool_submit(sm->worker_pool, async_transition_job, token)) {
+            async_transition_job(token);
+        }
+        return POLYCALL_SM_PENDING;
     }
 
     /* Execute transition actions */
-    if (from_state->on_exit) from_state->on_exit(sm->ctx);
-    if (transition->action) transition->action(sm->ctx);
-    if (to_state->on_enter) to_state->on_enter(sm->ctx);
+    run_phase(from_state->on_exit, sm->ctx, inst != NULL, &phase_ns[POLYCALL_SM_PHASE_EXIT], &mark_ns);
+    run_phase(transition->action, sm->ctx, inst != NULL, &phase_ns[POLYCALL_SM_PHASE_ACTION], &mark_ns);
+    run_phase(to_state->on_enter, sm->ctx, inst != NULL, &phase_ns[POLYCALL_SM_PHASE_ENTER], &mark_ns);
 
-    /* Update state machine */
-    sm->current_state = transition->to_state;
-    update_state_timestamp(to_state);
+    commit_transition(sm, transition_id, transition);
+
+    if (inst) instrumentation_record(inst, transition, transition_id,
+                                     POLYCALL_SM_SUCCESS, start_ns, phase_ns);
+    if (callback) callback(sm, transition_id, POLYCALL_SM_SUCCESS, user_data);
+
+    return POLYCALL_SM_SUCCESS;
+}
+
+void polycall_sm_async_complete(PolyCall_AsyncToken* token, polycall_sm_status_t status) {
+    if (!token) return;
+
+    PolyCall_StateMachine* sm = token->sm;
+    const PolyCall_Transition* transition = &sm->transitions[token->transition_id];
+
+    if (status == POLYCALL_SM_SUCCESS) {
+        if (token->timed && !token->mark_ns) token->mark_ns = polycall_monotonic_ns();
+        run_phase(sm->states[transition->to_state].on_enter, sm->ctx, token->timed,
+                  &token->phase_ns[POLYCALL_SM_PHASE_ENTER], &token->mark_ns);
+    }
+    token->status = status;
 
+    /* Let the owner (e.g. an executor) apply the result on its own thread */
+    if (sm->async_commit) {
+        sm->async_commit(sm, token, sm->async_commit_data);
+    } else {
+        polycall_sm_async_commit(sm, token);
+    }
+}
+
+void polycall_sm_async_commit(PolyCall_StateMachine* sm, PolyCall_AsyncToken* token) {
+    if (!sm || !token) return;
+
+    unsigned int transition_id = token->transition_id;
+    const PolyCall_Transition* transition = &sm->transitions[transition_id];
+    polycall_sm_status_t status = token->status;
+
+    if (status == POLYCALL_SM_SUCCESS) {
+        commit_transition(sm, transition_id, transition);
+    } else {
+        count_failure(sm);
+        if (sm->shm_slot) polycall_sm_shm_publish(sm, false);
+        if (has_observers(sm)) polycall_sm_observers_publish(sm, transition_id, status);
+        POLYCALL_TRACE4(transition_end, sm->machine_id, transition_id, transition->to_state, status);
+    }
+
+    struct PolyCall_SMInstrumentation* inst = instrumentation_active(sm);
+    if (inst && token->timed) {
+        instrumentation_record(inst, transition, transition_id,
+                               status, token->start_ns, token->phase_ns);
+    }
+
+    PolyCall_TransitionCallback callback = token->callback;
+    void* user_data = token->user_data;
+    polycall_mem_free(sm->ctx, token);
+
+    __atomic_store_n(&sm->pending_transition, 0, __ATOMIC_RELEASE);
+    if (callback) callback(sm, transition_id, status, user_data);
+}
+
+bool polycall_sm_async_pending(const PolyCall_StateMachine* sm) {
+    return sm && async_in_flight(sm);
+}
+
+polycall_sm_status_t polycall_sm_set_transition_async(
+    PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    PolyCall_AsyncAction async_action
+) {
+    if (!sm || !sm->is_initialized) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    if (transition_id >= sm->num_transitions) 
+        return POLYCALL_SM_ERROR_INVALID_TRANSITION;
+
+    sm->transitions[transition_id].is_async = true;
+    sm->transitions[transition_id].async_action = async_action;
+    sm->layout_dirty = true;
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_set_worker_pool(
+    PolyCall_StateMachine* sm,
+    polycall_worker_pool_t* pool
+) {
+    if (!sm || !sm->is_initialized) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    sm->worker_pool = pool;
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_set_wal(
+    PolyCall_StateMachine* sm,
+    polycall_sm_wal_t* wal,
+    uint64_t machine_id
+) {
+    if (!sm || !sm->is_initialized) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    sm->wal = wal;
+    sm->machine_id = machine_id;
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_recover_state(
+    PolyCall_StateMachine* sm,
+    unsigned int state_id,
+    unsigned int version,
+    uint64_t timestamp
+) {
+    if (!sm || !sm->is_initialized) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    if (state_id >= sm->num_states) 
+        return POLYCALL_SM_ERROR_INVALID_STATE;
+
+    sm->current_state = state_id;
+    sm->states[state_id].version = version;
+    sm->states[state_id].timestamp = timestamp;
+    sm->states[state_id].checksum = calculate_state_checksum(&sm->states[state_id]);
+    mark_state_dirty(sm, state_id);
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_restore_state_fields(
+    PolyCall_StateMachine* sm,
+    unsigned int state_id,
+    unsigned int version,
+    uint64_t timestamp,
+    bool is_locked
+) {
+    if (!sm || !sm->is_initialized) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    if (state_id >= sm->num_states) 
+        return POLYCALL_SM_ERROR_INVALID_STATE;
+
+    PolyCall_State* state = &sm->states[state_id];
+    state->version = version;
+    state->timestamp = timestamp;
+    state->is_locked = is_locked;
+    state->checksum = calculate_state_checksum(state);
     return POLYCALL_SM_SUCCESS;
 }
 
@@ -180,13 +748,14 @@ polycall_sm_status_t polycall_sm_verify_state_integrity(
 
     PolyCall_State* state = &sm->states[state_id];
     uint32_t current_checksum = calculate_state_checksum(state);
+    sm->state_stats[state_id].integrity_check_count++;
+    mark_state_dirty(sm, state_id);
 
-    if (current_checksum != state->checksum) {
-        sm->diagnostics.integrity_violations++;
-        return POLYCALL_SM_ERROR_INTEGRITY_CHECK_FAILED;
-    }
+    bool valid = current_checksum == state->checksum &&
+                 (!sm->integrity_check || sm->integrity_check(state));
+    POLYCALL_TRACE3(integrity_check, sm->machine_id, state_id, valid);
 
-    if (sm->integrity_check && !sm->integrity_check(state)) {
+    if (!valid) {
         sm->diagnostics.integrity_violations++;
         return POLYCALL_SM_ERROR_INTEGRITY_CHECK_FAILED;
     }
@@ -208,6 +777,7 @@ polycall_sm_status_t polycall_sm_lock_state(
 
     sm->states[state_id].is_locked = true;
     update_state_timestamp(&sm->states[state_id]);
+    mark_state_dirty(sm, state_id);
     return POLYCALL_SM_SUCCESS;
 }
 
@@ -223,6 +793,7 @@ polycall_sm_status_t polycall_sm_unlock_state(
 
     sm->states[state_id].is_locked = false;
     update_state_timestamp(&sm->states[state_id]);
+    mark_state_dirty(sm, state_id);
     return POLYCALL_SM_SUCCESS;
 }
 
@@ -267,6 +838,7 @@ polycall_sm_status_t polycall_sm_restore_state_from_snapshot(
 
     memcpy(state, &snapshot->state, sizeof(PolyCall_State));
     update_state_timestamp(state);
+    mark_state_dirty(sm, snapshot->state.id);
 
     return POLYCALL_SM_SUCCESS;
 }
@@ -306,8 +878,207 @@ polycall_sm_status_t polycall_sm_get_state_diagnostics(
     diagnostics->last_modified = state->timestamp;
     diagnostics->is_locked = state->is_locked;
     diagnostics->current_checksum = state->checksum;
-    diagnostics->transition_count = 0;  /* Updated in future implementation */
-    diagnostics->integrity_check_count = 0;  /* Updated in future implementation */
+    diagnostics->transition_count = sm->state_stats[state_id].transition_count;
+    diagnostics->integrity_check_count = sm->state_stats[state_id].integrity_check_count;
 
     return POLYCALL_SM_SUCCESS;
-}
\ No newline at end of file
+}
+
+/* Instrumentation functions */
+
+polycall_sm_status_t polycall_sm_enable_instrumentation(
+    PolyCall_StateMachine* sm,
+    bool enable
+) {
+    if (!sm || !sm->is_initialized) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    struct PolyCall_SMInstrumentation* inst = sm->instrumentation;
+    if (!inst) {
+        if (!enable) return POLYCALL_SM_SUCCESS;
+        inst = polycall_mem_calloc(sm->ctx, 1, sizeof(struct PolyCall_SMInstrumentation));
+        if (!inst) return POLYCALL_SM_ERROR_OUT_OF_MEMORY;
+        inst->ctx = sm->ctx;
+        atomic_init(&inst->enabled, true);
+        __atomic_store_n(&sm->instrumentation, inst, __ATOMIC_RELEASE);
+        return POLYCALL_SM_SUCCESS;
+    }
+
+    // Never freed here: readers on other threads may hold the block
+    atomic_store_explicit(&inst->enabled, enable, memory_order_relaxed);
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_get_transition_stats(
+    const PolyCall_StateMachine* sm,
+    unsigned int transition_id,
+    PolyCall_TransitionStats* stats
+) {
+    if (!sm || !sm->is_initialized || !stats) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+    
+    if (transition_id >= sm->num_transitions) 
+        return POLYCALL_SM_ERROR_INVALID_TRANSITION;
+
+    const struct PolyCall_SMInstrumentation* inst = instrumentation_of(sm);
+    const stats_slot_t* slot =
+        inst ? __atomic_load_n(&inst->transitions[transition_id], __ATOMIC_ACQUIRE) : NULL;
+    if (!slot) {
+        memset(stats, 0, sizeof(PolyCall_TransitionStats));
+        return POLYCALL_SM_SUCCESS;
+    }
+
+    /* Retry until a copy was not overlapped by a write; the writer holds
+     * the sequence odd only for the few stores of one record */
+    for (;;) {
+        uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (!(before & 1)) {
+            stats->count = __atomic_load_n(&slot->stats.count, __ATOMIC_ACQUIRE);
+            stats->failures = __atomic_load_n(&slot->stats.failures, __ATOMIC_ACQUIRE);
+            for (int phase = 0; phase < POLYCALL_SM_PHASE_COUNT; phase++) {
+                shared_histogram_load(&stats->phases[phase], &slot->stats.phases[phase]);
+            }
+            shared_histogram_load(&stats->total, &slot->stats.total);
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == before) break;
+        }
+        sched_yield();
+    }
+
+    return POLYCALL_SM_SUCCESS;
+}
+
+polycall_sm_status_t polycall_sm_get_transition_history(
+    const PolyCall_StateMachine* sm,
+    PolyCall_TransitionRecord* records,
+    size_t max_records,
+    size_t* record_count
+) {
+    if (!sm || !sm->is_initialized || !records || !record_count) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    *record_count = 0;
+    struct PolyCall_SMInstrumentation* inst = instrumentation_of(sm);
+    if (!inst) return POLYCALL_SM_SUCCESS;
+
+    uint64_t head = atomic_load_explicit(&inst->history_head, memory_order_acquire);
+    uint64_t available = head < POLYCALL_SM_HISTORY_SIZE ? head : POLYCALL_SM_HISTORY_SIZE;
+    if (available > max_records) available = max_records;
+
+    /* Walk newest to oldest; slots overwritten while we read are skipped */
+    for (uint64_t i = 0; i < available; i++) {
+        uint64_t sequence = head - 1 - i;
+        history_slot_t* slot = &inst->history[sequence % POLYCALL_SM_HISTORY_SIZE];
+
+        const PolyCall_TransitionRecord* record = &slot->record;
+
+        uint64_t before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (before != sequence * 2 + 2) continue;
+        PolyCall_TransitionRecord copy = {
+            .sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE),
+            .start_ns = __atomic_load_n(&record->start_ns, __ATOMIC_ACQUIRE),
+            .duration_ns = __atomic_load_n(&record->duration_ns, __ATOMIC_ACQUIRE),
+            .transition_id = __atomic_load_n(&record->transition_id, __ATOMIC_ACQUIRE),
+            .from_state = __atomic_load_n(&record->from_state, __ATOMIC_ACQUIRE),
+            .to_state = __atomic_load_n(&record->to_state, __ATOMIC_ACQUIRE),
+            .status = __atomic_load_n(&record->status, __ATOMIC_ACQUIRE)
+        };
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != before) continue;
+
+        records[(*record_count)++] = copy;
+    }
+
+    return POLYCALL_SM_SUCCESS;
+}
+
+// Names come from definitions and add_state, so quote them properly
+static void export_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+            fputc(*c, out);
+        } else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void export_histogram(FILE* out, const polycall_histogram_t* hist) {
+    fprintf(out, "{\"count\":%llu,\"mean\":%.1f,\"min\":%llu,\"p50\":%llu,"
+                 "\"p90\":%llu,\"p99\":%llu,\"max\":%llu}",
+            (unsigned long long)hist->count,
+            polycall_histogram_mean(hist),
+            (unsigned long long)hist->min,
+            (unsigned long long)polycall_histogram_percentile(hist, 50.0),
+            (unsigned long long)polycall_histogram_percentile(hist, 90.0),
+            (unsigned long long)polycall_histogram_percentile(hist, 99.0),
+            (unsigned long long)hist->max);
+}
+
+polycall_sm_status_t polycall_sm_export_stats(
+    const PolyCall_StateMachine* sm,
+    FILE* out
+) {
+    static const char* phase_names[POLYCALL_SM_PHASE_COUNT] = {
+        "guard", "on_exit", "action", "on_enter"
+    };
+
+    if (!sm || !sm->is_initialized || !out) 
+        return POLYCALL_SM_ERROR_NOT_INITIALIZED;
+
+    fprintf(out, "{\"current_state\":%u,\"failed_transitions\":%u,"
+                 "\"integrity_violations\":%u,\"states\":[",
+            sm->current_state,
+            sm->diagnostics.failed_transitions,
+            sm->diagnostics.integrity_violations);
+
+    for (unsigned int i = 0; i < sm->num_states; i++) {
+        fprintf(out, "%s{\"id\":%u,\"name\":", i ? "," : "", i);
+        export_string(out, sm->states[i].name);
+        fprintf(out, ",\"transition_count\":%u,\"integrity_check_count\":%u}",
+                sm->state_stats[i].transition_count,
+                sm->state_stats[i].integrity_check_count);
+    }
+
+    fprintf(out, "],\"transitions\":[");
+    for (unsigned int i = 0; i < sm->num_transitions; i++) {
+        PolyCall_TransitionStats stats;
+        polycall_sm_get_transition_stats(sm, i, &stats);
+
+        fprintf(out, "%s{\"id\":%u,\"name\":", i ? "," : "", i);
+        export_string(out, sm->transitions[i].name);
+        fprintf(out, ",\"count\":%llu,\"failures\":%llu,\"total_ns\":",
+                (unsigned long long)stats.count,
+                (unsigned long long)stats.failures);
+        export_histogram(out, &stats.total);
+        for (int phase = 0; phase < POLYCALL_SM_PHASE_COUNT; phase++) {
+            fprintf(out, ",\"%s_ns\":", phase_names[phase]);
+            export_histogram(out, &stats.phases[phase]);
+        }
+        fprintf(out, "}");
+    }
+
+    PolyCall_TransitionRecord history[POLYCALL_SM_HISTORY_SIZE];
+    size_t history_count = 0;
+    polycall_sm_get_transition_history(sm, history, POLYCALL_SM_HISTORY_SIZE, &history_count);
+
+    fprintf(out, "],\"history\":[");
+    for (size_t i = 0; i < history_count; i++) {
+        fprintf(out, "%s{\"sequence\":%llu,\"transition\":%u,\"from\":%u,\"to\":%u,"
+                     "\"status\":%d,\"start_ns\":%llu,\"duration_ns\":%llu}",
+                i ? "," : "",
+                (unsigned long long)history[i].sequence,
+                history[i].transition_id,
+                history[i].from_state,
+                history[i].to_state,
+                (int)history[i].status,
+                (unsigned long long)history[i].start_ns,
+                (unsigned long long)history[i].duration_ns);
+    }
+    fprintf(out, "]}\n");
+
+    return POLYCALL_SM_SUCCESS;
+}
@@ -0,0 +1,472 @@
+#include "polycall_worker_pool.h"
+#include "polycall_queue.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define DEQUE_INITIAL_CAPACITY 256
+#define STRAND_BATCH 32
+#define STEAL_ATTEMPTS 2
+#define INJECT_CAPACITY 4096
+
+typedef struct worker_task {
+    polycall_task_fn fn;
+    void* arg;
+    struct worker_task* next;
+} worker_task_t;
+
+// Chase-Lev deque (Le et al., "Correct and Efficient Work-Stealing for
+// Weak Memory Models"). The owner pushes and takes at bottom, thieves
+// steal at top. Fences are folded into seq_cst accesses so the ordering
+// is visible to ThreadSanitizer.
+typedef struct deque_array {
+    int64_t mask;
+    struct deque_array* retired;    // Previous array, freed with the pool
+    worker_task_t* slots[];
+} deque_array_t;
+
+typedef struct {
+    _Alignas(64) int64_t top;
+    _Alignas(64) int64_t bottom;
+    deque_array_t* array;
+} ws_deque_t;
+
+typedef struct {
+    ws_deque_t deque;
+    polycall_worker_pool_t* pool;
+    uint64_t rng;                   // Victim selection
+} worker_t;
+
+// Ordered tasks queue on a strand; at most one runner per strand is
+// scheduled, so its tasks run one at a time in submission order
+typedef struct {
+    pthread_mutex_t lock;
+    worker_task_t* head;
+    worker_task_t* tail;
+    bool scheduled;
+    polycall_worker_pool_t* pool;
+} strand_t;
+
+struct polycall_worker_pool {
+    polycall_mpmc_t* injected;      // Tasks from non-worker threads
+    pthread_mutex_t lock;           // Overflow list and sleeping workers
+    pthread_cond_t available;
+    worker_task_t* head;            // Overflow once injected is full
+    worker_task_t* tail;
+    bool stopping;
+    int sleepers;
+    pthread_t* threads;
+    worker_t* workers;              // Deques, worker_count of them
+    unsigned int worker_count;
+    unsigned int thread_count;
+    strand_t strands[POLYCALL_WORKER_POOL_STRANDS];
+};
+
+static _Thread_local worker_t* current_worker;
+
+static deque_array_t* deque_array_create(int64_t capacity) {
+    deque_array_t* array = malloc(sizeof(deque_array_t) + (size_t)capacity * sizeof(worker_task_t*));
+    if (!array) return NULL;
+    array->mask = capacity - 1;
+    array->retired = NULL;
+    return array;
+}
+
+static bool deque_init(ws_deque_t* deque) {
+    deque->top = 0;
+    deque->bottom = 0;
+    deque->array = deque_array_create(DEQUE_INITIAL_CAPACITY);
+    return deque->array != NULL;
+}
+
+static void deque_free(ws_deque_t* deque) {
+    deque_array_t* array = deque->array;
+    while (array) {
+        deque_array_t* retired = array->retired;
+        free(array);
+        array = retired;
+    }
+    deque->array = NULL;
+}
+
+// Owner only
+static bool deque_push(ws_deque_t* deque, worker_task_t* task) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    deque_array_t* array = __atomic_load_n(&deque->array, __ATOMIC_RELAXED);
+
+    if (bottom - top > array->mask) {
+        // Full: double, keeping the old array alive for in-flight thieves
+        deque_array_t* grown = deque_array_create((array->mask + 1) * 2);
+        if (!grown) return false;
+        for (int64_t i = top; i < bottom; i++) {
+            grown->slots[i & grown->mask] =
+                __atomic_load_n(&array->slots[i & array->mask], __ATOMIC_RELAXED);
+        }
+        grown->retired = array;
+        __atomic_store_n(&deque->array, grown, __ATOMIC_RELEASE);
+        array = grown;
+    }
+
+    __atomic_store_n(&array->slots[bottom & array->mask], task, __ATOMIC_RELAXED);
+    // seq_cst pairs with the sleeper count check in wake_one
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+// Owner only, newest first
+static worker_task_t* deque_take(ws_deque_t* deque) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    deque_array_t* array = __atomic_load_n(&deque->array, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+
+    if (top > bottom) {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    worker_task_t* task = __atomic_load_n(&array->slots[bottom & array->mask], __ATOMIC_RELAXED);
+    if (top == bottom) {
+        // Last task: race thieves for it
+        if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            task = NULL;
+        }
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+// Any thread, oldest first; NULL when empty or the race was lost
+static worker_task_t* deque_steal(ws_deque_t* deque) {
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST);
+    if (top >= bottom) return NULL;
+
+    deque_array_t* array = __atomic_load_n(&deque->array, __ATOMIC_ACQUIRE);
+    worker_task_t* task = __atomic_load_n(&array->slots[top & array->mask], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return task;
+}
+
+static bool deque_empty(ws_deque_t* deque) {
+    return __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST) >=
+           __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST);
+}
+
+static void wake_one(polycall_worker_pool_t* pool) {
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST) == 0) return;
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Workers push onto their own deque, other threads onto the injection
+// queue, spilling to the locked overflow list only when that is full
+static bool schedule(polycall_worker_pool_t* pool, worker_task_t* task, bool external) {
+    worker_t* self = current_worker;
+    if (self && self->pool == pool && deque_push(&self->deque, task)) {
+        wake_one(pool);
+        return true;
+    }
+
+    if (external && __atomic_load_n(&pool->stopping, __ATOMIC_ACQUIRE)) return false;
+    if (polycall_mpmc_push(pool->injected, &task)) {
+        wake_one(pool);
+        return true;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (external && pool->stopping) {
+        pthread_mutex_unlock(&pool->lock);
+        return false;
+    }
+    task->next = NULL;
+    if (pool->tail) pool->tail->next = task;
+    else __atomic_store_n(&pool->head, task, __ATOMIC_RELAXED);
+    pool->tail = task;
+    if (pool->sleepers > 0) pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+static worker_task_t* pop_injected(polycall_worker_pool_t* pool) {
+    worker_task_t* injected;
+    if (polycall_mpmc_pop(pool->injected, &injected)) return injected;
+    if (!__atomic_load_n(&pool->head, __ATOMIC_RELAXED)) return NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    worker_task_t* task = pool->head;
+    if (task) {
+        __atomic_store_n(&pool->head, task->next, __ATOMIC_RELAXED);
+        if (!pool->head) pool->tail = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return task;
+}
+
+static uint64_t next_random(worker_t* worker) {
+    worker->rng ^= worker->rng << 13;
+    worker->rng ^= worker->rng >> 7;
+    worker->rng ^= worker->rng << 17;
+    return worker->rng;
+}
+
+static worker_task_t* steal_any(worker_t* self) {
+    polycall_worker_pool_t* pool = self->pool;
+    unsigned int count = pool->worker_count;
+    if (count < 2) return NULL;
+
+    for (int attempt = 0; attempt < STEAL_ATTEMPTS; attempt++) {
+        unsigned int start = (unsigned int)(next_random(self) % count);
+        for (unsigned int i = 0; i < count; i++) {
+            worker_t* victim = &pool->workers[(start + i) % count];
+            if (victim == self) continue;
+            worker_task_t* task = deque_steal(&victim->deque);
+            if (task) return task;
+        }
+    }
+    return NULL;
+}
+
+static worker_task_t* find_task(worker_t* self) {
+    worker_task_t* task = deque_take(&self->deque);
+    if (!task) task = pop_injected(self->pool);
+    if (!task) task = steal_any(self);
+    return task;
+}
+
+static bool any_work(polycall_worker_pool_t* pool) {
+    if (pool->head) return true;    // Caller holds pool->lock
+    if (polycall_mpmc_size(pool->injected) > 0) return true;
+    for (unsigned int i = 0; i < pool->worker_count; i++) {
+        if (!deque_empty(&pool->workers[i].deque)) return true;
+    }
+    return false;
+}
+
+static void* worker_main(void* arg) {
+    worker_t* self = (worker_t*)arg;
+    polycall_worker_pool_t* pool = self->pool;
+    current_worker = self;
+
+    for (;;) {
+        worker_task_t* task = find_task(self);
+        if (task) {
+            task->fn(task->arg);
+            free(task);
+            continue;
+        }
+
+        // Announce as a sleeper before re-checking, so a concurrent push
+        // either is seen here or sees the sleeper and signals
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        bool idle = !any_work(pool);
+        if (idle && pool->stopping) {
+            // Stopping and fully drained
+            __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+            pthread_cond_broadcast(&pool->available);
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        if (idle) pthread_cond_wait(&pool->available, &pool->lock);
+        __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    current_worker = NULL;
+    return NULL;
+}
+
+static worker_task_t* task_create(polycall_task_fn fn, void* arg) {
+    worker_task_t* task = malloc(sizeof(worker_task_t));
+    if (!task) return NULL;
+    task->fn = fn;
+    task->arg = arg;
+    task->next = NULL;
+    return task;
+}
+
+static void strand_run(void* arg) {
+    strand_t* strand = (strand_t*)arg;
+
+    for (int i = 0; i < STRAND_BATCH; i++) {
+        pthread_mutex_lock(&strand->lock);
+        worker_task_t* task = strand->head;
+        if (!task) {
+            strand->scheduled = false;
+            pthread_mutex_unlock(&strand->lock);
+            return;
+        }
+        strand->head = task->next;
+        if (!strand->head) strand->tail = NULL;
+        pthread_mutex_unlock(&strand->lock);
+
+        task->fn(task->arg);
+        free(task);
+    }
+
+    // Yield to other work, staying scheduled so order is kept
+    worker_task_t* runner = task_create(strand_run, strand);
+    if (!runner || !schedule(strand->pool, runner, false)) {
+        free(runner);
+        strand_run(strand);
+    }
+}
+
+polycall_status_t polycall_worker_pool_create(
+    unsigned int thread_count,
+    polycall_worker_pool_t** pool
+) {
+    if (!pool) return POLYCALL_ERROR_INVALID_PARAMETERS;
+
+    if (thread_count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (unsigned int)cpus : 1;
+    }
+
+    polycall_worker_pool_t* p = calloc(1, sizeof(polycall_worker_pool_t));
+    if (!p) return POLYCALL_ERROR_OUT_OF_MEMORY;
+
+    p->injected = polycall_mpmc_create(INJECT_CAPACITY, sizeof(worker_task_t*));
+    p->threads = calloc(thread_count, sizeof(pthread_t));
+    p->workers = aligned_alloc(64, ((thread_count * sizeof(worker_t)) + 63) & ~(size_t)63);
+    if (!p->injected || !p->threads || !p->workers) {
+        polycall_mpmc_destroy(p->injected);
+        free(p->threads);
+        free(p->workers);
+        free(p);
+        return POLYCALL_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (unsigned int i = 0; i < thread_count; i++) {
+        worker_t* worker = &p->workers[i];
+        if (!deque_init(&worker->deque)) {
+            while (i-- > 0) deque_free(&p->workers[i].deque);
+            polycall_mpmc_destroy(p->injected);
+            free(p->threads);
+            free(p->workers);
+            free(p);
+            return POLYCALL_ERROR_OUT_OF_MEMORY;
+        }
+        worker->pool = p;
+        worker->rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->available, NULL);
+    for (unsigned int i = 0; i < POLYCALL_WORKER_POOL_STRANDS; i++) {
+        pthread_mutex_init(&p->strands[i].lock, NULL);
+        p->strands[i].pool = p;
+    }
+
+    p->worker_count = thread_count;
+    for (unsigned int i = 0; i < thread_count; i++) {
+        if (pthread_create(&p->threads[i], NULL, worker_main, &p->workers[i]) != 0) {
+            polycall_worker_pool_destroy(p);
+            return POLYCALL_ERROR_INITIALIZATION_FAILED;
+        }
+        p->thread_count = i + 1;
+    }
+
+    *pool = p;
+    return POLYCALL_SUCCESS;
+}
+
+bool polycall_worker_pool_submit(
+    polycall_worker_pool_t* pool,
+    polycall_task_fn fn,
+    void* arg
+) {
+    if (!pool || !fn) return false;
+
+    worker_task_t* task = task_create(fn, arg);
+    if (!task) return false;
+    if (!schedule(pool, task, true)) {
+        free(task);
+        return false;
+    }
+    return true;
+}
+
+bool polycall_worker_pool_submit_ordered(
+    polycall_worker_pool_t* pool,
+    uint64_t key,
+    polycall_task_fn fn,
+    void* arg
+) {
+    if (!pool || !fn) return false;
+
+    worker_task_t* task = task_create(fn, arg);
+    if (!task) return false;
+
+    // Fibonacci hashing spreads sequential session ids across strands
+    uint64_t hash = (key * 0x9E3779B97F4A7C15ULL) >> 32;
+    strand_t* strand = &pool->strands[hash % POLYCALL_WORKER_POOL_STRANDS];
+
+    pthread_mutex_lock(&strand->lock);
+    if (__atomic_load_n(&pool->stopping, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_unlock(&strand->lock);
+        free(task);
+        return false;
+    }
+    if (strand->tail) strand->tail->next = task;
+    else strand->head = task;
+    strand->tail = task;
+    bool start = !strand->scheduled;
+    strand->scheduled = true;
+    pthread_mutex_unlock(&strand->lock);
+
+    if (start) {
+        worker_task_t* runner = task_create(strand_run, strand);
+        if (!runner || !schedule(pool, runner, false)) {
+            // Cannot fail once queued; run the strand here rather than strand it
+            free(runner);
+            strand_run(strand);
+        }
+    }
+    return true;
+}
+
+unsigned int polycall_worker_pool_size(const polycall_worker_pool_t* pool) {
+    return pool ? pool->thread_count : 0;
+}
+
+void polycall_worker_pool_destroy(polycall_worker_pool_t* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->stopping, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    // Submissions that raced the stop flag past the last worker run here
+    worker_task_t* task;
+    while ((task = pop_injected(pool)) != NULL) {
+        task->fn(task->arg);
+        free(task);
+    }
+
+    for (unsigned int i = 0; i < POLYCALL_WORKER_POOL_STRANDS; i++) {
+        pthread_mutex_destroy(&pool->strands[i].lock);
+    }
+    for (unsigned int i = 0; i < pool->worker_count; i++) {
+        deque_free(&pool->workers[i].deque);
+    }
+    polycall_mpmc_destroy(pool->injected);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->available);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,147 @@
+// test_cpp.cpp - C++ coroutine layer and typed commands over a loopback pair
+#include "polycall.hpp"
+#include "polycall_command.hpp"
+#include "test_util.h"
+#include <cstdio>
+#include <optional>
+#include <string_view>
+
+struct add_request { std::int32_t a, b; };
+struct add_response { std::int64_t sum; };
+struct flags_request { bool verbose; std::array<std::uint16_t, 3> ports; };
+struct flags_response { std::uint32_t mask; };
+
+POLYCALL_LAYOUT(add_request, &add_request::a, &add_request::b);
+POLYCALL_LAYOUT(add_response, &add_response::sum);
+POLYCALL_LAYOUT(flags_request, &flags_request::verbose, &flags_request::ports);
+POLYCALL_LAYOUT(flags_response, &flags_response::mask);
+
+using add = polycall::command<"add", add_request, add_response>;
+using flags = polycall::command<"flags", flags_request, flags_response>;
+using unserved = polycall::command<"unserved", add_request, add_response>;
+
+static_assert(add::request_size == 4 + 8);
+static_assert(flags::request_size == 4 + 1 + 6);
+static_assert(add::id == polycall::command_id("add"));
+
+// Every handler takes the leading arguments serve() forwards
+static add_response do_add(int& calls, const add_request& r) {
+    calls++;
+    return {std::int64_t{r.a} + r.b};
+}
+
+static flags_response do_flags(int& calls, const flags_request& r) {
+    calls++;
+    return {(r.verbose ? 1u : 0u) | (std::uint32_t{r.ports[2]} << 1)};
+}
+
+static constexpr polycall::dispatcher<polycall::handler<add, do_add>,
+                                      polycall::handler<flags, do_flags>> commands;
+static_assert(commands.handles(add::id) && commands.handles(flags::id));
+static_assert(!commands.handles(unserved::id));
+
+// Raw calls against an echo handler on the other end of the pair
+static polycall::task<> echo(polycall::session& peer) {
+    for (;;) {
+        polycall::message request = co_await peer.next_command();
+        if (!request.ok) co_return;
+        peer.respond(request.payload);
+    }
+}
+
+static polycall::task<> raw_client(polycall::session& peer, bool& done) {
+    for (int i = 0; i < 10; i++) {
+        polycall::message reply = co_await peer.call(polycall::bytes("ping"));
+        CHECK(reply.ok);
+        CHECK(polycall::text(reply.payload) == "ping");
+    }
+    done = true;
+}
+
+static polycall::task<> typed_client(polycall::session& peer, bool& done) {
+    std::optional<add_response> sum = co_await polycall::call<add>(peer, {2, -5});
+    CHECK(sum && sum->sum == -3);
+
+    std::optional<flags_response> mask =
+        co_await polycall::call<flags>(peer, {true, {80, 443, 7}});
+    CHECK(mask && mask->mask == (1u | (7u << 1)));
+
+    // Answered with an ERROR message, not a response
+    std::optional<add_response> missing = co_await polycall::call<unserved>(peer, {1, 1});
+    CHECK(!missing);
+    done = true;
+}
+
+static void drive(polycall::event_loop& loop, const bool& done) {
+    for (int i = 0; i < 10000 && !done; i++) loop.run_once(10);
+    CHECK(done);
+}
+
+static void test_raw_calls(polycall::context& ctx) {
+    auto [client_end, server_end] = polycall::endpoint::loopback_pair();
+    polycall::session client(ctx, client_end);
+    polycall::session server(ctx, server_end);
+
+    bool done = false;
+    polycall::event_loop loop;
+    loop.spawn(echo(server));
+    loop.spawn(raw_client(client, done));
+    drive(loop, done);
+}
+
+static void test_typed_commands(polycall::context& ctx) {
+    auto [client_end, server_end] = polycall::endpoint::loopback_pair();
+    polycall::session client(ctx, client_end);
+    polycall::session server(ctx, server_end);
+
+    int calls = 0;
+    bool done = false;
+    polycall::event_loop loop;
+    loop.spawn(polycall::serve(server, commands, calls));
+    loop.spawn(typed_client(client, done));
+    drive(loop, done);
+    CHECK(calls == 2);
+
+    // Dispatch without a session: bad sizes and unknown ids are reported
+    std::array<std::byte, 4> short_add{};
+    polycall::codec<std::uint32_t>::encode(add::id, short_add.data());
+    auto ignore = [](std::span<const std::byte>) {};
+    CHECK(commands.dispatch(short_add, ignore, calls) == polycall::dispatch_status::malformed);
+    polycall::codec<std::uint32_t>::encode(unserved::id, short_add.data());
+    CHECK(commands.dispatch(short_add, ignore, calls) ==
+          polycall::dispatch_status::unknown_command);
+}
+
+static polycall::task<> unknown_transition(polycall::state_machine& sm, bool& done) {
+    polycall_sm_status_t status = co_await sm.transition("missing");
+    CHECK(status != POLYCALL_SM_SUCCESS);
+    done = true;
+}
+
+static void test_state_machine(polycall::context& ctx) {
+    polycall::state_machine sm(ctx);
+    bool done = false;
+    polycall::event_loop loop;
+    loop.spawn(unknown_transition(sm, done));
+    drive(loop, done);
+}
+
+int main() {
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    try {
+        polycall::context ctx(&config);
+        test_raw_calls(ctx);
+        test_typed_commands(ctx);
+        test_state_machine(ctx);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "test_cpp: %s\n", e.what());
+        return 1;
+    }
+
+    if (failures) {
+        std::fprintf(stderr, "test_cpp: %d failures\n", failures);
+        return 1;
+    }
+    std::printf("test_cpp: ok\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+// test_error.c - Thread-local error records and their lazily rendered text
+#include "polycall.h"
+#include "polycall_error.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+static polycall_context_t ctx;
+
+static void test_set_and_clear(void) {
+    polycall_error_clear();
+    CHECK(polycall_error_code() == POLYCALL_ERR_NONE);
+    CHECK(strcmp(polycall_error_message(), "") == 0);
+
+    polycall_error_set(POLYCALL_ERR_REGISTRY, "Registry full");
+    CHECK(polycall_error_code() == POLYCALL_ERR_REGISTRY);
+    CHECK(strcmp(polycall_error_message(), "Registry full") == 0);
+    CHECK(strcmp(polycall_get_last_error(ctx), polycall_error_message()) == 0);
+
+    polycall_error_clear();
+    CHECK(polycall_error_code() == POLYCALL_ERR_NONE);
+    CHECK(strcmp(polycall_error_message(), "") == 0);
+    CHECK(strcmp(polycall_get_last_error(ctx), "") == 0);
+}
+
+static void test_detail_rendering(void) {
+    polycall_error_set_detail(POLYCALL_ERR_PROTOCOL_SIZE, "Message too large",
+                              "%lld > %lld bytes", 5000, 4096);
+    CHECK(polycall_error_code() == POLYCALL_ERR_PROTOCOL_SIZE);
+    const char* text = polycall_error_message();
+    CHECK(strcmp(text, "Message too large: 5000 > 4096 bytes") == 0);
+    // A second read reuses the rendered text
+    CHECK(polycall_error_message() == text);
+    CHECK(strcmp(polycall_get_last_error(ctx), text) == 0);
+
+    // A new detailed error renders again instead of returning the stale text
+    polycall_error_set_detail(POLYCALL_ERR_PROTOCOL_SIZE, "Message too large",
+                              "%lld > %lld bytes", 9000, 4096);
+    CHECK(strcmp(polycall_error_message(), "Message too large: 9000 > 4096 bytes") == 0);
+
+    // A plain error after a detailed one drops the detail
+    polycall_error_set(POLYCALL_ERR_PROTOCOL_CHECKSUM, "Checksum mismatch");
+    CHECK(strcmp(polycall_error_message(), "Checksum mismatch") == 0);
+    CHECK(strcmp(polycall_get_last_error(ctx), "Checksum mismatch") == 0);
+
+    polycall_error_clear();
+}
+
+typedef struct {
+    int seen_code;
+    char seen_text[POLYCALL_ERROR_TEXT_LENGTH];
+} probe_t;
+
+static void* probe_main(void* arg) {
+    probe_t* probe = arg;
+    probe->seen_code = polycall_error_code();
+    snprintf(probe->seen_text, sizeof(probe->seen_text), "%s", polycall_get_last_error(ctx));
+
+    // Leave an error behind on this thread; the caller must not see it
+    polycall_error_set_detail(POLYCALL_ERR_STATE_MACHINE, "Transition failed",
+                              "id %lld", 7, 0);
+    return NULL;
+}
+
+static void test_thread_isolation(void) {
+    polycall_error_set_detail(POLYCALL_ERR_SESSION_EXISTS, "Session exists",
+                              "id %lld", 42, 0);
+
+    probe_t probe = { -1, "unset" };
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, probe_main, &probe) == 0);
+    pthread_join(thread, NULL);
+
+    CHECK(probe.seen_code == POLYCALL_ERR_NONE);
+    CHECK(strcmp(probe.seen_text, "") == 0);
+
+    CHECK(polycall_error_code() == POLYCALL_ERR_SESSION_EXISTS);
+    CHECK(strcmp(polycall_error_message(), "Session exists: id 42") == 0);
+    CHECK(strcmp(polycall_get_last_error(ctx), "Session exists: id 42") == 0);
+
+    polycall_error_clear();
+}
+
+int main(void) {
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_error: context init failed\n");
+        return 1;
+    }
+
+    test_set_and_clear();
+    test_detail_rendering();
+    test_thread_isolation();
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_error: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_error: ok\n");
+    return 0;
+}
@@ -0,0 +1,159 @@
+// test_memory.c - Per-context arena, size classes and thread caches
+#include "polycall.h"
+#include "polycall_memory.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORKERS 4
+#define WORKER_ROUNDS 2000
+
+static bool all_zero(const uint8_t* bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (bytes[i]) return false;
+    }
+    return true;
+}
+
+static void test_arena(polycall_context_t ctx) {
+    polycall_memory_stats_t before, after;
+    CHECK(polycall_mem_get_stats(ctx, &before) == POLYCALL_SUCCESS);
+    CHECK(before.chunks == 1);
+
+    // Zeroed, aligned, and rounded up to the alignment
+    uint8_t* first = polycall_mem_arena_alloc(ctx, 24);
+    uint8_t* second = polycall_mem_arena_alloc(ctx, 1);
+    CHECK(first && second);
+    CHECK(((uintptr_t)first & 15) == 0);
+    CHECK(((uintptr_t)second & 15) == 0);
+    CHECK(second == first + 32);
+    CHECK(all_zero(first, 24));
+    CHECK(polycall_mem_get_stats(ctx, &after) == POLYCALL_SUCCESS);
+    CHECK(after.arena_used == before.arena_used + 48);
+
+    // Larger than a chunk: a dedicated chunk, the bump region stays put
+    uint8_t* big = polycall_mem_arena_alloc(ctx, before.chunk_size + 1);
+    CHECK(big != NULL);
+    uint8_t* third = polycall_mem_arena_alloc(ctx, 16);
+    CHECK(third == second + 16);
+    CHECK(polycall_mem_get_stats(ctx, &after) == POLYCALL_SUCCESS);
+    CHECK(after.chunks == 2);
+
+    // Arena memory is never handed to free; the tag check ignores it
+    polycall_mem_free(ctx, first);
+    CHECK(polycall_mem_arena_alloc(NULL, 16) == NULL);
+}
+
+static void test_size_classes(polycall_context_t ctx) {
+    // A freed block comes straight back from the thread cache
+    void* block = polycall_mem_alloc(ctx, 100);
+    CHECK(block != NULL);
+    CHECK(((uintptr_t)block & 15) == 0);
+    polycall_mem_free(ctx, block);
+    CHECK(polycall_mem_alloc(ctx, 100) == block);
+    polycall_mem_free(ctx, block);
+
+    uint8_t* zeroed = polycall_mem_calloc(ctx, 10, 30);
+    CHECK(zeroed && all_zero(zeroed, 300));
+    polycall_mem_free(ctx, zeroed);
+    CHECK(polycall_mem_calloc(ctx, SIZE_MAX / 2, 4) == NULL);
+
+    // Above the largest class: heap backed but tracked by the context
+    polycall_memory_stats_t stats;
+    void* large = polycall_mem_alloc(ctx, POLYCALL_MEM_MAX_CLASS_SIZE + 1);
+    CHECK(large != NULL);
+    CHECK(polycall_mem_get_stats(ctx, &stats) == POLYCALL_SUCCESS);
+    CHECK(stats.large_bytes == POLYCALL_MEM_MAX_CLASS_SIZE + 1);
+    polycall_mem_free(ctx, large);
+    CHECK(polycall_mem_get_stats(ctx, &stats) == POLYCALL_SUCCESS);
+    CHECK(stats.large_bytes == 0);
+
+    // Blocks from another context are left alone
+    polycall_context_t other = NULL;
+    polycall_config_t config = { 0, 0, NULL };
+    CHECK(polycall_init_with_config(&other, &config) == POLYCALL_SUCCESS);
+    void* foreign = polycall_mem_alloc(other, 64);
+    polycall_mem_free(ctx, foreign);
+    CHECK(polycall_mem_alloc(ctx, 64) != foreign);
+    polycall_mem_free(other, foreign);
+    polycall_cleanup(other);
+}
+
+// Blocks allocated on one thread and freed on another
+static void* worker_main(void* arg) {
+    polycall_context_t ctx = (polycall_context_t)arg;
+    void* blocks[64];
+    for (int round = 0; round < WORKER_ROUNDS; round++) {
+        for (int i = 0; i < 64; i++) {
+            blocks[i] = polycall_mem_alloc(ctx, (size_t)(16 << (i % 8)));
+            CHECK(blocks[i] != NULL);
+            if (blocks[i]) memset(blocks[i], i, 16);
+        }
+        for (int i = 0; i < 64; i++) {
+            CHECK(blocks[i] == NULL || ((uint8_t*)blocks[i])[15] == i);
+            polycall_mem_free(ctx, blocks[i]);
+        }
+    }
+    return NULL;
+}
+
+static void test_threads(polycall_context_t ctx) {
+    pthread_t threads[WORKERS];
+    for (int i = 0; i < WORKERS; i++) {
+        CHECK(pthread_create(&threads[i], NULL, worker_main, ctx) == 0);
+    }
+    for (int i = 0; i < WORKERS; i++) pthread_join(threads[i], NULL);
+
+    // Exited threads returned their caches, so the arena stopped growing
+    polycall_memory_stats_t stats;
+    CHECK(polycall_mem_get_stats(ctx, &stats) == POLYCALL_SUCCESS);
+    size_t chunks = stats.chunks;
+    CHECK(pthread_create(&threads[0], NULL, worker_main, ctx) == 0);
+    pthread_join(threads[0], NULL);
+    CHECK(polycall_mem_get_stats(ctx, &stats) == POLYCALL_SUCCESS);
+    CHECK(stats.chunks == chunks);
+}
+
+// Mapped chunks behave like malloc'd ones whatever placement succeeds
+static void test_prefault(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 256 * 1024, NULL };
+    config.flags = POLYCALL_MEM_PREFAULT | POLYCALL_MEM_NUMA_LOCAL;
+    CHECK(polycall_init_with_config(&ctx, &config) == POLYCALL_SUCCESS);
+
+    uint8_t* object = polycall_mem_arena_alloc(ctx, 4096);
+    CHECK(object && all_zero(object, 4096));
+    void* block = polycall_mem_alloc(ctx, 1000);
+    CHECK(block != NULL);
+    polycall_mem_free(ctx, block);
+
+    polycall_memory_stats_t stats;
+    CHECK(polycall_mem_get_stats(ctx, &stats) == POLYCALL_SUCCESS);
+    CHECK(stats.chunk_size >= 256 * 1024);
+    polycall_cleanup(ctx);
+}
+
+int main(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_memory: context init failed\n");
+        return 1;
+    }
+
+    test_arena(ctx);
+    test_size_classes(ctx);
+    test_threads(ctx);
+    test_prefault();
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_memory: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_memory: ok\n");
+    return 0;
+}
@@ -0,0 +1,151 @@
+// test_metrics.c - Per-thread metric blocks, rendering and the HTTP endpoint
+#include "polycall.h"
+#include "polycall_metrics.h"
+#include "test_util.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define WORKERS 4
+#define WORKER_ADDS 10000
+
+static polycall_metric_sample_t samples[POLYCALL_METRICS_MAX];
+
+static const polycall_metric_sample_t* sample_of(polycall_metrics_t* metrics, polycall_metric_id_t id) {
+    size_t count = 0;
+    CHECK(polycall_metrics_snapshot(metrics, samples, POLYCALL_METRICS_MAX, &count) == POLYCALL_SUCCESS);
+    CHECK(id < count);
+    return &samples[id];
+}
+
+typedef struct {
+    polycall_metrics_t* metrics;
+    polycall_metric_id_t counter;
+    polycall_metric_id_t gauge;
+    polycall_metric_id_t histogram;
+} workload_t;
+
+static void* worker_main(void* arg) {
+    workload_t* work = (workload_t*)arg;
+    for (int i = 0; i < WORKER_ADDS; i++) {
+        polycall_metrics_counter_add(work->metrics, work->counter, 1);
+        polycall_metrics_gauge_add(work->metrics, work->gauge, i % 2 ? -1 : 2);
+        polycall_metrics_observe(work->metrics, work->histogram, (uint64_t)i);
+    }
+    return NULL;
+}
+
+static void test_registry(polycall_metrics_t* metrics) {
+    workload_t work = { metrics, 0, 0, 0 };
+    CHECK(polycall_metrics_register(metrics, POLYCALL_METRIC_COUNTER, "test_events_total",
+                                    "Events", "", &work.counter) == POLYCALL_SUCCESS);
+    CHECK(work.counter == POLYCALL_METRIC_BUILTIN_COUNT);
+    CHECK(polycall_metrics_register(metrics, POLYCALL_METRIC_GAUGE, "test_depth",
+                                    "Depth", "queue=\"a\"", &work.gauge) == POLYCALL_SUCCESS);
+    CHECK(polycall_metrics_register(metrics, POLYCALL_METRIC_HISTOGRAM, "test_latency_ns",
+                                    "Latency", "", &work.histogram) == POLYCALL_SUCCESS);
+    CHECK(polycall_metrics_register(metrics, POLYCALL_METRIC_COUNTER, "", "", "", &work.counter) ==
+          POLYCALL_ERROR_INVALID_PARAMETERS);
+
+    pthread_t threads[WORKERS];
+    for (int i = 0; i < WORKERS; i++) {
+        CHECK(pthread_create(&threads[i], NULL, worker_main, &work) == 0);
+    }
+    for (int i = 0; i < WORKERS; i++) pthread_join(threads[i], NULL);
+
+    CHECK(sample_of(metrics, work.counter)->counter == WORKERS * WORKER_ADDS);
+    CHECK(sample_of(metrics, work.gauge)->gauge == WORKERS * WORKER_ADDS / 2);
+    const polycall_metric_sample_t* latency = sample_of(metrics, work.histogram);
+    CHECK(latency->kind == POLYCALL_METRIC_HISTOGRAM);
+    CHECK(latency->histogram.count == WORKERS * WORKER_ADDS);
+    CHECK(latency->histogram.max == WORKER_ADDS - 1);
+
+    // Ids past the registered ones are dropped, not stored out of band
+    polycall_metric_id_t unregistered = work.histogram + 1;
+    polycall_metrics_counter_add(metrics, unregistered, 5);
+    polycall_metrics_gauge_add(metrics, POLYCALL_METRICS_MAX + 1, 5);
+    CHECK(polycall_metrics_register(metrics, POLYCALL_METRIC_COUNTER, "test_late_total",
+                                    "Registered after the stray add", "", &unregistered) == POLYCALL_SUCCESS);
+    CHECK(sample_of(metrics, unregistered)->counter == 0);
+}
+
+static void test_render(polycall_metrics_t* metrics) {
+    size_t length = polycall_metrics_render(metrics, NULL, 0);
+    CHECK(length > 0);
+    char* text = malloc(length + 1);
+    CHECK(polycall_metrics_render(metrics, text, length + 1) == length);
+    CHECK(strlen(text) == length);
+
+    char expected[64];
+    snprintf(expected, sizeof(expected), "test_events_total %d\n", WORKERS * WORKER_ADDS);
+    CHECK(strstr(text, expected) != NULL);
+    CHECK(strstr(text, "# TYPE test_depth gauge\n") != NULL);
+    CHECK(strstr(text, "test_depth{queue=\"a\"} ") != NULL);
+    CHECK(strstr(text, "test_latency_ns_bucket{le=\"+Inf\"} ") != NULL);
+    CHECK(strstr(text, "polycall_protocol_messages_received_total{type=\"command\"} 0\n") != NULL);
+
+    // A short buffer still reports the full length
+    char small[16];
+    CHECK(polycall_metrics_render(metrics, small, sizeof(small)) == length);
+    CHECK(strlen(small) == sizeof(small) - 1);
+    free(text);
+}
+
+static void test_serve(polycall_metrics_t* metrics) {
+    polycall_metrics_server_t* server = NULL;
+    CHECK(polycall_metrics_serve(metrics, 0, &server) == POLYCALL_SUCCESS);
+    uint16_t port = polycall_metrics_server_port(server);
+    CHECK(port != 0);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    CHECK(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    const char* request = "GET /metrics HTTP/1.0\r\n\r\n";
+    CHECK(send(fd, request, strlen(request), 0) == (ssize_t)strlen(request));
+
+    static char response[64 * 1024];
+    size_t received = 0;
+    ssize_t n;
+    while ((n = recv(fd, response + received, sizeof(response) - 1 - received, 0)) > 0) {
+        received += (size_t)n;
+    }
+    response[received] = '\0';
+    close(fd);
+
+    CHECK(strncmp(response, "HTTP/1.0 200 OK\r\n", 17) == 0);
+    CHECK(strstr(response, "# TYPE test_events_total counter\n") != NULL);
+    polycall_metrics_server_stop(server);
+}
+
+int main(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_metrics: context init failed\n");
+        return 1;
+    }
+
+    polycall_metrics_t* metrics = polycall_context_metrics(ctx);
+    CHECK(metrics != NULL);
+    test_registry(metrics);
+    test_render(metrics);
+    test_serve(metrics);
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_metrics: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_metrics: ok\n");
+    return 0;
+}
@@ -0,0 +1,205 @@
+// test_network.c - Pooled dispatch, inline handlers and write backpressure
+#include "polycall.h"
+#include "network.h"
+#include "polycall_metrics.h"
+#include "polycall_worker_pool.h"
+#include "test_util.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define PACKETS 64
+
+static polycall_metric_sample_t samples[POLYCALL_METRICS_MAX];
+
+static int64_t clients_gauge(polycall_context_t ctx) {
+    size_t count = 0;
+    CHECK(polycall_metrics_snapshot(polycall_context_metrics(ctx), samples,
+                                    POLYCALL_METRICS_MAX, &count) == POLYCALL_SUCCESS);
+    return samples[POLYCALL_METRIC_NET_CLIENTS].gauge;
+}
+
+static int connect_to(NetworkProgram* program) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(program->endpoints[0].port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    CHECK(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+// Pooled on_receive: bytes of one connection must arrive in send order
+static uint8_t received[PACKETS];
+static int received_count;
+static int handlers_running;
+
+static void pooled_receive(NetworkEndpoint* endpoint, NetworkPacket* packet) {
+    (void)endpoint;
+    CHECK(__atomic_add_fetch(&handlers_running, 1, __ATOMIC_ACQ_REL) == 1);
+    usleep(1000);  // Still queued on the pool when cleanup starts
+    const uint8_t* bytes = (const uint8_t*)packet->data;
+    for (size_t i = 0; i < packet->size && received_count < PACKETS; i++) {
+        received[received_count++] = bytes[i];
+    }
+    __atomic_sub_fetch(&handlers_running, 1, __ATOMIC_ACQ_REL);
+}
+
+static void test_pooled_dispatch(polycall_context_t ctx) {
+    polycall_worker_pool_t* pool = NULL;
+    CHECK(polycall_worker_pool_create(2, &pool) == POLYCALL_SUCCESS);
+
+    NetworkProgram program;
+    net_init_program_with_context(&program, ctx);
+    CHECK(program.endpoints != NULL);
+    if (!program.endpoints) {
+        net_cleanup_program(&program);
+        polycall_worker_pool_destroy(pool);
+        return;
+    }
+    program.worker_pool = (struct polycall_worker_pool*)pool;
+    program.ordered_dispatch = true;
+    program.handlers.on_receive = pooled_receive;
+
+    int fd = connect_to(&program);
+    net_run(&program);  // Accept
+    CHECK(clients_gauge(ctx) == 1);
+
+    // One net_run per byte, so every byte is its own pooled packet
+    for (int i = 0; i < PACKETS; i++) {
+        uint8_t byte = (uint8_t)i;
+        CHECK(write(fd, &byte, 1) == 1);
+        net_run(&program);
+    }
+
+    // Cleanup waits for the packets still on the pool
+    net_cleanup_program(&program);
+    CHECK(received_count == PACKETS);
+    for (int i = 0; i < received_count; i++) {
+        CHECK(received[i] == i);
+    }
+    CHECK(clients_gauge(ctx) == 0);
+
+    close(fd);
+    polycall_worker_pool_destroy(pool);
+}
+
+// Inline handlers run without clients_lock, so they may walk the clients
+static NetworkProgram* inline_program;
+static int inline_calls;
+static int inline_active;
+
+static void inline_receive(NetworkEndpoint* endpoint, NetworkPacket* packet) {
+    (void)endpoint;
+    (void)packet;
+    inline_calls++;
+    CHECK(pthread_mutex_trylock(&inline_program->clients_lock) == 0);
+    for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+        pthread_mutex_lock(&inline_program->clients[i].lock);
+        if (inline_program->clients[i].is_active) inline_active++;
+        pthread_mutex_unlock(&inline_program->clients[i].lock);
+    }
+    pthread_mutex_unlock(&inline_program->clients_lock);
+}
+
+static void test_inline_handler(polycall_context_t ctx) {
+    NetworkProgram program;
+    net_init_program_with_context(&program, ctx);
+    CHECK(program.endpoints != NULL);
+    if (!program.endpoints) {
+        net_cleanup_program(&program);
+        return;
+    }
+    inline_program = &program;
+    program.handlers.on_receive = inline_receive;
+
+    int fd = connect_to(&program);
+    net_run(&program);
+    CHECK(clients_gauge(ctx) == 1);
+
+    CHECK(write(fd, "hello", 5) == 5);
+    net_run(&program);
+    CHECK(inline_calls == 1);
+    CHECK(inline_active == 1);
+
+    // The peer hanging up closes the slot exactly once
+    close(fd);
+    net_run(&program);
+    CHECK(!program.clients[0].is_active);
+    CHECK(clients_gauge(ctx) == 0);
+
+    net_cleanup_program(&program);
+    CHECK(clients_gauge(ctx) == 0);
+}
+
+static void test_backpressure(void) {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+
+    ClientState state;
+    net_init_client_state(&state);
+    state.socket_fd = fds[0];
+    state.is_active = true;
+    state.generation = 1;
+    NetworkEndpoint endpoint = {
+        .socket_fd = fds[0],
+        .client = &state,
+        .client_generation = 1
+    };
+
+    // The peer never reads: the socket fills, then the queue, then EAGAIN
+    static char chunk[64 * 1024];
+    NetworkPacket packet = { chunk, sizeof(chunk), 0 };
+    ssize_t result = 0;
+    int sends = 0;
+    while (sends < 1000 && (result = net_send(&endpoint, &packet)) > 0) sends++;
+    CHECK(result == -1);
+    CHECK(errno == EAGAIN);
+    CHECK(state.write_queued >= NET_WRITE_QUEUE_LIMIT);
+    CHECK(state.write_queued < NET_WRITE_QUEUE_LIMIT + sizeof(chunk));
+
+    // A refused send queued nothing
+    size_t queued = state.write_queued;
+    CHECK(net_send(&endpoint, &packet) == -1);
+    CHECK(state.write_queued == queued);
+
+    // Sends for an earlier connection in the slot fail outright
+    endpoint.client_generation = 0;
+    CHECK(net_send(&endpoint, &packet) == -1);
+    CHECK(errno == EPIPE);
+
+    net_cleanup_client_state(&state);
+    CHECK(state.write_head == NULL && state.write_queued == 0);
+    close(fds[1]);
+}
+
+int main(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_network: context init failed\n");
+        return 1;
+    }
+
+    test_pooled_dispatch(ctx);
+    test_inline_handler(ctx);
+    test_backpressure();
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_network: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_network: ok\n");
+    return 0;
+}
@@ -326,6 +326,8 @@ int main(void) {
                 printf("  Creation time: %lu\n", diag.creation_time);
                 printf("  Last modified: %lu\n", diag.last_modified);
                 printf("  Is locked: %s\n", diag.is_locked ? "yes" : "no");
+                printf("  Transitions in: %u\n", diag.transition_count);
+                printf("  Integrity checks: %u\n", diag.integrity_check_count);
                 printf("  Checksum: %u\n", diag.current_checksum);
             } else {
                 printf("Failed to get state diagnostics\n");
@@ -0,0 +1,151 @@
+// test_protocol.c - Deframing protocol messages from a byte stream
+#include "polycall.h"
+#include "polycall_protocol.h"
+#include "test_util.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static char commands[8][64];
+static int command_count;
+
+static void on_command(polycall_protocol_context_t* ctx, const char* command, size_t length) {
+    (void)ctx;
+    if (command_count < 8 && length < sizeof(commands[0])) {
+        memcpy(commands[command_count], command, length);
+        commands[command_count][length] = '\0';
+    }
+    command_count++;
+}
+
+// Header and payload of one COMMAND message; returns the frame length
+static size_t build_frame(uint8_t* out, uint32_t sequence, const char* text) {
+    size_t length = strlen(text);
+    polycall_message_header_t header = {
+        .version = POLYCALL_PROTOCOL_VERSION,
+        .type = POLYCALL_MSG_COMMAND,
+        .sequence = sequence,
+        .payload_length = (uint32_t)length,
+        .checksum = polycall_protocol_calculate_checksum(text, length)
+    };
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), text, length);
+    return sizeof(header) + length;
+}
+
+typedef struct {
+    int peer;                           // Raw end the test writes frames into
+    NetworkEndpoint endpoint;
+    polycall_protocol_context_t protocol;
+} session_t;
+
+static void session_open(session_t* session, polycall_context_t ctx, size_t max_message_size) {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+
+    memset(&session->endpoint, 0, sizeof(session->endpoint));
+    pthread_mutex_init(&session->endpoint.lock, NULL);
+    session->endpoint.socket_fd = fds[0];
+    session->peer = fds[1];
+
+    polycall_protocol_config_t config = {
+        .callbacks = { .on_command = on_command },
+        .max_message_size = max_message_size
+    };
+    CHECK(polycall_protocol_init(&session->protocol, ctx, &session->endpoint, &config));
+    command_count = 0;
+}
+
+static void session_close(session_t* session) {
+    polycall_protocol_cleanup(&session->protocol);
+    close(session->endpoint.socket_fd);
+    close(session->peer);
+    pthread_mutex_destroy(&session->endpoint.lock);
+}
+
+static void send_bytes(session_t* session, const uint8_t* data, size_t length) {
+    CHECK(write(session->peer, data, length) == (ssize_t)length);
+}
+
+static void test_split_and_coalesced(polycall_context_t ctx) {
+    session_t session;
+    session_open(&session, ctx, 0);
+
+    uint8_t frames[256];
+    size_t first = build_frame(frames, 1, "status");
+    size_t second = build_frame(frames + first, 2, "reload");
+    size_t third = build_frame(frames + first + second, 3, "stop");
+
+    // Nothing pending yet
+    errno = 0;
+    CHECK(!polycall_protocol_receive(&session.protocol));
+    CHECK(errno == EAGAIN || errno == EWOULDBLOCK);
+
+    // A header split across reads waits for the rest of the frame
+    send_bytes(&session, frames, 5);
+    CHECK(!polycall_protocol_receive(&session.protocol));
+    send_bytes(&session, frames + 5, first - 5 - 2);
+    CHECK(!polycall_protocol_receive(&session.protocol));
+    CHECK(command_count == 0);
+
+    // The tail of the first frame arrives together with two more
+    send_bytes(&session, frames + first - 2, 2 + second + third);
+    CHECK(polycall_protocol_receive(&session.protocol));
+    CHECK(polycall_protocol_receive(&session.protocol));
+    CHECK(polycall_protocol_receive(&session.protocol));
+    CHECK(!polycall_protocol_receive(&session.protocol));
+    CHECK(command_count == 3);
+    CHECK(strcmp(commands[0], "status") == 0);
+    CHECK(strcmp(commands[1], "reload") == 0);
+    CHECK(strcmp(commands[2], "stop") == 0);
+
+    session_close(&session);
+}
+
+static void test_oversized(polycall_context_t ctx) {
+    session_t session;
+    session_open(&session, ctx, 8);
+
+    uint8_t frames[256];
+    size_t big = build_frame(frames, 1, "far too long for the limit");
+    CHECK(big > sizeof(polycall_message_header_t) + 8);
+    send_bytes(&session, frames, sizeof(polycall_message_header_t));
+    CHECK(!polycall_protocol_receive(&session.protocol));
+    CHECK(command_count == 0);
+
+    // The buffered stream was dropped; a later well-formed frame still works
+    size_t small = build_frame(frames, 2, "ok");
+    send_bytes(&session, frames, small);
+    CHECK(polycall_protocol_receive(&session.protocol));
+    CHECK(command_count == 1);
+    CHECK(strcmp(commands[0], "ok") == 0);
+
+    session_close(&session);
+}
+
+int main(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_protocol: context init failed\n");
+        return 1;
+    }
+
+    test_split_and_coalesced(ctx);
+    test_oversized(ctx);
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_protocol: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_protocol: ok\n");
+    return 0;
+}
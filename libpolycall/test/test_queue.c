@@ -0,0 +1,184 @@
+// test_queue.c - Bounded MPMC/SPSC queue tests (run under `make tsan` too)
+#include "polycall_queue.h"
+#include "polycall_histogram.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define ITEMS_PER_PRODUCER 200000
+#define SPSC_ITEMS 1000000
+
+static void test_mpmc_basic(void) {
+    polycall_mpmc_t* queue = polycall_mpmc_create(5, sizeof(uint64_t));
+    CHECK(queue != NULL);
+    CHECK(polycall_mpmc_capacity(queue) == 8);
+    CHECK(polycall_mpmc_create(8, 0) == NULL);
+
+    uint64_t value;
+    CHECK(!polycall_mpmc_pop(queue, &value));
+    for (uint64_t i = 0; i < 8; i++) CHECK(polycall_mpmc_push(queue, &i));
+    value = 99;
+    CHECK(!polycall_mpmc_push(queue, &value));
+    CHECK(polycall_mpmc_size(queue) == 8);
+
+    // FIFO across several laps of the ring
+    for (uint64_t lap = 0; lap < 3; lap++) {
+        for (uint64_t i = 0; i < 8; i++) {
+            CHECK(polycall_mpmc_pop(queue, &value));
+            CHECK(value == lap * 8 + i);
+            uint64_t next = (lap + 1) * 8 + i;
+            CHECK(polycall_mpmc_push(queue, &next));
+        }
+    }
+    CHECK(polycall_mpmc_size(queue) == 8);
+    polycall_mpmc_destroy(queue);
+}
+
+typedef struct {
+    polycall_mpmc_t* queue;
+    unsigned int id;
+    uint64_t sum;
+    uint64_t count;
+    uint64_t last[PRODUCERS];       // Per-producer order seen by one consumer
+    uint64_t* consumed;
+} mpmc_thread_t;
+
+static void* mpmc_producer(void* arg) {
+    mpmc_thread_t* self = arg;
+    for (uint64_t i = 1; i <= ITEMS_PER_PRODUCER; i++) {
+        uint64_t item = ((uint64_t)self->id << 32) | i;
+        while (!polycall_mpmc_push(self->queue, &item)) sched_yield();
+    }
+    return NULL;
+}
+
+static void* mpmc_consumer(void* arg) {
+    mpmc_thread_t* self = arg;
+    uint64_t item;
+    while (__atomic_load_n(self->consumed, __ATOMIC_RELAXED) < PRODUCERS * ITEMS_PER_PRODUCER) {
+        if (!polycall_mpmc_pop(self->queue, &item)) {
+            sched_yield();
+            continue;
+        }
+        unsigned int producer = (unsigned int)(item >> 32);
+        uint64_t sequence = item & 0xffffffffu;
+        CHECK(producer < PRODUCERS);
+        if (producer < PRODUCERS) {
+            CHECK(sequence > self->last[producer]);
+            self->last[producer] = sequence;
+        }
+        self->sum += sequence;
+        self->count++;
+        __atomic_add_fetch(self->consumed, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void test_mpmc_threads(void) {
+    polycall_mpmc_t* queue = polycall_mpmc_create(1024, sizeof(uint64_t));
+    uint64_t consumed = 0;
+    pthread_t threads[PRODUCERS + CONSUMERS];
+    mpmc_thread_t state[PRODUCERS + CONSUMERS] = {0};
+
+    uint64_t start = polycall_monotonic_ns();
+    for (unsigned int i = 0; i < PRODUCERS + CONSUMERS; i++) {
+        state[i].queue = queue;
+        state[i].id = i;
+        state[i].consumed = &consumed;
+        pthread_create(&threads[i], NULL, i < PRODUCERS ? mpmc_producer : mpmc_consumer, &state[i]);
+    }
+    for (unsigned int i = 0; i < PRODUCERS + CONSUMERS; i++) pthread_join(threads[i], NULL);
+    uint64_t elapsed = polycall_monotonic_ns() - start;
+
+    uint64_t sum = 0, count = 0;
+    for (unsigned int i = PRODUCERS; i < PRODUCERS + CONSUMERS; i++) {
+        sum += state[i].sum;
+        count += state[i].count;
+    }
+    uint64_t n = ITEMS_PER_PRODUCER;
+    CHECK(count == PRODUCERS * n);
+    CHECK(sum == PRODUCERS * (n * (n + 1) / 2));
+    CHECK(polycall_mpmc_size(queue) == 0);
+
+    printf("mpmc %dx%d: %.1f M items/s\n", PRODUCERS, CONSUMERS,
+           (double)count * 1e3 / (double)(elapsed ? elapsed : 1));
+    polycall_mpmc_destroy(queue);
+}
+
+typedef struct {
+    uint64_t sequence;
+    uint64_t check;
+} spsc_item_t;
+
+static void* spsc_producer(void* arg) {
+    polycall_spsc_t* ring = arg;
+    for (uint64_t i = 0; i < SPSC_ITEMS; i++) {
+        spsc_item_t item = { i, ~i };
+        while (!polycall_spsc_push(ring, &item)) sched_yield();
+    }
+    return NULL;
+}
+
+static void test_spsc(void) {
+    polycall_spsc_t* ring = polycall_spsc_create(3, sizeof(spsc_item_t));
+    CHECK(ring != NULL);
+    CHECK(polycall_spsc_capacity(ring) == 4);
+    CHECK(polycall_spsc_front(ring) == NULL);
+    polycall_spsc_destroy(ring);
+
+    ring = polycall_spsc_create(256, sizeof(spsc_item_t));
+    pthread_t producer;
+    uint64_t start = polycall_monotonic_ns();
+    pthread_create(&producer, NULL, spsc_producer, ring);
+
+    // Alternate single pops, peeks and batches on the consumer side
+    uint64_t expected = 0;
+    spsc_item_t batch[32];
+    while (expected < SPSC_ITEMS) {
+        spsc_item_t* front = polycall_spsc_front(ring);
+        if (!front) {
+            sched_yield();
+            continue;
+        }
+        CHECK(front->sequence == expected && front->check == ~expected);
+
+        if (expected % 3 == 0) {
+            spsc_item_t item;
+            CHECK(polycall_spsc_pop(ring, &item));
+            CHECK(item.sequence == expected);
+            expected++;
+        } else {
+            size_t got = polycall_spsc_pop_batch(ring, batch, 32);
+            CHECK(got >= 1);
+            for (size_t i = 0; i < got; i++) {
+                CHECK(batch[i].sequence == expected && batch[i].check == ~expected);
+                expected++;
+            }
+        }
+    }
+    pthread_join(producer, NULL);
+    uint64_t elapsed = polycall_monotonic_ns() - start;
+
+    CHECK(polycall_spsc_size(ring) == 0);
+    CHECK(!polycall_spsc_pop(ring, NULL));
+    printf("spsc: %.1f M items/s\n", (double)SPSC_ITEMS * 1e3 / (double)(elapsed ? elapsed : 1));
+    polycall_spsc_destroy(ring);
+}
+
+int main(void) {
+    test_mpmc_basic();
+    test_mpmc_threads();
+    test_spsc();
+
+    if (failures) {
+        fprintf(stderr, "test_queue: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_queue: ok\n");
+    return 0;
+}
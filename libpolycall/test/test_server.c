@@ -0,0 +1,440 @@
+// test_server.c - Config files, reload, backpressure and drain
+#include "polycall.h"
+#include "polycall_error.h"
+#include "polycall_protocol.h"
+#include "polycall_server.h"
+#include "test_util.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define BIG_COMMAND 4000
+#define BACKLOG_COMMANDS 4096       // 16 MB, more than the socket buffers hold
+
+// Config files
+
+static void write_config(char* path, const char* text) {
+    strcpy(path, "/tmp/test_server_XXXXXX");
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    CHECK(write(fd, text, strlen(text)) == (ssize_t)strlen(text));
+    close(fd);
+}
+
+static polycall_status_t load_text(const char* text, polycall_server_config_t* config) {
+    char path[64];
+    write_config(path, text);
+    polycall_status_t status = polycall_server_config_load(path, config);
+    unlink(path);
+    return status;
+}
+
+static void test_config_parser(void) {
+    polycall_server_config_t config;
+    polycall_server_config_defaults(&config);
+    CHECK(load_text("# comment line\n"
+                    "\n"
+                    "endpoint 127.0.0.1:9000   # trailing comment\n"
+                    "endpoint [::1]:9001\n"
+                    "io_threads 2\n"
+                    "workers 3\n"
+                    "max_inflight 7\n"
+                    "idle_timeout_ms 250\n"
+                    "auth_token secret\n", &config) == POLYCALL_SUCCESS);
+    CHECK(config.endpoint_count == 2);
+    CHECK(strcmp(config.endpoints[0].address, "127.0.0.1") == 0 && config.endpoints[0].port == 9000);
+    CHECK(strcmp(config.endpoints[1].address, "::1") == 0 && config.endpoints[1].port == 9001);
+    CHECK(config.io_threads == 2 && config.workers == 3);
+    CHECK(config.max_inflight == 7 && config.idle_timeout_ms == 250);
+    CHECK(strcmp(config.auth_token, "secret") == 0);
+    CHECK(config.max_frame == 65536);   // Untouched settings keep their value
+
+    // A rejected file leaves the config alone and names the line
+    polycall_server_config_t before = config;
+    CHECK(load_text("workers 1\nmax_frame 0x10\n", &config) == POLYCALL_ERROR_INVALID_PARAMETERS);
+    CHECK(strstr(polycall_error_message(), "line 2") != NULL);
+    CHECK(memcmp(&before, &config, sizeof(config)) == 0);
+
+    CHECK(load_text("no_such_setting 1\n", &config) == POLYCALL_ERROR_INVALID_PARAMETERS);
+    CHECK(load_text("io_threads 65\n", &config) == POLYCALL_ERROR_INVALID_PARAMETERS);
+    CHECK(load_text("endpoint 127.0.0.1\n", &config) == POLYCALL_ERROR_INVALID_PARAMETERS);
+    CHECK(load_text("endpoint localhost:80\n", &config) == POLYCALL_ERROR_INVALID_PARAMETERS);
+    CHECK(load_text("backlog 10 20\n", &config) == POLYCALL_ERROR_INVALID_PARAMETERS);
+    CHECK(load_text("max_inflight 0\n", &config) == POLYCALL_ERROR_INVALID_PARAMETERS);
+    CHECK(polycall_server_config_load("/nonexistent/polycall.conf", &config) ==
+          POLYCALL_ERROR_INVALID_PARAMETERS);
+    CHECK(memcmp(&before, &config, sizeof(config)) == 0);
+}
+
+// A blocking protocol client
+
+typedef struct {
+    NetworkEndpoint endpoint;
+    polycall_protocol_context_t protocol;
+    int handshakes;
+    int responses;
+    int errors;
+    char last[64];
+} client_t;
+
+static void on_client_handshake(polycall_protocol_context_t* ctx) {
+    ((client_t*)ctx->user_data)->handshakes++;
+}
+
+static void on_client_response(polycall_protocol_context_t* ctx, const void* payload, size_t length) {
+    client_t* client = ctx->user_data;
+    client->responses++;
+    size_t copied = length < sizeof(client->last) - 1 ? length : sizeof(client->last) - 1;
+    memcpy(client->last, payload, copied);
+    client->last[copied] = '\0';
+}
+
+static void on_client_error(polycall_protocol_context_t* ctx, const char* error) {
+    (void)error;
+    ((client_t*)ctx->user_data)->errors++;
+}
+
+// Receive until *counter reaches target; false on timeout or hangup
+static bool client_wait(client_t* client, const int* counter, int target) {
+    while (*counter < target) {
+        if (!polycall_protocol_receive(&client->protocol)) return false;
+    }
+    return true;
+}
+
+// Connect and authenticate; true once the server accepted the token
+static bool client_open(client_t* client, polycall_context_t ctx, uint16_t port, const char* token) {
+    memset(client, 0, sizeof(*client));
+    pthread_mutex_init(&client->endpoint.lock, NULL);
+    client->endpoint.socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct timeval timeout = { .tv_sec = 2, .tv_usec = 0 };
+    setsockopt(client->endpoint.socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int one = 1;            // Commands reach the server as they are sent
+    setsockopt(client->endpoint.socket_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    CHECK(connect(client->endpoint.socket_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+
+    polycall_protocol_config_t config = {
+        .callbacks = {
+            .on_handshake = on_client_handshake,
+            .on_response = on_client_response,
+            .on_error = on_client_error
+        },
+        .user_data = client
+    };
+    CHECK(polycall_protocol_init(&client->protocol, ctx, &client->endpoint, &config));
+    CHECK(polycall_protocol_start_handshake(&client->protocol));
+    if (!client_wait(client, &client->handshakes, 1)) return false;
+    CHECK(polycall_protocol_complete_handshake(&client->protocol));
+    CHECK(polycall_protocol_authenticate(&client->protocol, token, strlen(token)));
+    while (client->responses == 0 && client->errors == 0) {
+        if (!polycall_protocol_receive(&client->protocol)) return false;
+    }
+    return client->responses == 1;
+}
+
+static void client_command(client_t* client, const char* text) {
+    CHECK(polycall_protocol_send(&client->protocol, POLYCALL_MSG_COMMAND, text, strlen(text),
+                                 POLYCALL_FLAG_NONE));
+}
+
+// The server closed the connection and sent nothing more
+static bool client_at_eof(client_t* client) {
+    char byte;
+    return recv(client->endpoint.socket_fd, &byte, 1, 0) == 0;
+}
+
+static void client_close(client_t* client) {
+    polycall_protocol_cleanup(&client->protocol);
+    close(client->endpoint.socket_fd);
+    pthread_mutex_destroy(&client->endpoint.lock);
+}
+
+static polycall_server_t* start_server(polycall_context_t ctx, const polycall_server_config_t* config,
+                                       polycall_server_handler_t handler, void* user_data) {
+    polycall_server_t* server = NULL;
+    CHECK(polycall_server_create(ctx, config, handler, user_data, &server) == POLYCALL_SUCCESS);
+    CHECK(polycall_server_start(server) == POLYCALL_SUCCESS);
+    return server;
+}
+
+static void local_config(polycall_server_config_t* config, unsigned int workers) {
+    polycall_server_config_defaults(config);
+    strcpy(config->endpoints[0].address, "127.0.0.1");
+    config->endpoints[0].port = 0;
+    config->io_threads = 1;
+    config->workers = workers;
+}
+
+static void test_reload(polycall_context_t ctx) {
+    polycall_server_config_t config;
+    local_config(&config, 0);
+    polycall_server_t* server = start_server(ctx, &config, NULL, NULL);
+    uint16_t port = polycall_server_port(server, 0);
+    CHECK(port != 0);
+
+    client_t first;
+    CHECK(client_open(&first, ctx, port, "anything"));
+    client_command(&first, "one");
+    CHECK(client_wait(&first, &first.responses, 2));
+    CHECK(strcmp(first.last, "one") == 0);
+
+    // Add an endpoint and a token; the open connection stays up
+    polycall_server_config_t reloaded = config;
+    reloaded.endpoints[1] = reloaded.endpoints[0];
+    reloaded.endpoint_count = 2;
+    strcpy(reloaded.auth_token, "secret");
+    CHECK(polycall_server_reload(server, &reloaded) == POLYCALL_SUCCESS);
+    CHECK(polycall_server_port(server, 0) == port);
+    uint16_t second_port = polycall_server_port(server, 1);
+    CHECK(second_port != 0 && second_port != port);
+
+    client_command(&first, "two");
+    CHECK(client_wait(&first, &first.responses, 3));
+    CHECK(strcmp(first.last, "two") == 0);
+
+    client_t wrong, right;
+    CHECK(!client_open(&wrong, ctx, second_port, "anything"));
+    CHECK(wrong.errors == 1);
+    client_close(&wrong);
+    CHECK(client_open(&right, ctx, port, "secret"));
+    client_close(&right);
+
+    // A bad config changes nothing
+    polycall_server_config_t broken = reloaded;
+    broken.endpoint_count = 0;
+    CHECK(polycall_server_reload(server, &broken) == POLYCALL_ERROR_INVALID_PARAMETERS);
+    CHECK(polycall_server_port(server, 1) == second_port);
+
+    client_close(&first);
+    polycall_server_destroy(server);
+}
+
+// Handler that holds every call until the gate opens
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t opened;
+    bool open;
+    int calls;
+} gate_t;
+
+static void gate_init(gate_t* gate, bool open) {
+    pthread_mutex_init(&gate->lock, NULL);
+    pthread_cond_init(&gate->opened, NULL);
+    gate->open = open;
+    gate->calls = 0;
+}
+
+static void gate_open(gate_t* gate) {
+    pthread_mutex_lock(&gate->lock);
+    gate->open = true;
+    pthread_cond_broadcast(&gate->opened);
+    pthread_mutex_unlock(&gate->lock);
+}
+
+static int gate_calls(gate_t* gate) {
+    pthread_mutex_lock(&gate->lock);
+    int calls = gate->calls;
+    pthread_mutex_unlock(&gate->lock);
+    return calls;
+}
+
+static void gate_wait_calls(gate_t* gate, int calls) {
+    for (int i = 0; i < 2000 && gate_calls(gate) < calls; i++) usleep(1000);
+    CHECK(gate_calls(gate) >= calls);
+}
+
+static void gate_destroy(gate_t* gate) {
+    pthread_cond_destroy(&gate->opened);
+    pthread_mutex_destroy(&gate->lock);
+}
+
+static bool gated_handler(void* user_data, const void* request, size_t request_length,
+                          void* response, size_t capacity, size_t* response_length) {
+    gate_t* gate = user_data;
+    pthread_mutex_lock(&gate->lock);
+    gate->calls++;
+    while (!gate->open) pthread_cond_wait(&gate->opened, &gate->lock);
+    pthread_mutex_unlock(&gate->lock);
+
+    size_t length = request_length < capacity ? request_length : capacity;
+    memcpy(response, request, length);
+    *response_length = length;
+    return true;
+}
+
+// Sends commands until done, blocking whenever the server stops reading.
+// It has its own endpoint on a dup of the socket, since a blocked send
+// holds the endpoint lock the reader needs.
+typedef struct {
+    NetworkEndpoint endpoint;
+    polycall_protocol_context_t protocol;
+    int sent;
+} sender_t;
+
+static void* sender_main(void* arg) {
+    sender_t* sender = arg;
+    static char command[BIG_COMMAND];
+    memset(command, 'x', sizeof(command));
+    for (int i = 0; i < BACKLOG_COMMANDS; i++) {
+        if (!polycall_protocol_send(&sender->protocol, POLYCALL_MSG_COMMAND, command,
+                                    sizeof(command), POLYCALL_FLAG_NONE)) {
+            break;
+        }
+        __atomic_add_fetch(&sender->sent, 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// A stalled handler stops the server reading, so the client's sends back up
+static void test_backpressure(polycall_context_t ctx) {
+    gate_t gate;
+    gate_init(&gate, false);
+    polycall_server_config_t config;
+    local_config(&config, 1);
+    config.max_inflight = 2;
+    polycall_server_t* server = start_server(ctx, &config, gated_handler, &gate);
+
+    client_t client;
+    CHECK(client_open(&client, ctx, polycall_server_port(server, 0), "anything"));
+    sender_t sender;
+    memset(&sender, 0, sizeof(sender));
+    pthread_mutex_init(&sender.endpoint.lock, NULL);
+    sender.endpoint.socket_fd = dup(client.endpoint.socket_fd);
+    polycall_protocol_config_t protocol_config = { .user_data = &sender };
+    CHECK(polycall_protocol_init(&sender.protocol, ctx, &sender.endpoint, &protocol_config));
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, sender_main, &sender) == 0);
+
+    // Wait for the sender to stall: sockets full, nothing read past max_inflight
+    int sent = -1;
+    for (int quiet = 0; quiet < 5; ) {
+        usleep(20000);
+        int now = __atomic_load_n(&sender.sent, __ATOMIC_ACQUIRE);
+        quiet = now == sent ? quiet + 1 : 0;
+        sent = now;
+    }
+    CHECK(sent < BACKLOG_COMMANDS);
+    CHECK(gate_calls(&gate) == 1);
+
+    // Everything is answered, in order, once the handler moves on
+    gate_open(&gate);
+    bool answered = client_wait(&client, &client.responses, 1 + BACKLOG_COMMANDS);
+    CHECK(answered);
+    if (!answered) shutdown(client.endpoint.socket_fd, SHUT_RDWR);  // Unblock the sender
+    pthread_join(thread, NULL);
+    CHECK(sender.sent == BACKLOG_COMMANDS);
+    CHECK(gate_calls(&gate) == BACKLOG_COMMANDS);
+
+    polycall_protocol_cleanup(&sender.protocol);
+    close(sender.endpoint.socket_fd);
+    pthread_mutex_destroy(&sender.endpoint.lock);
+    client_close(&client);
+    polycall_server_destroy(server);
+    gate_destroy(&gate);
+}
+
+static void* drain_main(void* arg) {
+    polycall_server_drain(arg);
+    return NULL;
+}
+
+static void test_drain(polycall_context_t ctx) {
+    gate_t gate;
+    gate_init(&gate, false);
+    polycall_server_config_t config;
+    local_config(&config, 2);
+    polycall_server_t* server = start_server(ctx, &config, gated_handler, &gate);
+
+    client_t client;
+    CHECK(client_open(&client, ctx, polycall_server_port(server, 0), "anything"));
+    client_command(&client, "a");
+    client_command(&client, "b");
+    client_command(&client, "c");
+    gate_wait_calls(&gate, 1);
+    usleep(50000);          // Until the server has read b and c
+
+    // Drain waits for the dispatched commands and answers all of them
+    pthread_t drainer;
+    CHECK(pthread_create(&drainer, NULL, drain_main, server) == 0);
+    usleep(50000);
+    CHECK(polycall_server_connections(server) == 1);
+    gate_open(&gate);
+    pthread_join(drainer, NULL);
+
+    CHECK(client_wait(&client, &client.responses, 4));
+    CHECK(strcmp(client.last, "c") == 0);
+    CHECK(client_at_eof(&client));
+    CHECK(polycall_server_connections(server) == 0);
+    CHECK(polycall_server_port(server, 0) == 0);
+
+    client_close(&client);
+    polycall_server_destroy(server);
+    gate_destroy(&gate);
+}
+
+static void test_forced_drain(polycall_context_t ctx) {
+    gate_t gate;
+    gate_init(&gate, false);
+    polycall_server_config_t config;
+    local_config(&config, 1);
+    config.drain_timeout_ms = 100;
+    polycall_server_t* server = start_server(ctx, &config, gated_handler, &gate);
+
+    client_t client;
+    CHECK(client_open(&client, ctx, polycall_server_port(server, 0), "anything"));
+    for (int i = 0; i < 4; i++) client_command(&client, "queued");
+    gate_wait_calls(&gate, 1);
+    usleep(50000);          // Until the server has read the rest
+
+    // Past the timeout the connection is closed with nothing answered
+    pthread_t drainer;
+    CHECK(pthread_create(&drainer, NULL, drain_main, server) == 0);
+    CHECK(client_at_eof(&client));
+    CHECK(client.responses == 1);
+
+    // Only the running call is waited for; the queued ones never run
+    gate_open(&gate);
+    pthread_join(drainer, NULL);
+    CHECK(gate_calls(&gate) == 1);
+
+    client_close(&client);
+    polycall_server_destroy(server);
+    gate_destroy(&gate);
+}
+
+int main(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_server: context init failed\n");
+        return 1;
+    }
+
+    test_config_parser();
+    test_reload(ctx);
+    test_backpressure(ctx);
+    test_drain(ctx);
+    test_forced_drain(ctx);
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_server: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_server: ok\n");
+    return 0;
+}
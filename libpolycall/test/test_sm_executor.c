@@ -0,0 +1,147 @@
+// test_sm_executor.c - Mailbox ordering, async parking and shutdown
+#include "polycall.h"
+#include "polycall_state_machine.h"
+#include "polycall_sm_executor.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MACHINES 8
+#define EVENTS_PER_MACHINE 2000
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+typedef struct {
+    unsigned int succeeded;
+    unsigned int failed;
+    unsigned int invalid;
+} tally_t;
+
+static void count_result(PolyCall_StateMachine* sm, unsigned int transition_id,
+                         polycall_sm_status_t status, void* user_data) {
+    (void)sm;
+    (void)transition_id;
+    tally_t* tally = (tally_t*)user_data;
+    if (status == POLYCALL_SM_SUCCESS) __atomic_add_fetch(&tally->succeeded, 1, __ATOMIC_RELAXED);
+    else __atomic_add_fetch(&tally->failed, 1, __ATOMIC_RELAXED);
+    if (status == POLYCALL_SM_ERROR_INVALID_TRANSITION) __atomic_add_fetch(&tally->invalid, 1, __ATOMIC_RELAXED);
+}
+
+// Alternating go/back only succeeds if every mailbox runs in posting order
+static void test_ordering(polycall_context_t ctx) {
+    polycall_sm_executor_config_t config = { 3, 16, false };
+    polycall_sm_executor_t* executor = NULL;
+    CHECK(polycall_sm_executor_create(&config, &executor) == POLYCALL_SM_SUCCESS);
+
+    PolyCall_StateMachine* machines[MACHINES];
+    polycall_sm_mailbox_t* mailboxes[MACHINES];
+    tally_t tally = {0};
+
+    for (unsigned int m = 0; m < MACHINES; m++) {
+        machines[m] = make_machine(ctx);
+        CHECK(polycall_sm_executor_attach(executor, machines[m], m, &mailboxes[m]) == POLYCALL_SM_SUCCESS);
+        CHECK(polycall_sm_mailbox_machine(mailboxes[m]) == machines[m]);
+        CHECK(polycall_sm_mailbox_id(mailboxes[m]) == m);
+    }
+
+    for (unsigned int i = 0; i < EVENTS_PER_MACHINE; i++) {
+        for (unsigned int m = 0; m < MACHINES; m++) {
+            CHECK(polycall_sm_post_transition(mailboxes[m], i % 2 ? "back" : "go",
+                                              count_result, &tally) == POLYCALL_SM_SUCCESS);
+        }
+    }
+    CHECK(polycall_sm_post_transition(mailboxes[0], "nope", count_result, &tally) ==
+          POLYCALL_SM_ERROR_INVALID_TRANSITION);
+    // Unknown ids are only found on the shard and still reach the callback
+    CHECK(polycall_sm_post_event(mailboxes[0], 99, count_result, &tally) == POLYCALL_SM_SUCCESS);
+
+    for (unsigned int m = 0; m < MACHINES; m++) {
+        CHECK(polycall_sm_executor_detach(mailboxes[m]) == POLYCALL_SM_SUCCESS);
+    }
+    polycall_sm_executor_destroy(executor);
+
+    CHECK(tally.succeeded == MACHINES * EVENTS_PER_MACHINE);
+    CHECK(tally.failed == 1);
+    CHECK(tally.invalid == 1);
+    for (unsigned int m = 0; m < MACHINES; m++) {
+        CHECK(machines[m]->current_state == 0);
+        CHECK(machines[m]->async_commit == NULL);
+        polycall_sm_destroy(machines[m]);
+    }
+}
+
+static PolyCall_AsyncToken* parked_token;
+
+static polycall_sm_action_result_t park(polycall_context_t ctx, PolyCall_AsyncToken* token) {
+    (void)ctx;
+    __atomic_store_n(&parked_token, token, __ATOMIC_RELEASE);
+    return POLYCALL_SM_ACTION_PENDING;
+}
+
+static void* complete_later(void* arg) {
+    (void)arg;
+    PolyCall_AsyncToken* token;
+    while (!(token = __atomic_load_n(&parked_token, __ATOMIC_ACQUIRE))) sleep_ms(1);
+    sleep_ms(50);
+    polycall_sm_async_complete(token, POLYCALL_SM_SUCCESS);
+    return NULL;
+}
+
+// Destroy waits for a parked transition and still runs the events behind it
+static void test_destroy_waits_for_async(polycall_context_t ctx) {
+    polycall_sm_executor_config_t config = { 2, 0, false };
+    polycall_sm_executor_t* executor = NULL;
+    CHECK(polycall_sm_executor_create(&config, &executor) == POLYCALL_SM_SUCCESS);
+
+    PolyCall_StateMachine* sm = make_machine(ctx);
+    CHECK(polycall_sm_set_transition_async(sm, 0, park) == POLYCALL_SM_SUCCESS);
+
+    polycall_sm_mailbox_t* mailbox = NULL;
+    CHECK(polycall_sm_executor_attach(executor, sm, 1, &mailbox) == POLYCALL_SM_SUCCESS);
+
+    tally_t tally = {0};
+    parked_token = NULL;
+    CHECK(polycall_sm_post_event(mailbox, 0, count_result, &tally) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_post_event(mailbox, 1, count_result, &tally) == POLYCALL_SM_SUCCESS);
+
+    pthread_t completer;
+    CHECK(pthread_create(&completer, NULL, complete_later, NULL) == 0);
+
+    // Mailbox left attached on purpose: destroy must unhook the machine
+    polycall_sm_executor_destroy(executor);
+    pthread_join(completer, NULL);
+
+    CHECK(tally.succeeded == 2);
+    CHECK(tally.failed == 0);
+    CHECK(sm->current_state == 0);
+    CHECK(!polycall_sm_async_pending(sm));
+    CHECK(sm->async_commit == NULL);
+    CHECK(sm->async_commit_data == NULL);
+    polycall_sm_destroy(sm);
+}
+
+int main(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_sm_executor: context init failed\n");
+        return 1;
+    }
+
+    test_ordering(ctx);
+    test_destroy_waits_for_async(ctx);
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_sm_executor: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_sm_executor: ok\n");
+    return 0;
+}
@@ -0,0 +1,124 @@
+// test_sm_observer.c - Transition event fan-out and observer lifetimes
+#include "polycall.h"
+#include "polycall_state_machine.h"
+#include "polycall_sm_observer.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROUND_TRIPS 20000
+
+static polycall_context_t ctx;
+
+static void test_fan_out(void) {
+    PolyCall_StateMachine* sm = make_machine(ctx);
+    polycall_sm_observer_t* wide = NULL;
+    polycall_sm_observer_t* narrow = NULL;
+    polycall_sm_observer_t* gone = NULL;
+    CHECK(polycall_sm_observe(sm, 0, &wide) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_observe(sm, 2, &narrow) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_observe(sm, 0, &gone) == POLYCALL_SM_SUCCESS);
+    polycall_sm_unobserve(gone);
+
+    CHECK(polycall_sm_execute_transition(sm, "go") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(sm, "back") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(sm, "go") == POLYCALL_SM_SUCCESS);
+
+    polycall_sm_event_t events[8];
+    CHECK(polycall_sm_observer_poll(wide, events, 8) == 3);
+    for (unsigned int i = 0; i < 3; i++) {
+        CHECK(events[i].sequence == i + 1);
+        CHECK(events[i].transition_id == i % 2);
+        CHECK(events[i].to_state == (i + 1) % 2);
+        CHECK(events[i].status == POLYCALL_SM_SUCCESS);
+    }
+    CHECK(polycall_sm_observer_dropped(wide) == 0);
+
+    // A full ring drops and counts instead of blocking the transition
+    CHECK(polycall_sm_observer_poll(narrow, events, 8) == 2);
+    CHECK(polycall_sm_observer_dropped(narrow) == 1);
+
+    polycall_sm_unobserve(narrow);
+    polycall_sm_unobserve(wide);
+    polycall_sm_destroy(sm);
+}
+
+// Handles outlive the machine: queued events stay readable until unobserve
+static void test_outlives_machine(void) {
+    PolyCall_StateMachine* sm = make_machine(ctx);
+    polycall_sm_observer_t* observer = NULL;
+    CHECK(polycall_sm_observe(sm, 0, &observer) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(sm, "go") == POLYCALL_SM_SUCCESS);
+    polycall_sm_destroy(sm);
+
+    polycall_sm_event_t event;
+    CHECK(polycall_sm_observer_poll(observer, &event, 1) == 1);
+    CHECK(event.to_state == 1);
+    CHECK(polycall_sm_observer_poll(observer, &event, 1) == 0);
+    polycall_sm_unobserve(observer);
+}
+
+typedef struct {
+    polycall_sm_observer_t* observer;
+    int done;
+    uint64_t last_sequence;
+} poller_t;
+
+static void* poller_main(void* arg) {
+    poller_t* poller = (poller_t*)arg;
+    polycall_sm_event_t events[64];
+    for (;;) {
+        int done = __atomic_load_n(&poller->done, __ATOMIC_ACQUIRE);
+        size_t count = polycall_sm_observer_poll(poller->observer, events, 64);
+        for (size_t i = 0; i < count; i++) {
+            CHECK(events[i].sequence > poller->last_sequence);
+            poller->last_sequence = events[i].sequence;
+        }
+        if (done && count == 0) break;
+    }
+    return NULL;
+}
+
+static void test_concurrent_poll(void) {
+    PolyCall_StateMachine* sm = make_machine(ctx);
+    poller_t poller = { NULL, 0, 0 };
+    CHECK(polycall_sm_observe(sm, 64, &poller.observer) == POLYCALL_SM_SUCCESS);
+
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, poller_main, &poller) == 0);
+    for (int i = 0; i < ROUND_TRIPS; i++) {
+        CHECK(polycall_sm_execute_transition_id(sm, 0) == POLYCALL_SM_SUCCESS);
+        CHECK(polycall_sm_execute_transition_id(sm, 1) == POLYCALL_SM_SUCCESS);
+    }
+    // Destroy detaches the observer while its poller is still running
+    polycall_sm_destroy(sm);
+    __atomic_store_n(&poller.done, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+
+    // Every event was either delivered or counted as dropped
+    CHECK(poller.last_sequence == 2 * ROUND_TRIPS ||
+          polycall_sm_observer_dropped(poller.observer) > 0);
+    polycall_sm_unobserve(poller.observer);
+}
+
+int main(void) {
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_sm_observer: context init failed\n");
+        return 1;
+    }
+
+    test_fan_out();
+    test_outlives_machine();
+    test_concurrent_poll();
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_sm_observer: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_sm_observer: ok\n");
+    return 0;
+}
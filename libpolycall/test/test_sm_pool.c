@@ -0,0 +1,147 @@
+// test_sm_pool.c - Pooled machine recycling and release statuses
+#include "polycall.h"
+#include "polycall_state_machine.h"
+#include "polycall_sm_pool.h"
+#include "test_util.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static PolyCall_AsyncToken* parked_token;
+
+static polycall_sm_action_result_t park(polycall_context_t ctx, PolyCall_AsyncToken* token) {
+    (void)ctx;
+    parked_token = token;
+    return POLYCALL_SM_ACTION_PENDING;
+}
+
+static const PolyCall_State states[] = {
+    { .name = "idle", .id = 0, .version = 1 },
+    { .name = "busy", .id = 1, .version = 1 },
+};
+
+static const PolyCall_Transition transitions[] = {
+    { .name = "go", .from_state = 0, .to_state = 1, .is_valid = true },
+    { .name = "go_async", .from_state = 0, .to_state = 1, .is_valid = true,
+      .is_async = true, .async_action = park },
+};
+
+static const PolyCall_StateMachineDef def = {
+    .name = "pooled",
+    .states = states,
+    .num_states = 2,
+    .transitions = transitions,
+    .num_transitions = 2,
+    .initial_state = 0,
+};
+
+static size_t in_use(polycall_sm_pool_t* pool) {
+    polycall_sm_pool_stats_t stats;
+    polycall_sm_pool_get_stats(pool, &stats);
+    return stats.in_use;
+}
+
+static void test_recycle(polycall_context_t ctx) {
+    polycall_sm_pool_config_t config = { 4, 2 };
+    polycall_sm_pool_t* pool = NULL;
+    polycall_sm_pool_t* other = NULL;
+    CHECK(polycall_sm_pool_create(ctx, &def, NULL, &config, &pool) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_pool_create(ctx, &def, NULL, &config, &other) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_pool_def(pool) == &def);
+
+    PolyCall_StateMachine* machines[10];
+    for (int i = 0; i < 10; i++) {
+        CHECK(polycall_sm_pool_acquire(pool, &machines[i]) == POLYCALL_SM_SUCCESS);
+        CHECK(machines[i]->current_state == 0);
+    }
+    CHECK(in_use(pool) == 10);
+
+    polycall_sm_pool_stats_t stats;
+    polycall_sm_pool_get_stats(pool, &stats);
+    CHECK(stats.slabs == 3);
+    CHECK(stats.allocated == 12);
+
+    CHECK(polycall_sm_execute_transition(machines[0], "go") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_pool_release(other, machines[0]) == POLYCALL_SM_ERROR_INVALID_CONTEXT);
+    CHECK(polycall_sm_pool_release(pool, NULL) == POLYCALL_SM_ERROR_INVALID_CONTEXT);
+    CHECK(in_use(pool) == 10);
+
+    // Released machines come back reset, spilling past the thread cache
+    for (int i = 0; i < 10; i++) {
+        CHECK(polycall_sm_pool_release(pool, machines[i]) == POLYCALL_SM_SUCCESS);
+    }
+    CHECK(in_use(pool) == 0);
+    for (int i = 0; i < 10; i++) {
+        CHECK(polycall_sm_pool_acquire(pool, &machines[i]) == POLYCALL_SM_SUCCESS);
+        CHECK(machines[i]->current_state == 0);
+    }
+    polycall_sm_pool_get_stats(pool, &stats);
+    CHECK(stats.slabs == 3);
+    for (int i = 0; i < 10; i++) polycall_sm_destroy(machines[i]);
+    CHECK(in_use(pool) == 0);
+
+    polycall_sm_pool_destroy(other);
+    polycall_sm_pool_destroy(pool);
+}
+
+// A machine released mid-transition is parked, then recycled once it lands
+static void test_release_pending(polycall_context_t ctx) {
+    polycall_sm_pool_config_t config = { 1, 1 };
+    polycall_sm_pool_t* pool = NULL;
+    CHECK(polycall_sm_pool_create(ctx, &def, NULL, &config, &pool) == POLYCALL_SM_SUCCESS);
+
+    PolyCall_StateMachine* sm = NULL;
+    CHECK(polycall_sm_pool_acquire(pool, &sm) == POLYCALL_SM_SUCCESS);
+    parked_token = NULL;
+    CHECK(polycall_sm_execute_transition_async(sm, 1, NULL, NULL) == POLYCALL_SM_PENDING);
+    CHECK(parked_token != NULL);
+
+    CHECK(polycall_sm_pool_release(pool, sm) == POLYCALL_SM_PENDING);
+    CHECK(in_use(pool) == 1);
+
+    // Still in flight: the next acquire must not hand it out
+    PolyCall_StateMachine* fresh = NULL;
+    CHECK(polycall_sm_pool_acquire(pool, &fresh) == POLYCALL_SM_SUCCESS);
+    CHECK(fresh != sm);
+    CHECK(in_use(pool) == 2);
+
+    polycall_sm_async_complete(parked_token, POLYCALL_SM_SUCCESS);
+    CHECK(sm->current_state == 1);
+
+    polycall_sm_pool_stats_t stats;
+    polycall_sm_pool_get_stats(pool, &stats);
+    size_t slabs = stats.slabs;
+
+    PolyCall_StateMachine* recycled = NULL;
+    CHECK(polycall_sm_pool_acquire(pool, &recycled) == POLYCALL_SM_SUCCESS);
+    CHECK(recycled == sm);
+    CHECK(recycled->current_state == 0);
+    CHECK(in_use(pool) == 2);
+    polycall_sm_pool_get_stats(pool, &stats);
+    CHECK(stats.slabs == slabs);
+
+    CHECK(polycall_sm_pool_release(pool, recycled) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_pool_release(pool, fresh) == POLYCALL_SM_SUCCESS);
+    CHECK(in_use(pool) == 0);
+    polycall_sm_pool_destroy(pool);
+}
+
+int main(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_sm_pool: context init failed\n");
+        return 1;
+    }
+
+    test_recycle(ctx);
+    test_release_pending(ctx);
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_sm_pool: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_sm_pool: ok\n");
+    return 0;
+}
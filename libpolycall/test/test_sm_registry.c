@@ -0,0 +1,144 @@
+// test_sm_registry.c - Session registry: growth, visitors and lock-free lookups
+#include "polycall_sm_registry.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ENTRIES 20000
+#define READERS 3
+
+// The registry never dereferences machines, so distinct addresses suffice
+static char machines[ENTRIES + 1];
+#define MACHINE(id) ((PolyCall_StateMachine*)(void*)&machines[(id)])
+
+static void test_basic(void) {
+    polycall_sm_registry_t* registry = NULL;
+    CHECK(polycall_sm_registry_create(3, 4, &registry) == POLYCALL_SM_SUCCESS);
+
+    CHECK(polycall_sm_registry_insert(registry, 0, MACHINE(1)) == POLYCALL_SM_ERROR_INVALID_CONTEXT);
+    CHECK(polycall_sm_registry_insert(registry, 7, NULL) == POLYCALL_SM_ERROR_INVALID_CONTEXT);
+    CHECK(polycall_sm_registry_lookup(registry, 7) == NULL);
+
+    CHECK(polycall_sm_registry_insert(registry, 7, MACHINE(7)) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_registry_insert(registry, 7, MACHINE(8)) == POLYCALL_SM_ERROR_ALREADY_EXISTS);
+    CHECK(polycall_sm_registry_lookup(registry, 7) == MACHINE(7));
+    CHECK(polycall_sm_registry_count(registry) == 1);
+
+    PolyCall_StateMachine* removed = NULL;
+    CHECK(polycall_sm_registry_remove(registry, 7, &removed) == POLYCALL_SM_SUCCESS);
+    CHECK(removed == MACHINE(7));
+    CHECK(polycall_sm_registry_remove(registry, 7, NULL) == POLYCALL_SM_ERROR_NOT_FOUND);
+    CHECK(polycall_sm_registry_lookup(registry, 7) == NULL);
+    CHECK(polycall_sm_registry_count(registry) == 0);
+
+    // Reinsert after removal reuses the id
+    CHECK(polycall_sm_registry_insert(registry, 7, MACHINE(9)) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_registry_lookup(registry, 7) == MACHINE(9));
+
+    polycall_sm_registry_destroy(registry);
+}
+
+static polycall_sm_registry_visit_t drop_odd(uint64_t session_id, PolyCall_StateMachine* sm, void* user_data) {
+    CHECK(sm == MACHINE(session_id));
+    (*(size_t*)user_data)++;
+    return session_id % 2 ? POLYCALL_SM_REGISTRY_REMOVE : POLYCALL_SM_REGISTRY_CONTINUE;
+}
+
+static polycall_sm_registry_visit_t stop_at_once(uint64_t session_id, PolyCall_StateMachine* sm, void* user_data) {
+    (void)session_id;
+    (void)sm;
+    (*(size_t*)user_data)++;
+    return POLYCALL_SM_REGISTRY_STOP;
+}
+
+// Tiny tables force many incremental migrations
+static void test_growth_and_visit(void) {
+    polycall_sm_registry_t* registry = NULL;
+    CHECK(polycall_sm_registry_create(4, 2, &registry) == POLYCALL_SM_SUCCESS);
+
+    for (uint64_t id = 1; id <= ENTRIES; id++) {
+        CHECK(polycall_sm_registry_insert(registry, id, MACHINE(id)) == POLYCALL_SM_SUCCESS);
+    }
+    CHECK(polycall_sm_registry_count(registry) == ENTRIES);
+    for (uint64_t id = 1; id <= ENTRIES; id++) {
+        CHECK(polycall_sm_registry_lookup(registry, id) == MACHINE(id));
+    }
+
+    size_t seen = 0;
+    CHECK(polycall_sm_registry_foreach(registry, drop_odd, &seen) == ENTRIES);
+    CHECK(seen == ENTRIES);
+    CHECK(polycall_sm_registry_count(registry) == ENTRIES / 2);
+    for (uint64_t id = 1; id <= ENTRIES; id++) {
+        CHECK(polycall_sm_registry_lookup(registry, id) == (id % 2 ? NULL : MACHINE(id)));
+    }
+
+    seen = 0;
+    polycall_sm_registry_foreach(registry, stop_at_once, &seen);
+    CHECK(seen == 1);
+
+    polycall_sm_registry_destroy(registry);
+}
+
+typedef struct {
+    polycall_sm_registry_t* registry;
+    int done;
+} concurrent_t;
+
+// Even ids stay put and must always be found; odd ids come and go
+static void* reader_main(void* arg) {
+    concurrent_t* shared = (concurrent_t*)arg;
+    while (!__atomic_load_n(&shared->done, __ATOMIC_ACQUIRE)) {
+        for (uint64_t id = 2; id <= ENTRIES; id += 2) {
+            CHECK(polycall_sm_registry_lookup(shared->registry, id) == MACHINE(id));
+        }
+        for (uint64_t id = 1; id <= ENTRIES; id += 2) {
+            PolyCall_StateMachine* sm = polycall_sm_registry_lookup(shared->registry, id);
+            CHECK(sm == NULL || sm == MACHINE(id));
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent_lookups(void) {
+    concurrent_t shared = { NULL, 0 };
+    CHECK(polycall_sm_registry_create(2, 2, &shared.registry) == POLYCALL_SM_SUCCESS);
+    for (uint64_t id = 2; id <= ENTRIES; id += 2) {
+        CHECK(polycall_sm_registry_insert(shared.registry, id, MACHINE(id)) == POLYCALL_SM_SUCCESS);
+    }
+
+    pthread_t readers[READERS];
+    for (int i = 0; i < READERS; i++) {
+        CHECK(pthread_create(&readers[i], NULL, reader_main, &shared) == 0);
+    }
+
+    // Churn odd ids so the tables keep growing and migrating under readers
+    for (int round = 0; round < 3; round++) {
+        for (uint64_t id = 1; id <= ENTRIES; id += 2) {
+            CHECK(polycall_sm_registry_insert(shared.registry, id, MACHINE(id)) == POLYCALL_SM_SUCCESS);
+        }
+        for (uint64_t id = 1; id <= ENTRIES; id += 2) {
+            CHECK(polycall_sm_registry_remove(shared.registry, id, NULL) == POLYCALL_SM_SUCCESS);
+        }
+    }
+
+    __atomic_store_n(&shared.done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < READERS; i++) pthread_join(readers[i], NULL);
+
+    CHECK(polycall_sm_registry_count(shared.registry) == ENTRIES / 2);
+    polycall_sm_registry_destroy(shared.registry);
+}
+
+int main(void) {
+    test_basic();
+    test_growth_and_visit();
+    test_concurrent_lookups();
+
+    if (failures) {
+        fprintf(stderr, "test_sm_registry: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_sm_registry: ok\n");
+    return 0;
+}
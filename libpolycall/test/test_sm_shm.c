@@ -0,0 +1,135 @@
+// test_sm_shm.c - Shared-memory publishing: naming, slots and seqlock reads
+#include "polycall.h"
+#include "polycall_state_machine.h"
+#include "polycall_sm_shm.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ROUND_TRIPS 20000
+
+static polycall_context_t ctx;
+static char name[64];
+
+static void test_naming_and_slots(void) {
+    polycall_sm_shm_t* shm = NULL;
+    polycall_sm_shm_t* second = NULL;
+    polycall_sm_shm_t* reader = NULL;
+    CHECK(polycall_sm_shm_create(name, 2, &shm) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_shm_capacity(shm) == 2);
+
+    // A live region is never taken over
+    CHECK(polycall_sm_shm_create(name, 2, &second) == POLYCALL_SM_ERROR_ALREADY_EXISTS);
+    CHECK(second == NULL);
+
+    CHECK(polycall_sm_shm_open(name, &reader) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_shm_capacity(reader) == 2);
+
+    PolyCall_StateMachine* sm = make_machine(ctx);
+    CHECK(polycall_sm_attach_shm(sm, reader, 5) == POLYCALL_SM_ERROR_INVALID_CONTEXT);
+    CHECK(polycall_sm_attach_shm(sm, shm, 5) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(sm, "go") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(sm, "back") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(sm, "go") == POLYCALL_SM_SUCCESS);
+
+    polycall_sm_shm_entry_t entry;
+    CHECK(polycall_sm_shm_read(reader, 0, &entry) == POLYCALL_SM_SUCCESS);
+    CHECK(entry.machine_id == 5);
+    CHECK(entry.current_state == 1);
+    CHECK(entry.num_states == 2);
+    CHECK(entry.transition_count == 3);
+    CHECK(strcmp(entry.state_name, "busy") == 0);
+    CHECK(polycall_sm_shm_read(reader, 1, &entry) == POLYCALL_SM_ERROR_NOT_FOUND);
+    CHECK(polycall_sm_shm_read(reader, 2, &entry) == POLYCALL_SM_ERROR_INVALID_STATE);
+
+    // A new owner of the slot starts counting from zero
+    polycall_sm_detach_shm(sm);
+    CHECK(polycall_sm_shm_read(reader, 0, &entry) == POLYCALL_SM_ERROR_NOT_FOUND);
+    PolyCall_StateMachine* next = make_machine(ctx);
+    CHECK(polycall_sm_attach_shm(next, shm, 6) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_shm_read(reader, 0, &entry) == POLYCALL_SM_SUCCESS);
+    CHECK(entry.machine_id == 6);
+    CHECK(entry.transition_count == 0);
+
+    // The region stays mapped while a machine can still publish into it
+    CHECK(polycall_sm_shm_close(shm) == POLYCALL_SM_ERROR_STATE_LOCKED);
+    CHECK(polycall_sm_execute_transition(next, "go") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_shm_read(reader, 0, &entry) == POLYCALL_SM_SUCCESS);
+    CHECK(entry.transition_count == 1);
+
+    polycall_sm_destroy(next);
+    polycall_sm_destroy(sm);
+    CHECK(polycall_sm_shm_close(reader) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_shm_close(shm) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_shm_open(name, &reader) == POLYCALL_SM_ERROR_NOT_FOUND);
+    CHECK(polycall_sm_shm_unlink(name) == POLYCALL_SM_ERROR_NOT_FOUND);
+}
+
+typedef struct {
+    polycall_sm_shm_t* reader;
+    int done;
+    unsigned long reads;
+} monitor_t;
+
+// State and transition count must always come from the same write
+static void* monitor_main(void* arg) {
+    monitor_t* monitor = (monitor_t*)arg;
+    while (!__atomic_load_n(&monitor->done, __ATOMIC_ACQUIRE)) {
+        polycall_sm_shm_entry_t entry;
+        polycall_sm_status_t status = polycall_sm_shm_read(monitor->reader, 0, &entry);
+        if (status != POLYCALL_SM_SUCCESS) continue;
+        CHECK(entry.current_state == (unsigned int)(entry.transition_count % 2));
+        CHECK(strcmp(entry.state_name, entry.current_state ? "busy" : "idle") == 0);
+        __atomic_add_fetch(&monitor->reads, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void test_concurrent_reader(void) {
+    polycall_sm_shm_t* shm = NULL;
+    CHECK(polycall_sm_shm_create(name, 1, &shm) == POLYCALL_SM_SUCCESS);
+    monitor_t monitor = { NULL, 0, 0 };
+    CHECK(polycall_sm_shm_open(name, &monitor.reader) == POLYCALL_SM_SUCCESS);
+
+    PolyCall_StateMachine* sm = make_machine(ctx);
+    CHECK(polycall_sm_attach_shm(sm, shm, 1) == POLYCALL_SM_SUCCESS);
+
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, monitor_main, &monitor) == 0);
+    // Keep going until the monitor got a turn; on one CPU it may not before
+    for (int i = 0; i < ROUND_TRIPS || !__atomic_load_n(&monitor.reads, __ATOMIC_RELAXED); i++) {
+        CHECK(polycall_sm_execute_transition_id(sm, 0) == POLYCALL_SM_SUCCESS);
+        CHECK(polycall_sm_execute_transition_id(sm, 1) == POLYCALL_SM_SUCCESS);
+    }
+    __atomic_store_n(&monitor.done, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    CHECK(monitor.reads > 0);
+
+    polycall_sm_destroy(sm);
+    polycall_sm_shm_close(monitor.reader);
+    polycall_sm_shm_close(shm);
+}
+
+int main(void) {
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_sm_shm: context init failed\n");
+        return 1;
+    }
+    snprintf(name, sizeof(name), "/polycall_test_%ld", (long)getpid());
+
+    test_naming_and_slots();
+    test_concurrent_reader();
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_sm_shm: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_sm_shm: ok\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+// test_sm_snapshot.c - Base and delta snapshots between primary and standby
+#include "polycall.h"
+#include "polycall_state_machine.h"
+#include "polycall_sm_snapshot.h"
+#include "test_util.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const PolyCall_State states[] = {
+    { .name = "idle", .id = 0, .version = 1 },
+    { .name = "busy", .id = 1, .version = 1 },
+    { .name = "done", .id = 2, .version = 1 },
+};
+
+static const PolyCall_Transition transitions[] = {
+    { .name = "go", .from_state = 0, .to_state = 1, .is_valid = true },
+    { .name = "back", .from_state = 1, .to_state = 0, .is_valid = true },
+    { .name = "finish", .from_state = 1, .to_state = 2, .is_valid = true },
+};
+
+static const PolyCall_StateMachineDef def = {
+    .name = "replicated",
+    .states = states,
+    .num_states = 3,
+    .transitions = transitions,
+    .num_transitions = 3,
+    .initial_state = 0,
+};
+
+static void check_replica(PolyCall_StateMachine* primary, PolyCall_StateMachine* standby) {
+    CHECK(standby->current_state == primary->current_state);
+    for (unsigned int i = 0; i < primary->num_states; i++) {
+        CHECK(standby->states[i].version == primary->states[i].version);
+        CHECK(standby->states[i].timestamp == primary->states[i].timestamp);
+        CHECK(standby->state_stats[i].transition_count == primary->state_stats[i].transition_count);
+        CHECK(polycall_sm_verify_state_integrity(standby, i) == POLYCALL_SM_SUCCESS);
+    }
+}
+
+static void test_replication(polycall_context_t ctx) {
+    PolyCall_StateMachine* primary = NULL;
+    PolyCall_StateMachine* standby = NULL;
+    CHECK(polycall_sm_create_from_def(ctx, &def, &primary, NULL) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_create_from_def(ctx, &def, &standby, NULL) == POLYCALL_SM_SUCCESS);
+    primary->machine_id = 42;
+
+    uint8_t buffer[POLYCALL_SM_SNAPSHOT_MAX_SIZE];
+    size_t length = 0;
+    polycall_sm_snapshot_info_t info;
+
+    // First delta without a base is a base carrying every state
+    CHECK(polycall_sm_execute_transition(primary, "go") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_snapshot_delta(primary, buffer, sizeof(buffer), &length) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_snapshot_peek(buffer, length, &info) == POLYCALL_SM_SUCCESS);
+    CHECK(info.is_base);
+    CHECK(info.machine_id == 42);
+    CHECK(info.epoch == 1);
+    CHECK(info.state_count == 3);
+    CHECK(polycall_sm_snapshot_apply(standby, buffer, length) == POLYCALL_SM_SUCCESS);
+    check_replica(primary, standby);
+
+    // Deltas carry only the states touched since the previous epoch
+    CHECK(polycall_sm_execute_transition(primary, "back") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_snapshot_delta(primary, buffer, sizeof(buffer), &length) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_snapshot_peek(buffer, length, &info) == POLYCALL_SM_SUCCESS);
+    CHECK(!info.is_base);
+    CHECK(info.base_epoch == 1);
+    CHECK(info.state_count == 1);
+    CHECK(polycall_sm_snapshot_apply(standby, buffer, length) == POLYCALL_SM_SUCCESS);
+    check_replica(primary, standby);
+
+    // A lost delta is refused until a new base arrives
+    CHECK(polycall_sm_execute_transition(primary, "go") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_snapshot_delta(primary, buffer, sizeof(buffer), &length) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(primary, "finish") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_snapshot_delta(primary, buffer, sizeof(buffer), &length) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_snapshot_apply(standby, buffer, length) == POLYCALL_SM_ERROR_VERSION_MISMATCH);
+    CHECK(standby->current_state == 0);
+    CHECK(polycall_sm_snapshot_base(primary, buffer, sizeof(buffer), &length) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_snapshot_apply(standby, buffer, length) == POLYCALL_SM_SUCCESS);
+    check_replica(primary, standby);
+
+    // Corrupt or truncated input is rejected without being applied
+    CHECK(polycall_sm_snapshot_apply(standby, buffer, length - 1) == POLYCALL_SM_ERROR_INTEGRITY_CHECK_FAILED);
+    buffer[0] ^= 0xff;
+    CHECK(polycall_sm_snapshot_apply(standby, buffer, length) == POLYCALL_SM_ERROR_VERSION_MISMATCH);
+
+    polycall_sm_destroy(standby);
+    polycall_sm_destroy(primary);
+}
+
+static void test_buffer_too_small(polycall_context_t ctx) {
+    PolyCall_StateMachine* sm = NULL;
+    CHECK(polycall_sm_create_from_def(ctx, &def, &sm, NULL) == POLYCALL_SM_SUCCESS);
+
+    uint8_t buffer[POLYCALL_SM_SNAPSHOT_MAX_SIZE];
+    size_t length = 0;
+    CHECK(polycall_sm_snapshot_base(sm, buffer, 16, &length) == POLYCALL_SM_ERROR_BUFFER_TOO_SMALL);
+    CHECK(length == 56 + 3 * 24);
+    CHECK(sm->snapshot_epoch == 0);
+
+    // The reported size is enough
+    size_t needed = length;
+    CHECK(polycall_sm_snapshot_base(sm, buffer, needed, &length) == POLYCALL_SM_SUCCESS);
+    CHECK(length == needed);
+    CHECK(sm->snapshot_epoch == 1);
+
+    polycall_sm_destroy(sm);
+}
+
+int main(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_sm_snapshot: context init failed\n");
+        return 1;
+    }
+
+    test_replication(ctx);
+    test_buffer_too_small(ctx);
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_sm_snapshot: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_sm_snapshot: ok\n");
+    return 0;
+}
@@ -0,0 +1,241 @@
+// test_sm_wal.c - Checkpoint + log recovery and torn-tail handling
+#include "polycall.h"
+#include "polycall_state_machine.h"
+#include "polycall_sm_registry.h"
+#include "polycall_sm_wal.h"
+#include "test_util.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static polycall_context_t ctx;
+static char dir[] = "/tmp/polycall_walXXXXXX";
+static char log_path[64];
+
+typedef struct {
+    PolyCall_StateMachine* machines[2];
+    polycall_sm_registry_t* registry;
+} fleet_t;
+
+static void fleet_create(fleet_t* fleet) {
+    CHECK(polycall_sm_registry_create(0, 0, &fleet->registry) == POLYCALL_SM_SUCCESS);
+    for (int m = 0; m < 2; m++) {
+        fleet->machines[m] = make_machine(ctx);
+        CHECK(polycall_sm_registry_insert(fleet->registry, (uint64_t)m + 1, fleet->machines[m]) ==
+              POLYCALL_SM_SUCCESS);
+    }
+}
+
+static void fleet_destroy(fleet_t* fleet) {
+    for (int m = 0; m < 2; m++) polycall_sm_destroy(fleet->machines[m]);
+    polycall_sm_registry_destroy(fleet->registry);
+}
+
+static polycall_sm_wal_recovery_t recover(fleet_t* fleet) {
+    polycall_sm_wal_recovery_t result;
+    fleet_create(fleet);
+    CHECK(polycall_sm_wal_recover(log_path, fleet->registry, &result) == POLYCALL_SM_SUCCESS);
+    return result;
+}
+
+static off_t file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+// Run a history with a checkpoint in the middle; returns the last lsn
+static uint64_t write_history(unsigned int* versions) {
+    fleet_t fleet;
+    fleet_create(&fleet);
+
+    polycall_sm_wal_config_t config = { log_path, 0, true };
+    polycall_sm_wal_t* wal = NULL;
+    CHECK(polycall_sm_wal_open(&config, &wal) == POLYCALL_SM_SUCCESS);
+    for (int m = 0; m < 2; m++) {
+        CHECK(polycall_sm_set_wal(fleet.machines[m], wal, (uint64_t)m + 1) == POLYCALL_SM_SUCCESS);
+    }
+
+    CHECK(polycall_sm_execute_transition(fleet.machines[0], "go") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(fleet.machines[1], "go") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_wal_sync(wal, UINT64_MAX) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_wal_checkpoint(wal, fleet.registry) == POLYCALL_SM_SUCCESS);
+
+    // After the checkpoint: machine 1 ends up back in "busy", machine 2 in "idle"
+    CHECK(polycall_sm_execute_transition(fleet.machines[0], "back") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(fleet.machines[0], "go") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_execute_transition(fleet.machines[1], "back") == POLYCALL_SM_SUCCESS);
+    uint64_t last = fleet.machines[1]->wal_lsn;
+    CHECK(polycall_sm_wal_sync(wal, last) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_wal_durable_lsn(wal) == last);
+
+    for (int m = 0; m < 2; m++) {
+        versions[m * 2] = fleet.machines[m]->states[0].version;
+        versions[m * 2 + 1] = fleet.machines[m]->states[1].version;
+        polycall_sm_set_wal(fleet.machines[m], NULL, 0);
+    }
+    polycall_sm_wal_close(wal);
+    fleet_destroy(&fleet);
+    return last;
+}
+
+static void check_restored(const fleet_t* fleet, const unsigned int* versions, bool second_lost) {
+    CHECK(fleet->machines[0]->current_state == 1);
+    CHECK(fleet->machines[1]->current_state == (second_lost ? 1u : 0u));
+    CHECK(fleet->machines[0]->states[0].version == versions[0]);
+    CHECK(fleet->machines[0]->states[1].version == versions[1]);
+    if (!second_lost) CHECK(fleet->machines[1]->states[0].version == versions[2]);
+    CHECK(fleet->machines[1]->states[1].version == versions[3]);
+
+    // Restored and replayed states carry resealed checksums
+    for (int m = 0; m < 2; m++) {
+        for (unsigned int s = 0; s < 2; s++) {
+            CHECK(polycall_sm_verify_state_integrity(fleet->machines[m], s) == POLYCALL_SM_SUCCESS);
+        }
+    }
+}
+
+static void test_recovery(void) {
+    unsigned int versions[4];
+    uint64_t last = write_history(versions);
+
+    fleet_t fleet;
+    polycall_sm_wal_recovery_t result = recover(&fleet);
+    CHECK(result.machines_restored == 2);
+    CHECK(result.records_applied == 3);
+    CHECK(result.records_skipped == 0);
+    CHECK(result.checkpoint_lsn == last - 3);
+    CHECK(result.last_lsn == last);
+    check_restored(&fleet, versions, false);
+    fleet_destroy(&fleet);
+}
+
+static void test_torn_tail(void) {
+    unsigned int versions[4];
+    uint64_t last = write_history(versions);
+    off_t intact = file_size(log_path);
+    CHECK(intact > 0);
+
+    // Half a record left by a crash mid-write is ignored
+    int fd = open(log_path, O_WRONLY | O_APPEND);
+    CHECK(fd >= 0);
+    uint8_t garbage[sizeof(polycall_sm_wal_record_t) / 2];
+    memset(garbage, 0xab, sizeof(garbage));
+    CHECK(write(fd, garbage, sizeof(garbage)) == (ssize_t)sizeof(garbage));
+    close(fd);
+
+    fleet_t fleet;
+    polycall_sm_wal_recovery_t result = recover(&fleet);
+    CHECK(result.records_applied == 3);
+    CHECK(result.last_lsn == last);
+    check_restored(&fleet, versions, false);
+    fleet_destroy(&fleet);
+
+    // A corrupt final record ends replay just before it
+    fd = open(log_path, O_RDWR);
+    CHECK(fd >= 0);
+    off_t victim = intact - (off_t)sizeof(polycall_sm_wal_record_t) + 8;
+    uint8_t byte = 0;
+    CHECK(pread(fd, &byte, 1, victim) == 1);
+    byte ^= 0xff;
+    CHECK(pwrite(fd, &byte, 1, victim) == 1);
+    close(fd);
+
+    result = recover(&fleet);
+    CHECK(result.records_applied == 2);
+    CHECK(result.last_lsn == last - 1);
+    check_restored(&fleet, versions, true);
+    fleet_destroy(&fleet);
+
+    // Reopening cuts the log back to the last valid record and continues after it
+    polycall_sm_wal_config_t config = { log_path, 0, true };
+    polycall_sm_wal_t* wal = NULL;
+    CHECK(polycall_sm_wal_open(&config, &wal) == POLYCALL_SM_SUCCESS);
+    CHECK(file_size(log_path) == intact - (off_t)sizeof(polycall_sm_wal_record_t));
+
+    polycall_sm_wal_record_t record = { .machine_id = 2, .to_state = 0, .version = versions[2] };
+    uint64_t lsn = 0;
+    CHECK(polycall_sm_wal_append(wal, &record, &lsn) == POLYCALL_SM_SUCCESS);
+    CHECK(lsn == last);
+    CHECK(polycall_sm_wal_sync(wal, lsn) == POLYCALL_SM_SUCCESS);
+    polycall_sm_wal_close(wal);
+
+    result = recover(&fleet);
+    CHECK(result.records_applied == 3);
+    CHECK(fleet.machines[1]->current_state == 0);
+    fleet_destroy(&fleet);
+}
+
+// A commit the log refuses still happens, but its lsn can never sync
+static void test_append_failure(void) {
+    PolyCall_StateMachine* sm = make_machine(ctx);
+    polycall_sm_wal_config_t config = { log_path, 0, true };
+    polycall_sm_wal_t* wal = NULL;
+    CHECK(polycall_sm_wal_open(&config, &wal) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_set_wal(sm, wal, 1) == POLYCALL_SM_SUCCESS);
+
+    CHECK(polycall_sm_execute_transition(sm, "go") == POLYCALL_SM_SUCCESS);
+    uint64_t durable = sm->wal_lsn;
+    CHECK(polycall_sm_wal_sync(wal, durable) == POLYCALL_SM_SUCCESS);
+
+    // The log cannot grow any more: the flusher fails on the next batch
+    struct rlimit saved;
+    CHECK(getrlimit(RLIMIT_FSIZE, &saved) == 0);
+    struct rlimit limit = { (rlim_t)file_size(log_path), saved.rlim_max };
+    void (*previous)(int) = signal(SIGXFSZ, SIG_IGN);
+    CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+    CHECK(polycall_sm_execute_transition(sm, "back") == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_wal_sync(wal, sm->wal_lsn) == POLYCALL_SM_ERROR_IO);
+    CHECK(sm->diagnostics.wal_failures == 0);
+
+    // Appends are refused from then on; the machine still moves
+    CHECK(polycall_sm_execute_transition(sm, "go") == POLYCALL_SM_SUCCESS);
+    CHECK(sm->current_state == 1);
+    CHECK(sm->diagnostics.wal_failures == 1);
+    CHECK(sm->wal_lsn == POLYCALL_SM_WAL_LSN_LOST);
+    CHECK(polycall_sm_wal_sync(wal, sm->wal_lsn) == POLYCALL_SM_ERROR_IO);
+
+    CHECK(setrlimit(RLIMIT_FSIZE, &saved) == 0);
+    signal(SIGXFSZ, previous);
+    polycall_sm_set_wal(sm, NULL, 0);
+    polycall_sm_wal_close(wal);
+    polycall_sm_destroy(sm);
+}
+
+static void remove_files(void) {
+    char path[96];
+    unlink(log_path);
+    snprintf(path, sizeof(path), "%s.ckpt", log_path);
+    unlink(path);
+}
+
+int main(void) {
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS || !mkdtemp(dir)) {
+        fprintf(stderr, "test_sm_wal: setup failed\n");
+        return 1;
+    }
+    snprintf(log_path, sizeof(log_path), "%s/machines.wal", dir);
+
+    test_recovery();
+    remove_files();
+    test_torn_tail();
+    remove_files();
+    test_append_failure();
+    remove_files();
+    rmdir(dir);
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_sm_wal: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_sm_wal: ok\n");
+    return 0;
+}
@@ -0,0 +1,40 @@
+// test_util.h - Checks and fixtures shared by the test programs
+#ifndef POLYCALL_TEST_UTIL_H
+#define POLYCALL_TEST_UTIL_H
+
+#include "polycall.h"
+#include "polycall_state_machine.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Each test is one program; main reports the total and fails on any
+static int failures;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);             \
+        }                                                                   \
+    } while (0)
+
+// 0 --go--> 1 --back--> 0, with an optional action on go and guard on back
+static inline PolyCall_StateMachine* make_machine_with(
+    polycall_context_t ctx,
+    PolyCall_StateAction go_action,
+    bool (*back_guard)(const PolyCall_State*, const PolyCall_State*)
+) {
+    PolyCall_StateMachine* sm = NULL;
+    CHECK(polycall_sm_create_with_integrity(ctx, &sm, NULL) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_add_state(sm, "idle", NULL, NULL, false) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_add_state(sm, "busy", NULL, NULL, false) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_add_transition(sm, "go", 0, 1, go_action, NULL) == POLYCALL_SM_SUCCESS);
+    CHECK(polycall_sm_add_transition(sm, "back", 1, 0, NULL, back_guard) == POLYCALL_SM_SUCCESS);
+    return sm;
+}
+
+static inline PolyCall_StateMachine* make_machine(polycall_context_t ctx) {
+    return make_machine_with(ctx, NULL, NULL);
+}
+
+#endif // POLYCALL_TEST_UTIL_H
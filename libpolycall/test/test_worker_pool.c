@@ -0,0 +1,127 @@
+// test_worker_pool.c - Unordered tasks, stealing and per-key strands
+#include "polycall.h"
+#include "polycall_worker_pool.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS 4
+#define TASKS 20000
+#define KEYS 8
+#define KEY_TASKS 2000
+
+static int completed;
+
+static void count_task(void* arg) {
+    (void)arg;
+    __atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED);
+}
+
+static void test_submit(void) {
+    polycall_worker_pool_t* pool = NULL;
+    CHECK(polycall_worker_pool_create(THREADS, &pool) == POLYCALL_SUCCESS);
+    CHECK(polycall_worker_pool_size(pool) == THREADS);
+
+    completed = 0;
+    for (int i = 0; i < TASKS; i++) {
+        CHECK(polycall_worker_pool_submit(pool, count_task, NULL));
+    }
+
+    // Destroy runs whatever is still queued
+    polycall_worker_pool_destroy(pool);
+    CHECK(completed == TASKS);
+}
+
+// Tasks submitted from a worker land on its own deque and get stolen
+typedef struct {
+    polycall_worker_pool_t* pool;
+    int fanout;
+} spawn_t;
+
+static void spawn_task(void* arg) {
+    spawn_t* spawn = (spawn_t*)arg;
+    for (int i = 0; i < spawn->fanout; i++) {
+        CHECK(polycall_worker_pool_submit(spawn->pool, count_task, NULL));
+    }
+}
+
+static void test_nested_submit(void) {
+    polycall_worker_pool_t* pool = NULL;
+    CHECK(polycall_worker_pool_create(THREADS, &pool) == POLYCALL_SUCCESS);
+
+    completed = 0;
+    spawn_t spawn = { pool, TASKS / 10 };
+    for (int i = 0; i < 10; i++) {
+        CHECK(polycall_worker_pool_submit(pool, spawn_task, &spawn));
+    }
+    polycall_worker_pool_destroy(pool);
+    CHECK(completed == TASKS);
+}
+
+typedef struct {
+    int running;                // Tasks of this key running right now
+    int next;                   // Sequence the next task must carry
+} strand_state_t;
+
+typedef struct {
+    strand_state_t* strand;
+    int sequence;
+} ordered_task_t;
+
+static void ordered_task(void* arg) {
+    ordered_task_t* task = (ordered_task_t*)arg;
+    strand_state_t* strand = task->strand;
+
+    CHECK(__atomic_add_fetch(&strand->running, 1, __ATOMIC_ACQ_REL) == 1);
+    CHECK(strand->next == task->sequence);
+    strand->next++;
+    __atomic_sub_fetch(&strand->running, 1, __ATOMIC_ACQ_REL);
+}
+
+static void test_ordered(void) {
+    polycall_worker_pool_t* pool = NULL;
+    CHECK(polycall_worker_pool_create(THREADS, &pool) == POLYCALL_SUCCESS);
+
+    static strand_state_t strands[KEYS];
+    static ordered_task_t tasks[KEYS][KEY_TASKS];
+    memset(strands, 0, sizeof(strands));
+
+    // Keys interleaved, so every strand has work queued behind a running task
+    for (int i = 0; i < KEY_TASKS; i++) {
+        for (int key = 0; key < KEYS; key++) {
+            tasks[key][i].strand = &strands[key];
+            tasks[key][i].sequence = i;
+            CHECK(polycall_worker_pool_submit_ordered(pool, (uint64_t)key * 977,
+                                                      ordered_task, &tasks[key][i]));
+        }
+    }
+    polycall_worker_pool_destroy(pool);
+
+    for (int key = 0; key < KEYS; key++) {
+        CHECK(strands[key].next == KEY_TASKS);
+    }
+}
+
+int main(void) {
+    polycall_context_t ctx = NULL;
+    polycall_config_t config = { 0, 1024 * 1024, NULL };
+    if (polycall_init_with_config(&ctx, &config) != POLYCALL_SUCCESS) {
+        fprintf(stderr, "test_worker_pool: context init failed\n");
+        return 1;
+    }
+
+    test_submit();
+    test_nested_submit();
+    test_ordered();
+
+    polycall_cleanup(ctx);
+    if (failures) {
+        fprintf(stderr, "test_worker_pool: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_worker_pool: ok\n");
+    return 0;
+}
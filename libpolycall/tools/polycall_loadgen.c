@@ -0,0 +1,931 @@
+// polycall-loadgen - Open-loop load generator for polycall servers
+//
+// Opens many TCP connections, takes each one through handshake and
+// authentication and then issues pipelined commands at a fixed aggregate
+// rate. Every command is stamped with the time it was scheduled to go out
+// rather than the time it actually left, so a server that stalls is charged
+// for the requests its stall held back (coordinated omission correction,
+// as in wrk2). Requests that came due but were still waiting for a free
+// pipeline slot when the run ended are reported as never sent and recorded
+// with the latency they had reached by then. Latencies go into a log-linear histogram with better than
+// 1% resolution and are printed as an HdrHistogram percentile spectrum.
+//
+// Frames are built and parsed by the protocol layer: each connection's
+// protocol context sends into an in-process loopback pair whose far end
+// is drained into the socket, and whole frames read off the socket are
+// handed to polycall_protocol_process.
+//
+// The reply to a request is the next frame the server sends, whatever its
+// type, so the tool also drives a server that just echoes frames back.
+// ERROR frames answer a request but are counted as errors.
+#include "polycall.h"
+#include "polycall_protocol.h"
+#include "polycall_histogram.h"
+#include "network.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#define LOADGEN_MAX_THREADS 64
+#define LOADGEN_MAX_FRAME (1u << 20)
+// polycall_protocol_send builds frames of at most 4096 bytes
+#define LOADGEN_MAX_PAYLOAD (4096 - sizeof(polycall_message_header_t))
+#define LOADGEN_READ_CHUNK 16384
+#define LOADGEN_EVENTS 256
+#define LOADGEN_DRAIN_NS 2000000000ull   // Wait for stragglers after the run
+#define LOADGEN_WIRE_CAPACITY 64
+
+// Log-linear histogram: 2^HDR_SUB_BITS linear buckets per power of two
+// keeps every recorded value within 1/128 of its true value
+#define HDR_SUB_BITS 7
+#define HDR_SUB_COUNT (1u << HDR_SUB_BITS)
+#define HDR_MAX_MSB 40                   // ~18 minutes in nanoseconds
+#define HDR_BUCKETS ((HDR_MAX_MSB - HDR_SUB_BITS + 2) * HDR_SUB_COUNT)
+
+typedef struct {
+    uint64_t counts[HDR_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+    double sum_squares;
+} hdr_t;
+
+typedef struct {
+    const char* host;
+    const char* port;
+    unsigned int connections;
+    unsigned int threads;
+    double rate;                    // Requests/s over all connections, 0 = closed loop
+    double duration;                // Seconds measured
+    double warmup;                  // Seconds run before measuring
+    double connect_timeout;
+    unsigned int pipeline;          // Outstanding requests per connection
+    size_t payload;
+    const char* credentials;
+    bool json;
+} loadgen_options_t;
+
+typedef enum {
+    CONN_CONNECTING,
+    CONN_HANDSHAKE,                 // Handshake sent, waiting for the reply
+    CONN_AUTH,                      // Credentials sent, waiting for the reply
+    CONN_READY,
+    CONN_CLOSED
+} conn_phase_t;
+
+struct worker;
+
+typedef struct {
+    struct worker* worker;
+    int fd;
+    conn_phase_t phase;
+    bool protocol_ready;
+    bool writable_armed;
+    polycall_protocol_context_t protocol;
+    NetworkEndpoint local;          // The protocol context sends here...
+    NetworkEndpoint wire;           // ...and this end is drained to the socket
+    uint8_t* in;
+    size_t in_length;
+    size_t in_capacity;
+    uint8_t* out;
+    size_t out_offset;
+    size_t out_length;
+    size_t out_capacity;
+    uint64_t* intents;              // Ring of scheduled send times, one per outstanding request
+    unsigned int intent_head;
+    unsigned int intent_count;
+    uint64_t setup_start;
+} conn_t;
+
+typedef struct worker {
+    pthread_t thread;
+    const loadgen_options_t* options;
+    const struct addrinfo* address;
+    pthread_barrier_t* barrier;
+    int epoll_fd;
+    polycall_context_t ctx;
+    conn_t* conns;
+    unsigned int conn_count;
+    unsigned int ready;
+    unsigned int cursor;
+    uint8_t* payload;
+    double interval_ns;             // Between this worker's scheduled requests
+    uint64_t start_ns;              // Schedule origin, shared by all workers
+    uint64_t measure_ns;            // End of warm-up
+    uint64_t next_intent;           // Index of the next scheduled request
+    bool measuring;
+    hdr_t latency;
+    hdr_t setup;
+    uint64_t sent;
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t dropped;               // Outstanding on a connection that closed
+    uint64_t unfinished;            // Outstanding when the run ended
+    uint64_t unsent;                // Came due during the run but never went out
+    uint64_t connect_failures;
+    uint64_t behind_ns;             // Worst lag of a send behind its schedule
+} worker_t;
+
+// Histogram
+
+static unsigned int hdr_index(uint64_t value) {
+    if (value < HDR_SUB_COUNT) return (unsigned int)value;
+    unsigned int msb = 63u - (unsigned int)__builtin_clzll(value);
+    if (msb > HDR_MAX_MSB) return HDR_BUCKETS - 1;
+    unsigned int sub = (unsigned int)(value >> (msb - HDR_SUB_BITS)) & (HDR_SUB_COUNT - 1);
+    return ((msb - HDR_SUB_BITS + 1) << HDR_SUB_BITS) + sub;
+}
+
+// Largest value that lands in the bucket, as HdrHistogram reports it
+static uint64_t hdr_highest(unsigned int index) {
+    if (index < HDR_SUB_COUNT) return index;
+    unsigned int msb = (index >> HDR_SUB_BITS) + HDR_SUB_BITS - 1;
+    uint64_t lower = (uint64_t)(HDR_SUB_COUNT | (index & (HDR_SUB_COUNT - 1))) << (msb - HDR_SUB_BITS);
+    return lower + (1ull << (msb - HDR_SUB_BITS)) - 1;
+}
+
+static void hdr_reset(hdr_t* hdr) {
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->min = UINT64_MAX;
+}
+
+static void hdr_record(hdr_t* hdr, uint64_t value) {
+    hdr->counts[hdr_index(value)]++;
+    hdr->total++;
+    if (value < hdr->min) hdr->min = value;
+    if (value > hdr->max) hdr->max = value;
+    hdr->sum += (double)value;
+    hdr->sum_squares += (double)value * (double)value;
+}
+
+static void hdr_merge(hdr_t* into, const hdr_t* from) {
+    for (unsigned int i = 0; i < HDR_BUCKETS; i++) into->counts[i] += from->counts[i];
+    into->total += from->total;
+    if (from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+    into->sum += from->sum;
+    into->sum_squares += from->sum_squares;
+}
+
+static uint64_t hdr_percentile(const hdr_t* hdr, double percentile) {
+    if (hdr->total == 0) return 0;
+    if (percentile >= 100.0) return hdr->max;
+
+    uint64_t rank = (uint64_t)ceil(percentile / 100.0 * (double)hdr->total);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < HDR_BUCKETS; i++) {
+        seen += hdr->counts[i];
+        if (seen >= rank) {
+            uint64_t value = hdr_highest(i);
+            return value > hdr->max ? hdr->max : value;
+        }
+    }
+    return hdr->max;
+}
+
+static double hdr_mean(const hdr_t* hdr) {
+    return hdr->total ? hdr->sum / (double)hdr->total : 0.0;
+}
+
+static double hdr_stddev(const hdr_t* hdr) {
+    if (hdr->total < 2) return 0.0;
+    double mean = hdr_mean(hdr);
+    double variance = hdr->sum_squares / (double)hdr->total - mean * mean;
+    return variance > 0 ? sqrt(variance) : 0.0;
+}
+
+// HdrHistogram's percentile distribution, values in milliseconds: five
+// ticks per halving of the distance to 100%
+static void hdr_print_spectrum(FILE* out, const hdr_t* hdr) {
+    fprintf(out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    if (hdr->total == 0) return;
+
+    uint64_t seen = 0;
+    unsigned int index = 0;
+    double percentile = 0.0;
+    for (;;) {
+        uint64_t rank = (uint64_t)ceil(percentile / 100.0 * (double)hdr->total);
+        if (rank == 0) rank = 1;
+        while (seen < rank && index < HDR_BUCKETS) seen += hdr->counts[index++];
+        if (seen >= hdr->total) break;
+
+        uint64_t value = hdr_highest(index - 1);
+        fprintf(out, "%12.3f %14.12f %10llu %14.2f\n", (double)value / 1e6, percentile / 100.0,
+                (unsigned long long)seen, 100.0 / (100.0 - percentile));
+
+        double halvings = floor(log2(100.0 / (100.0 - percentile))) + 1.0;
+        percentile += 100.0 / (pow(2.0, halvings) * 5.0);
+    }
+    fprintf(out, "%12.3f %14.12f %10llu %14s\n", (double)hdr->max / 1e6, 1.0,
+            (unsigned long long)hdr->total, "inf");
+    fprintf(out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n",
+            hdr_mean(hdr) / 1e6, hdr_stddev(hdr) / 1e6);
+    fprintf(out, "#[Max     = %12.3f, Total count    = %12llu]\n",
+            (double)hdr->max / 1e6, (unsigned long long)hdr->total);
+    fprintf(out, "#[Buckets = %12u, SubBuckets     = %12u]\n",
+            HDR_BUCKETS / HDR_SUB_COUNT, HDR_SUB_COUNT);
+}
+
+// Connections
+
+static void conn_close(conn_t* conn) {
+    if (conn->phase == CONN_CLOSED) return;
+    worker_t* worker = conn->worker;
+
+    if (conn->phase == CONN_READY) {
+        worker->ready--;
+        worker->dropped += conn->intent_count;
+        conn->intent_count = 0;
+    } else {
+        worker->connect_failures++;
+    }
+    conn->phase = CONN_CLOSED;
+    if (conn->fd >= 0) {
+        close(conn->fd);            // Also drops it from the epoll set
+        conn->fd = -1;
+    }
+}
+
+static bool conn_reserve(uint8_t** buffer, size_t* capacity, size_t needed) {
+    if (needed <= *capacity) return true;
+    size_t grown = *capacity ? *capacity : 4096;
+    while (grown < needed) grown *= 2;
+    uint8_t* resized = realloc(*buffer, grown);
+    if (!resized) return false;
+    *buffer = resized;
+    *capacity = grown;
+    return true;
+}
+
+static void conn_watch(conn_t* conn, bool writable) {
+    if (conn->writable_armed == writable) return;
+    struct epoll_event event = {
+        .events = EPOLLIN | (writable ? EPOLLOUT : 0),
+        .data.ptr = conn
+    };
+    epoll_ctl(conn->worker->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->writable_armed = writable;
+}
+
+// Move frames the protocol layer produced onto the socket; whatever the
+// kernel does not take waits for EPOLLOUT
+static void conn_flush(conn_t* conn) {
+    NetworkPacket frame;
+    while (net_receive_owned(&conn->wire, &frame) > 0) {
+        size_t needed = conn->out_length + frame.size;
+        if (conn->out_offset > 0 && needed > conn->out_capacity) {
+            memmove(conn->out, conn->out + conn->out_offset, conn->out_length - conn->out_offset);
+            conn->out_length -= conn->out_offset;
+            conn->out_offset = 0;
+            needed = conn->out_length + frame.size;
+        }
+        if (!conn_reserve(&conn->out, &conn->out_capacity, needed)) {
+            net_packet_free(frame.data);
+            conn_close(conn);
+            return;
+        }
+        memcpy(conn->out + conn->out_length, frame.data, frame.size);
+        conn->out_length += frame.size;
+        net_packet_free(frame.data);
+    }
+
+    while (conn->out_offset < conn->out_length) {
+        ssize_t sent = send(conn->fd, conn->out + conn->out_offset,
+                            conn->out_length - conn->out_offset, MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn->out_offset += (size_t)sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            conn_watch(conn, true);
+            return;
+        }
+        conn_close(conn);
+        return;
+    }
+    conn->out_offset = conn->out_length = 0;
+    conn_watch(conn, false);
+}
+
+static bool conn_push_intent(conn_t* conn, uint64_t intended) {
+    unsigned int pipeline = conn->worker->options->pipeline;
+    if (conn->intent_count == pipeline) return false;
+    conn->intents[(conn->intent_head + conn->intent_count) % pipeline] = intended;
+    conn->intent_count++;
+    return true;
+}
+
+static void conn_send_command(conn_t* conn, uint64_t intended) {
+    worker_t* worker = conn->worker;
+    if (!conn_push_intent(conn, intended)) return;
+    if (!polycall_protocol_send(&conn->protocol, POLYCALL_MSG_COMMAND, worker->payload,
+                                worker->options->payload, POLYCALL_FLAG_NONE)) {
+        conn_close(conn);
+        return;
+    }
+    worker->sent++;
+    conn_flush(conn);
+}
+
+// Any frame from the server answers the oldest request on the connection
+static void conn_reply(conn_t* conn, bool ok) {
+    worker_t* worker = conn->worker;
+    uint64_t now = polycall_monotonic_ns();
+
+    switch (conn->phase) {
+        case CONN_HANDSHAKE: {
+            const char* credentials = worker->options->credentials;
+            if (!ok || !polycall_protocol_complete_handshake(&conn->protocol) ||
+                !polycall_protocol_authenticate(&conn->protocol, credentials, strlen(credentials))) {
+                conn_close(conn);
+                return;
+            }
+            conn->phase = CONN_AUTH;
+            conn_flush(conn);
+            break;
+        }
+
+        case CONN_AUTH:
+            if (!ok) {
+                conn_close(conn);
+                return;
+            }
+            conn->phase = CONN_READY;
+            worker->ready++;
+            hdr_record(&worker->setup, now - conn->setup_start);
+            break;
+
+        case CONN_READY: {
+            if (conn->intent_count == 0) {
+                worker->errors++;   // Unsolicited
+                return;
+            }
+            uint64_t intended = conn->intents[conn->intent_head];
+            conn->intent_head = (conn->intent_head + 1) % worker->options->pipeline;
+            conn->intent_count--;
+            if (!worker->measuring || intended < worker->measure_ns) break;
+            if (ok) {
+                worker->completed++;
+                hdr_record(&worker->latency, now - intended);
+            } else {
+                worker->errors++;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static void on_reply_handshake(polycall_protocol_context_t* ctx) {
+    conn_reply(ctx->user_data, true);
+}
+
+static void on_reply_auth(polycall_protocol_context_t* ctx, const char* credentials) {
+    (void)credentials;
+    conn_reply(ctx->user_data, true);
+}
+
+static void on_reply_command(polycall_protocol_context_t* ctx, const char* command, size_t length) {
+    (void)command;
+    (void)length;
+    conn_reply(ctx->user_data, true);
+}
+
+static void on_reply_response(polycall_protocol_context_t* ctx, const void* payload, size_t length) {
+    (void)payload;
+    (void)length;
+    conn_reply(ctx->user_data, true);
+}
+
+static void on_reply_error(polycall_protocol_context_t* ctx, const char* error) {
+    (void)error;
+    conn_reply(ctx->user_data, false);
+}
+
+// Hand every complete frame in the input buffer to the protocol layer
+static void conn_read(conn_t* conn) {
+    for (;;) {
+        if (!conn_reserve(&conn->in, &conn->in_capacity, conn->in_length + LOADGEN_READ_CHUNK)) {
+            conn_close(conn);
+            return;
+        }
+        ssize_t got = recv(conn->fd, conn->in + conn->in_length, LOADGEN_READ_CHUNK, 0);
+        if (got == 0) {
+            conn_close(conn);
+            return;
+        }
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            conn_close(conn);
+            return;
+        }
+        conn->in_length += (size_t)got;
+        if ((size_t)got < LOADGEN_READ_CHUNK) break;
+    }
+
+    size_t offset = 0;
+    while (conn->phase != CONN_CLOSED &&
+           conn->in_length - offset >= sizeof(polycall_message_header_t)) {
+        polycall_message_header_t header;
+        memcpy(&header, conn->in + offset, sizeof(header));
+        if (header.payload_length > LOADGEN_MAX_FRAME) {
+            conn_close(conn);
+            return;
+        }
+        size_t frame = sizeof(header) + header.payload_length;
+        if (conn->in_length - offset < frame) break;
+
+        if (!polycall_protocol_process(&conn->protocol, conn->in + offset, frame)) {
+            conn_reply(conn, false);
+        }
+        offset += frame;
+    }
+    if (conn->phase == CONN_CLOSED) return;
+
+    memmove(conn->in, conn->in + offset, conn->in_length - offset);
+    conn->in_length -= offset;
+    conn_flush(conn);
+}
+
+static void conn_connected(conn_t* conn) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+        conn_close(conn);
+        return;
+    }
+    int one = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    conn->phase = CONN_HANDSHAKE;
+    if (!polycall_protocol_start_handshake(&conn->protocol)) {
+        conn_close(conn);
+        return;
+    }
+    conn_flush(conn);
+}
+
+static bool conn_open(conn_t* conn, worker_t* worker) {
+    conn->worker = worker;
+    conn->fd = -1;
+    conn->phase = CONN_CONNECTING;
+    conn->intents = calloc(worker->options->pipeline, sizeof(uint64_t));
+    if (!conn->intents) return false;
+
+    if (!net_loopback_pair(&conn->local, &conn->wire, LOADGEN_WIRE_CAPACITY)) return false;
+    polycall_protocol_config_t config = {
+        .callbacks = {
+            .on_handshake = on_reply_handshake,
+            .on_auth_request = on_reply_auth,
+            .on_command = on_reply_command,
+            .on_response = on_reply_response,
+            .on_error = on_reply_error
+        },
+        .max_message_size = LOADGEN_MAX_FRAME,
+        .user_data = conn
+    };
+    if (!polycall_protocol_init(&conn->protocol, worker->ctx, &conn->local, &config)) return false;
+    conn->protocol_ready = true;
+
+    const struct addrinfo* address = worker->address;
+    conn->fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK, address->ai_protocol);
+    if (conn->fd < 0) {
+        conn_close(conn);
+        return true;
+    }
+    conn->setup_start = polycall_monotonic_ns();
+    if (connect(conn->fd, address->ai_addr, address->ai_addrlen) != 0 && errno != EINPROGRESS) {
+        conn_close(conn);
+        return true;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN | EPOLLOUT, .data.ptr = conn };
+    conn->writable_armed = true;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, conn->fd, &event) != 0) conn_close(conn);
+    return true;
+}
+
+static void conn_release(conn_t* conn) {
+    if (conn->phase != CONN_CLOSED && conn->fd >= 0) close(conn->fd);
+    if (conn->protocol_ready) polycall_protocol_cleanup(&conn->protocol);
+    if (conn->local.loopback) {
+        // Frames never drained still belong to us
+        NetworkPacket frame;
+        while (net_receive_owned(&conn->wire, &frame) > 0) net_packet_free(frame.data);
+        net_close(&conn->local);
+        net_close(&conn->wire);
+    }
+    free(conn->intents);
+    free(conn->in);
+    free(conn->out);
+}
+
+// Worker loop
+
+static void worker_poll(worker_t* worker, int timeout_ms) {
+    struct epoll_event events[LOADGEN_EVENTS];
+    int count = epoll_wait(worker->epoll_fd, events, LOADGEN_EVENTS, timeout_ms);
+    for (int i = 0; i < count; i++) {
+        conn_t* conn = events[i].data.ptr;
+        if (conn->phase == CONN_CLOSED) continue;
+        if (conn->phase == CONN_CONNECTING) {
+            if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) conn_connected(conn);
+            continue;
+        }
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) conn_read(conn);
+        if (conn->phase != CONN_CLOSED && (events[i].events & EPOLLOUT)) conn_flush(conn);
+    }
+}
+
+// Next READY connection with room in its pipeline, round robin
+static conn_t* worker_pick(worker_t* worker) {
+    for (unsigned int tried = 0; tried < worker->conn_count; tried++) {
+        conn_t* conn = &worker->conns[worker->cursor];
+        worker->cursor = (worker->cursor + 1) % worker->conn_count;
+        if (conn->phase == CONN_READY && conn->intent_count < worker->options->pipeline) return conn;
+    }
+    return NULL;
+}
+
+// Issue every request whose scheduled time has come. When all pipelines
+// are full the schedule keeps running: the backlog goes out later, still
+// stamped with the times it was due.
+static void worker_issue(worker_t* worker, uint64_t now, uint64_t end) {
+    if (worker->interval_ns <= 0) {
+        conn_t* conn;
+        while ((conn = worker_pick(worker)) != NULL) conn_send_command(conn, polycall_monotonic_ns());
+        return;
+    }
+
+    for (;;) {
+        uint64_t intended = worker->start_ns + (uint64_t)((double)worker->next_intent * worker->interval_ns);
+        if (intended > now || intended >= end) return;
+        conn_t* conn = worker_pick(worker);
+        if (!conn) return;
+        if (now - intended > worker->behind_ns) worker->behind_ns = now - intended;
+        conn_send_command(conn, intended);
+        worker->next_intent++;
+    }
+}
+
+static void* worker_main(void* arg) {
+    worker_t* worker = arg;
+    const loadgen_options_t* options = worker->options;
+
+    // Connect and authenticate everything before the clock starts
+    uint64_t deadline = polycall_monotonic_ns() + (uint64_t)(options->connect_timeout * 1e9);
+    for (unsigned int i = 0; i < worker->conn_count; i++) {
+        if (!conn_open(&worker->conns[i], worker)) {
+            fprintf(stderr, "polycall-loadgen: out of memory opening connections\n");
+            worker->conn_count = i + 1;
+            conn_close(&worker->conns[i]);
+            break;
+        }
+    }
+    for (;;) {
+        unsigned int pending = 0;
+        for (unsigned int i = 0; i < worker->conn_count; i++) {
+            conn_phase_t phase = worker->conns[i].phase;
+            if (phase != CONN_READY && phase != CONN_CLOSED) pending++;
+        }
+        if (pending == 0) break;
+        if (polycall_monotonic_ns() >= deadline) {
+            for (unsigned int i = 0; i < worker->conn_count; i++) {
+                if (worker->conns[i].phase != CONN_READY) conn_close(&worker->conns[i]);
+            }
+            break;
+        }
+        worker_poll(worker, 10);
+    }
+
+    // Connected; wait for the others, then for main to set the clock
+    pthread_barrier_wait(worker->barrier);
+    pthread_barrier_wait(worker->barrier);
+
+    uint64_t start = worker->start_ns;
+    uint64_t end = worker->measure_ns + (uint64_t)(options->duration * 1e9);
+    while (worker->ready > 0) {
+        uint64_t now = polycall_monotonic_ns();
+        if (now >= end) break;
+        if (!worker->measuring && now >= worker->measure_ns) worker->measuring = true;
+        worker_issue(worker, now, end);
+
+        // Sleep only when the next request is comfortably far off
+        int timeout = 0;
+        if (worker->interval_ns > 0) {
+            uint64_t next = start + (uint64_t)((double)worker->next_intent * worker->interval_ns);
+            if (next > now + 2000000) timeout = (int)((next - now) / 1000000) - 1;
+        }
+        worker_poll(worker, timeout);
+    }
+    worker->measuring = true;
+
+    // Requests still waiting for a pipeline slot (or for any connection at
+    // all) waited at least until the end; leaving them out would hide the
+    // worst of a stall
+    if (worker->interval_ns > 0) {
+        for (;; worker->next_intent++) {
+            uint64_t intended = start + (uint64_t)((double)worker->next_intent * worker->interval_ns);
+            if (intended >= end) break;
+            if (intended < worker->measure_ns) continue;
+            worker->unsent++;
+            hdr_record(&worker->latency, end - intended);
+        }
+    }
+
+    // Let requests already sent complete
+    uint64_t drain = polycall_monotonic_ns() + LOADGEN_DRAIN_NS;
+    for (;;) {
+        uint64_t outstanding = 0;
+        for (unsigned int i = 0; i < worker->conn_count; i++) {
+            if (worker->conns[i].phase == CONN_READY) outstanding += worker->conns[i].intent_count;
+        }
+        if (outstanding == 0) break;
+        if (polycall_monotonic_ns() >= drain) {
+            worker->unfinished = outstanding;
+            break;
+        }
+        worker_poll(worker, 1);
+    }
+    return NULL;
+}
+
+// Reporting
+
+static void print_text(FILE* out, const loadgen_options_t* options, const hdr_t* latency,
+                       const hdr_t* setup, const worker_t* total, unsigned int ready) {
+    fprintf(out, "polycall-loadgen %s:%s, %u connections, %u threads, ", options->host,
+            options->port, options->connections, options->threads);
+    if (options->rate > 0) {
+        fprintf(out, "%.0f req/s open loop", options->rate);
+    } else {
+        fprintf(out, "closed loop");
+    }
+    fprintf(out, ", pipeline %u, %zu B payload\n", options->pipeline, options->payload);
+    fprintf(out, "  connected %u/%u, setup p50 %.3f ms, p99 %.3f ms\n", ready, options->connections,
+            (double)hdr_percentile(setup, 50.0) / 1e6, (double)hdr_percentile(setup, 99.0) / 1e6);
+    fprintf(out, "  %llu requests completed in %.1f s, %llu errors, %llu dropped, %llu unfinished, "
+            "%llu never sent\n",
+            (unsigned long long)total->completed, options->duration,
+            (unsigned long long)total->errors, (unsigned long long)total->dropped,
+            (unsigned long long)total->unfinished, (unsigned long long)total->unsent);
+    fprintf(out, "  throughput %.1f req/s", (double)total->completed / options->duration);
+    if (options->rate > 0) {
+        fprintf(out, ", worst send lag behind schedule %.3f ms", (double)total->behind_ns / 1e6);
+    }
+    fprintf(out, "\n\n  Latency from scheduled send time (ms)%s:\n",
+            total->unsent ? ", never-sent requests counted until the end of the run" : "");
+
+    static const double marks[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+    for (size_t i = 0; i < sizeof(marks) / sizeof(marks[0]); i++) {
+        fprintf(out, "  %7g%% %10.3f\n", marks[i], (double)hdr_percentile(latency, marks[i]) / 1e6);
+    }
+    fprintf(out, "  %8s %10.3f\n\n  Detailed percentile spectrum:\n", "max",
+            (double)latency->max / 1e6);
+    hdr_print_spectrum(out, latency);
+}
+
+static void print_json(FILE* out, const loadgen_options_t* options, const hdr_t* latency,
+                       const worker_t* total, unsigned int ready) {
+    fprintf(out, "{\"host\": \"%s\", \"port\": \"%s\", \"connections\": %u, \"connected\": %u, "
+            "\"threads\": %u, \"rate\": %.1f, \"pipeline\": %u, \"payload\": %zu, \"duration_s\": %.3f,\n",
+            options->host, options->port, options->connections, ready, options->threads,
+            options->rate, options->pipeline, options->payload, options->duration);
+    fprintf(out, " \"completed\": %llu, \"errors\": %llu, \"dropped\": %llu, \"unfinished\": %llu, "
+            "\"unsent\": %llu, \"throughput\": %.1f,\n",
+            (unsigned long long)total->completed, (unsigned long long)total->errors,
+            (unsigned long long)total->dropped, (unsigned long long)total->unfinished,
+            (unsigned long long)total->unsent, (double)total->completed / options->duration);
+    fprintf(out, " \"latency_ns\": {\"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, "
+            "\"p99.9\": %llu, \"p99.99\": %llu, \"max\": %llu}}\n",
+            hdr_mean(latency),
+            (unsigned long long)hdr_percentile(latency, 50.0),
+            (unsigned long long)hdr_percentile(latency, 90.0),
+            (unsigned long long)hdr_percentile(latency, 99.0),
+            (unsigned long long)hdr_percentile(latency, 99.9),
+            (unsigned long long)hdr_percentile(latency, 99.99),
+            (unsigned long long)latency->max);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --host HOST            Server address (default 127.0.0.1)\n"
+            "  --port PORT            Server port (default 8080)\n"
+            "  --connections N        Concurrent connections (default 100)\n"
+            "  --threads N            Event loop threads (default 1)\n"
+            "  --rate R               Requests/s over all connections, 0 for closed loop\n"
+            "                         (default 10000)\n"
+            "  --duration S           Seconds measured (default 10)\n"
+            "  --warmup S             Seconds run before measuring (default 2)\n"
+            "  --pipeline N           Outstanding requests per connection (default 16)\n"
+            "  --payload BYTES        Command payload size, at most 4080 (default 64)\n"
+            "  --credentials TEXT     Sent in the AUTH message (default loadgen)\n"
+            "  --connect-timeout S    Time allowed to connect and authenticate (default 10)\n"
+            "  --json                 Print a JSON summary instead of the report\n",
+            program);
+}
+
+static bool parse_options(int argc, char** argv, loadgen_options_t* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--json") == 0) {
+            options->json = true;
+            continue;
+        }
+        if (!value) return false;
+        i++;
+        if (strcmp(arg, "--host") == 0) {
+            options->host = value;
+        } else if (strcmp(arg, "--port") == 0) {
+            options->port = value;
+        } else if (strcmp(arg, "--connections") == 0) {
+            options->connections = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options->threads = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--rate") == 0) {
+            options->rate = strtod(value, NULL);
+        } else if (strcmp(arg, "--duration") == 0) {
+            options->duration = strtod(value, NULL);
+        } else if (strcmp(arg, "--warmup") == 0) {
+            options->warmup = strtod(value, NULL);
+        } else if (strcmp(arg, "--pipeline") == 0) {
+            options->pipeline = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--payload") == 0) {
+            options->payload = strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--credentials") == 0) {
+            options->credentials = value;
+        } else if (strcmp(arg, "--connect-timeout") == 0) {
+            options->connect_timeout = strtod(value, NULL);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Thousands of connections need more than the usual 1024 descriptors
+static void raise_fd_limit(unsigned int connections) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+    rlim_t wanted = (rlim_t)connections + 64;
+    if (limit.rlim_cur >= wanted) return;
+    limit.rlim_cur = limit.rlim_max == RLIM_INFINITY || limit.rlim_max > wanted ? wanted : limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+int main(int argc, char** argv) {
+    loadgen_options_t options = {
+        .host = "127.0.0.1",
+        .port = "8080",
+        .connections = 100,
+        .threads = 1,
+        .rate = 10000,
+        .duration = 10,
+        .warmup = 2,
+        .connect_timeout = 10,
+        .pipeline = 16,
+        .payload = 64,
+        .credentials = "loadgen"
+    };
+    if (!parse_options(argc, argv, &options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.connections == 0 || options.threads == 0 || options.threads > LOADGEN_MAX_THREADS ||
+        options.pipeline == 0 || options.payload == 0 ||
+        options.duration <= 0 || options.warmup < 0 || options.rate < 0 || !options.credentials[0]) {
+        fprintf(stderr, "polycall-loadgen: invalid option value\n");
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.payload > LOADGEN_MAX_PAYLOAD) {
+        // The protocol layer would refuse every command and drop the connections
+        fprintf(stderr, "polycall-loadgen: --payload is at most %zu bytes\n", (size_t)LOADGEN_MAX_PAYLOAD);
+        return 2;
+    }
+    if (options.threads > options.connections) options.threads = options.connections;
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* address = NULL;
+    int resolved = getaddrinfo(options.host, options.port, &hints, &address);
+    if (resolved != 0) {
+        fprintf(stderr, "polycall-loadgen: %s:%s: %s\n", options.host, options.port, gai_strerror(resolved));
+        return 1;
+    }
+    raise_fd_limit(options.connections);
+
+    uint8_t* payload = malloc(options.payload);
+    worker_t* workers = calloc(options.threads, sizeof(worker_t));
+    hdr_t* merged = malloc(2 * sizeof(hdr_t));
+    if (!payload || !workers || !merged) {
+        fprintf(stderr, "polycall-loadgen: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < options.payload; i++) payload[i] = (uint8_t)('a' + i % 26);
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, options.threads + 1);
+
+    // One context per thread: contexts are not shared across event loops
+    for (unsigned int t = 0; t < options.threads; t++) {
+        worker_t* worker = &workers[t];
+        worker->options = &options;
+        worker->address = address;
+        worker->barrier = &barrier;
+        worker->payload = payload;
+        worker->conn_count = options.connections / options.threads +
+                             (t < options.connections % options.threads ? 1 : 0);
+        worker->conns = calloc(worker->conn_count, sizeof(conn_t));
+        worker->epoll_fd = epoll_create1(0);
+        hdr_reset(&worker->latency);
+        hdr_reset(&worker->setup);
+        if (options.rate > 0) worker->interval_ns = 1e9 * options.threads / options.rate;
+
+        polycall_config_t config = { .memory_pool_size = 4 * 1024 * 1024 };
+        if (!worker->conns || worker->epoll_fd < 0 ||
+            polycall_init_with_config(&worker->ctx, &config) != POLYCALL_SUCCESS ||
+            pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            // Workers already started are parked on the barrier
+            fprintf(stderr, "polycall-loadgen: failed to start worker %u\n", t);
+            return 1;
+        }
+    }
+
+    // Every worker has connected; the schedule starts now for all of them
+    pthread_barrier_wait(&barrier);
+    uint64_t start = polycall_monotonic_ns();
+    for (unsigned int t = 0; t < options.threads; t++) {
+        workers[t].start_ns = start;
+        workers[t].measure_ns = start + (uint64_t)(options.warmup * 1e9);
+    }
+    pthread_barrier_wait(&barrier);
+    for (unsigned int t = 0; t < options.threads; t++) pthread_join(workers[t].thread, NULL);
+
+    hdr_t* latency = &merged[0];
+    hdr_t* setup = &merged[1];
+    hdr_reset(latency);
+    hdr_reset(setup);
+    worker_t total = { 0 };
+    unsigned int ready = 0;
+    for (unsigned int t = 0; t < options.threads; t++) {
+        worker_t* worker = &workers[t];
+        hdr_merge(latency, &worker->latency);
+        hdr_merge(setup, &worker->setup);
+        total.completed += worker->completed;
+        total.errors += worker->errors;
+        total.dropped += worker->dropped;
+        total.unfinished += worker->unfinished;
+        total.unsent += worker->unsent;
+        total.connect_failures += worker->connect_failures;
+        if (worker->behind_ns > total.behind_ns) total.behind_ns = worker->behind_ns;
+        ready += (unsigned int)worker->setup.total;
+    }
+
+    int status = 0;
+    if (ready == 0) {
+        fprintf(stderr, "polycall-loadgen: no connection to %s:%s reached READY\n",
+                options.host, options.port);
+        status = 1;
+    } else if (options.json) {
+        print_json(stdout, &options, latency, &total, ready);
+    } else {
+        print_text(stdout, &options, latency, setup, &total, ready);
+    }
+
+    for (unsigned int t = 0; t < options.threads; t++) {
+        worker_t* worker = &workers[t];
+        for (unsigned int i = 0; i < worker->conn_count && worker->conns; i++) {
+            conn_release(&worker->conns[i]);
+        }
+        free(worker->conns);
+        if (worker->epoll_fd >= 0) close(worker->epoll_fd);
+        if (worker->ctx) polycall_cleanup(worker->ctx);
+    }
+    pthread_barrier_destroy(&barrier);
+    freeaddrinfo(address);
+    free(merged);
+    free(workers);
+    free(payload);
+    return status;
+}
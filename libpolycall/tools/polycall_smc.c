@@ -0,0 +1,454 @@
+// polycall-smc - PolyCall state machine compiler
+//
+// Reads a declarative state machine description and emits a C header and
+// source pair holding constant state/transition tables, state and event
+// enums, a PolyCall_StateMachineDef and an inline event dispatcher.
+//
+// Input format (one declaration per line, '#' starts a comment):
+//
+//   machine NAME
+//   state NAME [enter=SYMBOL] [exit=SYMBOL] [final]
+//   initial STATE
+//   transition NAME FROM -> TO [event=EVENT] [action=SYMBOL] [guard=SYMBOL]
+//                              [async | async=SYMBOL]
+//
+// 'async' runs the transition's callbacks on the machine's worker pool;
+// async=SYMBOL also names a PolyCall_AsyncAction that may finish later.
+// The event defaults to the transition name. One event may be shared by
+// several transitions as long as their source states differ.
+#include "polycall.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+#define SMC_MAX_LINE 512
+#define SMC_MAX_EVENTS POLYCALL_MAX_TRANSITIONS
+#define SMC_MAX_SYMBOL 128
+
+typedef struct {
+    char name[POLYCALL_MAX_NAME_LENGTH];
+    char on_enter[SMC_MAX_SYMBOL];
+    char on_exit[SMC_MAX_SYMBOL];
+    bool is_final;
+} smc_state_t;
+
+typedef struct {
+    char name[POLYCALL_MAX_NAME_LENGTH];
+    unsigned int from_state;
+    unsigned int to_state;
+    unsigned int event;
+    char action[SMC_MAX_SYMBOL];
+    char guard[SMC_MAX_SYMBOL];
+    char async_action[SMC_MAX_SYMBOL];
+    bool is_async;
+} smc_transition_t;
+
+typedef struct {
+    char name[SMC_MAX_SYMBOL];
+    smc_state_t states[POLYCALL_MAX_STATES];
+    unsigned int num_states;
+    smc_transition_t transitions[POLYCALL_MAX_TRANSITIONS];
+    unsigned int num_transitions;
+    char events[SMC_MAX_EVENTS][POLYCALL_MAX_NAME_LENGTH];
+    unsigned int num_events;
+    char initial[POLYCALL_MAX_NAME_LENGTH];
+} smc_machine_t;
+
+static const char* g_input_path = "<input>";
+static unsigned int g_line = 0;
+
+static void smc_error(const char* message, const char* detail) {
+    fprintf(stderr, "%s:%u: error: %s%s%s\n", g_input_path, g_line, message,
+            detail ? ": " : "", detail ? detail : "");
+    exit(1);
+}
+
+static bool is_identifier(const char* text) {
+    if (!text || !*text || (!isalpha((unsigned char)*text) && *text != '_')) return false;
+    for (const char* p = text; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '_') return false;
+    }
+    return true;
+}
+
+static void copy_name(char* dst, size_t size, const char* src) {
+    if (!is_identifier(src)) smc_error("invalid identifier", src);
+    if (strlen(src) >= size) smc_error("name too long", src);
+    strcpy(dst, src);
+}
+
+static int find_state(const smc_machine_t* m, const char* name) {
+    for (unsigned int i = 0; i < m->num_states; i++) {
+        if (strcmp(m->states[i].name, name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static unsigned int intern_event(smc_machine_t* m, const char* name) {
+    for (unsigned int i = 0; i < m->num_events; i++) {
+        if (strcmp(m->events[i], name) == 0) return i;
+    }
+    if (m->num_events >= SMC_MAX_EVENTS) smc_error("too many events", name);
+    copy_name(m->events[m->num_events], POLYCALL_MAX_NAME_LENGTH, name);
+    return m->num_events++;
+}
+
+// Split "key=value"; returns value or NULL for bare words
+static char* split_option(char* token) {
+    char* eq = strchr(token, '=');
+    if (!eq) return NULL;
+    *eq = '\0';
+    return eq + 1;
+}
+
+static void parse_state(smc_machine_t* m, char** tokens, int count) {
+    if (count < 2) smc_error("expected: state NAME [enter=SYM] [exit=SYM] [final]", NULL);
+    if (m->num_states >= POLYCALL_MAX_STATES) smc_error("too many states", tokens[1]);
+    if (find_state(m, tokens[1]) >= 0) smc_error("duplicate state", tokens[1]);
+
+    smc_state_t* state = &m->states[m->num_states];
+    memset(state, 0, sizeof(*state));
+    copy_name(state->name, sizeof(state->name), tokens[1]);
+
+    for (int i = 2; i < count; i++) {
+        char* value = split_option(tokens[i]);
+        if (!value && strcmp(tokens[i], "final") == 0) {
+            state->is_final = true;
+        } else if (value && strcmp(tokens[i], "enter") == 0) {
+            copy_name(state->on_enter, sizeof(state->on_enter), value);
+        } else if (value && strcmp(tokens[i], "exit") == 0) {
+            copy_name(state->on_exit, sizeof(state->on_exit), value);
+        } else {
+            smc_error("unknown state option", tokens[i]);
+        }
+    }
+
+    m->num_states++;
+}
+
+static void parse_transition(smc_machine_t* m, char** tokens, int count) {
+    if (count < 5 || strcmp(tokens[3], "->") != 0)
+        smc_error("expected: transition NAME FROM -> TO [event=E] [action=SYM] [guard=SYM]", NULL);
+    if (m->num_transitions >= POLYCALL_MAX_TRANSITIONS) smc_error("too many transitions", tokens[1]);
+
+    for (unsigned int i = 0; i < m->num_transitions; i++) {
+        if (strcmp(m->transitions[i].name, tokens[1]) == 0) smc_error("duplicate transition", tokens[1]);
+    }
+
+    int from = find_state(m, tokens[2]);
+    int to = find_state(m, tokens[4]);
+    if (from < 0) smc_error("unknown state", tokens[2]);
+    if (to < 0) smc_error("unknown state", tokens[4]);
+
+    smc_transition_t* transition = &m->transitions[m->num_transitions];
+    memset(transition, 0, sizeof(*transition));
+    copy_name(transition->name, sizeof(transition->name), tokens[1]);
+    transition->from_state = (unsigned int)from;
+    transition->to_state = (unsigned int)to;
+
+    const char* event = tokens[1];
+    for (int i = 5; i < count; i++) {
+        char* value = split_option(tokens[i]);
+        if (!value && strcmp(tokens[i], "async") == 0) {
+            transition->is_async = true;
+        } else if (!value) {
+            smc_error("unknown transition option", tokens[i]);
+        } else if (strcmp(tokens[i], "async") == 0) {
+            transition->is_async = true;
+            copy_name(transition->async_action, sizeof(transition->async_action), value);
+        } else if (strcmp(tokens[i], "event") == 0) {
+            event = value;
+        } else if (strcmp(tokens[i], "action") == 0) {
+            copy_name(transition->action, sizeof(transition->action), value);
+        } else if (strcmp(tokens[i], "guard") == 0) {
+            copy_name(transition->guard, sizeof(transition->guard), value);
+        } else {
+            smc_error("unknown transition option", tokens[i]);
+        }
+    }
+    transition->event = intern_event(m, event);
+
+    // Dispatch must be deterministic: one transition per (state, event)
+    for (unsigned int i = 0; i < m->num_transitions; i++) {
+        if (m->transitions[i].from_state == transition->from_state &&
+            m->transitions[i].event == transition->event) {
+            smc_error("event already handled in this state", event);
+        }
+    }
+
+    m->num_transitions++;
+}
+
+static void parse_file(FILE* in, smc_machine_t* m) {
+    char line[SMC_MAX_LINE];
+
+    while (fgets(line, sizeof(line), in)) {
+        g_line++;
+
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char* tokens[16];
+        int count = 0;
+        for (char* tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+            if (count == 16) smc_error("too many tokens", NULL);
+            tokens[count++] = tok;
+        }
+        if (count == 0) continue;
+
+        if (strcmp(tokens[0], "machine") == 0 && count == 2) {
+            copy_name(m->name, sizeof(m->name), tokens[1]);
+        } else if (strcmp(tokens[0], "state") == 0) {
+            parse_state(m, tokens, count);
+        } else if (strcmp(tokens[0], "initial") == 0 && count == 2) {
+            copy_name(m->initial, sizeof(m->initial), tokens[1]);
+        } else if (strcmp(tokens[0], "transition") == 0) {
+            parse_transition(m, tokens, count);
+        } else {
+            smc_error("unknown declaration", tokens[0]);
+        }
+    }
+
+    g_line = 0;
+    if (!m->name[0]) smc_error("missing 'machine' declaration", NULL);
+    if (m->num_states == 0) smc_error("machine has no states", m->name);
+    if (m->initial[0] && find_state(m, m->initial) < 0) smc_error("unknown initial state", m->initial);
+}
+
+static void upper(char* dst, const char* src) {
+    while (*src) *dst++ = (char)toupper((unsigned char)*src++);
+    *dst = '\0';
+}
+
+static const char* basename_of(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static void emit_header(FILE* out, const smc_machine_t* m, const char* guard_name) {
+    char prefix[SMC_MAX_SYMBOL];
+    char item[SMC_MAX_SYMBOL];
+    upper(prefix, m->name);
+
+    fprintf(out, "/* Generated by polycall-smc from %s - do not edit */\n", basename_of(g_input_path));
+    fprintf(out, "#ifndef %s\n#define %s\n\n", guard_name, guard_name);
+    fprintf(out, "#include \"polycall_state_machine.h\"\n\n");
+    fprintf(out, "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n");
+
+    fprintf(out, "typedef enum {\n");
+    for (unsigned int i = 0; i < m->num_states; i++) {
+        upper(item, m->states[i].name);
+        fprintf(out, "    %s_STATE_%s = %u,\n", prefix, item, i);
+    }
+    fprintf(out, "    %s_STATE_COUNT = %u\n} %s_state_t;\n\n", prefix, m->num_states, m->name);
+
+    fprintf(out, "typedef enum {\n");
+    for (unsigned int i = 0; i < m->num_events; i++) {
+        upper(item, m->events[i]);
+        fprintf(out, "    %s_EVENT_%s = %u,\n", prefix, item, i);
+    }
+    fprintf(out, "    %s_EVENT_COUNT = %u\n} %s_event_t;\n\n", prefix, m->num_events, m->name);
+
+    fprintf(out, "typedef enum {\n");
+    for (unsigned int i = 0; i < m->num_transitions; i++) {
+        upper(item, m->transitions[i].name);
+        fprintf(out, "    %s_TRANSITION_%s = %u,\n", prefix, item, i);
+    }
+    fprintf(out, "    %s_TRANSITION_COUNT = %u\n} %s_transition_t;\n\n",
+            prefix, m->num_transitions, m->name);
+
+    fprintf(out, "extern const PolyCall_StateMachineDef %s_sm_def;\n\n", m->name);
+
+    // Dispatcher specialized on the constant (state, event) table
+    fprintf(out, "static inline polycall_sm_status_t %s_sm_dispatch(\n"
+                 "    PolyCall_StateMachine* sm,\n"
+                 "    %s_event_t event\n) {\n", m->name, m->name);
+    fprintf(out, "    switch (sm->current_state) {\n");
+    for (unsigned int s = 0; s < m->num_states; s++) {
+        bool has_any = false;
+        for (unsigned int t = 0; t < m->num_transitions; t++) {
+            if (m->transitions[t].from_state == s) has_any = true;
+        }
+        if (!has_any) continue;
+
+        upper(item, m->states[s].name);
+        fprintf(out, "        case %s_STATE_%s:\n", prefix, item);
+        fprintf(out, "            switch (event) {\n");
+        for (unsigned int t = 0; t < m->num_transitions; t++) {
+            if (m->transitions[t].from_state != s) continue;
+            char event_name[SMC_MAX_SYMBOL];
+            char transition_name[SMC_MAX_SYMBOL];
+            upper(event_name, m->events[m->transitions[t].event]);
+            upper(transition_name, m->transitions[t].name);
+            fprintf(out, "                case %s_EVENT_%s:\n", prefix, event_name);
+            fprintf(out, "                    return polycall_sm_execute_transition_id(sm, %s_TRANSITION_%s);\n",
+                    prefix, transition_name);
+        }
+        fprintf(out, "                default:\n                    break;\n");
+        fprintf(out, "            }\n            break;\n");
+    }
+    fprintf(out, "        default:\n            break;\n    }\n");
+    fprintf(out, "    return POLYCALL_SM_ERROR_INVALID_TRANSITION;\n}\n\n");
+
+    fprintf(out, "#ifdef __cplusplus\n}\n#endif\n\n#endif /* %s */\n", guard_name);
+}
+
+typedef enum {
+    SYMBOL_STATE_ACTION,
+    SYMBOL_GUARD,
+    SYMBOL_ASYNC_ACTION
+} smc_symbol_kind_t;
+
+static void emit_symbol_decl(FILE* out, const char* symbol, smc_symbol_kind_t kind,
+                             char declared[][SMC_MAX_SYMBOL], unsigned int* declared_count) {
+    if (!symbol[0]) return;
+    for (unsigned int i = 0; i < *declared_count; i++) {
+        if (strcmp(declared[i], symbol) == 0) return;
+    }
+    strcpy(declared[(*declared_count)++], symbol);
+
+    switch (kind) {
+        case SYMBOL_GUARD:
+            fprintf(out, "bool %s(const PolyCall_State* from, const PolyCall_State* to);\n", symbol);
+            break;
+        case SYMBOL_ASYNC_ACTION:
+            fprintf(out, "polycall_sm_action_result_t %s(polycall_context_t ctx, "
+                         "PolyCall_AsyncToken* token);\n", symbol);
+            break;
+        default:
+            fprintf(out, "void %s(polycall_context_t ctx);\n", symbol);
+            break;
+    }
+}
+
+static void emit_source(FILE* out, const smc_machine_t* m, const char* header_name) {
+    static char declared[POLYCALL_MAX_STATES * 2 + POLYCALL_MAX_TRANSITIONS * 3][SMC_MAX_SYMBOL];
+    unsigned int declared_count = 0;
+    int initial = m->initial[0] ? find_state(m, m->initial) : 0;
+
+    fprintf(out, "/* Generated by polycall-smc from %s - do not edit */\n", basename_of(g_input_path));
+    fprintf(out, "#include \"%s\"\n\n", header_name);
+
+    fprintf(out, "/* Callbacks provided by the application */\n");
+    for (unsigned int i = 0; i < m->num_states; i++) {
+        emit_symbol_decl(out, m->states[i].on_enter, SYMBOL_STATE_ACTION, declared, &declared_count);
+        emit_symbol_decl(out, m->states[i].on_exit, SYMBOL_STATE_ACTION, declared, &declared_count);
+    }
+    for (unsigned int i = 0; i < m->num_transitions; i++) {
+        emit_symbol_decl(out, m->transitions[i].action, SYMBOL_STATE_ACTION, declared, &declared_count);
+        emit_symbol_decl(out, m->transitions[i].guard, SYMBOL_GUARD, declared, &declared_count);
+        emit_symbol_decl(out, m->transitions[i].async_action, SYMBOL_ASYNC_ACTION,
+                         declared, &declared_count);
+    }
+
+    fprintf(out, "\nstatic const PolyCall_State %s_states[%u] = {\n", m->name, m->num_states);
+    for (unsigned int i = 0; i < m->num_states; i++) {
+        const smc_state_t* s = &m->states[i];
+        fprintf(out, "    { .name = \"%s\", .on_enter = %s, .on_exit = %s, .is_final = %s, "
+                     ".id = %u, .version = 1 },\n",
+                s->name,
+                s->on_enter[0] ? s->on_enter : "NULL",
+                s->on_exit[0] ? s->on_exit : "NULL",
+                s->is_final ? "true" : "false", i);
+    }
+    fprintf(out, "};\n\n");
+
+    if (m->num_transitions > 0) {
+        fprintf(out, "static const PolyCall_Transition %s_transitions[%u] = {\n",
+                m->name, m->num_transitions);
+        for (unsigned int i = 0; i < m->num_transitions; i++) {
+            const smc_transition_t* t = &m->transitions[i];
+            fprintf(out, "    { .name = \"%s\", .from_state = %u, .to_state = %u, .action = %s, "
+                         ".is_valid = true, .guard_condition = %s, .is_async = %s, .async_action = %s },\n",
+                    t->name, t->from_state, t->to_state,
+                    t->action[0] ? t->action : "NULL",
+                    t->guard[0] ? t->guard : "NULL",
+                    t->is_async ? "true" : "false",
+                    t->async_action[0] ? t->async_action : "NULL");
+        }
+        fprintf(out, "};\n\n");
+    }
+
+    fprintf(out, "const PolyCall_StateMachineDef %s_sm_def = {\n", m->name);
+    fprintf(out, "    .name = \"%s\",\n", m->name);
+    fprintf(out, "    .states = %s_states,\n", m->name);
+    fprintf(out, "    .num_states = %u,\n", m->num_states);
+    if (m->num_transitions > 0) {
+        fprintf(out, "    .transitions = %s_transitions,\n", m->name);
+    } else {
+        fprintf(out, "    .transitions = NULL,\n");
+    }
+    fprintf(out, "    .num_transitions = %u,\n", m->num_transitions);
+    fprintf(out, "    .initial_state = %d\n};\n", initial);
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "Usage: %s -o OUTPUT_BASE INPUT.sm\n", argv0);
+    fprintf(stderr, "Writes OUTPUT_BASE.h and OUTPUT_BASE.c\n");
+}
+
+int main(int argc, char** argv) {
+    const char* output_base = NULL;
+    const char* input_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_base = argv[++i];
+        } else if (!input_path) {
+            input_path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!output_base || !input_path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(input_path, "r");
+    if (!in) {
+        perror(input_path);
+        return 1;
+    }
+
+    static smc_machine_t machine;
+    g_input_path = input_path;
+    parse_file(in, &machine);
+    fclose(in);
+
+    size_t base_len = strlen(output_base);
+    char* header_path = malloc(base_len + 3);
+    char* source_path = malloc(base_len + 3);
+    if (!header_path || !source_path) return 1;
+    sprintf(header_path, "%s.h", output_base);
+    sprintf(source_path, "%s.c", output_base);
+
+    char guard_name[SMC_MAX_SYMBOL + 8];
+    char base_name[SMC_MAX_SYMBOL];
+    snprintf(base_name, sizeof(base_name), "%s", basename_of(output_base));
+    upper(guard_name, base_name);
+    for (char* p = guard_name; *p; p++) {
+        if (!isalnum((unsigned char)*p)) *p = '_';
+    }
+    strcat(guard_name, "_H");
+
+    FILE* header = fopen(header_path, "w");
+    FILE* source = fopen(source_path, "w");
+    if (!header || !source) {
+        perror(output_base);
+        return 1;
+    }
+
+    emit_header(header, &machine, guard_name);
+    emit_source(source, &machine, basename_of(header_path));
+
+    fclose(header);
+    fclose(source);
+    free(header_path);
+    free(source_path);
+    return 0;
+}